@@ -1,7 +1,9 @@
+import 'dart:io';
 import 'package:flutter/material.dart';
 import 'package:flutter_svg/flutter_svg.dart';
 import 'package:sino_scanner/services/PassportData.dart';
 import 'package:sino_scanner/services/ScanResult.dart';
+import '../services/ImagePathHelper.dart';
 import '../services/sinosecuReader.dart';
 
 class HomeScreen extends StatefulWidget {
@@ -18,6 +20,7 @@ class _HomeScreenState extends State<HomeScreen> {
   PassportData? _passportData;
   Map<String, dynamic>? _rawScanData;
   List<String>? _savedImagePaths;
+  Map<String, dynamic>? _scanTextures;
   bool _saveImages = true;
   bool _enableDebugMode = false;
 
@@ -102,24 +105,36 @@ class _HomeScreenState extends State<HomeScreen> {
     });
 
     try {
+      String customName = 'passport_${DateTime.now().millisecondsSinceEpoch}';
       // Use the enhanced scan method
       ScanResult result = await SinosecuReader.performCompleteScan(
         timeoutSeconds: 20,
         enableDebug: _enableDebugMode,
         validateData: true,
-        saveImages: _saveImages,
-        customName: 'passport_${DateTime.now().millisecondsSinceEpoch}',
+        customName: customName,
         cleanupOld: true,
       );
 
       if (result.success) {
+        // Straight from the scan into textures first; saving to disk, if on,
+        // is archival and queued behind them on the SDK thread, whether or
+        // not the textures could be shown.
+        Map<String, dynamic> images = await SinosecuReader.showScanImages();
+        if (!mounted) return;
         setState(() {
+          _scanTextures = images['textures'] != null ? Map<String, dynamic>.from(images['textures']) : null;
           _statusText = 'Document scanned successfully!';
           _passportData = result.passportData;
           _rawScanData = result.rawScanData;
-          _savedImagePaths = result.savedImagePaths;
           _isScanning = false;
         });
+        if (_saveImages) {
+          Map<String, dynamic> saved = await SinosecuReader.savePassportImages(customName: customName);
+          if (!mounted) return;
+          setState(() {
+            _savedImagePaths = saved['success'] == true ? List<String>.from(saved['savedFiles'] ?? []) : null;
+          });
+        }
       } else {
         setState(() {
           _statusText = 'Scan failed: ${result.error}';
@@ -171,6 +186,18 @@ class _HomeScreenState extends State<HomeScreen> {
         return;
       }
 
+      // Previews are written in the background after a save, so look for
+      // them now rather than per frame; missing ones fall back below.
+      Map<String, String> thumbnails = {};
+      Map<String, String> previews = {};
+      for (String imagePath in imagePaths) {
+        String thumbnail = ImagePathHelper.previewPath(imagePath, ImagePathHelper.thumbnailEdge);
+        String preview = ImagePathHelper.previewPath(imagePath, ImagePathHelper.previewEdge);
+        if (await File(thumbnail).exists()) thumbnails[imagePath] = thumbnail;
+        if (await File(preview).exists()) previews[imagePath] = preview;
+      }
+      if (!mounted) return;
+
       showDialog(
         context: context,
         builder: (context) => AlertDialog(
@@ -183,18 +210,15 @@ class _HomeScreenState extends State<HomeScreen> {
               itemBuilder: (context, index) {
                 String imagePath = imagePaths[index];
                 String fileName = imagePath.split('/').last;
+                String? thumbnail = thumbnails[imagePath];
 
                 return ListTile(
-                  leading: const Icon(Icons.image),
+                  leading: thumbnail != null
+                      ? Image.file(File(thumbnail), width: 56, height: 56, fit: BoxFit.cover, cacheWidth: 112)
+                      : const Icon(Icons.image),
                   title: Text(fileName),
                   subtitle: Text(imagePath),
-                  onTap: () {
-                    // You could implement image viewing here
-                    Navigator.of(context).pop();
-                    ScaffoldMessenger.of(context).showSnackBar(
-                      SnackBar(content: Text('Image path: $imagePath')),
-                    );
-                  },
+                  onTap: () => _showImage(previews[imagePath] ?? imagePath, fileName),
                 );
               },
             ),
@@ -214,6 +238,26 @@ class _HomeScreenState extends State<HomeScreen> {
     }
   }
 
+  void _showImage(String imagePath, String title) {
+    showDialog(
+      context: context,
+      builder: (context) => AlertDialog(
+        title: Text(title),
+        content: Image.file(
+          File(imagePath),
+          fit: BoxFit.contain,
+          errorBuilder: (context, error, stackTrace) => Text('Cannot show $imagePath'),
+        ),
+        actions: [
+          TextButton(
+            onPressed: () => Navigator.of(context).pop(),
+            child: const Text('Close'),
+          ),
+        ],
+      ),
+    );
+  }
+
   @override
   Widget build(BuildContext context) {
     return Scaffold(
@@ -388,6 +432,10 @@ class _HomeScreenState extends State<HomeScreen> {
               ],
 
               // Saved Images Display
+              if (_scanTextures != null && _scanTextures!.isNotEmpty) ...[
+                const SizedBox(height: 10),
+                _buildScanImagesCard(),
+              ],
               if (_savedImagePaths != null && _savedImagePaths!.isNotEmpty) ...[
                 const SizedBox(height: 10),
                 _buildSavedImagesCard(),
@@ -546,6 +594,49 @@ class _HomeScreenState extends State<HomeScreen> {
     );
   }
 
+  Widget _buildScanImagesCard() {
+    const Map<String, String> labels = {
+      '.jpg': 'White',
+      '_IR.jpg': 'IR',
+      '_UV.jpg': 'UV',
+      '_Head.jpg': 'Portrait',
+      '_HeadEc.jpg': 'Chip portrait',
+    };
+    return Card(
+      elevation: 2,
+      margin: const EdgeInsets.symmetric(vertical: 5),
+      child: ExpansionTile(
+        title: const Text("Scan Images", style: TextStyle(fontSize: 16, fontWeight: FontWeight.w600)),
+        initiallyExpanded: true,
+        children: [
+          Padding(
+            padding: const EdgeInsets.all(12.0),
+            child: Wrap(
+              spacing: 12,
+              runSpacing: 12,
+              children: [
+                for (MapEntry<String, dynamic> plane in _scanTextures!.entries)
+                  SizedBox(
+                    width: 240,
+                    child: Column(
+                      children: [
+                        AspectRatio(
+                          aspectRatio: (plane.value['width'] as int) / (plane.value['height'] as int),
+                          child: Texture(textureId: plane.value['id'] as int),
+                        ),
+                        const SizedBox(height: 4),
+                        Text(labels[plane.key] ?? plane.key, style: const TextStyle(fontSize: 12)),
+                      ],
+                    ),
+                  ),
+              ],
+            ),
+          ),
+        ],
+      ),
+    );
+  }
+
   Widget _buildSavedImagesCard() {
     return Card(
       elevation: 2,
@@ -65,6 +65,17 @@ class ImagePathHelper {
     return path.join(passportsDir, fileName);
   }
 
+  // Preview edges the native side writes by default (SINO_SCANNER_PREVIEWS)
+  static const int thumbnailEdge = 256;
+  static const int previewEdge = 768;
+
+  // Path of the preview of an image for a given edge:
+  // passports/p_IR.jpg -> passports/previews/p_IR@256.jpg
+  static String previewPath(String imagePath, int edge) {
+    return path.join(path.dirname(imagePath), 'previews',
+        '${path.basenameWithoutExtension(imagePath)}@$edge.jpg');
+  }
+
   // Clean up old images (optional - keep only last N images)
   static Future<void> cleanupOldImages({int keepCount = 50}) async {
     try {
@@ -90,6 +101,13 @@ class ImagePathHelper {
           for (int i = keepCount; i < imageFiles.length; i++) {
             await imageFiles[i].delete();
             print('[Flutter] Deleted old image: ${imageFiles[i].path}');
+
+            for (int edge in [thumbnailEdge, previewEdge]) {
+              File preview = File(previewPath(imageFiles[i].path, edge));
+              if (await preview.exists()) {
+                await preview.delete();
+              }
+            }
           }
         }
       }
@@ -8,6 +8,9 @@ import 'ScanResult.dart';
 
 class SinosecuReader {
   static const MethodChannel _channel = MethodChannel('com.example.sino_scanner');
+  static const EventChannel _detectionChannel = EventChannel('com.example.sino_scanner/detection');
+  static const EventChannel _kioskChannel = EventChannel('com.example.sino_scanner/kiosk');
+  static const EventChannel _readinessChannel = EventChannel('com.example.sino_scanner/readiness');
 
   static Future<int> initializeScanner({
     required String userId,
@@ -37,6 +40,29 @@ class SinosecuReader {
     }
   }
 
+  // The native side warms the SDK up at start-up when it has settings (from
+  // the environment, or saved after the last successful initializeScanner).
+  // Readiness map:
+  //   {"state": "idle" | "warming" | "ready" | "failed", "source": "warmup" | "channel",
+  //    "result": <initializeScanner result>, "time_to_ready_us": n,
+  //    "phases_us": {"verify", "init_sdk", "config_file", "document_types", "total"}}
+  static Future<Map<String, dynamic>> getScannerReadiness() async {
+    try {
+      final Map<dynamic, dynamic>? result = await _channel.invokeMethod('getScannerReadiness');
+      return result != null ? Map<String, dynamic>.from(result) : {};
+    } on PlatformException catch (e) {
+      print('[Flutter] Failed to get scanner readiness: ${e.message}');
+      return {};
+    }
+  }
+
+  // Same map as getScannerReadiness, sent on listen and on every change.
+  static Stream<Map<String, dynamic>> readinessEvents() {
+    return _readinessChannel.receiveBroadcastStream().map((event) {
+      return Map<String, dynamic>.from(event as Map);
+    });
+  }
+
   // The SDK's DetectDocument returns an int.
   static Future<int> detectDocument() async {
     try {
@@ -58,6 +84,63 @@ class SinosecuReader {
     }
   }
 
+  // Push-based detection: the native side polls DetectDocument once and only
+  // sends state changes. Each event is a map:
+  //   {"state": "empty" | "placed" | "removed" | "phone_barcode" | "device_lost" | "error",
+  //    "code": <raw DetectDocument / error code>, "timestampMs": <monotonic ms>}
+  // The native poll loop runs while at least one listener is subscribed.
+  static Stream<Map<String, dynamic>> detectionEvents() {
+    return _detectionChannel.receiveBroadcastStream().map((event) {
+      final Map<String, dynamic> detection = Map<String, dynamic>.from(event as Map);
+      print('[Flutter] Detection event: $detection');
+      return detection;
+    });
+  }
+
+  // Continuous scan mode: every document placed on the reader is scanned
+  // without a scanDocumentComplete call. Results arrive on kioskScans().
+  static Future<bool> startKioskMode({
+    String? imageDirectory,
+    int imageTypes = 0x1F,
+    String? archiveDirectory,
+    int workers = 2,
+  }) async {
+    try {
+      final bool result = await _channel.invokeMethod('startKioskMode', {
+        if (imageDirectory != null) 'imageDirectory': imageDirectory,
+        'imageTypes': imageTypes,
+        if (archiveDirectory != null) 'archiveDirectory': archiveDirectory,
+        'workers': workers,
+      });
+      return result;
+    } on PlatformException catch (e) {
+      print('[Flutter] Failed to start kiosk mode: ${e.message}');
+      return false;
+    }
+  }
+
+  // Returns the pipeline counters: documents, completed, failed,
+  // backpressure_waits, in_flight.
+  static Future<Map<String, dynamic>> stopKioskMode() async {
+    try {
+      final Map<dynamic, dynamic>? result = await _channel.invokeMethod('stopKioskMode');
+      return result != null ? Map<String, dynamic>.from(result) : {};
+    } on PlatformException catch (e) {
+      print('[Flutter] Failed to stop kiosk mode: ${e.message}');
+      return {};
+    }
+  }
+
+  // One event per document scanned in kiosk mode:
+  //   {"sequence": n, "result": <scanDocumentComplete map>, "images_saved": bool,
+  //    "image_base": path, "archive_path": path, "valid": {"passport_number", "dates", "mrz"},
+  //    "sdk_us": n, "post_process_us": n}
+  static Stream<Map<String, dynamic>> kioskScans() {
+    return _kioskChannel.receiveBroadcastStream().map((event) {
+      return Map<String, dynamic>.from(event as Map);
+    });
+  }
+
   // Wait for document detection with timeout
   static Future<int> waitForDocumentDetection(int timeoutSeconds) async {
     try {
@@ -309,6 +392,29 @@ class SinosecuReader {
     }
   }
 
+  // Shows the images of the last scan as textures:
+  // {'sequence': n, 'textures': {'<suffix>': {'id', 'width', 'height'}}}, keyed
+  // by file suffix ('.jpg' white, '_IR.jpg', '_UV.jpg', ...). Texture ids stay
+  // the same from scan to scan. With archivePath the images are also saved
+  // there, after the textures and whether or not they could be shown;
+  // nothing waits for that, so use savePassportImages when the saved paths
+  // are needed.
+  static Future<Map<String, dynamic>> showScanImages({int imageTypes = 0x1F, String? archivePath}) async {
+    try {
+      final Map<dynamic, dynamic>? result = await _channel.invokeMethod('showScanImages', {
+        'imageTypes': imageTypes,
+        if (archivePath != null) 'archivePath': archivePath,
+      });
+      return result != null ? Map<String, dynamic>.from(result) : {};
+    } on PlatformException catch (e) {
+      print('[Flutter] Failed to show scan images: ${e.message}');
+      return {};
+    } catch (e) {
+      print('[Flutter] Unknown error during showScanImages: $e');
+      return {};
+    }
+  }
+
   // Load configuration file
   static Future<int> loadConfiguration(String configPath) async {
     configPath = "/home/kinektek/sino_scanner/build/linux/arm64/release/bundle/lib/IDCardConfig.ini";
@@ -342,6 +448,55 @@ class SinosecuReader {
     }
   }
 
+  // Per-stage scan latency (microseconds) by document type:
+  // {'documents': {'<type>': {'scans': n, 'stages': {'<stage>': {'p50_us': .., 'p99_us': .., ...}}}},
+  //  'failures': {...}}. The 'all' document merges every type.
+  static Future<Map<String, dynamic>> getScanMetrics({bool reset = false}) async {
+    try {
+      final Map<dynamic, dynamic>? result = await _channel.invokeMethod('getScanMetrics', {
+        'reset': reset,
+      });
+      return result != null ? Map<String, dynamic>.from(result) : {};
+    } on PlatformException catch (e) {
+      print('[Flutter] Failed to get scan metrics: ${e.message}');
+      return {};
+    } catch (e) {
+      print('[Flutter] Unknown error during getScanMetrics: $e');
+      return {};
+    }
+  }
+
+  // Records every SDK call into a trace the mock SDK can replay. Returns the
+  // trace path, or null if it could not be created.
+  static Future<String?> startSdkTrace({String? path, bool compress = false}) async {
+    try {
+      return await _channel.invokeMethod<String>('startSdkTrace', {
+        if (path != null) 'path': path,
+        'compress': compress,
+      });
+    } on PlatformException catch (e) {
+      print('[Flutter] Failed to start SDK trace: ${e.message}');
+      return null;
+    } catch (e) {
+      print('[Flutter] Unknown error during startSdkTrace: $e');
+      return null;
+    }
+  }
+
+  // {'path', 'records', 'dropped', 'bytes', 'compressed'} of the closed trace.
+  static Future<Map<String, dynamic>> stopSdkTrace() async {
+    try {
+      final Map<dynamic, dynamic>? result = await _channel.invokeMethod('stopSdkTrace');
+      return result != null ? Map<String, dynamic>.from(result) : {};
+    } on PlatformException catch (e) {
+      print('[Flutter] Failed to stop SDK trace: ${e.message}');
+      return {};
+    } catch (e) {
+      print('[Flutter] Unknown error during stopSdkTrace: $e');
+      return {};
+    }
+  }
+
   static Future<void> releaseScanner() async {
     try {
       await _channel.invokeMethod('releaseScanner');
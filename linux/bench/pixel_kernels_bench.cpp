@@ -0,0 +1,181 @@
+// Micro-benchmark for pixel_kernels: the dispatched SIMD kernels against
+// the scalar reference, on a page-sized capture.
+//
+//   cmake -DSINO_SCANNER_BUILD_BENCHMARKS=ON ... && ./pixel_kernels_bench [iterations]
+#include "pixel_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The reader's white-light page image.
+constexpr size_t kWidth = 2048;
+constexpr size_t kHeight = 1536;
+
+std::vector<uint8_t> noise(size_t bytes, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::vector<uint8_t> data(bytes);
+    for (auto& byte : data) byte = static_cast<uint8_t>(random());
+    return data;
+}
+
+bool same(const char* kernel, size_t pixels, const std::vector<uint8_t>& simd, const std::vector<uint8_t>& scalar) {
+    if (simd == scalar) {
+        return true;
+    }
+    std::fprintf(stderr, "%s: SIMD and scalar output differ at %zu pixels\n", kernel, pixels);
+    return false;
+}
+
+// Every kernel at sizes around its block lengths, so the tails are covered.
+bool crossCheck() {
+    for (size_t pixels = 0; pixels < 100; pixels++) {
+        std::vector<uint8_t> gray = noise(pixels, 1);
+        std::vector<uint8_t> rgb = noise(pixels * 3, 2);
+        std::vector<uint8_t> rgba = noise(pixels * 4, 3);
+
+        std::vector<uint8_t> a(pixels * 4), b(pixels * 4);
+        grayToRgba(gray.data(), a.data(), pixels);
+        grayToRgbaScalar(gray.data(), b.data(), pixels);
+        if (!same("grayToRgba", pixels, a, b)) return false;
+        // In place, from the last quarter of the buffer.
+        std::vector<uint8_t> inPlace(pixels * 4);
+        std::copy(gray.begin(), gray.end(), inPlace.begin() + pixels * 3);
+        grayToRgba(inPlace.data() + pixels * 3, inPlace.data(), pixels);
+        if (!same("grayToRgba in place", pixels, inPlace, b)) return false;
+
+        a.assign(pixels * 3, 0);
+        b.assign(pixels * 3, 0);
+        swapRedBlue(rgb.data(), a.data(), pixels);
+        swapRedBlueScalar(rgb.data(), b.data(), pixels);
+        if (!same("swapRedBlue", pixels, a, b)) return false;
+        inPlace = rgb;
+        swapRedBlue(inPlace.data(), inPlace.data(), pixels);
+        if (!same("swapRedBlue in place", pixels, inPlace, b)) return false;
+
+        a = rgba;
+        b = rgba;
+        premultiplyAlpha(a.data(), pixels);
+        premultiplyAlphaScalar(b.data(), pixels);
+        if (!same("premultiplyAlpha", pixels, a, b)) return false;
+
+        for (int channels = 1; channels <= 4; channels++) {
+            for (int channel = 0; channel < channels; channel++) {
+                a.assign(pixels, 0);
+                b.assign(pixels, 0);
+                extractChannel(rgba.data(), pixels, channels, channel, a.data());
+                extractChannelScalar(rgba.data(), pixels, channels, channel, b.data());
+                if (!same("extractChannel", pixels, a, b)) return false;
+            }
+        }
+    }
+
+    // Every alpha against every sample value, and the exact rounding.
+    std::vector<uint8_t> all(256 * 256 * 4);
+    for (size_t i = 0; i < 256 * 256; i++) {
+        all[i * 4] = all[i * 4 + 1] = all[i * 4 + 2] = static_cast<uint8_t>(i & 0xFF);
+        all[i * 4 + 3] = static_cast<uint8_t>(i >> 8);
+    }
+    std::vector<uint8_t> premultiplied = all;
+    premultiplyAlpha(premultiplied.data(), 256 * 256);
+    for (size_t i = 0; i < 256 * 256; i++) {
+        unsigned expected = ((i & 0xFF) * (i >> 8) * 2 + 255) / 510;
+        if (premultiplied[i * 4] != expected || premultiplied[i * 4 + 3] != (i >> 8)) {
+            std::fprintf(stderr, "premultiplyAlpha: %zu * %zu / 255 is not %u\n", i & 0xFF, i >> 8, expected);
+            return false;
+        }
+    }
+
+    for (size_t width : {1, 7, 33, 100}) {
+        for (size_t height : {1, 4, 9, 17}) {
+            for (int channels = 1; channels <= 4; channels++) {
+                size_t stride = width * channels + 5;
+                std::vector<uint8_t> image = noise(stride * height, 4);
+                for (int factor : {2, 4}) {
+                    size_t outStride = width / factor * channels + 3;
+                    std::vector<uint8_t> a(outStride * (height / factor)), b(a.size());
+                    if (!downscaleBox(image.data(), width, height, stride, channels, factor, a.data(), outStride) ||
+                        !downscaleBoxScalar(image.data(), width, height, stride, channels, factor, b.data(),
+                                            outStride) ||
+                        !same("downscaleBox", width * height, a, b)) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Milliseconds per call.
+template<typename Fn>
+double millisPerCall(size_t iterations, Fn&& fn) {
+    fn();   // Fault the buffers in
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    return static_cast<double>(elapsed) / 1e6 / static_cast<double>(iterations);
+}
+
+void report(const char* kernel, double simd, double scalar, size_t bytes) {
+    std::printf("  %-20s %8.3f %8.3f %8.1fx %8.0f\n", kernel, simd, scalar, scalar / simd,
+                static_cast<double>(bytes) / simd / 1e3);
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50;
+
+    if (!crossCheck()) {
+        return 1;
+    }
+
+    const size_t pixels = kWidth * kHeight;
+    std::vector<uint8_t> gray = noise(pixels, 5);
+    std::vector<uint8_t> rgb = noise(pixels * 3, 6);
+    std::vector<uint8_t> rgba = noise(pixels * 4, 7);
+    std::vector<uint8_t> out(pixels * 4);
+
+    std::printf("ms per %zux%zu image, %s kernels (%zu iterations)\n", kWidth, kHeight, pixelKernelIsa(), iterations);
+    std::printf("  %-20s %8s %8s %9s %8s\n", "", "simd", "scalar", "speedup", "MB/s");
+    report("gray to rgba",
+           millisPerCall(iterations, [&]() { grayToRgba(gray.data(), out.data(), pixels); }),
+           millisPerCall(iterations, [&]() { grayToRgbaScalar(gray.data(), out.data(), pixels); }),
+           pixels * 5);
+    report("swap red/blue",
+           millisPerCall(iterations, [&]() { swapRedBlue(rgb.data(), out.data(), pixels); }),
+           millisPerCall(iterations, [&]() { swapRedBlueScalar(rgb.data(), out.data(), pixels); }),
+           pixels * 6);
+    // Premultiplying an already premultiplied image costs the same.
+    report("premultiply alpha",
+           millisPerCall(iterations, [&]() { premultiplyAlpha(rgba.data(), pixels); }),
+           millisPerCall(iterations, [&]() { premultiplyAlphaScalar(rgba.data(), pixels); }),
+           pixels * 8);
+    report("extract channel",
+           millisPerCall(iterations, [&]() { extractChannel(rgb.data(), pixels, 3, 0, out.data()); }),
+           millisPerCall(iterations, [&]() { extractChannelScalar(rgb.data(), pixels, 3, 0, out.data()); }),
+           pixels * 4);
+    for (int factor : {2, 4}) {
+        size_t outWidth = kWidth / factor;
+        size_t outBytes = outWidth * 3 * (kHeight / factor);
+        report(factor == 2 ? "downscale rgb 2x" : "downscale rgb 4x",
+               millisPerCall(iterations, [&]() {
+                   downscaleBox(rgb.data(), kWidth, kHeight, kWidth * 3, 3, factor, out.data(), outWidth * 3);
+               }),
+               millisPerCall(iterations, [&]() {
+                   downscaleBoxScalar(rgb.data(), kWidth, kHeight, kWidth * 3, 3, factor, out.data(), outWidth * 3);
+               }),
+               pixels * 3 + outBytes);
+    }
+    return 0;
+}
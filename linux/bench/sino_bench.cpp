@@ -0,0 +1,675 @@
+// Benchmark suite for the native scanner stack: SinosecuScanner and
+// PngWrapper built exactly as the runner builds them, driven by the mock
+// libIDCard (mock_sdk/mock_idcard.cpp) instead of a reader.
+//
+// Micro-benchmarks time the per-field and per-scan helpers; scenarios run
+// whole scans end to end. Results are written as JSON (to stdout unless
+// --json is given) so two builds can be compared before a rollout.
+//
+//   cmake -DSINO_SCANNER_BUILD_BENCHMARKS=ON ... && ./sino_bench
+//
+//   --filter TEXT    only run benchmarks and scenarios whose name contains TEXT
+//   --json PATH      write the report to PATH
+//   --min-time MS    sampling time per micro-benchmark, default 500
+//   --scans N        scans per scenario, default 200
+//   --poll-ms MS     detection poll interval for the scan scenario, default 1
+//   --idle-s S       empty-desk time before the placement in detectionIdle,
+//                    default 20
+//
+// The mock replays without sleeping (SINO_MOCK_SPEED=0) unless the
+// environment says otherwise; set SINO_MOCK_TRACE to replay a recorded
+// session instead of the built-in one.
+//
+// detectionIdle is the exception. It measures what background detection
+// costs on an empty desk and how quickly it sees a document placed after a
+// long idle, so it needs the desk in real time: it runs first, in a child
+// process whose mock replays a generated trace (an idle gap, then one
+// placement) at SINO_MOCK_SPEED=1, through a DetectionEngine with the
+// production schedule.
+#include "detection_engine.h"
+#include "logger.h"
+#include "png_wrapper.h"
+#include "runner/scan_record_value.h"
+#include "scan_record.h"
+#include "sdk_trace.h"
+#include "sinosecu_wrapper.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dlfcn.h>
+#include <filesystem>
+#include <png.h>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Reaches the SinosecuScanner internals the benchmarks time directly.
+struct SinoBenchAccess {
+    static std::string getFieldValue(SinosecuScanner& scanner, int attribute, int index) {
+        return scanner.getFieldValue(attribute, index);
+    }
+};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kOcrAttribute = 1;
+constexpr int kFieldIndices = 10;                  // Fields the built-in session fills per scan
+constexpr int64_t kTargetBatchNs = 20'000;         // Keeps clock overhead out of the samples
+constexpr size_t kMinSamples = 16;
+constexpr int kPngWidth = 1280;                    // A full-page passport scan
+constexpr int kPngHeight = 900;
+constexpr int64_t kDetectNs = 4'000'000;         // One DetectDocument on a reader
+
+const wchar_t* const kSampleFields[] = {
+        L"P<UTOERIKSSON<<ANNA<MARIA<<<<<<<<<<<<<<<<<<<",
+        L"L898902C36UTO7408122F1204159ZE184226B<<<<<10",
+        L"ERIKSSON",
+        L"ANNA MARIA",
+        L"L898902C3",
+        L"19740812",
+        L"张伟",
+        L"Åsa Öberg",
+};
+
+struct Options {
+    std::string filter;
+    std::string jsonPath;
+    int minTimeMs = 500;
+    int scans = 200;
+    int pollMs = 1;
+    int idleSeconds = 20;
+};
+
+struct Summary {
+    double mean = 0, p50 = 0, p90 = 0, p99 = 0, min = 0, max = 0;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    uint64_t iterations = 0;
+    size_t bytesPerOp = 0;                         // Input size, for throughput; 0 when not meaningful
+    Summary nsPerOp;
+};
+
+struct ScenarioResult {
+    std::string name;
+    int scans = 0;
+    int failures = 0;
+    double seconds = 0;
+    Summary latencyMicros;
+};
+
+// Written by the detectionIdle child to its parent through a pipe.
+struct DetectionResult {
+    bool ok = false;
+    double idleSeconds = 0;                // Empty desk before the placement
+    uint64_t idlePolls = 0;                // DetectDocument calls during it
+    uint64_t activePolls = 0;              // ... of which at the fast interval
+    double pollsPerIdleMinute = 0;
+    double backedOffPollsPerMinute = 0;    // After the active window only
+    double placementLatencyMs = 0;         // Document due on the glass -> Placed event
+};
+
+Summary summarize(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto rank = [&](double q) {
+        size_t index = static_cast<size_t>(q * static_cast<double>(samples.size() - 1) + 0.5);
+        return samples[std::min(index, samples.size() - 1)];
+    };
+    double total = 0;
+    for (double sample : samples) total += sample;
+    summary.mean = total / static_cast<double>(samples.size());
+    summary.p50 = rank(0.50);
+    summary.p90 = rank(0.90);
+    summary.p99 = rank(0.99);
+    summary.min = samples.front();
+    summary.max = samples.back();
+    return summary;
+}
+
+int64_t elapsedNs(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+// Times |fn| in batches sized to about kTargetBatchNs, sampling for
+// options.minTimeMs. Each sample is one batch's nanoseconds per call.
+template<typename Fn>
+BenchmarkResult measure(const char* name, const Options& options, Fn&& fn) {
+    BenchmarkResult result;
+    result.name = name;
+
+    size_t batch = 1;
+    while (batch < (1u << 20)) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < batch; i++) fn();
+        if (elapsedNs(start) >= kTargetBatchNs) break;
+        batch *= 2;
+    }
+
+    std::vector<double> samples;
+    auto deadline = Clock::now() + std::chrono::milliseconds(options.minTimeMs);
+    while (Clock::now() < deadline || samples.size() < kMinSamples) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < batch; i++) fn();
+        samples.push_back(static_cast<double>(elapsedNs(start)) / static_cast<double>(batch));
+        result.iterations += batch;
+    }
+    result.nsPerOp = summarize(std::move(samples));
+    return result;
+}
+
+bool selected(const Options& options, const char* name) {
+    return options.filter.empty() || std::strstr(name, options.filter.c_str()) != nullptr;
+}
+
+// The directory the mock libIDCard.so was loaded from, which is what
+// initializeScanner expects as its SDK directory.
+std::string sdkDirectory() {
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(&InitIDCard), &info) == 0 || !info.dli_fname) {
+        return std::string();
+    }
+    return std::filesystem::absolute(info.dli_fname).parent_path().string();
+}
+
+// Writes a noisy RGB test page so the decoder does real work per row.
+bool writeTestPng(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!info || setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        fclose(fp);
+        return false;
+    }
+    png_init_io(png, fp);
+    png_set_IHDR(png, info, kPngWidth, kPngHeight, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+
+    std::vector<png_byte> row(kPngWidth * 3);
+    uint32_t noise = 0x9E3779B9u;
+    for (int y = 0; y < kPngHeight; y++) {
+        for (int x = 0; x < kPngWidth; x++) {
+            noise = noise * 1664525u + 1013904223u;
+            row[x * 3] = static_cast<png_byte>((x + (noise >> 28)) & 0xFF);
+            row[x * 3 + 1] = static_cast<png_byte>((y + (noise >> 24)) & 0xFF);
+            row[x * 3 + 2] = static_cast<png_byte>(((x ^ y) + (noise >> 29)) & 0xFF);
+        }
+        png_write_row(png, row.data());
+    }
+    png_write_end(png, nullptr);
+    png_destroy_write_struct(&png, &info);
+    return fclose(fp) == 0;
+}
+
+bool succeeded(const ScanRecord& record) {
+    return record.status == ScanStatus::Success || record.status == ScanStatus::PartialSuccess;
+}
+
+// ================================
+// DETECTION IDLE
+// ================================
+
+// An InitIDCard, |idleNs| of empty desk, then one document placed and
+// processed. With SINO_MOCK_LOOP=0 nothing is placed after it.
+bool writeIdleTrace(const std::string& path, int64_t idleNs) {
+    std::vector<uint8_t> bytes;
+    sdk_trace::encodeHeader(bytes, 0);
+    SdkTraceRecord record;
+    auto add = [&](SdkCall call, int32_t result, int64_t startNs, int64_t durationNs) {
+        record.call = call;
+        record.result = result;
+        record.startNs = startNs;
+        record.durationNs = durationNs;
+        sdk_trace::encodeRecord(record, bytes);
+    };
+    add(SdkCall::InitIDCard, 0, 0, 0);
+    add(SdkCall::DetectDocument, 0, 0, kDetectNs);
+    add(SdkCall::DetectDocument, 1, idleNs, kDetectNs);
+    add(SdkCall::AutoProcessIDCard, 0, idleNs + kDetectNs, 0);
+    add(SdkCall::DetectDocument, 2, idleNs + 2 * kDetectNs, kDetectNs);
+
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    bool written = fwrite(bytes.data(), 1, bytes.size(), fp) == bytes.size();
+    return fclose(fp) == 0 && written;
+}
+
+// In the child: polls an empty desk for options.idleSeconds, through the
+// same DetectionEngine and schedule the runner uses, until the document
+// lands.
+DetectionResult measureDetection(const Options& options, const std::string& sdkPath) {
+    DetectionResult result;
+    SinosecuScanner scanner;
+    if (scanner.initializeScanner("", 0, sdkPath) != SinosecuScanner::SUCCESS) {
+        fprintf(stderr, "detectionIdle: initialization failed: %s\n", scanner.getLastError().c_str());
+        return result;
+    }
+    // The mock places the document this long after InitIDCard returns;
+    // counting from here instead leaves out the rest of initializeScanner.
+    auto idleStart = Clock::now();
+    auto placementDue = idleStart + std::chrono::seconds(options.idleSeconds);
+
+    std::mutex mutex;
+    std::condition_variable placed;
+    bool seen = false;
+    Clock::time_point seenAt;
+    DetectionScheduler::Stats stats;
+
+    DetectionEngine engine([&scanner] { return scanner.detectDocumentOnScanner(); });
+    engine.addListener([&](const DetectionEngine::Event& event) {
+        if (event.state != DetectionEngine::State::Placed) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!seen) {
+            seenAt = Clock::now();
+            stats = engine.schedulerStats();
+            seen = true;
+            placed.notify_all();
+        }
+    });
+    engine.start();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        placed.wait_until(lock, placementDue + std::chrono::seconds(10), [&] { return seen; });
+    }
+    engine.stop();
+    scanner.releaseScanner();
+    if (!seen) {
+        fprintf(stderr, "detectionIdle: the placement was never detected\n");
+        return result;
+    }
+
+    DetectionScheduler::Config schedule;
+    double idle = std::chrono::duration<double>(placementDue - idleStart).count();
+    double backedOff = idle - std::chrono::duration<double>(schedule.activeWindow).count();
+    result.ok = true;
+    result.idleSeconds = idle;
+    result.idlePolls = stats.polls > 0 ? stats.polls - 1 : 0;   // Not the poll that saw it
+    result.activePolls = std::min(stats.activePolls, result.idlePolls);
+    result.pollsPerIdleMinute = static_cast<double>(result.idlePolls) * 60.0 / idle;
+    result.backedOffPollsPerMinute = backedOff > 0
+            ? static_cast<double>(result.idlePolls - result.activePolls) * 60.0 / backedOff : 0;
+    result.placementLatencyMs = std::chrono::duration<double, std::milli>(seenAt - placementDue).count();
+    return result;
+}
+
+// Runs measureDetection in a child, which has to be forked before this
+// process makes its first SDK call: the mock reads its settings then, once.
+DetectionResult runDetectionIdle(const Options& options, const std::filesystem::path& workDir,
+                                 const std::string& sdkPath) {
+    DetectionResult result;
+    std::string tracePath = (workDir / "idle.sdktrace").string();
+    if (!writeIdleTrace(tracePath, static_cast<int64_t>(options.idleSeconds) * 1'000'000'000)) {
+        fprintf(stderr, "detectionIdle: cannot write %s\n", tracePath.c_str());
+        return result;
+    }
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return result;
+    }
+    fflush(nullptr);
+    pid_t child = fork();
+    if (child < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return result;
+    }
+    if (child == 0) {
+        close(fds[0]);
+        setenv("SINO_MOCK_TRACE", tracePath.c_str(), 1);
+        setenv("SINO_MOCK_SPEED", "1", 1);
+        setenv("SINO_MOCK_LOOP", "0", 1);
+        unsetenv("SINO_MOCK_FAULTS");
+
+        Logger::Config logConfig;
+        logConfig.path = (workDir / "detection.log").string();
+        logConfig.fileLevel = LogLevel::Warn;
+        logConfig.consoleLevel = LogLevel::Error;
+        Logger::getInstance().start(logConfig);
+        DetectionResult measured = measureDetection(options, sdkPath);
+        Logger::getInstance().stop();
+        bool sent = write(fds[1], &measured, sizeof(measured)) == static_cast<ssize_t>(sizeof(measured));
+        _exit(sent ? 0 : 1);
+    }
+
+    close(fds[1]);
+    DetectionResult received;
+    ssize_t length = read(fds[0], &received, sizeof(received));
+    close(fds[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (length == static_cast<ssize_t>(sizeof(received)) && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        result = received;
+    }
+    if (result.ok) {
+        fprintf(stderr, "%-28s %10.1f polls/idle min (%.1f backed off), placement seen in %.0f ms\n",
+                "detectionIdle", result.pollsPerIdleMinute, result.backedOffPollsPerMinute,
+                result.placementLatencyMs);
+    }
+    return result;
+}
+
+// ================================
+// JSON REPORT
+// ================================
+
+std::string jsonString(const std::string& value) {
+    std::string out = "\"";
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    return out + "\"";
+}
+
+void writeSummary(FILE* out, const Summary& summary) {
+    fprintf(out, "\"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"min\": %.1f, \"max\": %.1f",
+            summary.mean, summary.p50, summary.p90, summary.p99, summary.min, summary.max);
+}
+
+void writeReport(FILE* out, const Options& options, const std::string& sdkPath,
+                 const std::vector<BenchmarkResult>& benchmarks, const std::vector<ScenarioResult>& scenarios,
+                 const DetectionResult* detection) {
+    char timestamp[32];
+    std::time_t now = std::time(nullptr);
+    std::tm utc;
+    gmtime_r(&now, &utc);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    const char* trace = std::getenv("SINO_MOCK_TRACE");
+    const char* faults = std::getenv("SINO_MOCK_FAULTS");
+
+    fprintf(out, "{\n  \"schema\": \"sino_bench/1\",\n");
+    fprintf(out, "  \"timestamp\": %s,\n", jsonString(timestamp).c_str());
+    fprintf(out, "  \"host\": %s,\n", jsonString(host).c_str());
+    fprintf(out, "  \"build\": {\"compiler\": %s, \"arch\": %s, \"optimized\": %s, \"cpus\": %u},\n",
+            jsonString(__VERSION__).c_str(),
+#if defined(__aarch64__)
+            "\"aarch64\"",
+#elif defined(__x86_64__)
+            "\"x86_64\"",
+#else
+            "\"unknown\"",
+#endif
+#ifdef NDEBUG
+            "true",
+#else
+            "false",
+#endif
+            std::thread::hardware_concurrency());
+    fprintf(out, "  \"sdk\": {\"path\": %s, \"trace\": %s, \"speed\": %s, \"faults\": %s},\n",
+            jsonString(sdkPath).c_str(), jsonString(trace ? trace : "builtin").c_str(),
+            jsonString(std::getenv("SINO_MOCK_SPEED")).c_str(), jsonString(faults ? faults : "").c_str());
+    fprintf(out, "  \"options\": {\"filter\": %s, \"min_time_ms\": %d, \"scans\": %d, \"poll_ms\": %d, "
+                 "\"idle_s\": %d},\n",
+            jsonString(options.filter).c_str(), options.minTimeMs, options.scans, options.pollMs, options.idleSeconds);
+
+    fprintf(out, "  \"benchmarks\": [");
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        const BenchmarkResult& result = benchmarks[i];
+        fprintf(out, "%s\n    {\"name\": %s, \"unit\": \"ns/op\", \"iterations\": %llu, ", i ? "," : "",
+                jsonString(result.name).c_str(), static_cast<unsigned long long>(result.iterations));
+        if (result.bytesPerOp > 0) {
+            fprintf(out, "\"bytes_per_op\": %zu, \"mb_per_s\": %.1f, ", result.bytesPerOp,
+                    static_cast<double>(result.bytesPerOp) / result.nsPerOp.p50 * 1e3);
+        }
+        writeSummary(out, result.nsPerOp);
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n  ],\n");
+
+    fprintf(out, "  \"scenarios\": [");
+    for (size_t i = 0; i < scenarios.size(); i++) {
+        const ScenarioResult& result = scenarios[i];
+        fprintf(out, "%s\n    {\"name\": %s, \"scans\": %d, \"failures\": %d, \"seconds\": %.3f, "
+                     "\"scans_per_s\": %.1f, \"latency_us\": {", i ? "," : "",
+                jsonString(result.name).c_str(), result.scans, result.failures, result.seconds,
+                result.seconds > 0 ? result.scans / result.seconds : 0.0);
+        writeSummary(out, result.latencyMicros);
+        fprintf(out, "}}");
+    }
+    fprintf(out, "\n  ],\n");
+
+    // null when not selected or when it failed.
+    fprintf(out, "  \"detection\": ");
+    if (detection && detection->ok) {
+        fprintf(out, "{\"name\": \"detectionIdle\", \"idle_s\": %.1f, \"idle_polls\": %llu, "
+                     "\"active_polls\": %llu, \"polls_per_idle_min\": %.1f, \"backed_off_polls_per_min\": %.1f, "
+                     "\"placement_latency_ms\": %.1f}",
+                detection->idleSeconds, static_cast<unsigned long long>(detection->idlePolls),
+                static_cast<unsigned long long>(detection->activePolls), detection->pollsPerIdleMinute,
+                detection->backedOffPollsPerMinute, detection->placementLatencyMs);
+    } else {
+        fprintf(out, "null");
+    }
+    fprintf(out, "\n}\n");
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            fprintf(stderr, "%s needs a value\n", arg.c_str());
+            return false;
+        }
+        if (arg == "--filter") options.filter = value;
+        else if (arg == "--json") options.jsonPath = value;
+        else if (arg == "--min-time") options.minTimeMs = std::max(1, std::atoi(value));
+        else if (arg == "--scans") options.scans = std::max(1, std::atoi(value));
+        else if (arg == "--poll-ms") options.pollMs = std::max(1, std::atoi(value));
+        else if (arg == "--idle-s") options.idleSeconds = std::max(1, std::atoi(value));
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+        i++;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--filter TEXT] [--json PATH] [--min-time MS] [--scans N] [--poll-ms MS] "
+                        "[--idle-s S]\n", argv[0]);
+        return 2;
+    }
+    setenv("SINO_MOCK_SPEED", "0", 0);   // The mock reads it on the first SDK call
+
+    std::filesystem::path workDir = std::filesystem::temp_directory_path() /
+                                    ("sino_bench-" + std::to_string(getpid()));
+    std::filesystem::create_directories(workDir);
+
+    std::string sdkPath = sdkDirectory();
+    DetectionResult detection;
+    bool detectionSelected = selected(options, "detectionIdle");
+    if (detectionSelected) {
+        detection = runDetectionIdle(options, workDir, sdkPath);
+    }
+
+    Logger::Config logConfig;
+    logConfig.path = (workDir / "scanner.log").string();
+    logConfig.fileLevel = LogLevel::Warn;
+    logConfig.consoleLevel = LogLevel::Error;
+    Logger::getInstance().start(logConfig);
+
+    SinosecuScanner scanner;
+    if (scanner.initializeScanner("", 0, sdkPath) != SinosecuScanner::SUCCESS) {
+        fprintf(stderr, "Scanner initialization failed: %s\n", scanner.getLastError().c_str());
+        return 1;
+    }
+    DetectionScheduler::Config schedule;
+    schedule.fastInterval = std::chrono::milliseconds(options.pollMs);
+    scanner.setDetectionSchedule(schedule);
+
+    // One recognition pass so the mock has a current scan for field reads.
+    ScanRecord record;
+    scanner.recognizeDocument(record);
+    if (!succeeded(record)) {
+        fprintf(stderr, "Warm-up scan failed: %s\n", record.error.c_str());
+        return 1;
+    }
+
+    std::vector<BenchmarkResult> benchmarks;
+    std::vector<ScenarioResult> scenarios;
+    volatile size_t sink = 0;
+
+    auto run = [&](const char* name, auto&& fn) {
+        if (selected(options, name)) {
+            benchmarks.push_back(measure(name, options, fn));
+            fprintf(stderr, "%-28s %10.1f ns/op\n", name, benchmarks.back().nsPerOp.p50);
+        }
+    };
+
+    std::vector<std::wstring> wide(std::begin(kSampleFields), std::end(kSampleFields));
+    size_t field = 0;
+    run("wstring_to_string", [&] {
+        sink = sink + wstring_to_string(wide[field]).size();
+        field = (field + 1) % wide.size();
+    });
+    run("formatDate", [&] { sink = sink + scanner.formatDate("19740812").size(); });
+    run("isValidPassportNumber", [&] { sink = sink + scanner.isValidPassportNumber("L898902C3"); });
+    run("isValidDate", [&] { sink = sink + scanner.isValidDate("19740812"); });
+    run("isValidMRZ", [&] { sink = sink + scanner.isValidMRZ("L898902C36UTO7408122F1204159ZE184226B<<<<<10"); });
+
+    int index = 0;
+    run("getFieldValue", [&] {
+        sink = sink + SinoBenchAccess::getFieldValue(scanner, kOcrAttribute, index).size();
+        index = (index + 1) % kFieldIndices;
+    });
+    run("getDocumentFields", [&] { sink = sink + scanner.getDocumentFields(kOcrAttribute).size(); });
+    run("captureFields", [&] { sink = sink + scanner.captureFields(kOcrAttribute).size(); });
+
+    run("ScanRecord::toMap", [&] { sink = sink + record.toMap().size(); });
+    run("scan_record_value", [&] {
+        FlValue* value = scan_record_value(record);
+        sink = sink + (value != nullptr);
+        fl_value_unref(value);
+    });
+
+    if (selected(options, "readPngFromFile") || selected(options, "readPngFromPath") ||
+        selected(options, "readPngFromPathCached")) {
+        std::string pngPath = (workDir / "page.png").string();
+        FILE* fp = writeTestPng(pngPath) ? fopen(pngPath.c_str(), "rb") : nullptr;
+        if (!fp) {
+            fprintf(stderr, "Cannot create the test PNG in %s\n", workDir.c_str());
+            return 1;
+        }
+        PngWrapper& wrapper = PngWrapper::getInstance();
+        auto png = [&](const char* name, auto&& read) {
+            if (!selected(options, name)) {
+                return;
+            }
+            run(name, [&] {
+                CDib dib{};
+                sink = sink + (read(dib) == 0 ? dib.dataSize : 0);
+                free(dib.imageData);
+            });
+            benchmarks.back().bytesPerOp = static_cast<size_t>(kPngWidth) * kPngHeight * 3;
+        };
+        png("readPngFromFile", [&](CDib& dib) {
+            rewind(fp);
+            return wrapper.readPngFromFile(&dib, fp);
+        });
+        // read_png_file2's path: mapped, no stdio. Decoded every time, then
+        // from the cache.
+        wrapper.setCacheBudget(0);
+        png("readPngFromPath", [&](CDib& dib) { return wrapper.readPngFromPath(&dib, pngPath.c_str()); });
+        wrapper.setCacheBudget(static_cast<size_t>(64) << 20);
+        png("readPngFromPathCached", [&](CDib& dib) { return wrapper.readPngFromPath(&dib, pngPath.c_str()); });
+        fclose(fp);
+    }
+
+    // Scenarios: whole scans, one after another, as a kiosk would run them.
+    auto scenario = [&](const char* name, auto&& scan) {
+        if (!selected(options, name)) {
+            return;
+        }
+        ScenarioResult result;
+        result.name = name;
+        std::vector<double> latencies;
+        latencies.reserve(options.scans);
+        auto start = Clock::now();
+        for (int i = 0; i < options.scans; i++) {
+            auto scanStart = Clock::now();
+            if (!scan()) result.failures++;
+            latencies.push_back(static_cast<double>(elapsedNs(scanStart)) / 1e3);
+        }
+        result.seconds = static_cast<double>(elapsedNs(start)) / 1e9;
+        result.scans = options.scans;
+        result.latencyMicros = summarize(std::move(latencies));
+        fprintf(stderr, "%-28s %10.1f scans/s, p99 %.0f us, %d failed\n", name,
+                result.scans / result.seconds, result.latencyMicros.p99, result.failures);
+        scenarios.push_back(std::move(result));
+    };
+
+    // Recognition only: the document is taken to be on the glass already.
+    scenario("recognizeDocument", [&] {
+        record.reset();
+        scanner.recognizeDocument(record);
+        sink = sink + record.toMap().size();
+        return succeeded(record);
+    });
+    // Detection polling, recognition and the legacy map, as the channel's
+    // scanDocument call runs them.
+    scenario("scanDocumentComplete", [&] {
+        auto result = scanner.scanDocumentComplete(5);
+        sink = sink + result.size();
+        return result["status"] == "success" || result["status"] == "partial_success";
+    });
+
+    scanner.releaseScanner();
+    Logger::getInstance().stop();
+
+    FILE* out = stdout;
+    if (!options.jsonPath.empty()) {
+        out = fopen(options.jsonPath.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "Cannot write %s\n", options.jsonPath.c_str());
+            return 1;
+        }
+    }
+    writeReport(out, options, sdkPath, benchmarks, scenarios, detectionSelected ? &detection : nullptr);
+    if (out != stdout) {
+        fclose(out);
+    }
+    std::error_code error;
+    std::filesystem::remove_all(workDir, error);
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Micro-benchmark for utf8_transcoder: SIMD encoders against the scalar
+// reference and the std::wstring_convert path they replace.
+//
+//   cmake -DSINO_SCANNER_BUILD_BENCHMARKS=ON ... && ./utf8_transcoder_bench
+#include "utf8_transcoder.h"
+#include <chrono>
+#include <codecvt>
+#include <cstdio>
+#include <cstring>
+#include <locale>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A passport's worth of field values: mostly ASCII MRZ and names, plus a
+// domestic-script name.
+const wchar_t* const kSampleFields[] = {
+        L"P<UTOERIKSSON<<ANNA<MARIA<<<<<<<<<<<<<<<<<<<",
+        L"L898902C36UTO7408122F1204159ZE184226B<<<<<10",
+        L"ERIKSSON",
+        L"ANNA MARIA",
+        L"L898902C3",
+        L"19740812",
+        L"20120415",
+        L"UTO",
+        L"ZENITH",
+        L"张伟",
+        L"Åsa Öberg",
+};
+
+template<typename Fn>
+double nanosPerField(size_t iterations, size_t fields, Fn&& fn) {
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    return static_cast<double>(elapsed) / static_cast<double>(iterations * fields);
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+
+    std::vector<std::wstring> wide(std::begin(kSampleFields), std::end(kSampleFields));
+    std::vector<std::u16string> utf16;
+    for (const auto& field : wide) {
+        std::u16string units;
+        for (wchar_t c : field) units.push_back(static_cast<char16_t>(c)); // Samples are all in the BMP
+        utf16.push_back(units);
+    }
+    std::vector<char> out(4096);
+    volatile size_t sink = 0;
+
+    // Cross-check before timing anything.
+    for (const auto& field : wide) {
+        std::vector<char> scalar(field.size() * kUtf8BytesPerUtf32);
+        size_t a = wideToUtf8(field.data(), field.size(), out.data());
+        size_t b = utf32ToUtf8Scalar(reinterpret_cast<const char32_t*>(field.data()), field.size(), scalar.data());
+        if (a != b || std::memcmp(out.data(), scalar.data(), a) != 0) {
+            std::fprintf(stderr, "SIMD and scalar UTF-32 output differ\n");
+            return 1;
+        }
+    }
+
+    double utf32Simd = nanosPerField(iterations, wide.size(), [&]() {
+        for (const auto& field : wide) sink = sink + wideToUtf8(field.data(), field.size(), out.data());
+    });
+    double utf32Scalar = nanosPerField(iterations, wide.size(), [&]() {
+        for (const auto& field : wide) {
+            sink = sink + utf32ToUtf8Scalar(reinterpret_cast<const char32_t*>(field.data()), field.size(), out.data());
+        }
+    });
+    double utf16Simd = nanosPerField(iterations, utf16.size(), [&]() {
+        for (const auto& field : utf16) sink = sink + utf16ToUtf8(field.data(), field.size(), out.data());
+    });
+    double utf16Scalar = nanosPerField(iterations, utf16.size(), [&]() {
+        for (const auto& field : utf16) sink = sink + utf16ToUtf8Scalar(field.data(), field.size(), out.data());
+    });
+    std::string reused;
+    double appendReused = nanosPerField(iterations, wide.size(), [&]() {
+        for (const auto& field : wide) {
+            reused.clear();
+            appendUtf8(reused, field);
+            sink = sink + reused.size();
+        }
+    });
+    double legacy = nanosPerField(iterations / 10 + 1, wide.size(), [&]() {
+        for (const auto& field : wide) {
+            std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> conv;
+            sink = sink + conv.to_bytes(field).size();
+        }
+    });
+
+    std::printf("ns per field (%zu fields x %zu iterations)\n", wide.size(), iterations);
+    std::printf("  utf32 simd          %8.1f\n", utf32Simd);
+    std::printf("  utf32 scalar        %8.1f\n", utf32Scalar);
+    std::printf("  utf16 simd          %8.1f\n", utf16Simd);
+    std::printf("  utf16 scalar        %8.1f\n", utf16Scalar);
+    std::printf("  appendUtf8 (reused) %8.1f\n", appendReused);
+    std::printf("  wstring_convert     %8.1f\n", legacy);
+    return 0;
+}
@@ -0,0 +1,253 @@
+// sino_scannerd: owns the Sinosecu SDK and serves the reader to local
+// clients over a Unix socket (see src/scanner_daemon.h for the model and
+// src/daemon_protocol.h for the wire format).
+//
+//   sino_scannerd [--socket PATH] [--max-clients N] [--device BBB/DDD] [--cpu N]
+//   sino_scannerd [--socket PATH] [--max-clients N] [--no-standby] [--call-deadline MS]
+//                 --reader DEVICE[@CPU] ...
+//
+// The SDK is warmed up at start from the same settings the runner uses
+// (SINO_SCANNER_USER_ID etc., or the saved warmup.conf; see
+// src/scanner_warmup.h). Point the runner at the daemon with
+// SINO_SCANNER_DAEMON=PATH, or SINO_SCANNER_DAEMON=1 for the default
+// socket. SIGINT or SIGTERM releases the SDK and exits.
+//
+// --device confines the SDK to one reader: the SDK has no way to pick a
+// device and opens the first one it finds, so the process gets a private
+// /dev/bus/usb holding only that node (lsusb shows BBB/DDD as "Bus BBB
+// Device DDD"). --cpu pins every thread to one core.
+//
+// One or more --reader options run a ReaderPool instead (src/reader_pool.h):
+// a worker sino_scannerd per reader, each with its own --device and --cpu,
+// behind the one socket. DEVICE "any" leaves a worker unconfined; a reader
+// without @CPU gets a core of its own. Pick a reader in the runner with
+// SINO_SCANNER_READER=N.
+//
+// The pool also restarts a worker whose SDK crashes or hangs, promoting a
+// warmed standby worker in its place; --no-standby saves the second process
+// per reader at the cost of a cold Initialize on every restart. A call hangs
+// once it runs --call-deadline ms (default 30000) past the wait it asked
+// for. Use --reader any for a single supervised reader. To measure recovery
+// against the mock SDK:
+//
+//   SINO_MOCK_FAULTS=AutoProcessIDCard:crash:1:3 sino_scannerd --reader any
+//
+// then scan four times and read restarts and lastRecoveryMicros from
+// ListReaders (or the "recovered in" log line).
+#include "logger.h"
+#include "reader_pool.h"
+#include "scanner_daemon.h"
+#include "sdk_trace_recorder.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sched.h>
+#include <string>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+bool writeFile(const char* path, const std::string& text) {
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+    close(fd);
+    return written;
+}
+
+// Gives this process a mount namespace whose /dev/bus/usb holds only
+// |device|. Without CAP_SYS_ADMIN the namespace is made inside a user
+// namespace mapping only our own IDs. Must run before any thread starts.
+bool confineToDevice(const std::string& device, std::string& error) {
+    std::string node = "/dev/bus/usb/" + device;
+    size_t slash = device.find('/');
+    struct stat info;
+    if (slash == std::string::npos || device.find("..") != std::string::npos ||
+        stat(node.c_str(), &info) != 0 || !S_ISCHR(info.st_mode)) {
+        error = "no USB device " + node;
+        return false;
+    }
+
+    uid_t uid = getuid();
+    gid_t gid = getgid();
+    if (unshare(CLONE_NEWNS) != 0) {
+        if (errno != EPERM || unshare(CLONE_NEWUSER | CLONE_NEWNS) != 0 ||
+            !writeFile("/proc/self/setgroups", "deny") ||
+            !writeFile("/proc/self/uid_map", std::to_string(uid) + " " + std::to_string(uid) + " 1") ||
+            !writeFile("/proc/self/gid_map", std::to_string(gid) + " " + std::to_string(gid) + " 1")) {
+            error = std::string("cannot create a mount namespace: ") + strerror(errno);
+            return false;
+        }
+    }
+
+    // The bind source once /dev/bus/usb is covered. Opened inside the new
+    // namespace, since a bind mount cannot come from another one.
+    std::string bus = "/dev/bus/usb/" + device.substr(0, slash);
+    int source = -1;
+    int placeholder = -1;
+    bool confined = mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) == 0 &&
+                    (source = open(node.c_str(), O_PATH | O_CLOEXEC)) >= 0 &&
+                    mount("tmpfs", "/dev/bus/usb", "tmpfs", MS_NOSUID | MS_NOEXEC, "mode=0755") == 0 &&
+                    mkdir(bus.c_str(), 0755) == 0 &&
+                    (placeholder = open(node.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0600)) >= 0 &&
+                    mount(("/proc/self/fd/" + std::to_string(source)).c_str(), node.c_str(), nullptr, MS_BIND,
+                          nullptr) == 0;
+    if (!confined) {
+        error = "cannot confine to " + node + ": " + strerror(errno);
+    }
+    if (placeholder >= 0) close(placeholder);
+    if (source >= 0) close(source);
+    return confined;
+}
+
+bool pinToCpu(int cpu, std::string& error) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        error = "cannot pin to cpu " + std::to_string(cpu) + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+// DEVICE[@CPU]
+bool parseReader(const char* value, ReaderPool::Reader& reader) {
+    std::string text = value;
+    size_t at = text.find('@');
+    if (at != std::string::npos) {
+        char* end = nullptr;
+        long cpu = strtol(text.c_str() + at + 1, &end, 10);
+        if (*end != '\0' || cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        reader.cpu = static_cast<int>(cpu);
+        text.resize(at);
+    }
+    if (text.empty()) {
+        return false;
+    }
+    reader.device = text == "any" ? "" : text;
+    return true;
+}
+
+int usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--socket PATH] [--max-clients N] [--device BBB/DDD] [--cpu N]\n"
+            "       %s [--socket PATH] [--max-clients N] [--no-standby] [--call-deadline MS]\n"
+            "                 --reader DEVICE[@CPU] ...\n",
+            program, program);
+    return 2;
+}
+
+}
+
+int main(int argc, char** argv) {
+    ScannerDaemon::Config config;
+    std::string device;
+    int cpu = -1;
+    std::vector<ReaderPool::Reader> readers;
+    ReaderPool::Config poolConfig;
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(argv[i], "--socket") == 0 && value) {
+            config.socketPath = value;
+            i++;
+        } else if (strcmp(argv[i], "--max-clients") == 0 && value && std::atoi(value) > 0) {
+            config.maxClients = static_cast<size_t>(std::atoi(value));
+            i++;
+        } else if (strcmp(argv[i], "--device") == 0 && value) {
+            device = value;
+            i++;
+        } else if (strcmp(argv[i], "--cpu") == 0 && value && std::atoi(value) >= 0) {
+            cpu = std::atoi(value);
+            i++;
+        } else if (strcmp(argv[i], "--reader") == 0 && value) {
+            ReaderPool::Reader reader;
+            if (!parseReader(value, reader)) {
+                return usage(argv[0]);
+            }
+            readers.push_back(reader);
+            i++;
+        } else if (strcmp(argv[i], "--no-standby") == 0) {
+            poolConfig.standby = false;
+        } else if (strcmp(argv[i], "--call-deadline") == 0 && value && std::atoi(value) > 0) {
+            poolConfig.callDeadline = std::chrono::milliseconds(std::atoi(value));
+            i++;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (!readers.empty() && (!device.empty() || cpu >= 0)) {
+        return usage(argv[0]);
+    }
+
+    // Both apply to every thread, so they come before the first one starts.
+    std::string error;
+    if ((!device.empty() && !confineToDevice(device, error)) || (cpu >= 0 && !pinToCpu(cpu, error))) {
+        fprintf(stderr, "sino_scannerd: %s\n", error.c_str());
+        return 1;
+    }
+
+    // Block the stop signals in every thread; main waits for them below.
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    Logger::getInstance().start();
+
+    if (!readers.empty()) {
+        // The pool never calls the SDK; its workers do.
+        poolConfig.socketPath = config.socketPath;
+        poolConfig.maxClients = config.maxClients;
+        poolConfig.readers = readers;
+        ReaderPool pool;
+        if (!pool.start(poolConfig, error)) {
+            fprintf(stderr, "sino_scannerd: %s\n", error.c_str());
+            Logger::getInstance().stop();
+            return 1;
+        }
+        fprintf(stderr, "sino_scannerd: serving %zu readers at %s\n", pool.readerCount(), pool.socketPath().c_str());
+
+        int received = 0;
+        sigwait(&stopSignals, &received);
+        fprintf(stderr, "sino_scannerd: %s, shutting down\n", strsignal(received));
+        pool.stop();
+        Logger::getInstance().stop();
+        return 0;
+    }
+
+    config.warmup = WarmupSettings::load();
+    SdkTraceRecorder::getInstance().startFromEnvironment();
+
+    ScannerDaemon daemon;
+    if (!daemon.start(config, error)) {
+        fprintf(stderr, "sino_scannerd: %s\n", error.c_str());
+        SdkTraceRecorder::getInstance().stop();
+        Logger::getInstance().stop();
+        return 1;
+    }
+    if (!config.warmup.isComplete()) {
+        SINO_LOG_WARN("sino_scannerd: No warm-up settings; the SDK initializes on the first Initialize request");
+    }
+    fprintf(stderr, "sino_scannerd: serving %s\n", daemon.socketPath().c_str());
+
+    int received = 0;
+    sigwait(&stopSignals, &received);
+    fprintf(stderr, "sino_scannerd: %s, shutting down\n", strsignal(received));
+
+    daemon.stop();
+    SdkTraceRecorder::getInstance().stop();
+    Logger::getInstance().stop();
+    return 0;
+}
@@ -0,0 +1,738 @@
+/**
+ * Mock libIDCard
+ *
+ * A stand-in for the Sinosecu libIDCard.so that exports the same extern "C"
+ * surface sinosecu_wrapper.h declares, so the runner, the benchmarks and load
+ * tests run without a reader attached. Built and linked instead of the vendor
+ * SDK with -DSINO_SCANNER_MOCK_SDK=ON.
+ *
+ * It replays a recorded session (see sdk_trace.h): each AutoProcessIDCard in
+ * the trace starts a scan, and the field, name, confidence and timing reads
+ * that followed it answer the wrapper's reads after the replayed
+ * AutoProcessIDCard. SaveImageEx writes the recorded image files under the
+ * new base path. Call latencies are replayed (sleeps under a millisecond are
+ * skipped), and DetectDocument reproduces the desk: the document appears
+ * after the recorded idle gap, stays on the glass for as long as it did, and
+ * is reported taken out once.
+ *
+ * Configured from the environment when the first SDK call is made:
+ *
+ *   SINO_MOCK_TRACE   trace file to replay; without one, a built-in session
+ *                     of three synthetic passports is used
+ *   SINO_MOCK_SPEED   latency divisor, default 1; 0 replays without sleeping
+ *   SINO_MOCK_LOOP    0 to stop placing documents after the last scan,
+ *                     default 1 (start over)
+ *   SINO_MOCK_SEED    seed for fault injection, default random
+ *   SINO_MOCK_FAULTS  comma-separated Call:kind[:rate[:after]] rules, e.g.
+ *                     AutoProcessIDCard:error=-8:0.1    return -8 10% of the time
+ *                     AutoProcessIDCard:hang=30000:0.01 stall 30 s, then carry on
+ *                     AutoProcessIDCard:crash:0.001     raise SIGSEGV
+ *                     AutoProcessIDCard:crash:1:3       crash on the 4th call
+ *                     The rate defaults to 1 and applies once the first
+ *                     |after| calls (default 0) have passed, counted per
+ *                     process. Hangs are not scaled by speed.
+ */
+
+#include "sdk_trace.h"
+#include "utf8_transcoder.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+
+// The library is built with hidden visibility so its copies of sdk_trace and
+// the transcoder never interpose on the runner's; only the SDK functions,
+// with the signatures sinosecu_wrapper.h declares, are exported.
+#define MOCK_SDK_EXPORT __attribute__((visibility("default")))
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using FieldKey = std::pair<int, int>;   // (attribute, index), or (mainType, subType)
+
+constexpr int kPassportMainType = 13;
+constexpr int kCardTypeChip = 1;
+constexpr int kTimeConsumedChipRead = 5;
+
+// Used when the trace does not say.
+constexpr int64_t kDefaultPlacementGapNs = 2'000'000'000;
+constexpr int64_t kDefaultDwellNs = 600'000'000;
+constexpr int64_t kDefaultDetectNs = 4'000'000;
+constexpr int64_t kMinimumSleepNs = 1'000'000;
+
+struct Fault {
+    enum class Kind { Error, Hang, Crash };
+
+    SdkCall call;
+    Kind kind;
+    int value;     // Error: the result returned. Hang: milliseconds.
+    double rate;
+    int after;     // Calls that pass untouched first
+    int calls;     // Calls seen so far
+};
+
+// One AutoProcessIDCard and the reads that followed it.
+struct ReplayScan {
+    const SdkTraceRecord* process = nullptr;
+    const SdkTraceRecord* cardName = nullptr;
+    const SdkTraceRecord* saveImage = nullptr;
+    std::map<FieldKey, const SdkTraceRecord*> values;
+    std::map<FieldKey, const SdkTraceRecord*> names;
+    std::map<FieldKey, const SdkTraceRecord*> resultTypes;
+    std::map<FieldKey, const SdkTraceRecord*> confidences;
+    std::map<FieldKey, const SdkTraceRecord*> timeConsumed;
+    int64_t placementGapNs = kDefaultPlacementGapNs;   // Empty desk before the document arrived
+    int64_t dwellNs = kDefaultDwellNs;                 // On the glass after processing
+};
+
+enum class Desk { Empty, Present, Processed };
+
+struct MockSession {
+    std::mutex mutex;
+    std::vector<SdkTraceRecord> records;
+    std::vector<ReplayScan> scans;
+    const SdkTraceRecord* init = nullptr;
+    int64_t detectNs = kDefaultDetectNs;
+
+    double speed = 1.0;
+    bool loop = true;
+    std::vector<Fault> faults;
+    std::mt19937_64 random;
+
+    bool initialized = false;
+    size_t scansStarted = 0;
+    const ReplayScan* current = nullptr;
+    Desk desk = Desk::Empty;
+    Clock::time_point deskDue;   // Empty: placement. Processed: removal.
+
+    Clock::duration scaled(int64_t ns) const {
+        if (speed <= 0 || ns <= 0) {
+            return Clock::duration::zero();
+        }
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(static_cast<int64_t>(ns / speed)));
+    }
+
+    bool exhausted() const {
+        return scans.empty() || (!loop && scansStarted >= scans.size());
+    }
+
+    const ReplayScan& upcoming() const {
+        return scans[scansStarted % scans.size()];
+    }
+};
+
+void replayLatency(const MockSession& session, int64_t ns) {
+    auto duration = session.scaled(ns);
+    if (duration >= std::chrono::nanoseconds(kMinimumSleepNs)) {
+        std::this_thread::sleep_for(duration);
+    }
+}
+
+// === Synthetic session ===
+
+int mrzCheckDigit(const std::string& text) {
+    static constexpr int kWeights[] = {7, 3, 1};
+    int sum = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        int value = (c >= '0' && c <= '9') ? c - '0' : (c >= 'A' && c <= 'Z') ? c - 'A' + 10 : 0;
+        sum += value * kWeights[i % 3];
+    }
+    return sum % 10;
+}
+
+std::string mrzPad(std::string text, size_t width) {
+    std::replace(text.begin(), text.end(), ' ', '<');
+    text.resize(width, '<');
+    return text;
+}
+
+struct SyntheticHolder {
+    const char* number;
+    const char* country;
+    const char* surname;
+    const char* givenNames;
+    const char* gender;
+    const char* birthDate;    // YYYYMMDD
+    const char* expiryDate;
+};
+
+constexpr SyntheticHolder kSyntheticHolders[] = {
+        {"L898902C3", "UTO", "ERIKSSON", "ANNA MARIA", "F", "19740812", "20320415"},
+        {"X4RTBPFW4", "D", "MUSTERMANN", "ERIKA", "F", "19640812", "20311031"},
+        {"C01X00T47", "NLD", "DE BRUIJN", "WILLEKE LISELOTTE", "F", "19650310", "20330309"},
+};
+
+class SyntheticRecorder {
+public:
+    explicit SyntheticRecorder(std::vector<SdkTraceRecord>& records) : records(records), nowNs(0) {}
+
+    void add(SdkCall call, int32_t result, int64_t durationNs,
+             std::vector<int32_t> ints = {}, std::vector<std::string> blobs = {}) {
+        SdkTraceRecord record;
+        record.call = call;
+        record.result = result;
+        record.startNs = nowNs;
+        record.durationNs = durationNs;
+        record.ints = std::move(ints);
+        record.blobs = std::move(blobs);
+        records.push_back(std::move(record));
+        nowNs += durationNs;
+    }
+
+    void idle(int64_t ns) { nowNs += ns; }
+
+    void field(int attribute, int index, const std::string& value) {
+        int32_t length = static_cast<int32_t>(utf8ToWide(value).size());
+        add(SdkCall::GetRecogResultEx, 0, 40'000, {attribute, index, 1024, length}, {value});
+        add(SdkCall::GetFieldConfEx, 95, 10'000, {attribute, index});
+    }
+
+private:
+    std::vector<SdkTraceRecord>& records;
+    int64_t nowNs;
+};
+
+void appendSyntheticSession(std::vector<SdkTraceRecord>& records) {
+    SyntheticRecorder recorder(records);
+    recorder.add(SdkCall::InitIDCard, 0, 1'800'000'000, {0}, {"mock", "."});
+
+    for (const SyntheticHolder& holder : kSyntheticHolders) {
+        recorder.idle(kDefaultPlacementGapNs);
+        recorder.add(SdkCall::DetectDocument, 1, kDefaultDetectNs);
+        recorder.add(SdkCall::AutoProcessIDCard, kPassportMainType, 1'400'000'000, {kCardTypeChip});
+        recorder.add(SdkCall::GetTimeConsumed, 620, 5'000, {kTimeConsumedChipRead, 0});
+        recorder.add(SdkCall::GetIDCardName, 0, 20'000, {256, 8}, {"Passport"});
+
+        std::string birth = std::string(holder.birthDate).substr(2);
+        std::string expiry = std::string(holder.expiryDate).substr(2);
+        std::string number = mrzPad(holder.number, 9);
+        std::string line1 = mrzPad(std::string("P<") + mrzPad(holder.country, 3) + holder.surname +
+                                   "<<" + holder.givenNames, 44);
+        std::string optional = mrzPad("", 14);
+        std::string line2 = number + std::to_string(mrzCheckDigit(number)) + mrzPad(holder.country, 3) +
+                            birth + std::to_string(mrzCheckDigit(birth)) + holder.gender +
+                            expiry + std::to_string(mrzCheckDigit(expiry)) +
+                            optional + std::to_string(mrzCheckDigit(optional));
+        std::string composite = line2.substr(0, 10) + line2.substr(13, 7) + line2.substr(21, 22);
+        line2 += std::to_string(mrzCheckDigit(composite));
+
+        std::string englishName = std::string(holder.surname) + " " + holder.givenNames;
+        for (int attribute : {0, 1}) {   // Chip, then OCR page
+            recorder.field(attribute, 0, "P");
+            recorder.field(attribute, 1, holder.number);
+            recorder.field(attribute, 3, englishName);
+            recorder.field(attribute, 4, holder.gender);
+            recorder.field(attribute, 5, holder.birthDate);
+            recorder.field(attribute, 6, holder.expiryDate);
+            recorder.field(attribute, 7, holder.country);
+            recorder.field(attribute, 8, holder.surname);
+            recorder.field(attribute, 9, holder.givenNames);
+            recorder.field(attribute, 10, line1);
+            recorder.field(attribute, 11, line2);
+            recorder.field(attribute, 12, holder.country);
+        }
+
+        recorder.idle(kDefaultDwellNs);
+        recorder.add(SdkCall::DetectDocument, 2, kDefaultDetectNs);
+    }
+}
+
+// === Trace indexing ===
+
+void keep(std::map<FieldKey, const SdkTraceRecord*>& map, FieldKey key, const SdkTraceRecord& record) {
+    // Keep the successful read when the wrapper retried with a larger buffer.
+    auto it = map.find(key);
+    if (it == map.end() || record.result == 0) {
+        map[key] = &record;
+    }
+}
+
+FieldKey keyOf(const SdkTraceRecord& record) {
+    return FieldKey(record.ints.size() > 0 ? record.ints[0] : 0, record.ints.size() > 1 ? record.ints[1] : 0);
+}
+
+void indexSession(MockSession& session) {
+    std::vector<int64_t> detectDurations;
+    int64_t idleSinceNs = 0;          // Last removal, or the end of InitIDCard
+    int64_t placedAtNs = -1;
+    int64_t processedAtNs = 0;
+    bool removalSeen = true;
+    ReplayScan* scan = nullptr;
+
+    for (const SdkTraceRecord& record : session.records) {
+        switch (record.call) {
+            case SdkCall::InitIDCard:
+                session.init = &record;
+                idleSinceNs = record.startNs + record.durationNs;
+                break;
+            case SdkCall::DetectDocument:
+                detectDurations.push_back(record.durationNs);
+                if (record.result == 1 && removalSeen && placedAtNs < 0) {
+                    placedAtNs = record.startNs;
+                } else if (record.result == 2 && scan && !removalSeen) {
+                    scan->dwellNs = std::max<int64_t>(record.startNs - processedAtNs, 0);
+                    idleSinceNs = record.startNs;
+                    removalSeen = true;
+                }
+                break;
+            case SdkCall::AutoProcessIDCard:
+                scan = &session.scans.emplace_back();
+                scan->process = &record;
+                scan->placementGapNs = std::max<int64_t>((placedAtNs >= 0 ? placedAtNs : record.startNs) - idleSinceNs, 0);
+                processedAtNs = record.startNs + record.durationNs;
+                idleSinceNs = processedAtNs;
+                placedAtNs = -1;
+                removalSeen = false;
+                break;
+            case SdkCall::GetRecogResultEx:
+                if (scan) keep(scan->values, keyOf(record), record);
+                break;
+            case SdkCall::GetFieldNameEx:
+                if (scan) keep(scan->names, keyOf(record), record);
+                break;
+            case SdkCall::GetResultTypeEx:
+                if (scan) keep(scan->resultTypes, keyOf(record), record);
+                break;
+            case SdkCall::GetFieldConfEx:
+                if (scan) keep(scan->confidences, keyOf(record), record);
+                break;
+            case SdkCall::GetTimeConsumed:
+                if (scan) keep(scan->timeConsumed, keyOf(record), record);
+                break;
+            case SdkCall::GetIDCardName:
+                if (scan && (!scan->cardName || record.result == 0)) scan->cardName = &record;
+                break;
+            case SdkCall::SaveImageEx:
+                if (scan) scan->saveImage = &record;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!detectDurations.empty()) {
+        auto middle = detectDurations.begin() + detectDurations.size() / 2;
+        std::nth_element(detectDurations.begin(), middle, detectDurations.end());
+        session.detectNs = *middle;
+    }
+}
+
+// === Configuration ===
+
+bool parseCall(const std::string& name, SdkCall& call) {
+    for (uint8_t value = 1; value < static_cast<uint8_t>(SdkCall::Count); value++) {
+        if (name == sdk_trace::callName(static_cast<SdkCall>(value))) {
+            call = static_cast<SdkCall>(value);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseFault(const std::string& rule, Fault& fault) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= rule.size()) {
+        size_t end = rule.find(':', start);
+        if (end == std::string::npos) end = rule.size();
+        parts.push_back(rule.substr(start, end - start));
+        start = end + 1;
+    }
+    if (parts.size() < 2 || parts.size() > 4 || !parseCall(parts[0], fault.call)) {
+        return false;
+    }
+
+    std::string kind = parts[1];
+    size_t equals = kind.find('=');
+    std::string argument = equals == std::string::npos ? std::string() : kind.substr(equals + 1);
+    kind = kind.substr(0, equals);
+    if (kind == "error" && !argument.empty()) {
+        fault.kind = Fault::Kind::Error;
+    } else if (kind == "hang" && !argument.empty()) {
+        fault.kind = Fault::Kind::Hang;
+    } else if (kind == "crash") {
+        fault.kind = Fault::Kind::Crash;
+    } else {
+        return false;
+    }
+    fault.value = argument.empty() ? 0 : std::atoi(argument.c_str());
+    fault.rate = parts.size() >= 3 ? std::atof(parts[2].c_str()) : 1.0;
+    fault.after = parts.size() == 4 ? std::atoi(parts[3].c_str()) : 0;
+    fault.calls = 0;
+    return true;
+}
+
+void configure(MockSession& session) {
+    if (const char* speed = std::getenv("SINO_MOCK_SPEED")) {
+        session.speed = std::atof(speed);
+    }
+    if (const char* loop = std::getenv("SINO_MOCK_LOOP")) {
+        session.loop = std::atoi(loop) != 0;
+    }
+    const char* seed = std::getenv("SINO_MOCK_SEED");
+    session.random.seed(seed ? std::strtoull(seed, nullptr, 10) : std::random_device()());
+
+    if (const char* faults = std::getenv("SINO_MOCK_FAULTS")) {
+        std::string rules(faults);
+        size_t start = 0;
+        while (start < rules.size()) {
+            size_t end = rules.find(',', start);
+            if (end == std::string::npos) end = rules.size();
+            std::string rule = rules.substr(start, end - start);
+            Fault fault{};
+            if (parseFault(rule, fault)) {
+                session.faults.push_back(fault);
+            } else if (!rule.empty()) {
+                fprintf(stderr, "[mock-sdk] Ignoring fault rule '%s'\n", rule.c_str());
+            }
+            start = end + 1;
+        }
+    }
+
+    std::string source = "the synthetic session";
+    const char* trace = std::getenv("SINO_MOCK_TRACE");
+    if (trace && *trace) {
+        std::string error;
+        if (!sdk_trace::readTrace(trace, session.records, error)) {
+            fprintf(stderr, "[mock-sdk] %s; using the synthetic session\n", error.c_str());
+            session.records.clear();
+        } else {
+            source = trace;
+            if (!error.empty()) {
+                fprintf(stderr, "[mock-sdk] %s\n", error.c_str());
+            }
+        }
+    }
+    if (session.records.empty()) {
+        appendSyntheticSession(session.records);
+    }
+    indexSession(session);
+
+    fprintf(stderr, "[mock-sdk] Replaying %zu scans from %s at speed %g%s\n",
+            session.scans.size(), source.c_str(),
+            session.speed, session.faults.empty() ? "" : " with fault injection");
+}
+
+MockSession& session() {
+    // Never destroyed: the runner may still call in while statics are torn down.
+    static MockSession* instance = [] {
+        auto* created = new MockSession();
+        configure(*created);
+        return created;
+    }();
+    return *instance;
+}
+
+// Applies the fault rules for |call|. Returns true with |result| set when
+// the call should fail; hangs sleep and then let the call carry on.
+bool injectFault(SdkCall call, int& result) {
+    MockSession& mock = session();
+    if (mock.faults.empty()) {
+        return false;
+    }
+
+    int hangMillis = 0;
+    bool failed = false;
+    {
+        std::lock_guard<std::mutex> lock(mock.mutex);
+        std::uniform_real_distribution<double> draw(0.0, 1.0);
+        for (Fault& fault : mock.faults) {
+            if (fault.call != call || fault.calls++ < fault.after || draw(mock.random) >= fault.rate) {
+                continue;
+            }
+            switch (fault.kind) {
+                case Fault::Kind::Crash:
+                    fprintf(stderr, "[mock-sdk] Injected crash in %s\n", sdk_trace::callName(call));
+                    std::raise(SIGSEGV);
+                    std::abort();
+                case Fault::Kind::Hang:
+                    hangMillis += fault.value;
+                    break;
+                case Fault::Kind::Error:
+                    if (!failed) {
+                        result = fault.value;
+                        failed = true;
+                    }
+                    break;
+            }
+        }
+    }
+
+    if (hangMillis > 0) {
+        fprintf(stderr, "[mock-sdk] Injected %d ms hang in %s\n", hangMillis, sdk_trace::callName(call));
+        std::this_thread::sleep_for(std::chrono::milliseconds(hangMillis));
+    }
+    return failed;
+}
+
+const SdkTraceRecord* lookup(const std::map<FieldKey, const SdkTraceRecord*> ReplayScan::* map, FieldKey key) {
+    const ReplayScan* scan = session().current;
+    if (!scan) {
+        return nullptr;
+    }
+    auto it = (scan->*map).find(key);
+    return it == (scan->*map).end() ? nullptr : it->second;
+}
+
+// Answers a text read with the buffer protocol the wrapper expects: 1 and
+// the length needed (terminator included) when |buffer| is too small,
+// otherwise 0 and the length written (terminator excluded).
+int replayText(const SdkTraceRecord* record, wchar_t* buffer, int& bufferLen) {
+    if (!record) {
+        return -1;
+    }
+    if (record->result != 0 && record->result != 1) {
+        return record->result;
+    }
+
+    std::wstring value = utf8ToWide(record->blobs.empty() ? std::string_view() : std::string_view(record->blobs[0]));
+    int needed = static_cast<int>(value.size()) + 1;
+    if (!buffer || bufferLen < needed) {
+        bufferLen = needed;
+        return 1;
+    }
+    std::copy(value.begin(), value.end(), buffer);
+    buffer[value.size()] = L'\0';
+    bufferLen = needed - 1;
+    return 0;
+}
+
+int replayValue(const std::map<FieldKey, const SdkTraceRecord*> ReplayScan::* map, FieldKey key, int missing) {
+    MockSession& mock = session();
+    std::lock_guard<std::mutex> lock(mock.mutex);
+    const SdkTraceRecord* record = lookup(map, key);
+    return record ? record->result : missing;
+}
+
+}
+
+extern "C" {
+
+MOCK_SDK_EXPORT int InitIDCard(const wchar_t* lpUserID, int nType, const wchar_t* lpDirectory) {
+    (void) lpUserID;
+    (void) nType;
+    (void) lpDirectory;
+    int result = 0;
+    if (injectFault(SdkCall::InitIDCard, result)) {
+        return result;
+    }
+
+    MockSession& mock = session();
+    int64_t latencyNs = 0;
+    {
+        std::lock_guard<std::mutex> lock(mock.mutex);
+        if (mock.init) {
+            result = mock.init->result;
+            latencyNs = mock.init->durationNs;
+        }
+    }
+    replayLatency(mock, latencyNs);
+
+    std::lock_guard<std::mutex> lock(mock.mutex);
+    mock.initialized = (result == 0);
+    mock.current = nullptr;
+    mock.desk = Desk::Empty;
+    if (!mock.scans.empty()) {
+        mock.deskDue = Clock::now() + mock.scaled(mock.upcoming().placementGapNs);
+    }
+    return result;
+}
+
+MOCK_SDK_EXPORT void FreeIDCard() {
+    MockSession& mock = session();
+    std::lock_guard<std::mutex> lock(mock.mutex);
+    mock.initialized = false;
+    mock.current = nullptr;
+}
+
+MOCK_SDK_EXPORT int DetectDocument() {
+    int result = 0;
+    if (injectFault(SdkCall::DetectDocument, result)) {
+        return result;
+    }
+
+    MockSession& mock = session();
+    replayLatency(mock, mock.detectNs);
+
+    std::lock_guard<std::mutex> lock(mock.mutex);
+    if (!mock.initialized) {
+        return -1;
+    }
+    Clock::time_point now = Clock::now();
+    switch (mock.desk) {
+        case Desk::Empty:
+            if (mock.exhausted() || now < mock.deskDue) {
+                return 0;
+            }
+            mock.desk = Desk::Present;
+            return 1;
+        case Desk::Present:
+            return 1;
+        case Desk::Processed:
+            if (now < mock.deskDue) {
+                return 1;
+            }
+            mock.desk = Desk::Empty;
+            if (!mock.exhausted()) {
+                mock.deskDue = now + mock.scaled(mock.upcoming().placementGapNs);
+            }
+            return 2;
+    }
+    return 0;
+}
+
+MOCK_SDK_EXPORT int AutoProcessIDCard(int& nCardType) {
+    nCardType = 0;
+    int result = 0;
+    if (injectFault(SdkCall::AutoProcessIDCard, result)) {
+        return result;
+    }
+
+    MockSession& mock = session();
+    int64_t latencyNs = 0;
+    const ReplayScan* scan = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mock.mutex);
+        if (!mock.initialized) {
+            return -1;
+        }
+        if (mock.exhausted()) {
+            return -2;   // Nothing on the glass to capture
+        }
+        scan = &mock.upcoming();
+        mock.scansStarted++;
+        result = scan->process->result;
+        latencyNs = scan->process->durationNs;
+        if (!scan->process->ints.empty()) {
+            nCardType = scan->process->ints[0];
+        }
+    }
+    replayLatency(mock, latencyNs);
+
+    std::lock_guard<std::mutex> lock(mock.mutex);
+    mock.current = scan;
+    mock.desk = Desk::Processed;
+    mock.deskDue = Clock::now() + mock.scaled(scan->dwellNs);
+    return result;
+}
+
+MOCK_SDK_EXPORT int GetFieldNameEx(int nAttribute, int nIndex, wchar_t* lpBuffer, int& nBufferLen) {
+    MockSession& mock = session();
+    std::lock_guard<std::mutex> lock(mock.mutex);
+    return replayText(lookup(&ReplayScan::names, FieldKey(nAttribute, nIndex)), lpBuffer, nBufferLen);
+}
+
+MOCK_SDK_EXPORT int GetRecogResultEx(int nAttribute, int nIndex, wchar_t* lpBuffer, int& nBufferLen) {
+    int result = 0;
+    if (injectFault(SdkCall::GetRecogResultEx, result)) {
+        return result;
+    }
+    MockSession& mock = session();
+    std::lock_guard<std::mutex> lock(mock.mutex);
+    return replayText(lookup(&ReplayScan::values, FieldKey(nAttribute, nIndex)), lpBuffer, nBufferLen);
+}
+
+MOCK_SDK_EXPORT int GetResultTypeEx(int nAttribute, int nIndex) {
+    return replayValue(&ReplayScan::resultTypes, FieldKey(nAttribute, nIndex), 0);
+}
+
+MOCK_SDK_EXPORT int GetFieldConfEx(int nAttribute, int nIndex) {
+    return replayValue(&ReplayScan::confidences, FieldKey(nAttribute, nIndex), 0);
+}
+
+MOCK_SDK_EXPORT int GetIDCardName(wchar_t* lpBuffer, int& nBufferLen) {
+    MockSession& mock = session();
+    std::lock_guard<std::mutex> lock(mock.mutex);
+    return replayText(mock.current ? mock.current->cardName : nullptr, lpBuffer, nBufferLen);
+}
+
+MOCK_SDK_EXPORT int GetTimeConsumed(int nMainTimeType, int nSubTimeType) {
+    return replayValue(&ReplayScan::timeConsumed, FieldKey(nMainTimeType, nSubTimeType), 0);
+}
+
+MOCK_SDK_EXPORT int CheckDeviceOnlineEx() {
+    int result = 0;
+    if (injectFault(SdkCall::CheckDeviceOnlineEx, result)) {
+        return result;
+    }
+    MockSession& mock = session();
+    std::lock_guard<std::mutex> lock(mock.mutex);
+    return mock.initialized ? 1 : 3;
+}
+
+MOCK_SDK_EXPORT int SetConfigByFile(const wchar_t* lpConfigFile) {
+    (void) lpConfigFile;
+    int result = 0;
+    injectFault(SdkCall::SetConfigByFile, result);
+    return result;
+}
+
+MOCK_SDK_EXPORT int SetLanguage(int nLangType) {
+    (void) nLangType;
+    return 0;
+}
+
+MOCK_SDK_EXPORT void SetSaveImageType(int nImageType) {
+    (void) nImageType;
+}
+
+MOCK_SDK_EXPORT void SetRecogVIZ(bool bRecogVIZ) {
+    (void) bRecogVIZ;
+}
+
+MOCK_SDK_EXPORT void SetRecogDG(int nDG) {
+    (void) nDG;
+}
+
+MOCK_SDK_EXPORT int SetRecogChipCardAttribute(int nReadCard) {
+    (void) nReadCard;
+    return 0;
+}
+
+MOCK_SDK_EXPORT void ResetIDCardID() {}
+
+MOCK_SDK_EXPORT int AddIDCardID(int nMainID, int nSubID[], int nSubIDCount) {
+    (void) nMainID;
+    (void) nSubID;
+    (void) nSubIDCount;
+    return 0;
+}
+
+MOCK_SDK_EXPORT int SaveImageEx(const wchar_t* lpFileName, int nType) {
+    (void) nType;
+    int result = 0;
+    if (injectFault(SdkCall::SaveImageEx, result)) {
+        return result;
+    }
+
+    MockSession& mock = session();
+    const SdkTraceRecord* record = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mock.mutex);
+        record = mock.current ? mock.current->saveImage : nullptr;
+    }
+    if (!record || !lpFileName) {
+        return 0;   // Nothing was recorded for this scan
+    }
+
+    // blobs: base path, then (name suffix, bytes) per file.
+    std::filesystem::path base(wideToUtf8(std::wstring_view(lpFileName)));
+    std::string stem = (base.parent_path() / base.stem()).string();
+    for (size_t i = 1; i + 1 < record->blobs.size(); i += 2) {
+        std::ofstream file(stem + record->blobs[i], std::ios::binary | std::ios::trunc);
+        file.write(record->blobs[i + 1].data(), static_cast<std::streamsize>(record->blobs[i + 1].size()));
+    }
+    replayLatency(mock, record->durationNs);
+    return record->result;
+}
+
+}
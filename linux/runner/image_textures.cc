@@ -0,0 +1,119 @@
+#include "runner/image_textures.h"
+
+#include <memory>
+#include <mutex>
+
+#include "src/logger.h"
+
+// The frame a texture shows. Written by show() on the main loop, read by
+// copy_pixels on the raster thread.
+struct ImageTextureFrames {
+    std::mutex mutex;
+    std::unique_ptr<JpegCodec::Image> pending;   // Newest, not yet copied
+    std::unique_ptr<JpegCodec::Image> current;   // Last handed to the engine
+};
+
+G_DECLARE_FINAL_TYPE(SinoImageTexture, sino_image_texture, SINO, IMAGE_TEXTURE, FlPixelBufferTexture)
+
+struct _SinoImageTexture {
+    FlPixelBufferTexture parent_instance;
+    ImageTextureFrames* frames;
+};
+
+G_DEFINE_TYPE(SinoImageTexture, sino_image_texture, fl_pixel_buffer_texture_get_type())
+
+// The engine uploads |buffer| before returning to us, and the next call is
+// the only place |current| changes, so the pixels stay valid for as long as
+// it reads them.
+static gboolean sino_image_texture_copy_pixels(FlPixelBufferTexture* texture, const uint8_t** out_buffer,
+                                               uint32_t* width, uint32_t* height, GError** error) {
+    ImageTextureFrames* frames = SINO_IMAGE_TEXTURE(texture)->frames;
+    std::lock_guard<std::mutex> lock(frames->mutex);
+    if (frames->pending) {
+        frames->current = std::move(frames->pending);
+    }
+    if (!frames->current) {
+        return FALSE;
+    }
+    *out_buffer = frames->current->pixels.data();
+    *width = static_cast<uint32_t>(frames->current->width);
+    *height = static_cast<uint32_t>(frames->current->height);
+    return TRUE;
+}
+
+static void sino_image_texture_finalize(GObject* object) {
+    delete SINO_IMAGE_TEXTURE(object)->frames;
+    G_OBJECT_CLASS(sino_image_texture_parent_class)->finalize(object);
+}
+
+static void sino_image_texture_class_init(SinoImageTextureClass* klass) {
+    FL_PIXEL_BUFFER_TEXTURE_CLASS(klass)->copy_pixels = sino_image_texture_copy_pixels;
+    G_OBJECT_CLASS(klass)->finalize = sino_image_texture_finalize;
+}
+
+static void sino_image_texture_init(SinoImageTexture* self) {
+    self->frames = new ImageTextureFrames();
+}
+
+ImageTextures::ImageTextures(FlTextureRegistrar* registrar)
+        : registrar(FL_TEXTURE_REGISTRAR(g_object_ref(registrar))) {}
+
+ImageTextures::~ImageTextures() {
+    for (auto& [name, texture] : textures) {
+        fl_texture_registrar_unregister_texture(registrar, texture);
+        g_object_unref(texture);
+    }
+    g_object_unref(registrar);
+}
+
+bool ImageTextures::decode(const ImageSegmentView& view, ImageFrames& frames, std::string& error) {
+    JpegCodec& codec = JpegCodec::getInstance();
+    frames.sequence = view.sequence();
+    frames.planes.clear();
+    std::string planeError = "The scan has no images";
+    for (size_t i = 0; i < view.planes().size(); i++) {
+        const std::string& name = view.planes()[i].name;
+        std::string_view bytes = view.plane(i);
+        ImageFrames::Plane plane{name, {}};
+        if (!codec.decode(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), JpegCodec::Layout::Rgba,
+                          plane.image, planeError)) {
+            SINO_LOG_WARN("ImageTextures: Cannot decode plane %s of scan %llu: %s", name.c_str(),
+                          static_cast<unsigned long long>(frames.sequence), planeError.c_str());
+            continue;
+        }
+        frames.planes.push_back(std::move(plane));
+    }
+    if (frames.planes.empty()) {
+        error = planeError;
+        return false;
+    }
+    return true;
+}
+
+FlValue* ImageTextures::show(ImageFrames& frames) {
+    FlValue* result = fl_value_new_map();
+    FlValue* ids = fl_value_new_map();
+    for (ImageFrames::Plane& plane : frames.planes) {
+        FlTexture*& texture = textures[plane.name];
+        if (!texture) {
+            texture = FL_TEXTURE(g_object_new(sino_image_texture_get_type(), nullptr));
+            fl_texture_registrar_register_texture(registrar, texture);
+        }
+
+        FlValue* entry = fl_value_new_map();
+        fl_value_set_string_take(entry, "id", fl_value_new_int(fl_texture_get_id(texture)));
+        fl_value_set_string_take(entry, "width", fl_value_new_int(static_cast<int64_t>(plane.image.width)));
+        fl_value_set_string_take(entry, "height", fl_value_new_int(static_cast<int64_t>(plane.image.height)));
+        fl_value_set_string_take(ids, plane.name.c_str(), entry);
+
+        ImageTextureFrames* texture_frames = SINO_IMAGE_TEXTURE(texture)->frames;
+        {
+            std::lock_guard<std::mutex> lock(texture_frames->mutex);
+            texture_frames->pending = std::make_unique<JpegCodec::Image>(std::move(plane.image));
+        }
+        fl_texture_registrar_mark_texture_frame_available(registrar, texture);
+    }
+    fl_value_set_string_take(result, "sequence", fl_value_new_int(static_cast<int64_t>(frames.sequence)));
+    fl_value_set_string_take(result, "textures", ids);
+    return result;
+}
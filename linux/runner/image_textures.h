@@ -0,0 +1,57 @@
+#ifndef FLUTTER_IMAGE_TEXTURES_H_
+#define FLUTTER_IMAGE_TEXTURES_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "src/image_ring.h"
+#include "src/jpeg_codec.h"
+
+// The image planes of one scan, decoded to RGBA and waiting to be shown.
+struct ImageFrames {
+    struct Plane {
+        std::string name;   // File name suffix, as in the ImageRing segment
+        JpegCodec::Image image;
+    };
+    uint64_t sequence = 0;
+    std::vector<Plane> planes;
+};
+
+// Shows scan images to Dart as Flutter textures, one FlPixelBufferTexture
+// per image plane (white, IR, UV, portraits), so a new scan reaches the
+// screen without going through Dart or an image codec there.
+//
+// The SDK can only hand images out as JPEG files, which publishImages
+// stages on tmpfs; decode() turns a published segment into RGBA frames in
+// pooled buffers, on whatever thread calls it. show() then swaps them in on
+// the main loop. A plane keeps its texture, and texture id, from one scan
+// to the next; the engine copies the newest frame at its next raster.
+class ImageTextures {
+public:
+    explicit ImageTextures(FlTextureRegistrar* registrar);
+    // Unregisters every texture.
+    ~ImageTextures();
+
+    // Any thread. Planes that do not decode are left out and logged; false
+    // with |error| set only if none does.
+    static bool decode(const ImageSegmentView& view, ImageFrames& frames, std::string& error);
+
+    // Main loop only. Registers a texture for each plane seen for the first
+    // time and hands every plane its new frame. Returns (a new reference)
+    // {"sequence": n, "textures": {name: {"id", "width", "height"}}}, listing
+    // the planes of |frames| only.
+    FlValue* show(ImageFrames& frames);
+
+private:
+    FlTextureRegistrar* registrar;
+    std::map<std::string, FlTexture*> textures;   // Plane name -> texture
+
+    // Prevent copying
+    ImageTextures(const ImageTextures&) = delete;
+    ImageTextures& operator=(const ImageTextures&) = delete;
+};
+
+#endif
@@ -7,13 +7,76 @@
 
 #include "flutter/generated_plugin_registrant.h"
 #include "src/sinosecu_wrapper.h"
+#include "src/scanner_executor.h"
+#include "src/detection_engine.h"
+#include "src/kiosk_pipeline.h"
+#include "src/scanner_warmup.h"
+#include "src/sdk_trace_recorder.h"
+#include "src/scanner_client.h"
+#include "src/image_ring.h"
+#include "runner/image_textures.h"
+#include "runner/scan_record_value.h"
+#include "src/usb_hotplug_monitor.h"
+#include "src/logger.h"
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <functional>
 #include <memory>
 #include <iostream>
 #include <map>
+#include <unistd.h>
 
-// Global instance of our scanner wrapper.
+// Global instance of our scanner wrapper. The pointer itself is only
+// created and reset on the GTK main thread; every SDK call made through it
+// runs on global_sdk_executor.
 static std::unique_ptr<SinosecuScanner> global_scanner_instance;
 
+// Dedicated SDK thread. Blocking scanner calls are posted here so the GTK
+// main loop keeps rendering while a scan is in progress.
+static std::unique_ptr<ScannerExecutor> global_sdk_executor;
+
+// Native document detection loop, published over the detection event
+// channel while Dart is listening.
+static std::unique_ptr<DetectionEngine> global_detection_engine;
+static FlEventChannel* global_detection_channel = nullptr;
+
+// Wakes detection out of its idle back-off when a USB device comes or goes.
+static std::unique_ptr<UsbHotplugMonitor> global_usb_monitor;
+
+// Continuous scan mode. Fed by detection engine events; finished scans are
+// published on the kiosk event channel.
+static std::unique_ptr<KioskPipeline> global_kiosk_pipeline;
+static std::unique_ptr<ImageRing> global_image_ring;   // publishImages segments (local mode)
+static std::unique_ptr<ImageTextures> global_image_textures;   // showScanImages planes; main loop only
+// Decodes showScanImages segments, so neither the SDK thread nor the daemon
+// client's reader thread waits on libjpeg.
+static std::unique_ptr<ScannerExecutor> global_decode_executor;
+static FlEventChannel* global_kiosk_channel = nullptr;
+static std::atomic<bool> global_detection_listening{false};   // Dart is listening on the detection channel
+
+// SDK readiness, as last reported by a warm-up or initializeScanner call.
+// Main loop only; SDK-thread results arrive through deliver_readiness().
+struct ScannerReadiness {
+    const char* state = "idle";   // idle | warming | ready | failed
+    const char* source = "";      // warmup | channel | daemon
+    int result = 0;               // initializeScanner result
+    int64_t timeToReadyMicros = 0;   // From activate to the SDK being ready
+    SinosecuScanner::InitPhases phases;
+};
+static ScannerReadiness global_readiness;
+static std::chrono::steady_clock::time_point global_activate_time;
+static FlEventChannel* global_readiness_channel = nullptr;
+
+// Daemon mode: with SINO_SCANNER_DAEMON set, sino_scannerd owns the SDK and
+// this process holds no scanner, executor or detection engine. SDK calls
+// are forwarded to the daemon, which keeps the SDK warm across UI restarts.
+// Main loop only; reconnected on the next call if the daemon restarts.
+// SINO_SCANNER_READER=N picks reader N when the socket is a reader pool's.
+static std::string global_daemon_socket;
+static int global_daemon_reader = -1;
+static std::unique_ptr<ScannerClient> global_daemon_client;
+
 struct _MyApplication {
     GtkApplication parent_instance;
     char** dart_entrypoint_arguments;
@@ -21,6 +84,499 @@ struct _MyApplication {
 
 G_DEFINE_TYPE(MyApplication, my_application, GTK_TYPE_APPLICATION);
 
+// A method call response produced on the SDK thread, waiting to be delivered
+// from the GTK main loop.
+struct PendingResponse {
+    FlMethodCall* method_call;
+    FlMethodResponse* response;
+};
+
+static gboolean deliver_pending_response(gpointer user_data) {
+    PendingResponse* pending = static_cast<PendingResponse*>(user_data);
+    fl_method_call_respond(pending->method_call, pending->response, nullptr);
+    g_object_unref(pending->response);
+    g_object_unref(pending->method_call);
+    delete pending;
+    return G_SOURCE_REMOVE;
+}
+
+// Hand |response| back to the main loop; fl_method_call_respond must not be
+// called from the SDK thread. Takes ownership of |response|.
+static void respond_on_main_thread(FlMethodCall* method_call, FlMethodResponse* response) {
+    PendingResponse* pending = new PendingResponse{FL_METHOD_CALL(g_object_ref(method_call)), response};
+    g_idle_add(deliver_pending_response, pending);
+}
+
+// showScanImages frames decoded off the main loop, waiting to be shown.
+struct PendingScanImages {
+    FlMethodCall* method_call;
+    ImageFrames frames;
+    std::string error;   // Set if nothing was decoded
+};
+
+static gboolean deliver_scan_images(gpointer user_data) {
+    PendingScanImages* pending = static_cast<PendingScanImages*>(user_data);
+    g_autoptr(FlMethodResponse) response = nullptr;
+    if (!pending->error.empty()) {
+        response = FL_METHOD_RESPONSE(fl_method_error_response_new("IMAGES_FAILED", pending->error.c_str(), nullptr));
+    } else if (!global_image_textures) {
+        response = FL_METHOD_RESPONSE(fl_method_error_response_new("IMAGES_FAILED", "No texture registrar.", nullptr));
+    } else {
+        g_autoptr(FlValue) result = global_image_textures->show(pending->frames);
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+    fl_method_call_respond(pending->method_call, response, nullptr);
+    g_object_unref(pending->method_call);
+    delete pending;
+    return G_SOURCE_REMOVE;
+}
+
+// Decodes the segment behind |fd| (taking ownership) on the decode thread
+// and shows it from the main loop, responding to |method_call|. Returns at
+// once, from any thread.
+static void show_scan_images(FlMethodCall* method_call, int fd) {
+    PendingScanImages* pending = new PendingScanImages{FL_METHOD_CALL(g_object_ref(method_call)), {}, {}};
+    bool queued = global_decode_executor && global_decode_executor->post([pending, fd]() {
+        ImageSegmentView view;
+        if (view.open(fd, pending->error)) {
+            ImageTextures::decode(view, pending->frames, pending->error);
+        }
+        g_idle_add(deliver_scan_images, pending);
+    });
+    if (!queued) {
+        if (fd >= 0) close(fd);
+        pending->error = "Image decoder not running.";
+        g_idle_add(deliver_scan_images, pending);
+    }
+}
+
+// Run |work| on the SDK thread and respond with whatever it returns.
+static void dispatch_to_sdk_thread(FlMethodCall* method_call, std::function<FlMethodResponse*()> work) {
+    g_object_ref(method_call);
+    bool queued = global_sdk_executor && global_sdk_executor->post([method_call, work]() {
+        FlMethodResponse* response = work();
+        respond_on_main_thread(method_call, response);
+        g_object_unref(method_call);
+    });
+
+    if (!queued) {
+        std::cerr << "Linux side: SDK thread is not running." << std::endl;
+        fl_method_call_respond(method_call, FL_METHOD_RESPONSE(fl_method_error_response_new("SCANNER_NOT_READY", "SDK thread not running.", nullptr)), nullptr);
+        g_object_unref(method_call);
+    }
+}
+
+// Daemon mode: send |message| to sino_scannerd and respond with what
+// |convert| makes of the reply. Daemon errors become method errors with the
+// daemon's code (DISCONNECTED if it went away).
+static void dispatch_to_daemon(FlMethodCall* method_call, DaemonMessage message, const std::vector<uint8_t>& payload,
+                               std::function<FlMethodResponse*(DaemonReader&)> convert) {
+    g_object_ref(method_call);
+    bool sent = global_daemon_client && global_daemon_client->send(message, payload,
+            [method_call, convert](ScannerClient::Reply& reply) {
+        FlMethodResponse* response = nullptr;
+        if (reply.ok) {
+            DaemonReader reader(reply.payload);
+            response = convert(reader);
+            if (!reader.ok()) {
+                g_object_unref(response);
+                response = nullptr;
+            }
+        }
+        if (!response) {
+            std::string code = reply.ok ? "DAEMON_ERROR" : reply.errorCode;
+            std::string message = reply.ok ? "Malformed reply from sino_scannerd" : reply.errorMessage;
+            response = FL_METHOD_RESPONSE(fl_method_error_response_new(code.c_str(), message.c_str(), nullptr));
+        }
+        respond_on_main_thread(method_call, response);
+        g_object_unref(method_call);
+    });
+
+    if (!sent) {
+        fl_method_call_respond(method_call, FL_METHOD_RESPONSE(fl_method_error_response_new("SCANNER_NOT_READY", "sino_scannerd is not running.", nullptr)), nullptr);
+        g_object_unref(method_call);
+    }
+}
+
+// Daemon replies that are a single int or bool.
+static FlMethodResponse* daemon_int_response(DaemonReader& reply) {
+    int32_t value = 0;
+    reply.i32(value);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(value)));
+}
+
+static FlMethodResponse* daemon_bool_response(DaemonReader& reply) {
+    bool value = false;
+    reply.boolean(value);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(value)));
+}
+
+// publishImages result: {"sequence": n, "planes": {suffix: bytes}}, copied
+// out of the mapped segment.
+static FlMethodResponse* images_response(int fd) {
+    ImageSegmentView view;
+    std::string error;
+    if (!view.open(fd, error)) {
+        return FL_METHOD_RESPONSE(fl_method_error_response_new("IMAGES_FAILED", error.c_str(), nullptr));
+    }
+    g_autoptr(FlValue) result = fl_value_new_map();
+    FlValue* planes = fl_value_new_map();
+    for (size_t i = 0; i < view.planes().size(); i++) {
+        std::string_view bytes = view.plane(i);
+        fl_value_set_string_take(planes, view.planes()[i].name.c_str(),
+                                 fl_value_new_uint8_list(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size()));
+    }
+    fl_value_set_string_take(result, "sequence", fl_value_new_int(static_cast<int64_t>(view.sequence())));
+    fl_value_set_string_take(result, "planes", planes);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlMethodResponse* scan_record_response(const ScanRecord& record) {
+    g_autoptr(FlValue) map = scan_record_value(record);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(map));
+}
+
+// {"documents": {"<type>": {"scans": n, "stages": {"<stage>": {"count", "min_us",
+// "p50_us", "p90_us", "p99_us", "max_us", "mean_us"}}}}, "failures": {...}}.
+// The "all" document row merges every type.
+static FlMethodResponse* scan_metrics_response(const ScanMetrics::Summary& summary) {
+    g_autoptr(FlValue) map = fl_value_new_map();
+
+    FlValue* documents = fl_value_new_map();
+    for (const auto& document : summary.documents) {
+        FlValue* stages = fl_value_new_map();
+        for (const auto& stage : document.stages) {
+            FlValue* values = fl_value_new_map();
+            fl_value_set_string_take(values, "count", fl_value_new_int(static_cast<int64_t>(stage.count)));
+            fl_value_set_string_take(values, "min_us", fl_value_new_int(stage.min));
+            fl_value_set_string_take(values, "p50_us", fl_value_new_int(stage.p50));
+            fl_value_set_string_take(values, "p90_us", fl_value_new_int(stage.p90));
+            fl_value_set_string_take(values, "p99_us", fl_value_new_int(stage.p99));
+            fl_value_set_string_take(values, "max_us", fl_value_new_int(stage.max));
+            fl_value_set_string_take(values, "mean_us", fl_value_new_int(stage.mean));
+            fl_value_set_string_take(stages, ScanMetrics::stageName(stage.stage), values);
+        }
+        FlValue* entry = fl_value_new_map();
+        fl_value_set_string_take(entry, "scans", fl_value_new_int(static_cast<int64_t>(document.scans)));
+        fl_value_set_string_take(entry, "stages", stages);
+        fl_value_set_string_take(documents, document.documentType.c_str(), entry);
+    }
+    fl_value_set_string_take(map, "documents", documents);
+
+    FlValue* failures = fl_value_new_map();
+    for (const auto& [kind, count] : summary.failures) {
+        fl_value_set_string_take(failures, kind.c_str(), fl_value_new_int(static_cast<int64_t>(count)));
+    }
+    fl_value_set_string_take(map, "failures", failures);
+
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(map));
+}
+
+// {"path", "records", "dropped", "bytes", "compressed"}.
+static FlValue* sdk_trace_stats_value(const SdkTraceRecorder::Stats& stats) {
+    FlValue* map = fl_value_new_map();
+    fl_value_set_string_take(map, "path", fl_value_new_string(stats.path.c_str()));
+    fl_value_set_string_take(map, "records", fl_value_new_int(static_cast<int64_t>(stats.records)));
+    fl_value_set_string_take(map, "dropped", fl_value_new_int(static_cast<int64_t>(stats.dropped)));
+    fl_value_set_string_take(map, "bytes", fl_value_new_int(static_cast<int64_t>(stats.bytes)));
+    fl_value_set_string_take(map, "compressed", fl_value_new_bool(stats.compressed));
+    return map;
+}
+
+// {"state", "source", "result", "time_to_ready_us", "phases_us": {"verify",
+// "init_sdk", "config_file", "document_types", "total"}}.
+static FlValue* readiness_value(const ScannerReadiness& readiness) {
+    FlValue* map = fl_value_new_map();
+    fl_value_set_string_take(map, "state", fl_value_new_string(readiness.state));
+    fl_value_set_string_take(map, "source", fl_value_new_string(readiness.source));
+    fl_value_set_string_take(map, "result", fl_value_new_int(readiness.result));
+    fl_value_set_string_take(map, "time_to_ready_us", fl_value_new_int(readiness.timeToReadyMicros));
+
+    FlValue* phases = fl_value_new_map();
+    fl_value_set_string_take(phases, "verify", fl_value_new_int(readiness.phases.verifyMicros));
+    fl_value_set_string_take(phases, "init_sdk", fl_value_new_int(readiness.phases.sdkInitMicros));
+    fl_value_set_string_take(phases, "config_file", fl_value_new_int(readiness.phases.configFileMicros));
+    fl_value_set_string_take(phases, "document_types", fl_value_new_int(readiness.phases.documentTypesMicros));
+    fl_value_set_string_take(phases, "total", fl_value_new_int(readiness.phases.totalMicros));
+    fl_value_set_string_take(map, "phases_us", phases);
+    return map;
+}
+
+static void publish_readiness() {
+    if (global_readiness_channel) {
+        g_autoptr(FlValue) event = readiness_value(global_readiness);
+        fl_event_channel_send(global_readiness_channel, event, nullptr, nullptr);
+    }
+}
+
+static void set_readiness_state(const char* state, const char* source) {
+    global_readiness.state = state;
+    global_readiness.source = source;
+    publish_readiness();
+}
+
+// An initializeScanner outcome waiting to be recorded from the GTK main loop.
+struct PendingReadiness {
+    const char* source;
+    int result;
+    SinosecuScanner::InitPhases phases;
+    int64_t timeToReadyMicros;
+};
+
+static gboolean deliver_readiness(gpointer user_data) {
+    PendingReadiness* pending = static_cast<PendingReadiness*>(user_data);
+    bool ready = pending->result == SinosecuScanner::SUCCESS;
+    bool wasReady = strcmp(global_readiness.state, "ready") == 0;
+    global_readiness.state = ready ? "ready" : "failed";
+    global_readiness.source = pending->source;
+    global_readiness.result = pending->result;
+    if (!ready || !wasReady) {
+        // A repeat initializeScanner that found the SDK already warm keeps
+        // the original time to ready.
+        global_readiness.timeToReadyMicros = ready ? pending->timeToReadyMicros : 0;
+        global_readiness.phases = pending->phases;
+    }
+    publish_readiness();
+    delete pending;
+    return G_SOURCE_REMOVE;
+}
+
+// Runs on the SDK thread after initializeScanner returns.
+static void report_initialization(SinosecuScanner* scanner, const char* source, int result) {
+    auto timeToReady = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - global_activate_time).count();
+    g_idle_add(deliver_readiness, new PendingReadiness{source, result, scanner->getInitPhases(), timeToReady});
+}
+
+static FlMethodErrorResponse* readiness_listen_cb(FlEventChannel* channel, FlValue* args, gpointer user_data) {
+    // New listeners get the current state straight away.
+    publish_readiness();
+    return nullptr;
+}
+
+// A detection event waiting to be sent from the GTK main loop.
+struct PendingDetectionEvent {
+    DetectionEngine::Event event;
+};
+
+static gboolean deliver_detection_event(gpointer user_data) {
+    PendingDetectionEvent* pending = static_cast<PendingDetectionEvent*>(user_data);
+    bool streaming = global_daemon_client ? global_detection_listening.load()
+                                          : global_detection_engine && global_detection_engine->isRunning();
+    if (global_detection_channel && streaming) {
+        g_autoptr(FlValue) event_map = fl_value_new_map();
+        fl_value_set_string_take(event_map, "state", fl_value_new_string(DetectionEngine::stateName(pending->event.state)));
+        fl_value_set_string_take(event_map, "code", fl_value_new_int(pending->event.code));
+        fl_value_set_string_take(event_map, "timestampMs", fl_value_new_int(pending->event.timestampMs));
+        fl_event_channel_send(global_detection_channel, event_map, nullptr, nullptr);
+    }
+    delete pending;
+    return G_SOURCE_REMOVE;
+}
+
+// Runs on the detection engine thread; the poll itself is queued on the SDK
+// thread so it never overlaps AutoProcessIDCard or a chip read.
+static int detection_probe() {
+    if (!global_sdk_executor) {
+        return SinosecuScanner::ERROR_INIT;
+    }
+    std::future<int> result = global_sdk_executor->submit([]() {
+        return global_scanner_instance ? global_scanner_instance->detectDocumentOnScanner()
+                                       : SinosecuScanner::ERROR_INIT;
+    });
+    return result.get();
+}
+
+static FlMethodErrorResponse* detection_listen_cb(FlEventChannel* channel, FlValue* args, gpointer user_data) {
+    std::cout << "Linux side: Detection stream listening." << std::endl;
+    global_detection_listening = true;
+    if (global_daemon_client) {
+        // The daemon runs one engine for every subscribed client.
+        DaemonWriter mask;
+        mask.u32(daemon_protocol::kEventDetection);
+        global_daemon_client->send(DaemonMessage::Subscribe, mask.bytes(), [](ScannerClient::Reply&) {});
+        return nullptr;
+    }
+    global_detection_engine->start();
+    return nullptr;
+}
+
+static FlMethodErrorResponse* detection_cancel_cb(FlEventChannel* channel, FlValue* args, gpointer user_data) {
+    std::cout << "Linux side: Detection stream cancelled." << std::endl;
+    global_detection_listening = false;
+    if (global_daemon_client) {
+        DaemonWriter mask;
+        mask.u32(daemon_protocol::kEventDetection);
+        global_daemon_client->send(DaemonMessage::Unsubscribe, mask.bytes(), [](ScannerClient::Reply&) {});
+        return nullptr;
+    }
+    // Kiosk mode keeps the engine running on its own.
+    if (global_detection_engine && !(global_kiosk_pipeline && global_kiosk_pipeline->isRunning())) {
+        global_detection_engine->pause();
+    }
+    return nullptr;
+}
+
+// Daemon mode: an event from sino_scannerd waiting to be applied on the GTK
+// main loop.
+struct PendingDaemonEvent {
+    DaemonFrame frame;
+};
+
+static const char* readiness_state_literal(const std::string& state) {
+    for (const char* known : {"idle", "warming", "ready", "failed"}) {
+        if (state == known) return known;
+    }
+    return "failed";
+}
+
+static gboolean deliver_daemon_event(gpointer user_data) {
+    PendingDaemonEvent* pending = static_cast<PendingDaemonEvent*>(user_data);
+    DaemonReader event(pending->frame.payload);
+    if (pending->frame.message == DaemonMessage::ReadinessEvent) {
+        std::string state;
+        int32_t result = 0;
+        ScannerReadiness readiness;
+        if (event.str(state) && event.i32(result) && event.i64(readiness.timeToReadyMicros) &&
+            event.i64(readiness.phases.verifyMicros) && event.i64(readiness.phases.sdkInitMicros) &&
+            event.i64(readiness.phases.configFileMicros) && event.i64(readiness.phases.documentTypesMicros) &&
+            event.i64(readiness.phases.totalMicros)) {
+            readiness.state = readiness_state_literal(state);
+            readiness.source = "daemon";
+            readiness.result = result;
+            global_readiness = readiness;
+            publish_readiness();
+        }
+    } else if (pending->frame.message == DaemonMessage::DetectionEvent) {
+        std::string state;
+        int32_t code = 0;
+        int64_t timestampMs = 0;
+        if (global_detection_listening && event.str(state) && event.i32(code) && event.i64(timestampMs)) {
+            // Same mapping the daemon used to name the state.
+            DetectionEngine::Event detection{DetectionEngine::stateFromCode(code), code, timestampMs};
+            deliver_detection_event(new PendingDetectionEvent{detection});
+        }
+    }
+    delete pending;
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean deliver_daemon_lost(gpointer user_data) {
+    set_readiness_state("failed", "daemon");
+    return G_SOURCE_REMOVE;
+}
+
+// Daemon mode: connects to sino_scannerd if not already connected, and
+// subscribes to readiness (and detection, if Dart is listening). Called at
+// activate and again before each method call, so a restarted daemon is
+// picked up on the next call. Main loop only; connect() gives up after a
+// couple of seconds if the daemon does not answer, so a wedged one costs a
+// short stall rather than a hung UI.
+static bool ensure_daemon_connected() {
+    if (global_daemon_client->isConnected()) {
+        return true;
+    }
+    std::string error;
+    bool connected = global_daemon_reader >= 0
+            ? global_daemon_client->connect(global_daemon_socket, "sino_scanner runner",
+                                            static_cast<uint32_t>(global_daemon_reader), error)
+            : global_daemon_client->connect(global_daemon_socket, "sino_scanner runner", error);
+    if (!connected) {
+        std::cerr << "Linux side: " << error << std::endl;
+        return false;
+    }
+    uint32_t events = daemon_protocol::kEventReadiness | (global_detection_listening ? daemon_protocol::kEventDetection : 0);
+    DaemonWriter mask;
+    mask.u32(events);
+    global_daemon_client->send(DaemonMessage::Subscribe, mask.bytes(), [](ScannerClient::Reply&) {});
+    return true;
+}
+
+static void start_daemon_client(const char* socket) {
+    global_daemon_socket = strcmp(socket, "1") == 0 ? daemon_protocol::defaultSocketPath() : std::string(socket);
+    const char* reader = getenv("SINO_SCANNER_READER");
+    if (reader && *reader) {
+        global_daemon_reader = atoi(reader);
+    }
+    global_daemon_client = std::make_unique<ScannerClient>();
+    global_daemon_client->setEventHandler([](const DaemonFrame& event) {
+        if (event.message == DaemonMessage::ReadinessEvent || event.message == DaemonMessage::DetectionEvent) {
+            g_idle_add(deliver_daemon_event, new PendingDaemonEvent{event});
+        } else if (event.fd >= 0) {
+            close(event.fd);
+        }
+    });
+    global_daemon_client->setDisconnectHandler([]() {
+        g_idle_add(deliver_daemon_lost, nullptr);
+    });
+    std::cout << "Linux side: Forwarding scanner calls to sino_scannerd at " << global_daemon_socket << std::endl;
+    ensure_daemon_connected();
+}
+
+// Kiosk mode and SDK traces live with the SDK; run them in the daemon's
+// process instead.
+static bool is_local_only_method(const char* method_name) {
+    for (const char* local : {"startKioskMode", "stopKioskMode", "startSdkTrace", "stopSdkTrace"}) {
+        if (strcmp(method_name, local) == 0) return true;
+    }
+    return false;
+}
+
+// A finished kiosk scan waiting to be sent from the GTK main loop.
+struct PendingKioskEvent {
+    FlValue* event;
+};
+
+static gboolean deliver_kiosk_event(gpointer user_data) {
+    PendingKioskEvent* pending = static_cast<PendingKioskEvent*>(user_data);
+    if (global_kiosk_channel) {
+        fl_event_channel_send(global_kiosk_channel, pending->event, nullptr, nullptr);
+    }
+    fl_value_unref(pending->event);
+    delete pending;
+    return G_SOURCE_REMOVE;
+}
+
+// Runs on a kiosk worker thread: the event value is built here, off both the
+// SDK thread and the main loop, and only sent from the main loop.
+static void kiosk_sink(SinosecuScanner* scanner, const KioskScan& scan) {
+    auto serializeStart = std::chrono::steady_clock::now();
+    FlValue* event = fl_value_new_map();
+    fl_value_set_string_take(event, "sequence", fl_value_new_int(static_cast<int64_t>(scan.sequence)));
+    fl_value_set_string_take(event, "result", scan_record_value(scan.record));
+    fl_value_set_string_take(event, "images_saved", fl_value_new_bool(scan.imagesSaved));
+    if (!scan.imageBase.empty()) {
+        fl_value_set_string_take(event, "image_base", fl_value_new_string(scan.imageBase.c_str()));
+    }
+    if (!scan.archivePath.empty()) {
+        fl_value_set_string_take(event, "archive_path", fl_value_new_string(scan.archivePath.c_str()));
+    }
+    FlValue* valid = fl_value_new_map();
+    fl_value_set_string_take(valid, "passport_number", fl_value_new_bool(scan.passportNumberValid));
+    fl_value_set_string_take(valid, "dates", fl_value_new_bool(scan.datesValid));
+    fl_value_set_string_take(valid, "mrz", fl_value_new_bool(scan.mrzValid));
+    fl_value_set_string_take(event, "valid", valid);
+    fl_value_set_string_take(event, "sdk_us", fl_value_new_int(scan.sdkMicros));
+    fl_value_set_string_take(event, "post_process_us", fl_value_new_int(scan.postProcessMicros));
+
+    if (scan.record.succeeded()) {
+        auto serializeMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - serializeStart).count();
+        scanner->getScanMetrics().record(scan.record.documentName, ScanMetrics::Stage::Serialize, serializeMicros);
+    }
+    g_idle_add(deliver_kiosk_event, new PendingKioskEvent{event});
+}
+
+static FlValue* kiosk_stats_value(const KioskPipeline::Stats& stats) {
+    FlValue* map = fl_value_new_map();
+    fl_value_set_string_take(map, "documents", fl_value_new_int(static_cast<int64_t>(stats.documents)));
+    fl_value_set_string_take(map, "completed", fl_value_new_int(static_cast<int64_t>(stats.completed)));
+    fl_value_set_string_take(map, "failed", fl_value_new_int(static_cast<int64_t>(stats.failed)));
+    fl_value_set_string_take(map, "backpressure_waits", fl_value_new_int(static_cast<int64_t>(stats.backpressureWaits)));
+    fl_value_set_string_take(map, "in_flight", fl_value_new_int(static_cast<int64_t>(stats.inFlight)));
+    return map;
+}
+
 // Platform Channel Method Call Handler
 static void method_call_handler(FlMethodChannel* channel,
                                 FlMethodCall* method_call,
@@ -28,7 +584,13 @@ static void method_call_handler(FlMethodChannel* channel,
     const gchar* method_name = fl_method_call_get_name(method_call);
     FlValue* args = fl_method_call_get_args(method_call);
 
-    if (strcmp(method_name, "initializeScanner") == 0) {
+    if (global_daemon_client) {
+        if (is_local_only_method(method_name)) {
+            fl_method_call_respond(method_call, FL_METHOD_RESPONSE(fl_method_error_response_new("DAEMON_MODE", "Not available while sino_scannerd owns the scanner.", nullptr)), nullptr);
+            return;
+        }
+        ensure_daemon_connected();
+    } else if (strcmp(method_name, "initializeScanner") == 0) {
         if (!global_scanner_instance) {
             global_scanner_instance = std::make_unique<SinosecuScanner>();
         }
@@ -40,6 +602,7 @@ static void method_call_handler(FlMethodChannel* channel,
         }
     }
 
+    SinosecuScanner* scanner = global_scanner_instance.get();
     FlMethodResponse* response = nullptr;
 
     if (strcmp(method_name, "initializeScanner") == 0) {
@@ -67,21 +630,61 @@ static void method_call_handler(FlMethodChannel* channel,
                       << ", nType: " << nType
                       << ", Directory: " << (sdkDirectory_cstr ? sdkDirectory_cstr : "NULL") << std::endl;
 
-            int result = global_scanner_instance->initializeScanner(std::string(userId_cstr ? userId_cstr : ""), nType, std::string(sdkDirectory_cstr ? sdkDirectory_cstr : ""));
-            response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+            std::string userId(userId_cstr ? userId_cstr : "");
+            std::string sdkDirectory(sdkDirectory_cstr ? sdkDirectory_cstr : "");
+            if (global_daemon_client) {
+                // The daemon publishes readiness and saves the warm-up settings.
+                DaemonWriter request;
+                request.str(userId).i32(nType).str(sdkDirectory).str("");
+                dispatch_to_daemon(method_call, DaemonMessage::Initialize, request.bytes(), daemon_int_response);
+                return;
+            }
+            if (strcmp(global_readiness.state, "ready") != 0) {
+                set_readiness_state("warming", "channel");
+            }
+            dispatch_to_sdk_thread(method_call, [scanner, userId, nType, sdkDirectory]() {
+                // Returns at once if the start-up warm-up already used these settings.
+                int result = scanner->initializeScanner(userId, nType, sdkDirectory);
+                report_initialization(scanner, "channel", result);
+                if (result == SinosecuScanner::SUCCESS) {
+                    // Warm up with the same settings on the next start.
+                    WarmupSettings settings = WarmupSettings::load();
+                    settings.userId = userId;
+                    settings.nType = nType;
+                    settings.sdkDirectory = sdkDirectory;
+                    settings.save();
+                }
+                return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+            });
         }
     }
     else if (strcmp(method_name, "releaseScanner") == 0) {
         std::cout << "Linux side: Calling releaseScanner." << std::endl;
-        if (global_scanner_instance) {
-            global_scanner_instance->releaseScanner();
+        if (global_daemon_client) {
+            // Left initialized while other clients share the daemon.
+            global_daemon_client->send(DaemonMessage::CancelWait, {}, [](ScannerClient::Reply&) {});
+            dispatch_to_daemon(method_call, DaemonMessage::Release, {}, [](DaemonReader&) {
+                return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+            });
+            return;
         }
-        response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+        scanner->cancelPendingWait();
+        set_readiness_state("idle", "channel");
+        dispatch_to_sdk_thread(method_call, [scanner]() {
+            scanner->releaseScanner();
+            return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+        });
     }
     else if (strcmp(method_name, "detectDocument") == 0) {
         std::cout << "Linux side: Calling detectDocumentOnScanner." << std::endl;
-        int result = global_scanner_instance->detectDocumentOnScanner();
-        response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+        if (global_daemon_client) {
+            dispatch_to_daemon(method_call, DaemonMessage::DetectDocument, {}, daemon_int_response);
+            return;
+        }
+        dispatch_to_sdk_thread(method_call, [scanner]() {
+            int result = scanner->detectDocumentOnScanner();
+            return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+        });
     }
     else if (strcmp(method_name, "waitForDocumentDetection") == 0) {
         if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
@@ -93,20 +696,48 @@ static void method_call_handler(FlMethodChannel* channel,
             } else {
                 int timeoutSeconds = fl_value_get_int(timeout_value);
                 std::cout << "Linux side: Waiting for document detection (timeout: " << timeoutSeconds << "s)" << std::endl;
-                int result = global_scanner_instance->waitForDocumentDetection(timeoutSeconds);
-                response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+                if (global_daemon_client) {
+                    DaemonWriter request;
+                    request.i32(timeoutSeconds);
+                    dispatch_to_daemon(method_call, DaemonMessage::WaitForDocument, request.bytes(), daemon_int_response);
+                    return;
+                }
+                // Taken now, so a releaseScanner made while this is queued cancels it.
+                uint64_t generation = scanner->waitGeneration();
+                dispatch_to_sdk_thread(method_call, [scanner, timeoutSeconds, generation]() {
+                    int result = scanner->waitForDocumentDetection(timeoutSeconds, generation);
+                    return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+                });
             }
         }
     }
     else if (strcmp(method_name, "autoProcessDocument") == 0) {
         std::cout << "Linux side: Calling autoProcessDocument." << std::endl;
-        std::map<std::string, int> cpp_result_map = global_scanner_instance->autoProcessDocument();
-
-        g_autoptr(FlValue) return_value_map = fl_value_new_map();
-        for (const auto& pair : cpp_result_map) {
-            fl_value_set_string_take(return_value_map, pair.first.c_str(), fl_value_new_int(pair.second));
+        if (global_daemon_client) {
+            dispatch_to_daemon(method_call, DaemonMessage::AutoProcess, {}, [](DaemonReader& reply) {
+                g_autoptr(FlValue) return_value_map = fl_value_new_map();
+                uint32_t count = 0;
+                reply.u32(count);
+                for (uint32_t i = 0; i < count && reply.ok(); i++) {
+                    std::string key;
+                    int32_t value = 0;
+                    if (reply.str(key) && reply.i32(value)) {
+                        fl_value_set_string_take(return_value_map, key.c_str(), fl_value_new_int(value));
+                    }
+                }
+                return FL_METHOD_RESPONSE(fl_method_success_response_new(return_value_map));
+            });
+            return;
         }
-        response = FL_METHOD_RESPONSE(fl_method_success_response_new(return_value_map));
+        dispatch_to_sdk_thread(method_call, [scanner]() {
+            std::map<std::string, int> cpp_result_map = scanner->autoProcessDocument();
+
+            g_autoptr(FlValue) return_value_map = fl_value_new_map();
+            for (const auto& pair : cpp_result_map) {
+                fl_value_set_string_take(return_value_map, pair.first.c_str(), fl_value_new_int(pair.second));
+            }
+            return FL_METHOD_RESPONSE(fl_method_success_response_new(return_value_map));
+        });
     }
     else if (strcmp(method_name, "getDocumentFields") == 0) {
         if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
@@ -118,20 +749,56 @@ static void method_call_handler(FlMethodChannel* channel,
             } else {
                 int attribute = fl_value_get_int(attribute_value);
                 std::cout << "Linux side: Getting document fields for attribute: " << attribute << std::endl;
-                std::map<std::string, std::string> fields = global_scanner_instance->getDocumentFields(attribute);
-
-                g_autoptr(FlValue) return_value_map = fl_value_new_map();
-                for (const auto& pair : fields) {
-                    fl_value_set_string_take(return_value_map, pair.first.c_str(), fl_value_new_string(pair.second.c_str()));
+                if (global_daemon_client) {
+                    DaemonWriter request;
+                    request.i32(attribute);
+                    dispatch_to_daemon(method_call, DaemonMessage::GetDocumentFields, request.bytes(), [](DaemonReader& reply) {
+                        g_autoptr(FlValue) return_value_map = fl_value_new_map();
+                        uint32_t count = 0;
+                        reply.u32(count);
+                        for (uint32_t i = 0; i < count && reply.ok(); i++) {
+                            uint32_t position = 0;
+                            std::string value;
+                            if (reply.u32(position) && reply.str(value) && position < kPassportFieldCount) {
+                                fl_value_set_string_take(return_value_map, kPassportFields[position].name,
+                                                         fl_value_new_string_sized(value.data(), value.size()));
+                            }
+                        }
+                        return FL_METHOD_RESPONSE(fl_method_success_response_new(return_value_map));
+                    });
+                    return;
                 }
-                response = FL_METHOD_RESPONSE(fl_method_success_response_new(return_value_map));
+                dispatch_to_sdk_thread(method_call, [scanner, attribute]() {
+                    // Serialize straight from the snapshot arena.
+                    const FieldSnapshot& snapshot = scanner->captureFields(attribute);
+                    g_autoptr(FlValue) return_value_map = fl_value_new_map();
+                    snapshot.forEach([&return_value_map](const PassportFieldDescriptor& field, std::string_view value) {
+                        fl_value_set_string_take(return_value_map, field.name,
+                                                 fl_value_new_string_sized(value.data(), value.size()));
+                    });
+                    return FL_METHOD_RESPONSE(fl_method_success_response_new(return_value_map));
+                });
             }
         }
     }
     else if (strcmp(method_name, "checkDeviceStatus") == 0) {
         std::cout << "Linux side: Checking device status." << std::endl;
-        int result = global_scanner_instance->checkDeviceStatus();
-        response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+        if (global_daemon_client) {
+            // The daemon answers with its cached status while a scan runs.
+            dispatch_to_daemon(method_call, DaemonMessage::CheckDeviceStatus, {}, daemon_int_response);
+            return;
+        }
+        if (global_sdk_executor && global_sdk_executor->isBusy()) {
+            // Don't queue a status probe behind a running scan; the scan
+            // itself refreshes the cached status on every detection poll.
+            int result = scanner->getCachedDeviceStatus();
+            response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+        } else {
+            dispatch_to_sdk_thread(method_call, [scanner]() {
+                int result = scanner->checkDeviceStatus();
+                return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+            });
+        }
     }
     else if (strcmp(method_name, "scanDocumentComplete") == 0) {
         if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
@@ -143,20 +810,49 @@ static void method_call_handler(FlMethodChannel* channel,
             } else {
                 int timeoutSeconds = fl_value_get_int(timeout_value);
                 std::cout << "Linux side: Starting complete document scan (timeout: " << timeoutSeconds << "s)" << std::endl;
-                std::map<std::string, std::string> scanResult = global_scanner_instance->scanDocumentComplete(timeoutSeconds);
-
-                g_autoptr(FlValue) return_value_map = fl_value_new_map();
-                for (const auto& pair : scanResult) {
-                    fl_value_set_string_take(return_value_map, pair.first.c_str(), fl_value_new_string(pair.second.c_str()));
+                if (global_daemon_client) {
+                    DaemonWriter request;
+                    request.i32(timeoutSeconds);
+                    dispatch_to_daemon(method_call, DaemonMessage::ScanDocument, request.bytes(), [](DaemonReader& reply) {
+                        const uint8_t* data = nullptr;
+                        size_t length = 0;
+                        ScanRecord record;
+                        if (!reply.blob(data, length) || !record.fromBinary(data, length)) {
+                            return FL_METHOD_RESPONSE(fl_method_error_response_new("DAEMON_ERROR", "Malformed scan record from sino_scannerd", nullptr));
+                        }
+                        return scan_record_response(record);
+                    });
+                    return;
                 }
-                response = FL_METHOD_RESPONSE(fl_method_success_response_new(return_value_map));
+                uint64_t generation = scanner->waitGeneration();
+                dispatch_to_sdk_thread(method_call, [scanner, timeoutSeconds, generation]() {
+                    const ScanRecord& record = scanner->scanDocument(timeoutSeconds, generation);
+                    auto serializeStart = std::chrono::steady_clock::now();
+                    FlMethodResponse* scan_response = scan_record_response(record);
+                    if (record.succeeded()) {
+                        auto serializeMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - serializeStart).count();
+                        scanner->getScanMetrics().record(record.documentName, ScanMetrics::Stage::Serialize, serializeMicros);
+                    }
+                    return scan_response;
+                });
             }
         }
     }
     else if (strcmp(method_name, "getDocumentName") == 0) {
         std::cout << "Linux side: Getting document name." << std::endl;
-        std::string docName = global_scanner_instance->getDocumentName();
-        response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_string(docName.c_str())));
+        if (global_daemon_client) {
+            dispatch_to_daemon(method_call, DaemonMessage::GetDocumentName, {}, [](DaemonReader& reply) {
+                std::string docName;
+                reply.str(docName);
+                return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_string(docName.c_str())));
+            });
+            return;
+        }
+        dispatch_to_sdk_thread(method_call, [scanner]() {
+            std::string docName = scanner->getDocumentName();
+            return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_string(docName.c_str())));
+        });
     }
     else if (strcmp(method_name, "saveImages") == 0) {
         if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
@@ -169,11 +865,148 @@ static void method_call_handler(FlMethodChannel* channel,
                 !image_types_value || fl_value_get_type(image_types_value) != FL_VALUE_TYPE_INT) {
                 response = FL_METHOD_RESPONSE(fl_method_error_response_new("ARGUMENT_ERROR", "Invalid arguments for saveImages", nullptr));
             } else {
-                const char* basePath_cstr = fl_value_get_string(base_path_value);
+                std::string basePath(fl_value_get_string(base_path_value));
                 int imageTypes = fl_value_get_int(image_types_value);
-                std::cout << "Linux side: Saving images to: " << basePath_cstr << std::endl;
-                bool result = global_scanner_instance->saveImages(std::string(basePath_cstr), imageTypes);
-                response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(result)));
+                std::cout << "Linux side: Saving images to: " << basePath << std::endl;
+                if (global_daemon_client) {
+                    // Written by the daemon, so basePath must be writable by its user.
+                    DaemonWriter request;
+                    request.str(basePath).i32(imageTypes);
+                    dispatch_to_daemon(method_call, DaemonMessage::SaveImages, request.bytes(), daemon_bool_response);
+                    return;
+                }
+                dispatch_to_sdk_thread(method_call, [scanner, basePath, imageTypes]() {
+                    bool result = scanner->saveImages(basePath, imageTypes);
+                    return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(result)));
+                });
+            }
+        }
+    }
+    else if (strcmp(method_name, "publishImages") == 0) {
+        // Optional map: imageTypes (default all). The images of the last
+        // scan, straight from the SDK's files in shared memory to Dart.
+        int imageTypes = 0x1F;
+        FlValue* image_types_value = (args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP)
+                                     ? fl_value_lookup_string(args, "imageTypes") : nullptr;
+        if (image_types_value && fl_value_get_type(image_types_value) == FL_VALUE_TYPE_INT) {
+            imageTypes = static_cast<int>(fl_value_get_int(image_types_value));
+        }
+        std::cout << "Linux side: Publishing images." << std::endl;
+        if (global_daemon_client) {
+            DaemonWriter request;
+            request.i32(imageTypes);
+            g_object_ref(method_call);
+            bool sent = global_daemon_client->send(DaemonMessage::PublishImages, request.bytes(),
+                    [method_call](ScannerClient::Reply& reply) {
+                FlMethodResponse* images;
+                DaemonReader payload(reply.payload);
+                uint64_t sequence = 0;
+                if (reply.ok && reply.fd >= 0 && payload.u64(sequence)) {
+                    images = images_response(reply.fd);
+                    // The mapping outlives the reference; let the daemon reuse the slot.
+                    DaemonWriter release;
+                    release.u64(sequence);
+                    global_daemon_client->send(DaemonMessage::ReleaseImages, release.bytes(), [](ScannerClient::Reply&) {});
+                } else {
+                    if (reply.fd >= 0) close(reply.fd);
+                    std::string code = reply.ok ? "DAEMON_ERROR" : reply.errorCode;
+                    images = FL_METHOD_RESPONSE(fl_method_error_response_new(code.c_str(), reply.errorMessage.c_str(), nullptr));
+                }
+                respond_on_main_thread(method_call, images);
+                g_object_unref(method_call);
+            });
+            if (!sent) {
+                response = FL_METHOD_RESPONSE(fl_method_error_response_new("SCANNER_NOT_READY", "sino_scannerd is not running.", nullptr));
+                g_object_unref(method_call);
+            }
+        } else {
+            ImageRing* ring = global_image_ring.get();
+            dispatch_to_sdk_thread(method_call, [scanner, ring, imageTypes]() {
+                uint64_t sequence = scanner->publishImages(*ring, imageTypes);
+                ImageRing::Segment segment;
+                if (sequence == 0 || !ring->acquire(sequence, segment)) {
+                    return FL_METHOD_RESPONSE(fl_method_error_response_new("IMAGES_FAILED", scanner->getLastError().c_str(), nullptr));
+                }
+                FlMethodResponse* images = images_response(fcntl(segment.fd, F_DUPFD_CLOEXEC, 0));
+                ring->release(sequence);   // acquire's
+                ring->release(sequence);   // publishImages'
+                return images;
+            });
+        }
+    }
+    else if (strcmp(method_name, "showScanImages") == 0) {
+        // Optional map: imageTypes (default all), archivePath. The planes of
+        // the last scan as textures, {"sequence", "textures": {suffix: {"id",
+        // "width", "height"}}}. With archivePath, saveImages to it follows
+        // on the SDK side whether or not the textures could be shown.
+        int imageTypes = 0x1F;
+        std::string archivePath;
+        if (args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+            FlValue* image_types_value = fl_value_lookup_string(args, "imageTypes");
+            FlValue* archive_path_value = fl_value_lookup_string(args, "archivePath");
+            if (image_types_value && fl_value_get_type(image_types_value) == FL_VALUE_TYPE_INT) {
+                imageTypes = static_cast<int>(fl_value_get_int(image_types_value));
+            }
+            if (archive_path_value && fl_value_get_type(archive_path_value) == FL_VALUE_TYPE_STRING) {
+                archivePath = fl_value_get_string(archive_path_value);
+            }
+        }
+        // Without a texture registrar deliver_scan_images reports the error;
+        // the archive is still written.
+        if (global_daemon_client) {
+            DaemonWriter request;
+            request.i32(imageTypes);
+            g_object_ref(method_call);
+            bool sent = global_daemon_client->send(DaemonMessage::PublishImages, request.bytes(),
+                    [method_call, imageTypes, archivePath](ScannerClient::Reply& reply) {
+                DaemonReader payload(reply.payload);
+                uint64_t sequence = 0;
+                if (!archivePath.empty()) {
+                    DaemonWriter save;
+                    save.str(archivePath).i32(imageTypes);
+                    global_daemon_client->send(DaemonMessage::SaveImages, save.bytes(), [](ScannerClient::Reply&) {});
+                }
+                if (reply.ok && reply.fd >= 0 && payload.u64(sequence)) {
+                    show_scan_images(method_call, reply.fd);
+                    DaemonWriter release;
+                    release.u64(sequence);
+                    global_daemon_client->send(DaemonMessage::ReleaseImages, release.bytes(), [](ScannerClient::Reply&) {});
+                } else {
+                    if (reply.fd >= 0) close(reply.fd);
+                    std::string code = reply.ok ? "DAEMON_ERROR" : reply.errorCode;
+                    respond_on_main_thread(method_call, FL_METHOD_RESPONSE(
+                            fl_method_error_response_new(code.c_str(), reply.errorMessage.c_str(), nullptr)));
+                }
+                g_object_unref(method_call);
+            });
+            if (!sent) {
+                response = FL_METHOD_RESPONSE(fl_method_error_response_new("SCANNER_NOT_READY", "sino_scannerd is not running.", nullptr));
+                g_object_unref(method_call);
+            }
+        } else {
+            ImageRing* ring = global_image_ring.get();
+            g_object_ref(method_call);
+            bool queued = global_sdk_executor && global_sdk_executor->post([method_call, scanner, ring, imageTypes, archivePath]() {
+                uint64_t sequence = scanner->publishImages(*ring, imageTypes);
+                ImageRing::Segment segment;
+                if (sequence == 0 || !ring->acquire(sequence, segment)) {
+                    respond_on_main_thread(method_call, FL_METHOD_RESPONSE(
+                            fl_method_error_response_new("IMAGES_FAILED", scanner->getLastError().c_str(), nullptr)));
+                } else {
+                    show_scan_images(method_call, fcntl(segment.fd, F_DUPFD_CLOEXEC, 0));
+                    ring->release(sequence);   // acquire's
+                    ring->release(sequence);   // publishImages'
+                }
+                g_object_unref(method_call);
+                // Archival only, and whatever became of the textures; they
+                // do not wait for it.
+                if (!archivePath.empty()) {
+                    scanner->saveImages(archivePath, imageTypes);
+                }
+            });
+            if (!queued) {
+                response = FL_METHOD_RESPONSE(fl_method_error_response_new("SCANNER_NOT_READY", "SDK thread not running.", nullptr));
+                g_object_unref(method_call);
             }
         }
     }
@@ -185,16 +1018,128 @@ static void method_call_handler(FlMethodChannel* channel,
             if (!config_path_value || fl_value_get_type(config_path_value) != FL_VALUE_TYPE_STRING) {
                 response = FL_METHOD_RESPONSE(fl_method_error_response_new("ARGUMENT_ERROR", "Invalid configPath argument", nullptr));
             } else {
-                const char* configPath_cstr = fl_value_get_string(config_path_value);
-                std::cout << "Linux side: Loading configuration from: " << configPath_cstr << std::endl;
-                int result = global_scanner_instance->loadConfiguration(std::string(configPath_cstr));
-                response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+                std::string configPath(fl_value_get_string(config_path_value));
+                std::cout << "Linux side: Loading configuration from: " << configPath << std::endl;
+                if (global_daemon_client) {
+                    DaemonWriter request;
+                    request.str(configPath);
+                    dispatch_to_daemon(method_call, DaemonMessage::LoadConfiguration, request.bytes(), daemon_int_response);
+                    return;
+                }
+                dispatch_to_sdk_thread(method_call, [scanner, configPath]() {
+                    int result = scanner->loadConfiguration(configPath);
+                    return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(result)));
+                });
+            }
+        }
+    }
+    else if (strcmp(method_name, "startKioskMode") == 0) {
+        // Optional map: imageDirectory, imageTypes, archiveDirectory, workers.
+        KioskPipeline::Config config;
+        if (args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+            FlValue* value = fl_value_lookup_string(args, "imageDirectory");
+            if (value && fl_value_get_type(value) == FL_VALUE_TYPE_STRING) {
+                config.imageDirectory = fl_value_get_string(value);
+            }
+            value = fl_value_lookup_string(args, "imageTypes");
+            if (value && fl_value_get_type(value) == FL_VALUE_TYPE_INT) {
+                config.imageTypes = static_cast<int>(fl_value_get_int(value));
+            }
+            value = fl_value_lookup_string(args, "archiveDirectory");
+            if (value && fl_value_get_type(value) == FL_VALUE_TYPE_STRING) {
+                config.archiveDirectory = fl_value_get_string(value);
+            }
+            value = fl_value_lookup_string(args, "workers");
+            if (value && fl_value_get_type(value) == FL_VALUE_TYPE_INT && fl_value_get_int(value) > 0) {
+                config.workers = static_cast<size_t>(fl_value_get_int(value));
             }
         }
+        std::cout << "Linux side: Starting kiosk mode." << std::endl;
+        global_kiosk_pipeline->start(config);
+        global_detection_engine->start();
+        global_detection_engine->wake();
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(true)));
+    }
+    else if (strcmp(method_name, "stopKioskMode") == 0) {
+        std::cout << "Linux side: Stopping kiosk mode." << std::endl;
+        // Blocks only for scans already being post-processed.
+        global_kiosk_pipeline->stop();
+        if (!global_detection_listening) {
+            global_detection_engine->pause();
+        }
+        g_autoptr(FlValue) stats = kiosk_stats_value(global_kiosk_pipeline->getStats());
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(stats));
+    }
+    else if (strcmp(method_name, "getScannerReadiness") == 0) {
+        g_autoptr(FlValue) readiness = readiness_value(global_readiness);
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(readiness));
+    }
+    else if (strcmp(method_name, "getScanMetrics") == 0) {
+        // ScanMetrics is thread-safe; answered from the main loop so it never
+        // waits behind a running scan. {"reset": true} clears after reading.
+        FlValue* reset_value = (args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP)
+                               ? fl_value_lookup_string(args, "reset") : nullptr;
+        bool reset = reset_value && fl_value_get_type(reset_value) == FL_VALUE_TYPE_BOOL && fl_value_get_bool(reset_value);
+        if (global_daemon_client) {
+            // The daemon's histograms, summarized here; a reader pool sends
+            // every worker's added together.
+            DaemonWriter request;
+            request.boolean(reset);
+            dispatch_to_daemon(method_call, DaemonMessage::GetScanMetrics, request.bytes(), [](DaemonReader& reply) {
+                const uint8_t* data = nullptr;
+                size_t length = 0;
+                ScanMetrics metrics;
+                if (!reply.blob(data, length) || !metrics.merge(data, length)) {
+                    return FL_METHOD_RESPONSE(fl_method_error_response_new("DAEMON_ERROR", "Malformed scan metrics from sino_scannerd", nullptr));
+                }
+                return scan_metrics_response(metrics.summarize());
+            });
+            return;
+        }
+        ScanMetrics& metrics = scanner->getScanMetrics();
+        response = scan_metrics_response(reset ? metrics.summarizeAndReset() : metrics.summarize());
+    }
+    else if (strcmp(method_name, "startSdkTrace") == 0) {
+        // Optional map: path (default SdkTraceRecorder::defaultPath()),
+        // compress. Returns the trace path.
+        SdkTraceRecorder::Config config;
+        if (args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+            FlValue* value = fl_value_lookup_string(args, "path");
+            if (value && fl_value_get_type(value) == FL_VALUE_TYPE_STRING) {
+                config.path = fl_value_get_string(value);
+            }
+            value = fl_value_lookup_string(args, "compress");
+            if (value && fl_value_get_type(value) == FL_VALUE_TYPE_BOOL) {
+                config.compress = fl_value_get_bool(value);
+            }
+        }
+        SdkTraceRecorder& recorder = SdkTraceRecorder::getInstance();
+        std::string error;
+        if (recorder.start(config, error)) {
+            std::string path = recorder.getStats().path;
+            std::cout << "Linux side: Recording SDK calls to " << path << std::endl;
+            response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_string(path.c_str())));
+        } else {
+            response = FL_METHOD_RESPONSE(fl_method_error_response_new("TRACE_ERROR", error.c_str(), nullptr));
+        }
+    }
+    else if (strcmp(method_name, "stopSdkTrace") == 0) {
+        // Waits only for the writer thread to write out what is queued.
+        g_autoptr(FlValue) stats = sdk_trace_stats_value(SdkTraceRecorder::getInstance().stop());
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(stats));
     }
     else if (strcmp(method_name, "getLastError") == 0) {
+        // getLastError is thread-safe and answered straight from the main loop.
         std::cout << "Linux side: Getting last error." << std::endl;
-        std::string error = global_scanner_instance->getLastError();
+        if (global_daemon_client) {
+            dispatch_to_daemon(method_call, DaemonMessage::GetLastError, {}, [](DaemonReader& reply) {
+                std::string error;
+                reply.str(error);
+                return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_string(error.c_str())));
+            });
+            return;
+        }
+        std::string error = scanner->getLastError();
         response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_string(error.c_str())));
     }
     else {
@@ -202,9 +1147,11 @@ static void method_call_handler(FlMethodChannel* channel,
         response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
     }
 
-    // Return the response
+    // Respond to calls that were answered synchronously; everything else
+    // responds from deliver_pending_response().
     if (response) {
         fl_method_call_respond(method_call, response, nullptr);
+        g_object_unref(response);
     }
 }
 
@@ -240,6 +1187,76 @@ static void my_application_activate(GApplication* application) {
     g_autoptr(FlDartProject) project = fl_dart_project_new();
     fl_dart_project_set_dart_entrypoint_arguments(project, self->dart_entrypoint_arguments);
 
+    // Scanner-side logging goes through the async logger; the drain thread
+    // writes it to Logger::defaultPath() and echoes warnings to stderr.
+    Logger::getInstance().start();
+
+    // SINO_SCANNER_SDK_TRACE records every SDK call from here on, warm-up
+    // included, for replay through the mock SDK.
+    SdkTraceRecorder::getInstance().startFromEnvironment();
+
+    global_activate_time = std::chrono::steady_clock::now();
+    const char* daemon_socket = getenv("SINO_SCANNER_DAEMON");
+    if (daemon_socket && *daemon_socket && !global_daemon_client) {
+        // sino_scannerd owns the SDK, so none of the SDK-side state below
+        // is created in this process.
+        start_daemon_client(daemon_socket);
+    }
+    if (!global_daemon_client && !global_sdk_executor) {
+        global_sdk_executor = std::make_unique<ScannerExecutor>();
+        global_sdk_executor->start();
+    }
+    if (!global_daemon_client && !global_scanner_instance) {
+        // Created up front so the detection probe never races its creation;
+        // calls made before initializeScanner still fail with ERROR_INIT.
+        global_scanner_instance = std::make_unique<SinosecuScanner>();
+
+        // Warm the SDK up on its own thread while GTK and Flutter start, so
+        // neither the UI's initializeScanner nor the first scan pays for
+        // InitIDCard. Queued first, ahead of any Dart call.
+        WarmupSettings warmup = WarmupSettings::load();
+        if (warmup.isComplete()) {
+            SinosecuScanner* scanner = global_scanner_instance.get();
+            global_readiness.state = "warming";
+            global_readiness.source = "warmup";
+            global_sdk_executor->post([scanner, warmup]() {
+                int result = scanner->initializeScanner(warmup.userId, warmup.nType, warmup.sdkDirectory,
+                                                        warmup.configPath);
+                report_initialization(scanner, "warmup", result);
+            });
+        } else {
+            std::cout << "Linux side: No warm-up settings; the SDK initializes on the first initializeScanner call." << std::endl;
+        }
+    }
+    if (!global_daemon_client && !global_detection_engine) {
+        // Idle until the Dart side listens on the detection channel.
+        global_detection_engine = std::make_unique<DetectionEngine>(detection_probe);
+        global_detection_engine->addListener([](const DetectionEngine::Event& event) {
+            if (global_detection_listening) {
+                g_idle_add(deliver_detection_event, new PendingDetectionEvent{event});
+            }
+            global_kiosk_pipeline->onDetection(event);
+        });
+    }
+    if (!global_daemon_client && !global_image_ring) {
+        global_image_ring = std::make_unique<ImageRing>();
+    }
+    if (!global_daemon_client && !global_kiosk_pipeline) {
+        SinosecuScanner* scanner = global_scanner_instance.get();
+        global_kiosk_pipeline = std::make_unique<KioskPipeline>(
+                *global_sdk_executor, *scanner, [scanner](const KioskScan& scan) { kiosk_sink(scanner, scan); });
+    }
+    if (!global_daemon_client && !global_usb_monitor) {
+        global_usb_monitor = std::make_unique<UsbHotplugMonitor>();
+        SinosecuScanner* scanner = global_scanner_instance.get();
+        global_usb_monitor->start([scanner](UsbHotplugMonitor::Event event, int vendorId, int productId) {
+            std::cout << "Linux side: USB device " << (event == UsbHotplugMonitor::Event::Arrived ? "arrived" : "left")
+                      << " (" << std::hex << vendorId << ":" << productId << std::dec << ")" << std::endl;
+            scanner->wakeDetection();
+            global_detection_engine->wake();
+        });
+    }
+
     FlView* view = fl_view_new(project);
     gtk_widget_show(GTK_WIDGET(view));
     gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(view));
@@ -247,6 +1264,15 @@ static void my_application_activate(GApplication* application) {
     // Register Flutter plugins
     fl_register_plugins(FL_PLUGIN_REGISTRY(view));
 
+    // Scan images are shown through textures registered as a plugin of our own.
+    g_autoptr(FlPluginRegistrar) texture_plugin =
+            fl_plugin_registry_get_registrar_for_plugin(FL_PLUGIN_REGISTRY(view), "SinoScannerImageTextures");
+    global_image_textures = std::make_unique<ImageTextures>(fl_plugin_registrar_get_texture_registrar(texture_plugin));
+    if (!global_decode_executor) {
+        global_decode_executor = std::make_unique<ScannerExecutor>();
+        global_decode_executor->start();
+    }
+
     // Register custom platform channel
     FlEngine* engine = fl_view_get_engine(view);
     if (engine == nullptr) {
@@ -285,6 +1311,36 @@ static void my_application_activate(GApplication* application) {
 
     std::cout << "Linux side: SinoScanner platform channel registered successfully." << std::endl;
 
+    global_detection_channel = fl_event_channel_new(
+            messenger,
+            "com.example.sino_scanner/detection",
+            FL_METHOD_CODEC(codec)
+    );
+    fl_event_channel_set_stream_handlers(global_detection_channel,
+                                         detection_listen_cb,
+                                         detection_cancel_cb,
+                                         nullptr,
+                                         nullptr);
+
+    global_readiness_channel = fl_event_channel_new(
+            messenger,
+            "com.example.sino_scanner/readiness",
+            FL_METHOD_CODEC(codec)
+    );
+    fl_event_channel_set_stream_handlers(global_readiness_channel,
+                                         readiness_listen_cb,
+                                         nullptr,
+                                         nullptr,
+                                         nullptr);
+
+    // Kiosk scans are pushed whether or not anyone listens; events sent with
+    // no listener are dropped by the engine.
+    global_kiosk_channel = fl_event_channel_new(
+            messenger,
+            "com.example.sino_scanner/kiosk",
+            FL_METHOD_CODEC(codec)
+    );
+
     gtk_widget_grab_focus(GTK_WIDGET(view));
 }
 
@@ -313,11 +1369,55 @@ static void my_application_startup(GApplication* application) {
 
 // Implements GApplication::shutdown.
 static void my_application_shutdown(GApplication* application) {
+    if (global_daemon_client) {
+        // The daemon keeps the SDK initialized for the next client.
+        global_daemon_client->disconnect();
+        global_daemon_client.reset();
+    }
+    if (global_usb_monitor) {
+        global_usb_monitor->stop();
+        global_usb_monitor.reset();
+    }
+    if (global_scanner_instance) {
+        global_scanner_instance->cancelPendingWait();
+    }
+    if (global_kiosk_pipeline) {
+        global_kiosk_pipeline->stop();
+    }
+    if (global_detection_engine) {
+        // Must stop before the SDK thread: its probe waits on that thread.
+        global_detection_engine->stop();
+        global_detection_engine.reset();
+    }
+    g_clear_object(&global_detection_channel);
+    g_clear_object(&global_kiosk_channel);
+    g_clear_object(&global_readiness_channel);
+
     if (global_scanner_instance) {
         std::cout << "Linux side: Releasing scanner on application shutdown." << std::endl;
-        global_scanner_instance->releaseScanner();
-        global_scanner_instance.reset();
+        SinosecuScanner* scanner = global_scanner_instance.get();
+        if (!global_sdk_executor || !global_sdk_executor->post([scanner]() { scanner->releaseScanner(); })) {
+            scanner->releaseScanner();
+        }
+    }
+    if (global_sdk_executor) {
+        // Drains the release task queued above before joining.
+        global_sdk_executor->stop();
+        global_sdk_executor.reset();
+    }
+    // Reset after the SDK thread: a recognition queued before stop() still
+    // runs on it (and returns at once).
+    global_kiosk_pipeline.reset();
+    global_scanner_instance.reset();
+    if (global_decode_executor) {
+        // After the SDK thread and the daemon client, the two that post here.
+        global_decode_executor->stop();
+        global_decode_executor.reset();
     }
+    global_image_ring.reset();
+    global_image_textures.reset();
+    SdkTraceRecorder::getInstance().stop();
+    Logger::getInstance().stop();
     G_APPLICATION_CLASS(my_application_parent_class)->shutdown(application);
 }
 
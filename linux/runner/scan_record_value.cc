@@ -0,0 +1,61 @@
+#include "runner/scan_record_value.h"
+
+#include <string>
+
+static void set_snapshot_strings(FlValue* map, const FieldSnapshot& fields, const char* prefix) {
+    std::string key(prefix);
+    const size_t prefix_length = key.size();
+    fields.forEach([&](const PassportFieldDescriptor& field, std::string_view value) {
+        key.resize(prefix_length);
+        key.append(field.name);
+        fl_value_set_string_take(map, key.c_str(), fl_value_new_string_sized(value.data(), value.size()));
+    });
+}
+
+static FlValue* snapshot_confidence_map(const FieldSnapshot& fields) {
+    FlValue* map = fl_value_new_map();
+    for (size_t i = 0; i < kPassportFieldCount; i++) {
+        if (fields.has(i)) {
+            fl_value_set_string_take(map, kPassportFields[i].name, fl_value_new_int(fields.confidence(i)));
+        }
+    }
+    return map;
+}
+
+FlValue* scan_record_value(const ScanRecord& record) {
+    FlValue* map = fl_value_new_map();
+
+    if (record.status == ScanStatus::None || record.status == ScanStatus::NotReady ||
+        record.status == ScanStatus::DetectionFailed) {
+        fl_value_set_string_take(map, "error", fl_value_new_string(record.error.c_str()));
+        return map;
+    }
+
+    fl_value_set_string_take(map, "status", fl_value_new_string(ScanRecord::statusName(record.status)));
+    fl_value_set_string_take(map, "main_type", fl_value_new_string(record.mainTypeText().c_str()));
+    fl_value_set_string_take(map, "card_type", fl_value_new_string(std::to_string(record.cardType).c_str()));
+
+    if (record.status == ScanStatus::Error) {
+        fl_value_set_string_take(map, "error", fl_value_new_string(record.error.c_str()));
+    } else {
+        fl_value_set_string_take(map, "document_type", fl_value_new_string(record.documentName.c_str()));
+        if (!record.warning.empty()) {
+            fl_value_set_string_take(map, "warning", fl_value_new_string(record.warning.c_str()));
+        }
+        set_snapshot_strings(map, record.ocr, "ocr_");
+        set_snapshot_strings(map, record.chip, "chip_");
+
+        FlValue* confidence = fl_value_new_map();
+        fl_value_set_string_take(confidence, "ocr", snapshot_confidence_map(record.ocr));
+        fl_value_set_string_take(confidence, "chip", snapshot_confidence_map(record.chip));
+        fl_value_set_string_take(map, "confidence", confidence);
+    }
+
+    FlValue* timings = fl_value_new_map();
+    for (size_t i = 0; i < record.stageMicros.size(); i++) {
+        fl_value_set_string_take(timings, ScanRecord::stageName(static_cast<ScanStage>(i)),
+                                 fl_value_new_int(record.stageMicros[i]));
+    }
+    fl_value_set_string_take(map, "timings_us", timings);
+    return map;
+}
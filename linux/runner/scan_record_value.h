@@ -0,0 +1,13 @@
+#ifndef FLUTTER_SCAN_RECORD_VALUE_H_
+#define FLUTTER_SCAN_RECORD_VALUE_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+#include "src/scan_record.h"
+
+// The scan result Dart receives: the same keys as ScanRecord::toMap(), built
+// straight from the record, plus "confidence" ({"ocr": {...}, "chip": {...}})
+// and "timings_us" maps. Returns a new reference.
+FlValue* scan_record_value(const ScanRecord& record);
+
+#endif
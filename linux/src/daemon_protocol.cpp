@@ -0,0 +1,195 @@
+#include "daemon_protocol.h"
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+template<typename T>
+void appendRaw(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+}
+
+namespace daemon_protocol {
+
+std::string defaultSocketPath() {
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        return std::string(runtime) + "/sino_scanner/scanner.sock";
+    }
+    return "/tmp/sino_scanner-" + std::to_string(getuid()) + "/scanner.sock";
+}
+
+const char* messageName(DaemonMessage message) {
+    switch (message) {
+        case DaemonMessage::Hello: return "Hello";
+        case DaemonMessage::Initialize: return "Initialize";
+        case DaemonMessage::Release: return "Release";
+        case DaemonMessage::DetectDocument: return "DetectDocument";
+        case DaemonMessage::WaitForDocument: return "WaitForDocument";
+        case DaemonMessage::AutoProcess: return "AutoProcess";
+        case DaemonMessage::ScanDocument: return "ScanDocument";
+        case DaemonMessage::GetDocumentFields: return "GetDocumentFields";
+        case DaemonMessage::GetDocumentName: return "GetDocumentName";
+        case DaemonMessage::SaveImages: return "SaveImages";
+        case DaemonMessage::LoadConfiguration: return "LoadConfiguration";
+        case DaemonMessage::CheckDeviceStatus: return "CheckDeviceStatus";
+        case DaemonMessage::GetLastError: return "GetLastError";
+        case DaemonMessage::CancelWait: return "CancelWait";
+        case DaemonMessage::GetReadiness: return "GetReadiness";
+        case DaemonMessage::Subscribe: return "Subscribe";
+        case DaemonMessage::Unsubscribe: return "Unsubscribe";
+        case DaemonMessage::PublishImages: return "PublishImages";
+        case DaemonMessage::ReleaseImages: return "ReleaseImages";
+        case DaemonMessage::GetScanMetrics: return "GetScanMetrics";
+        case DaemonMessage::ListReaders: return "ListReaders";
+        case DaemonMessage::Heartbeat: return "Heartbeat";
+        case DaemonMessage::DetectionEvent: return "DetectionEvent";
+        case DaemonMessage::ScanEvent: return "ScanEvent";
+        case DaemonMessage::ReadinessEvent: return "ReadinessEvent";
+        case DaemonMessage::ImagesEvent: return "ImagesEvent";
+        case DaemonMessage::ReaderScanEvent: return "ReaderScanEvent";
+        default: return "Unknown";
+    }
+}
+
+}
+
+void DaemonFrame::encode(std::vector<uint8_t>& out) const {
+    appendRaw(out, static_cast<uint32_t>(payload.size()));
+    appendRaw(out, static_cast<uint16_t>(message));
+    appendRaw(out, flags);
+    appendRaw(out, requestId);
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+DaemonWriter& DaemonWriter::u32(uint32_t value) {
+    appendRaw(buffer, value);
+    return *this;
+}
+
+DaemonWriter& DaemonWriter::i32(int32_t value) {
+    appendRaw(buffer, value);
+    return *this;
+}
+
+DaemonWriter& DaemonWriter::u64(uint64_t value) {
+    appendRaw(buffer, value);
+    return *this;
+}
+
+DaemonWriter& DaemonWriter::i64(int64_t value) {
+    appendRaw(buffer, value);
+    return *this;
+}
+
+DaemonWriter& DaemonWriter::boolean(bool value) {
+    appendRaw(buffer, static_cast<uint8_t>(value ? 1 : 0));
+    return *this;
+}
+
+DaemonWriter& DaemonWriter::str(std::string_view value) {
+    appendRaw(buffer, static_cast<uint32_t>(value.size()));
+    buffer.insert(buffer.end(), value.begin(), value.end());
+    return *this;
+}
+
+DaemonWriter& DaemonWriter::blob(const std::vector<uint8_t>& value) {
+    appendRaw(buffer, static_cast<uint32_t>(value.size()));
+    buffer.insert(buffer.end(), value.begin(), value.end());
+    return *this;
+}
+
+template<typename T>
+bool DaemonReader::raw(T& value) {
+    if (failed || static_cast<size_t>(end - cursor) < sizeof(T)) {
+        failed = true;
+        return false;
+    }
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+bool DaemonReader::u32(uint32_t& value) { return raw(value); }
+bool DaemonReader::i32(int32_t& value) { return raw(value); }
+bool DaemonReader::u64(uint64_t& value) { return raw(value); }
+bool DaemonReader::i64(int64_t& value) { return raw(value); }
+
+bool DaemonReader::boolean(bool& value) {
+    uint8_t byte;
+    if (!raw(byte)) {
+        return false;
+    }
+    value = byte != 0;
+    return true;
+}
+
+bool DaemonReader::blob(const uint8_t*& data, size_t& length) {
+    uint32_t size;
+    if (!raw(size)) {
+        return false;
+    }
+    if (static_cast<size_t>(end - cursor) < size) {
+        failed = true;
+        return false;
+    }
+    data = cursor;
+    length = size;
+    cursor += size;
+    return true;
+}
+
+bool DaemonReader::str(std::string& value) {
+    const uint8_t* data;
+    size_t length;
+    if (!blob(data, length)) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(data), length);
+    return true;
+}
+
+void FrameDecoder::feed(const uint8_t* data, size_t length) {
+    if (consumed > 0 && consumed == buffer.size()) {
+        buffer.clear();
+        consumed = 0;
+    }
+    buffer.insert(buffer.end(), data, data + length);
+}
+
+bool FrameDecoder::next(DaemonFrame& frame) {
+    if (poisoned || buffer.size() - consumed < daemon_protocol::kHeaderBytes) {
+        return false;
+    }
+    const uint8_t* header = buffer.data() + consumed;
+    uint32_t payloadLength;
+    uint16_t message;
+    std::memcpy(&payloadLength, header, 4);
+    std::memcpy(&message, header + 4, 2);
+    std::memcpy(&frame.flags, header + 6, 2);
+    std::memcpy(&frame.requestId, header + 8, 4);
+    if (payloadLength > daemon_protocol::kMaxPayloadBytes) {
+        poisoned = true;
+        return false;
+    }
+    if (buffer.size() - consumed < daemon_protocol::kHeaderBytes + payloadLength) {
+        return false;
+    }
+
+    frame.message = static_cast<DaemonMessage>(message);
+    const uint8_t* payload = header + daemon_protocol::kHeaderBytes;
+    frame.payload.assign(payload, payload + payloadLength);
+    consumed += daemon_protocol::kHeaderBytes + payloadLength;
+
+    // Compact once most of the buffer has been handed out.
+    if (consumed > 64 * 1024 && consumed * 2 > buffer.size()) {
+        buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(consumed));
+        consumed = 0;
+    }
+    return true;
+}
@@ -0,0 +1,185 @@
+#ifndef SINO_SCANNER_DAEMON_PROTOCOL_H
+#define SINO_SCANNER_DAEMON_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Daemon Protocol
+ *
+ * Wire format between sino_scannerd and its clients over a Unix stream
+ * socket. Every message is one frame, little-endian:
+ *
+ *   u32 payloadLength | u16 message | u16 flags | u32 requestId | payload
+ *
+ * A client numbers its requests and may send any number before the first
+ * reply comes back; each reply carries the request's ID and message with
+ * kFlagReply set, plus kFlagError when the payload is an error instead of
+ * the result. Replies to SDK calls come back in the order the calls ran,
+ * but cheap requests (status, errors, subscriptions) are answered at once,
+ * ahead of SDK work queued earlier, so clients match replies by ID.
+ * Events have kFlagEvent set and request ID 0, and are only sent to
+ * clients subscribed to them.
+ *
+ * Payloads are flat sequences written with DaemonWriter and read back in
+ * the same order with DaemonReader: i32/i64/u32 values, bools as one byte,
+ * and strings/blobs as a u32 length and the bytes. Scan results are the
+ * ScanRecord::toBinary encoding as one blob. The request and reply layout of
+ * each message is listed next to it below.
+ *
+ * A frame with kFlagFd carries one file descriptor as SCM_RIGHTS ancillary
+ * data on its first byte: the sealed memfd of an ImageRing segment, which
+ * describes its own planes (see ImageSegmentView). The receiver owns it.
+ */
+enum class DaemonMessage : uint16_t {
+    Hello = 1,            // u32 version, str clientName[, u32 reader] -> u32 version, i32 pid, u32 clients
+                          // (reader: ReaderPool only, binds the connection to that worker)
+    Initialize,           // str userId, i32 nType, str sdkDirectory, str configPath -> i32 result
+    Release,              // -> bool released (false while other clients are connected)
+    DetectDocument,       // -> i32 result
+    WaitForDocument,      // i32 timeoutSeconds -> i32 result
+    AutoProcess,          // -> u32 count, then (str key, i32 value) pairs
+    ScanDocument,         // i32 timeoutSeconds -> blob ScanRecord
+    GetDocumentFields,    // i32 attribute -> u32 count, then (u32 position, str value) pairs
+    GetDocumentName,      // -> str name
+    SaveImages,           // str basePath, i32 imageTypes -> bool saved
+    LoadConfiguration,    // str configPath -> i32 result
+    CheckDeviceStatus,    // -> i32 status (the cached one while the SDK is busy)
+    GetLastError,         // -> str error
+    CancelWait,           // -> nothing; aborts this client's detection waits, running or queued
+    GetReadiness,         // -> readiness (see ReadinessEvent)
+    Subscribe,            // u32 eventMask -> u32 eventMask now in effect
+    Unsubscribe,          // u32 eventMask -> u32 eventMask now in effect
+    PublishImages,        // i32 imageTypes -> u64 sequence, segment fd; the client holds a
+                          // reference until ReleaseImages or disconnect
+    ReleaseImages,        // u64 sequence -> nothing
+    GetScanMetrics,       // bool reset -> blob ScanMetrics::toBinary
+    ListReaders,          // ReaderPool only -> u32 count, then per reader: u32 index, str device,
+                          // i32 cpu, i32 pid, str socketPath, bool online, u32 restarts,
+                          // i64 lastRecoveryMicros, bool standbyReady
+    Heartbeat,            // -> u32 message the SDK thread is running (0: idle), i64 runningMicros,
+                          // i64 allowanceMicros (the detection wait the call asked for)
+
+    // Events (kFlagEvent)
+    DetectionEvent = 0x100,   // str state, i32 code, i64 timestampMs
+    ScanEvent,                // u64 clientId, blob ScanRecord; every completed ScanDocument
+    ReadinessEvent,           // str state, i32 result, i64 timeToReadyMicros,
+                              // i64 verify, sdkInit, configFile, documentTypes, total (phase micros)
+    ImagesEvent,              // u64 clientId, u64 sequence, segment fd; every PublishImages,
+                              // each subscriber holding its own reference
+    ReaderScanEvent,          // u32 reader, u64 clientId, blob ScanRecord; ReaderPool's ScanEvent
+                              // from every worker, to connections not bound to one
+};
+
+namespace daemon_protocol {
+
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderBytes = 12;
+constexpr size_t kMaxPayloadBytes = 8 * 1024 * 1024;
+
+constexpr uint16_t kFlagReply = 0x1;
+constexpr uint16_t kFlagError = 0x2;   // Payload: str code, str message
+constexpr uint16_t kFlagEvent = 0x4;
+constexpr uint16_t kFlagFd = 0x8;      // One descriptor rides along (SCM_RIGHTS)
+
+// Subscribe/Unsubscribe event mask bits.
+constexpr uint32_t kEventDetection = 0x1;
+constexpr uint32_t kEventScan = 0x2;
+constexpr uint32_t kEventReadiness = 0x4;
+constexpr uint32_t kEventImages = 0x8;
+
+// $XDG_RUNTIME_DIR/sino_scanner/scanner.sock, or /tmp/sino_scanner-<uid>/
+// scanner.sock without a runtime directory.
+std::string defaultSocketPath();
+
+const char* messageName(DaemonMessage message);
+
+}
+
+struct DaemonFrame {
+    DaemonMessage message = DaemonMessage::Hello;
+    uint16_t flags = 0;
+    uint32_t requestId = 0;
+    std::vector<uint8_t> payload;
+    int fd = -1;          // With kFlagFd: sent with the frame, or received and owned by the handler
+
+    bool isReply() const { return flags & daemon_protocol::kFlagReply; }
+    bool isError() const { return flags & daemon_protocol::kFlagError; }
+    bool isEvent() const { return flags & daemon_protocol::kFlagEvent; }
+
+    // Appends the header and payload to |out|.
+    void encode(std::vector<uint8_t>& out) const;
+};
+
+/**
+ * Daemon Writer / Reader
+ *
+ * Payload encoding. Reader methods return false once the payload runs out
+ * and keep returning false afterwards, so a request can be parsed with one
+ * chain of reads and a single check.
+ */
+class DaemonWriter {
+public:
+    DaemonWriter& u32(uint32_t value);
+    DaemonWriter& i32(int32_t value);
+    DaemonWriter& u64(uint64_t value);
+    DaemonWriter& i64(int64_t value);
+    DaemonWriter& boolean(bool value);
+    DaemonWriter& str(std::string_view value);
+    DaemonWriter& blob(const std::vector<uint8_t>& value);
+
+    std::vector<uint8_t>& bytes() { return buffer; }
+    std::vector<uint8_t> take() { return std::move(buffer); }
+
+private:
+    std::vector<uint8_t> buffer;
+};
+
+class DaemonReader {
+public:
+    DaemonReader(const uint8_t* data, size_t length) : cursor(data), end(data + length), failed(false) {}
+    explicit DaemonReader(const std::vector<uint8_t>& payload) : DaemonReader(payload.data(), payload.size()) {}
+
+    bool u32(uint32_t& value);
+    bool i32(int32_t& value);
+    bool u64(uint64_t& value);
+    bool i64(int64_t& value);
+    bool boolean(bool& value);
+    bool str(std::string& value);
+    // Points into the payload; valid while the payload is.
+    bool blob(const uint8_t*& data, size_t& length);
+
+    bool ok() const { return !failed; }
+
+private:
+    template<typename T>
+    bool raw(T& value);
+
+    const uint8_t* cursor;
+    const uint8_t* end;
+    bool failed;
+};
+
+/**
+ * Frame Decoder
+ *
+ * Reassembles frames from a byte stream. Feed it whatever read() returned
+ * and pop complete frames until next() returns false. A frame larger than
+ * kMaxPayloadBytes poisons the stream; the connection should be dropped.
+ */
+class FrameDecoder {
+public:
+    void feed(const uint8_t* data, size_t length);
+    bool next(DaemonFrame& frame);
+    bool corrupt() const { return poisoned; }
+
+private:
+    std::vector<uint8_t> buffer;
+    size_t consumed = 0;
+    bool poisoned = false;
+};
+
+#endif //SINO_SCANNER_DAEMON_PROTOCOL_H
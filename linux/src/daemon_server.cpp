@@ -0,0 +1,509 @@
+#include "daemon_server.h"
+#include "logger.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t kReadChunkBytes = 64 * 1024;
+constexpr size_t kMaxOutboxBytes = 32 * 1024 * 1024;   // A client this far behind is dropped
+
+bool fillAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// send(), or sendmsg() with |descriptor| attached to the first byte.
+ssize_t writeSocket(int socket, const uint8_t* data, size_t length, int descriptor) {
+    if (descriptor < 0) {
+        return ::send(socket, data, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    iovec buffer{const_cast<uint8_t*>(data), length};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    std::memset(control, 0, sizeof(control));
+    msghdr message{};
+    message.msg_iov = &buffer;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(header), &descriptor, sizeof(int));
+    return sendmsg(socket, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+}
+
+DaemonServer::DaemonServer()
+        : listenFd(-1),
+          wakeFds{-1, -1},
+          running(false),
+          nextClientId(1) {}
+
+DaemonServer::~DaemonServer() {
+    stopServer();
+}
+
+bool DaemonServer::startServer(const Config& config, std::string& error) {
+    if (running) {
+        return true;
+    }
+    serverConfig = config;
+    if (serverConfig.socketPath.empty()) {
+        serverConfig.socketPath = daemon_protocol::defaultSocketPath();
+    }
+    if (!bindSocket(error)) {
+        return false;
+    }
+    if (pipe2(wakeFds, O_NONBLOCK | O_CLOEXEC) != 0) {
+        error = std::string("pipe2 failed: ") + strerror(errno);
+        close(listenFd);
+        listenFd = -1;
+        unlink(serverConfig.socketPath.c_str());
+        return false;
+    }
+    running = true;
+    ioThread = std::thread(&DaemonServer::run, this);
+    return true;
+}
+
+bool DaemonServer::bindSocket(std::string& error) {
+    sockaddr_un address;
+    if (!fillAddress(serverConfig.socketPath, address)) {
+        error = "socket path too long: " + serverConfig.socketPath;
+        return false;
+    }
+    std::error_code ignored;
+    std::filesystem::create_directories(std::filesystem::path(serverConfig.socketPath).parent_path(), ignored);
+
+    // A socket file left by a daemon that died is removed; a live daemon
+    // answering on it is not.
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0) {
+        bool live = connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        close(probe);
+        if (live) {
+            error = "another sino_scannerd is serving " + serverConfig.socketPath;
+            return false;
+        }
+    }
+    unlink(serverConfig.socketPath.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listenFd < 0) {
+        error = std::string("socket failed: ") + strerror(errno);
+        return false;
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        chmod(serverConfig.socketPath.c_str(), serverConfig.socketMode) != 0 ||
+        listen(listenFd, 16) != 0) {
+        error = "cannot listen on " + serverConfig.socketPath + ": " + strerror(errno);
+        close(listenFd);
+        listenFd = -1;
+        unlink(serverConfig.socketPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void DaemonServer::stopServer() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    wakeIoThread();
+    if (ioThread.joinable()) {
+        ioThread.join();
+    }
+
+    std::map<uint64_t, ClientPtr> remaining;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        remaining.swap(clients);
+    }
+    for (auto& [id, client] : remaining) {
+        {
+            std::lock_guard<std::mutex> lock(client->outMutex);
+            closeSocket(*client);
+        }
+        onDisconnect(client);
+    }
+    close(listenFd);
+    listenFd = -1;
+    unlink(serverConfig.socketPath.c_str());
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    wakeFds[0] = wakeFds[1] = -1;
+}
+
+size_t DaemonServer::clientCount() const {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    return clients.size();
+}
+
+void DaemonServer::wakeIoThread() {
+    uint8_t byte = 1;
+    // A full pipe already guarantees a wake-up.
+    ssize_t ignored = write(wakeFds[1], &byte, 1);
+    (void)ignored;
+}
+
+void DaemonServer::closeSocket(Client& client) {
+    client.closed = true;
+    close(client.fd);
+    for (auto& [offset, descriptor] : client.outboxFds) {
+        close(descriptor);
+    }
+    client.outboxFds.clear();
+}
+
+// ================================
+// I/O THREAD
+// ================================
+
+void DaemonServer::run() {
+    std::vector<pollfd> fds;
+    std::vector<ClientPtr> polled;
+
+    while (running) {
+        fds.clear();
+        polled.clear();
+        fds.push_back({wakeFds[0], POLLIN, 0});
+        fds.push_back({listenFd, POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            for (auto& [id, client] : clients) {
+                short events = POLLIN;
+                {
+                    std::lock_guard<std::mutex> outLock(client->outMutex);
+                    if (client->outboxSent < client->outbox.size()) {
+                        events |= POLLOUT;
+                    }
+                }
+                fds.push_back({client->fd, events, 0});
+                polled.push_back(client);
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            SINO_LOG_ERROR("DaemonServer: poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint8_t drain[64];
+            while (read(wakeFds[0], drain, sizeof(drain)) > 0) {}
+        }
+        if (fds[1].revents & POLLIN) {
+            acceptClients();
+        }
+
+        for (size_t i = 0; i < polled.size(); i++) {
+            const ClientPtr& client = polled[i];
+            short revents = fds[i + 2].revents;
+            bool alive = true;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                alive = readClient(client);
+            }
+            if (alive && (revents & POLLOUT)) {
+                alive = flushClient(*client);
+            }
+            if (alive) {
+                alive = !isClosed(*client);
+            }
+            if (!alive) {
+                disconnect(client);
+            }
+        }
+    }
+}
+
+void DaemonServer::acceptClients() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                SINO_LOG_WARN("DaemonServer: accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        ucred credentials{};
+        socklen_t length = sizeof(credentials);
+        getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length);
+
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        if (clients.size() >= serverConfig.maxClients) {
+            SINO_LOG_WARN("DaemonServer: Refusing pid %d, already serving %zu clients",
+                          static_cast<int>(credentials.pid), clients.size());
+            close(fd);
+            continue;
+        }
+        auto client = std::make_shared<Client>();
+        client->id = nextClientId++;
+        client->fd = fd;
+        client->pid = credentials.pid;
+        clients[client->id] = client;
+        SINO_LOG_INFO("DaemonServer: Client %llu connected (pid %d, uid %d)",
+                      static_cast<unsigned long long>(client->id), static_cast<int>(credentials.pid),
+                      static_cast<int>(credentials.uid));
+    }
+}
+
+bool DaemonServer::readClient(const ClientPtr& client) {
+    uint8_t chunk[kReadChunkBytes];
+    while (true) {
+        ssize_t received = recv(client->fd, chunk, sizeof(chunk), 0);
+        if (received > 0) {
+            client->decoder.feed(chunk, static_cast<size_t>(received));
+            if (static_cast<size_t>(received) < sizeof(chunk)) break;
+            continue;
+        }
+        if (received == 0) {
+            return false;   // Orderly shutdown
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        return false;
+    }
+
+    DaemonFrame frame;
+    while (client->decoder.next(frame)) {
+        dispatch(client, frame);
+    }
+    if (client->decoder.corrupt()) {
+        SINO_LOG_WARN("DaemonServer: Client %llu sent an oversized frame, disconnecting",
+                      static_cast<unsigned long long>(client->id));
+        return false;
+    }
+    return true;
+}
+
+bool DaemonServer::flushClient(Client& client) {
+    std::lock_guard<std::mutex> lock(client.outMutex);
+    writeOutbox(client);
+    return !client.closed;
+}
+
+void DaemonServer::writeOutbox(Client& client) {
+    while (!client.closed && client.outboxSent < client.outbox.size()) {
+        // A descriptor goes out with the first byte of its frame, so writes
+        // stop short of the next one.
+        size_t end = client.outbox.size();
+        int descriptor = -1;
+        bool carries = false;   // The front entry goes out with this write
+        if (!client.outboxFds.empty()) {
+            if (client.outboxFds.front().first == client.outboxSent) {
+                carries = true;
+                descriptor = client.outboxFds.front().second;
+                if (client.outboxFds.size() > 1) end = client.outboxFds[1].first;
+            } else {
+                end = client.outboxFds.front().first;
+            }
+        }
+        ssize_t sent = writeSocket(client.fd, client.outbox.data() + client.outboxSent,
+                                   end - client.outboxSent, descriptor);
+        if (sent > 0) {
+            if (carries) {
+                if (descriptor >= 0) close(descriptor);
+                client.outboxFds.pop_front();
+            }
+            client.outboxSent += static_cast<size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        client.closed = true;   // The I/O thread disconnects it
+    }
+    if (client.outboxSent == client.outbox.size()) {
+        client.outbox.clear();
+        client.outboxSent = 0;
+    }
+}
+
+void DaemonServer::disconnect(const ClientPtr& client) {
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        if (clients.erase(client->id) == 0) {
+            return;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(client->outMutex);
+        closeSocket(*client);
+    }
+    onDisconnect(client);
+    SINO_LOG_INFO("DaemonServer: Client %llu disconnected", static_cast<unsigned long long>(client->id));
+}
+
+void DaemonServer::dispatch(const ClientPtr& client, DaemonFrame& frame) {
+    if (frame.isReply() || frame.isEvent()) {
+        replyError(*client, frame, "BAD_REQUEST", "Clients may only send requests");
+        return;
+    }
+    DaemonReader args(frame.payload);
+
+    if (frame.message == DaemonMessage::Hello) {
+        uint32_t version = 0;
+        if (!args.u32(version) || !args.str(client->name)) {
+            replyError(*client, frame, "BAD_REQUEST", "malformed Hello request");
+            return;
+        }
+        if (version != daemon_protocol::kVersion) {
+            replyError(*client, frame, "VERSION_MISMATCH",
+                       "daemon speaks protocol " + std::to_string(daemon_protocol::kVersion));
+            return;
+        }
+        std::string refusal;
+        if (!onHello(client, args, refusal)) {
+            replyError(*client, frame, "HELLO_REFUSED", refusal);
+            return;
+        }
+        SINO_LOG_INFO("DaemonServer: Client %llu is %s", static_cast<unsigned long long>(client->id),
+                      client->name.c_str());
+        DaemonWriter payload;
+        payload.u32(daemon_protocol::kVersion).i32(getpid()).u32(static_cast<uint32_t>(clientCount()));
+        reply(*client, frame, payload.bytes());
+        return;
+    }
+
+    if (frame.message == DaemonMessage::Subscribe || frame.message == DaemonMessage::Unsubscribe) {
+        uint32_t mask = 0;
+        if (!args.u32(mask)) {
+            replyError(*client, frame, "BAD_REQUEST",
+                       std::string("malformed ") + daemon_protocol::messageName(frame.message) + " request");
+            return;
+        }
+        uint32_t previous = frame.message == DaemonMessage::Subscribe
+                ? client->subscriptions.fetch_or(mask)
+                : client->subscriptions.fetch_and(~mask);
+        uint32_t current = client->subscriptions.load();
+        DaemonWriter payload;
+        payload.u32(current);
+        reply(*client, frame, payload.bytes());
+        if (current != previous) {
+            onSubscriptionsChanged(client, previous, current);
+        }
+        return;
+    }
+
+    handleFrame(client, frame);
+}
+
+// ================================
+// REPLIES AND EVENTS
+// ================================
+
+void DaemonServer::send(Client& client, DaemonMessage message, uint16_t flags, uint32_t requestId,
+                        const std::vector<uint8_t>& payload, int descriptor) {
+    // Our own copy: the caller's may be closed before this is sent.
+    int copy = -1;
+    const std::vector<uint8_t>* body = &payload;
+    std::vector<uint8_t> errorPayload;
+    if (descriptor >= 0 && (copy = fcntl(descriptor, F_DUPFD_CLOEXEC, 0)) < 0) {
+        std::string reason = std::string("cannot pass a descriptor: ") + strerror(errno);
+        SINO_LOG_WARN("DaemonServer: %s %s to client %llu: %s",
+                      (flags & daemon_protocol::kFlagReply) ? "Failing" : "Dropping",
+                      daemon_protocol::messageName(message), static_cast<unsigned long long>(client.id),
+                      reason.c_str());
+        if (!(flags & daemon_protocol::kFlagReply)) {
+            return;   // An event without its descriptor means nothing
+        }
+        DaemonWriter error;
+        error.str("DESCRIPTOR_FAILED").str(reason);
+        errorPayload = error.take();
+        body = &errorPayload;
+        flags = (flags & ~daemon_protocol::kFlagFd) | daemon_protocol::kFlagError;
+    }
+
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(client.outMutex);
+        if (client.closed) {
+            if (copy >= 0) close(copy);
+            return;
+        }
+        bool idle = client.outboxSent == client.outbox.size();
+        size_t start = client.outbox.size();
+        DaemonFrame frame;
+        frame.message = message;
+        frame.flags = flags;
+        frame.requestId = requestId;
+        frame.payload = *body;
+        frame.encode(client.outbox);
+        if (copy >= 0) {
+            client.outboxFds.emplace_back(start, copy);
+        }
+
+        // Write straight away when nothing is queued ahead of this frame;
+        // whatever does not fit is left for the I/O thread.
+        if (idle) {
+            writeOutbox(client);
+        }
+        if (!client.outbox.empty() && client.outbox.size() - client.outboxSent > kMaxOutboxBytes) {
+            SINO_LOG_WARN("DaemonServer: Client %llu is not reading, disconnecting",
+                          static_cast<unsigned long long>(client.id));
+            client.closed = true;
+        }
+        queued = client.closed || !client.outbox.empty();
+    }
+    if (queued) {
+        wakeIoThread();
+    }
+}
+
+void DaemonServer::reply(Client& client, const DaemonFrame& request, const std::vector<uint8_t>& payload) {
+    send(client, request.message, daemon_protocol::kFlagReply, request.requestId, payload);
+}
+
+void DaemonServer::replyError(Client& client, const DaemonFrame& request, const char* code,
+                              const std::string& message) {
+    DaemonWriter payload;
+    payload.str(code).str(message);
+    send(client, request.message, daemon_protocol::kFlagReply | daemon_protocol::kFlagError,
+         request.requestId, payload.bytes());
+}
+
+std::vector<DaemonServer::ClientPtr> DaemonServer::subscribers(uint32_t eventMask) const {
+    std::vector<ClientPtr> subscribed;
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto& [id, client] : clients) {
+        if (client->subscriptions.load() & eventMask) {
+            subscribed.push_back(client);
+        }
+    }
+    return subscribed;
+}
+
+void DaemonServer::broadcast(uint32_t eventMask, DaemonMessage message, const std::vector<uint8_t>& payload) {
+    for (const ClientPtr& client : subscribers(eventMask)) {
+        send(*client, message, daemon_protocol::kFlagEvent, 0, payload);
+    }
+}
+
+bool DaemonServer::isClosed(Client& client) {
+    std::lock_guard<std::mutex> lock(client.outMutex);
+    return client.closed;
+}
+
+void DaemonServer::closeClient(Client& client) {
+    {
+        std::lock_guard<std::mutex> lock(client.outMutex);
+        client.closed = true;
+    }
+    wakeIoThread();
+}
@@ -0,0 +1,117 @@
+#ifndef SINO_SCANNER_DAEMON_SERVER_H
+#define SINO_SCANNER_DAEMON_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "daemon_protocol.h"
+
+/**
+ * Daemon Server
+ *
+ * The socket side of sino_scannerd, shared by ScannerDaemon (one SDK) and
+ * ReaderPool (a supervisor over several). One I/O thread polls the
+ * listening socket and every connection and hands each complete request to
+ * handleFrame(). Replies are written from whichever thread produced them
+ * when the socket has room, and queued for the I/O thread otherwise.
+ *
+ * Hello and Subscribe/Unsubscribe are answered here; everything else is the
+ * subclass's. Subclasses must call stopServer() from their own destructor (and
+ * before tearing down anything handleFrame() uses), since the I/O thread
+ * calls into them until then.
+ */
+class DaemonServer {
+public:
+    struct Config {
+        std::string socketPath;        // Empty: daemon_protocol::defaultSocketPath()
+        mode_t socketMode = 0660;      // Owner and group may connect
+        size_t maxClients = 32;
+    };
+
+    struct Client {
+        uint64_t id = 0;
+        int fd = -1;
+        pid_t pid = 0;
+        std::string name;                    // From Hello
+        FrameDecoder decoder;                // I/O thread only
+        std::atomic<uint32_t> subscriptions{0};
+
+        std::mutex outMutex;                 // Guards everything below
+        std::vector<uint8_t> outbox;
+        size_t outboxSent = 0;
+        std::deque<std::pair<size_t, int>> outboxFds;   // (outbox offset, descriptor to send there)
+        bool closed = false;
+    };
+    using ClientPtr = std::shared_ptr<Client>;
+
+    DaemonServer();
+    virtual ~DaemonServer();
+
+    bool isRunning() const { return running.load(); }
+    size_t clientCount() const;
+    const std::string& socketPath() const { return serverConfig.socketPath; }
+
+protected:
+    // Binds the socket and starts the I/O thread. Returns false with |error|
+    // set if the socket cannot be created or a live daemon already serves it.
+    bool startServer(const Config& config, std::string& error);
+    // Disconnects every client and joins the I/O thread. No handler runs
+    // once it returns.
+    void stopServer();
+
+    // I/O thread. |frame| is a request other than Hello or (Un)Subscribe.
+    virtual void handleFrame(const ClientPtr& client, DaemonFrame& frame) = 0;
+    // I/O thread, before Hello is answered. |args| is positioned after the
+    // client name. Returning false refuses the Hello with |error|.
+    virtual bool onHello(const ClientPtr& client, DaemonReader& args, std::string& error) { return true; }
+    virtual void onSubscriptionsChanged(const ClientPtr& client, uint32_t previous, uint32_t current) {}
+    // I/O thread, once |client| is closed and removed.
+    virtual void onDisconnect(const ClientPtr& client) {}
+
+    // Any thread. |descriptor|, if given, is duplicated and sent with the frame.
+    void send(Client& client, DaemonMessage message, uint16_t flags, uint32_t requestId,
+              const std::vector<uint8_t>& payload, int descriptor = -1);
+    void reply(Client& client, const DaemonFrame& request, const std::vector<uint8_t>& payload);
+    void replyError(Client& client, const DaemonFrame& request, const char* code, const std::string& message);
+    void broadcast(uint32_t eventMask, DaemonMessage message, const std::vector<uint8_t>& payload);
+    std::vector<ClientPtr> subscribers(uint32_t eventMask) const;
+    bool isClosed(Client& client);
+    // Any thread; the I/O thread disconnects it.
+    void closeClient(Client& client);
+
+private:
+    bool bindSocket(std::string& error);
+    void run();
+    void acceptClients();
+    bool readClient(const ClientPtr& client);
+    bool flushClient(Client& client);
+    void writeOutbox(Client& client);
+    void disconnect(const ClientPtr& client);
+    void dispatch(const ClientPtr& client, DaemonFrame& frame);
+    void wakeIoThread();
+    static void closeSocket(Client& client);
+
+    Config serverConfig;
+    int listenFd;
+    int wakeFds[2];                     // Self-pipe: replies queued, client closed, stop()
+    std::thread ioThread;
+    std::atomic<bool> running;
+
+    mutable std::mutex clientsMutex;
+    std::map<uint64_t, ClientPtr> clients;
+    uint64_t nextClientId;
+
+    // Prevent copying
+    DaemonServer(const DaemonServer&) = delete;
+    DaemonServer& operator=(const DaemonServer&) = delete;
+};
+
+#endif //SINO_SCANNER_DAEMON_SERVER_H
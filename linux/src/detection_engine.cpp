@@ -0,0 +1,171 @@
+#include "detection_engine.h"
+#include "logger.h"
+#include "sinosecu_wrapper.h"
+
+DetectionEngine::DetectionEngine(Probe probe)
+        : probe(std::move(probe)),
+          running(false),
+          paused(false),
+          wakeRequested(false),
+          state(State::Unknown),
+          nextListenerId(1) {}
+
+DetectionEngine::~DetectionEngine() {
+    stop();
+}
+
+void DetectionEngine::start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Forget the last state so the first poll after (re)starting is
+        // always published to new subscribers.
+        state = State::Unknown;
+        paused = false;
+        scheduler.noteActivity();
+        if (running) {
+            condition.notify_all();
+            return;
+        }
+        running = true;
+        worker = std::thread(&DetectionEngine::run, this);
+    }
+    SINO_LOG_INFO("DetectionEngine: started");
+}
+
+void DetectionEngine::pause() {
+    std::lock_guard<std::mutex> lock(mutex);
+    paused = true;
+}
+
+void DetectionEngine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    condition.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    SINO_LOG_INFO("DetectionEngine: stopped");
+}
+
+bool DetectionEngine::isRunning() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running && !paused;
+}
+
+int DetectionEngine::addListener(Listener listener) {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    int id = nextListenerId++;
+    listeners[id] = std::move(listener);
+    return id;
+}
+
+void DetectionEngine::removeListener(int listenerId) {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    listeners.erase(listenerId);
+}
+
+void DetectionEngine::wake() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        scheduler.noteActivity();
+        wakeRequested = true;
+    }
+    condition.notify_all();
+}
+
+void DetectionEngine::setSchedulerConfig(const DetectionScheduler::Config& config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    scheduler.setConfig(config);
+}
+
+DetectionScheduler::Stats DetectionEngine::schedulerStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return scheduler.getStats();
+}
+
+DetectionEngine::State DetectionEngine::currentState() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return state;
+}
+
+DetectionEngine::State DetectionEngine::stateFromCode(int code) {
+    switch (code) {
+        case 0: return State::Empty;
+        case 1: return State::Placed;
+        case 2: return State::Removed;
+        case 3: return State::PhoneBarcode;
+        case SinosecuScanner::ERROR_DEVICE: return State::DeviceLost;
+        default: return code < 0 ? State::Error : State::Unknown;
+    }
+}
+
+const char* DetectionEngine::stateName(State state) {
+    switch (state) {
+        case State::Empty: return "empty";
+        case State::Placed: return "placed";
+        case State::Removed: return "removed";
+        case State::PhoneBarcode: return "phone_barcode";
+        case State::DeviceLost: return "device_lost";
+        case State::Error: return "error";
+        default: return "unknown";
+    }
+}
+
+void DetectionEngine::publish(const Event& event) {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    for (const auto& entry : listeners) {
+        entry.second(event);
+    }
+}
+
+void DetectionEngine::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return !running || !paused; });
+            if (!running) {
+                return;
+            }
+        }
+
+        int code = probe();
+        State newState = stateFromCode(code);
+
+        bool changed = false;
+        std::chrono::milliseconds interval;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running) {
+                return;
+            }
+            if (paused) {
+                continue;
+            }
+            if (newState != state) {
+                state = newState;
+                changed = true;
+            }
+            scheduler.recordPoll(code);
+            interval = scheduler.nextInterval();
+        }
+
+        if (changed) {
+            Event event{newState, code,
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::steady_clock::now().time_since_epoch()).count()};
+            publish(event);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait_for(lock, interval, [this]() { return !running || paused || wakeRequested; });
+        wakeRequested = false;
+        if (!running) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef SINO_SCANNER_DETECTION_ENGINE_H
+#define SINO_SCANNER_DETECTION_ENGINE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "detection_scheduler.h"
+
+/**
+ * Detection Engine
+ *
+ * Runs the DetectDocument() poll loop once, natively, on a background thread
+ * and publishes state *changes* to its listeners. Callers no longer need to
+ * poll detectDocument over the method channel; they subscribe instead.
+ *
+ * Poll spacing comes from a DetectionScheduler: fast right after activity,
+ * backing off while the desk is idle, and cut short by wake().
+ *
+ * The engine does not call the SDK itself. It is given a probe that returns a
+ * DetectDocument()-style code (or a SinosecuScanner error code); the runner's
+ * probe forwards to the SDK thread so detection stays serialized with every
+ * other SDK call.
+ */
+class DetectionEngine {
+public:
+    enum class State {
+        Unknown,
+        Empty,          // DetectDocument() == 0
+        Placed,         // DetectDocument() == 1
+        Removed,        // DetectDocument() == 2
+        PhoneBarcode,   // DetectDocument() == 3 (AR/KR series)
+        DeviceLost,     // SinosecuScanner::ERROR_DEVICE
+        Error           // Any other negative code
+    };
+
+    struct Event {
+        State state;
+        int code;               // Raw probe result
+        int64_t timestampMs;    // steady_clock milliseconds
+    };
+
+    using Probe = std::function<int()>;
+    using Listener = std::function<void(const Event&)>;
+
+    explicit DetectionEngine(Probe probe);
+    ~DetectionEngine();
+
+    // start() launches the poll thread (or resumes a paused one). pause()
+    // never blocks, so it is safe to call from the GTK main loop while a
+    // probe is waiting behind a scan. stop() joins the thread.
+    void start();
+    void pause();
+    void stop();
+    bool isRunning() const;
+
+    // Listeners are called on the engine thread.
+    int addListener(Listener listener);
+    void removeListener(int listenerId);
+
+    // Poll immediately and return to the fast interval (USB hot-plug, device
+    // status change, a scan being requested). Safe from any thread.
+    void wake();
+
+    void setSchedulerConfig(const DetectionScheduler::Config& config);
+    DetectionScheduler::Stats schedulerStats() const;
+    State currentState() const;
+
+    static State stateFromCode(int code);
+    static const char* stateName(State state);
+
+private:
+    void run();
+    void publish(const Event& event);
+
+    Probe probe;
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    bool running;
+    bool paused;
+    bool wakeRequested;
+    State state;
+    DetectionScheduler scheduler;
+
+    std::mutex listenerMutex;
+    std::map<int, Listener> listeners;
+    int nextListenerId;
+
+    // Prevent copying
+    DetectionEngine(const DetectionEngine&) = delete;
+    DetectionEngine& operator=(const DetectionEngine&) = delete;
+};
+
+#endif //SINO_SCANNER_DETECTION_ENGINE_H
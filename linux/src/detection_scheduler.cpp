@@ -0,0 +1,53 @@
+#include "detection_scheduler.h"
+#include <algorithm>
+
+DetectionScheduler::DetectionScheduler() : DetectionScheduler(Config()) {}
+
+DetectionScheduler::DetectionScheduler(const Config& config)
+        : config(config),
+          lastActivity(Clock::now()),
+          idleInterval(config.fastInterval),
+          lastCode(0) {}
+
+void DetectionScheduler::recordPoll(int code, Clock::time_point now) {
+    stats.polls++;
+    if (isActive(now)) {
+        stats.activePolls++;
+    }
+
+    // Only a change of result counts as activity (placed, removed, device
+    // lost or back). A result that stays the same, whether a document left
+    // on the glass or a persistent error, backs off like an empty desk.
+    if (code != lastCode) {
+        lastActivity = now;
+        idleInterval = config.fastInterval;
+    }
+    lastCode = code;
+}
+
+void DetectionScheduler::noteActivity(Clock::time_point now) {
+    stats.wakeups++;
+    lastActivity = now;
+    idleInterval = config.fastInterval;
+}
+
+bool DetectionScheduler::isActive(Clock::time_point now) const {
+    return now - lastActivity < config.activeWindow;
+}
+
+std::chrono::milliseconds DetectionScheduler::nextInterval(Clock::time_point now) {
+    if (isActive(now)) {
+        return config.fastInterval;
+    }
+
+    // Idle: grow the interval geometrically from fastInterval to maxInterval.
+    auto grown = std::chrono::milliseconds(
+            static_cast<int64_t>(static_cast<double>(idleInterval.count()) * config.backoffFactor));
+    idleInterval = std::clamp(grown, config.fastInterval, config.maxInterval);
+    return idleInterval;
+}
+
+void DetectionScheduler::setConfig(const Config& newConfig) {
+    config = newConfig;
+    idleInterval = std::clamp(idleInterval, config.fastInterval, config.maxInterval);
+}
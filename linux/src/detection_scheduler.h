@@ -0,0 +1,65 @@
+#ifndef SINO_SCANNER_DETECTION_SCHEDULER_H
+#define SINO_SCANNER_DETECTION_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Detection Scheduler
+ *
+ * Decides how long to sleep between DetectDocument() polls. Right after any
+ * activity (a document placed or removed, a USB hot-plug or a change of
+ * device status) it polls fast; once the poll result has stayed the same
+ * for the active window it backs off exponentially up to maxInterval. A
+ * document left on the glass or a reader that stays unplugged is as quiet
+ * as an empty desk.
+ *
+ * This is policy only: it owns no thread and no lock. DetectionEngine keeps
+ * one and sleeps on its own condition variable so a wake() can cut the
+ * sleep short. SinosecuScanner::waitForDocumentDetection shares the config
+ * but, with a caller waiting, always polls at fastInterval.
+ */
+class DetectionScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        std::chrono::milliseconds fastInterval{30};
+        std::chrono::milliseconds maxInterval{1000};
+        std::chrono::milliseconds activeWindow{10000};
+        double backoffFactor = 2.0;
+    };
+
+    struct Stats {
+        uint64_t polls = 0;
+        uint64_t activePolls = 0;   // Polls made at fastInterval
+        uint64_t wakeups = 0;       // noteActivity() calls from outside the poll loop
+    };
+
+    DetectionScheduler();
+    explicit DetectionScheduler(const Config& config);
+
+    // Record the result of one DetectDocument() poll.
+    void recordPoll(int code, Clock::time_point now = Clock::now());
+
+    // Something outside the poll loop happened (hot-plug, user started a scan).
+    void noteActivity(Clock::time_point now = Clock::now());
+
+    // Interval to sleep before the next poll.
+    std::chrono::milliseconds nextInterval(Clock::time_point now = Clock::now());
+
+    bool isActive(Clock::time_point now = Clock::now()) const;
+
+    void setConfig(const Config& config);
+    const Config& getConfig() const { return config; }
+    Stats getStats() const { return stats; }
+
+private:
+    Config config;
+    Stats stats;
+    Clock::time_point lastActivity;
+    std::chrono::milliseconds idleInterval;
+    int lastCode;
+};
+
+#endif //SINO_SCANNER_DETECTION_SCHEDULER_H
@@ -0,0 +1,121 @@
+#include "field_snapshot.h"
+#include "sdk_trace_recorder.h"
+#include "sinosecu_wrapper.h"
+#include "utf8_transcoder.h"
+#include <algorithm>
+#include <cwchar>
+
+namespace {
+
+bool isTrimmable(wchar_t c) {
+    return c == L' ' || c == L'\t' || c == L'\n' || c == L'\r';
+}
+
+}
+
+FieldSnapshot::FieldSnapshot(size_t arenaBytes)
+        : arena(arenaBytes),
+          arenaUsed(0),
+          entries{},
+          scratch(1024),
+          capturedAttribute(-1),
+          presentCount(0) {}
+
+void FieldSnapshot::clear() {
+    arenaUsed = 0;
+    entries.fill(Entry{});
+    capturedAttribute = -1;
+    presentCount = 0;
+}
+
+std::string_view FieldSnapshot::value(size_t position) const {
+    if (!has(position)) {
+        return {};
+    }
+    const Entry& entry = entries[position];
+    return std::string_view(arena.data() + entry.offset, entry.length);
+}
+
+bool FieldSnapshot::readField(int attribute, int index, size_t& valueLength) {
+    int actualSize = static_cast<int>(scratch.size());
+    int result = traced_sdk::GetRecogResultEx(attribute, index, scratch.data(), actualSize);
+
+    if (result == 1 && actualSize > 0 && actualSize < 10000) {
+        // Buffer too small: grow the scratch buffer once and keep it.
+        scratch.resize(actualSize + 1);
+        actualSize = static_cast<int>(scratch.size());
+        result = traced_sdk::GetRecogResultEx(attribute, index, scratch.data(), actualSize);
+    }
+
+    if (result != 0 || actualSize <= 0) {
+        return false;
+    }
+
+    // The buffer is not cleared between calls, so bound the value both by the
+    // reported size and by the SDK's terminator.
+    size_t limit = std::min(static_cast<size_t>(actualSize), scratch.size() - 1);
+    valueLength = wcsnlen(scratch.data(), limit);
+    return true;
+}
+
+void FieldSnapshot::append(const wchar_t* text, size_t length, Entry& entry) {
+    size_t worstCase = length * kUtf8BytesPerUtf32;
+    if (arenaUsed + worstCase > arena.size()) {
+        arena.resize(std::max(arena.size() * 2, arenaUsed + worstCase));
+    }
+
+    entry.offset = static_cast<uint32_t>(arenaUsed);
+    entry.length = static_cast<uint32_t>(wideToUtf8(text, length, arena.data() + arenaUsed));
+    entry.present = true;
+    arenaUsed += entry.length;
+}
+
+void FieldSnapshot::assign(size_t position, std::string_view value, int confidence) {
+    if (position >= kPassportFieldCount || value.empty()) {
+        return;
+    }
+    if (arenaUsed + value.size() > arena.size()) {
+        arena.resize(std::max(arena.size() * 2, arenaUsed + value.size()));
+    }
+
+    Entry& entry = entries[position];
+    if (!entry.present) {
+        presentCount++;
+    }
+    entry.offset = static_cast<uint32_t>(arenaUsed);
+    entry.length = static_cast<uint32_t>(value.size());
+    entry.confidence = static_cast<int16_t>(confidence);
+    entry.present = true;
+    std::copy(value.begin(), value.end(), arena.begin() + static_cast<std::ptrdiff_t>(arenaUsed));
+    arenaUsed += value.size();
+}
+
+size_t FieldSnapshot::capture(int attribute, bool withConfidence) {
+    clear();
+    capturedAttribute = attribute;
+
+    for (size_t i = 0; i < kPassportFieldCount; i++) {
+        size_t length = 0;
+        if (!readField(attribute, kPassportFields[i].index, length)) {
+            continue;
+        }
+
+        const wchar_t* begin = scratch.data();
+        const wchar_t* end = begin + length;
+        while (begin < end && isTrimmable(*begin)) begin++;
+        while (end > begin && isTrimmable(*(end - 1))) end--;
+
+        if (begin == end) {
+            continue;
+        }
+
+        Entry& entry = entries[i];
+        append(begin, static_cast<size_t>(end - begin), entry);
+        entry.confidence = withConfidence
+                ? static_cast<int16_t>(traced_sdk::GetFieldConfEx(attribute, kPassportFields[i].index))
+                : static_cast<int16_t>(-1);
+        presentCount++;
+    }
+
+    return presentCount;
+}
@@ -0,0 +1,158 @@
+#ifndef SINO_SCANNER_FIELD_SNAPSHOT_H
+#define SINO_SCANNER_FIELD_SNAPSHOT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+// SDK field index -> result key. The order of this table is the field
+// position used by FieldSnapshot (and anything built on top of it).
+struct PassportFieldDescriptor {
+    int index;          // nIndex passed to GetRecogResultEx
+    const char* name;   // Key used in channel results
+};
+
+inline constexpr PassportFieldDescriptor kPassportFields[] = {
+        // Core MRZ fields (these exactly match the SDK documentation)
+        {0,  "passport_type"},           // "P" - Passport type from MRZ
+        {1,  "passport_number_mrz"},     // Passport number from MRZ
+        {2,  "domestic_name"},           // Name in local language/script
+        {3,  "english_name"},            // Full English name
+        {4,  "gender"},                  // "M" or "F"
+        {5,  "date_of_birth"},           // Birth date in YYYYMMDD format
+        {6,  "date_of_expiry"},          // Expiry date in YYYYMMDD format
+        {7,  "issuing_country_code"},    // 3-letter country code
+        {8,  "english_surname"},         // Surname only
+        {9,  "english_first_name"},      // First name(s)
+        {10, "mrz_line_1"},              // First MRZ line (44 characters)
+        {11, "mrz_line_2"},              // Second MRZ line (44 characters)
+        {12, "nationality_code"},        // Holder nationality code from MRZ
+
+        // Additional passport fields
+        {13, "passport_number_direct"},  // Passport number from direct OCR (visual zone)
+        {14, "place_of_birth"},          // Birth place
+        {15, "place_of_issue"},          // Issue place
+        {16, "date_of_issue"},           // Issue date
+        {17, "rfid_mrz"},                // MRZ data from RFID chip
+        {18, "ocr_mrz"},                 // MRZ data from OCR
+        {21, "national_id_number"},      // National ID number
+        {23, "gender_ocr"},              // Gender from OCR
+        {24, "nationality_code_ocr"},    // Nationality from OCR
+        {25, "id_card_number_ocr"},      // ID card number from OCR
+        {26, "birth_date_ocr"},          // Birth date from OCR
+        {27, "valid_until_ocr"},         // Valid until from OCR
+        {28, "issuing_authority_ocr"},   // Issuing authority from OCR
+        {29, "domestic_surname"},        // Domestic surname
+        {30, "domestic_first_name"}      // Domestic first name
+};
+
+inline constexpr size_t kPassportFieldCount = std::size(kPassportFields);
+
+// Typed position in kPassportFields. Keep in the same order as the table.
+enum class PassportField : uint8_t {
+    PassportType,
+    PassportNumberMrz,
+    DomesticName,
+    EnglishName,
+    Gender,
+    DateOfBirth,
+    DateOfExpiry,
+    IssuingCountryCode,
+    EnglishSurname,
+    EnglishFirstName,
+    MrzLine1,
+    MrzLine2,
+    NationalityCode,
+    PassportNumberDirect,
+    PlaceOfBirth,
+    PlaceOfIssue,
+    DateOfIssue,
+    RfidMrz,
+    OcrMrz,
+    NationalIdNumber,
+    GenderOcr,
+    NationalityCodeOcr,
+    IdCardNumberOcr,
+    BirthDateOcr,
+    ValidUntilOcr,
+    IssuingAuthorityOcr,
+    DomesticSurname,
+    DomesticFirstName,
+    Count
+};
+
+static_assert(static_cast<size_t>(PassportField::Count) == kPassportFieldCount,
+              "PassportField must list every entry of kPassportFields");
+
+/**
+ * Field Snapshot
+ *
+ * Pulls every passport field for one attribute (0 = chip, 1 = OCR) out of the
+ * SDK in a single pass. Values are trimmed and transcoded to UTF-8 once,
+ * straight into a preallocated arena; entries only record offsets into it.
+ * A snapshot is meant to be kept and reused across scans, so after the first
+ * scan a capture performs no heap allocations at all.
+ *
+ * Views returned by value()/forEach() stay valid until the next capture().
+ */
+class FieldSnapshot {
+public:
+    struct Entry {
+        uint32_t offset;
+        uint32_t length;
+        int16_t confidence;   // GetFieldConfEx, -1 when not requested
+        bool present;
+    };
+
+    explicit FieldSnapshot(size_t arenaBytes = 16 * 1024);
+
+    // Read every field in kPassportFields for |attribute|. Returns the number
+    // of non-empty fields. With |withConfidence| each present field also gets
+    // its GetFieldConfEx score.
+    size_t capture(int attribute, bool withConfidence = false);
+    void clear();
+
+    // Fill one field from an already transcoded value, as when decoding a
+    // record that was captured in another process. Empty values are skipped.
+    void assign(size_t position, std::string_view value, int confidence);
+
+    int attribute() const { return capturedAttribute; }
+    size_t size() const { return presentCount; }
+    bool empty() const { return presentCount == 0; }
+
+    // |position| indexes kPassportFields, not the SDK field index.
+    bool has(size_t position) const { return position < kPassportFieldCount && entries[position].present; }
+    std::string_view value(size_t position) const;
+    int confidence(size_t position) const { return has(position) ? entries[position].confidence : -1; }
+
+    bool has(PassportField field) const { return has(static_cast<size_t>(field)); }
+    std::string_view value(PassportField field) const { return value(static_cast<size_t>(field)); }
+    int confidence(PassportField field) const { return confidence(static_cast<size_t>(field)); }
+
+    // Calls visitor(const PassportFieldDescriptor&, std::string_view) for every
+    // present field, in table order.
+    template<typename Visitor>
+    void forEach(Visitor&& visitor) const {
+        for (size_t i = 0; i < kPassportFieldCount; i++) {
+            if (entries[i].present) {
+                visitor(kPassportFields[i], value(i));
+            }
+        }
+    }
+
+private:
+    bool readField(int attribute, int index, size_t& valueLength);
+    void append(const wchar_t* text, size_t length, Entry& entry);
+
+    std::vector<char> arena;
+    size_t arenaUsed;
+    std::array<Entry, kPassportFieldCount> entries;
+    std::vector<wchar_t> scratch;
+    int capturedAttribute;
+    size_t presentCount;
+};
+
+#endif //SINO_SCANNER_FIELD_SNAPSHOT_H
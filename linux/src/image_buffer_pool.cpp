@@ -0,0 +1,148 @@
+#include "image_buffer_pool.h"
+#include "logger.h"
+#include <sys/mman.h>
+#include <utility>
+
+namespace {
+
+constexpr size_t kSmallestClass = 4096;   // One page
+constexpr size_t kHugePage = 2 * 1024 * 1024;
+constexpr size_t kDefaultRetainBytes = 64 * 1024 * 1024;
+
+}
+
+// ================================
+// BUFFER
+// ================================
+
+ImageBufferPool::Buffer::Buffer(Buffer&& other) noexcept
+        : pool(std::exchange(other.pool, nullptr)),
+          bytes(std::exchange(other.bytes, nullptr)),
+          length(std::exchange(other.length, 0)),
+          mapped(std::exchange(other.mapped, 0)) {}
+
+ImageBufferPool::Buffer& ImageBufferPool::Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        reset();
+        pool = std::exchange(other.pool, nullptr);
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+        mapped = std::exchange(other.mapped, 0);
+    }
+    return *this;
+}
+
+void ImageBufferPool::Buffer::reset() {
+    if (bytes) {
+        pool->release(bytes, mapped);
+    }
+    pool = nullptr;
+    bytes = nullptr;
+    length = 0;
+    mapped = 0;
+}
+
+// ================================
+// POOL
+// ================================
+
+ImageBufferPool::ImageBufferPool(size_t retainBytes)
+        : retainBytes(retainBytes) {}
+
+ImageBufferPool::~ImageBufferPool() {
+    trim();
+}
+
+ImageBufferPool& ImageBufferPool::getInstance() {
+    static ImageBufferPool* instance = new ImageBufferPool(kDefaultRetainBytes);
+    return *instance;
+}
+
+size_t ImageBufferPool::sizeClass(size_t bytes) {
+    if (bytes >= kHugePage) {
+        return (bytes + kHugePage - 1) / kHugePage * kHugePage;
+    }
+    size_t size = kSmallestClass;
+    while (size < bytes) {
+        size <<= 1;
+    }
+    return size;
+}
+
+ImageBufferPool::Buffer ImageBufferPool::acquire(size_t bytes) {
+    Buffer buffer;
+    if (bytes == 0) {
+        return buffer;
+    }
+    size_t mapped = sizeClass(bytes);
+    unsigned char* memory = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = freeLists.find(mapped);
+        if (it != freeLists.end() && !it->second.empty()) {
+            memory = it->second.back();
+            it->second.pop_back();
+            counters.pooledBytes -= mapped;
+            counters.reused++;
+        }
+    }
+    if (!memory) {
+        void* fresh = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (fresh == MAP_FAILED) {
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.failed++;
+            SINO_LOG_ERROR("ImageBufferPool: Cannot map %zu KB", mapped >> 10);
+            return buffer;
+        }
+        if (mapped >= kHugePage) {
+            madvise(fresh, mapped, MADV_HUGEPAGE);   // Ignored without THP
+        }
+        memory = static_cast<unsigned char*>(fresh);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.acquired++;
+        counters.inUseBytes += mapped;
+        if (counters.inUseBytes > counters.highWaterBytes) {
+            counters.highWaterBytes = counters.inUseBytes;
+        }
+    }
+    buffer.pool = this;
+    buffer.bytes = memory;
+    buffer.length = bytes;
+    buffer.mapped = mapped;
+    return buffer;
+}
+
+void ImageBufferPool::release(unsigned char* bytes, size_t mapped) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.inUseBytes -= mapped;
+        if (counters.pooledBytes + mapped <= retainBytes) {
+            freeLists[mapped].push_back(bytes);
+            counters.pooledBytes += mapped;
+            return;
+        }
+    }
+    munmap(bytes, mapped);
+}
+
+void ImageBufferPool::trim() {
+    std::map<size_t, std::vector<unsigned char*>> released;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        released.swap(freeLists);
+        counters.pooledBytes = 0;
+    }
+    for (auto& [mapped, buffers] : released) {
+        for (unsigned char* bytes : buffers) {
+            munmap(bytes, mapped);
+        }
+    }
+}
+
+ImageBufferPool::Stats ImageBufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
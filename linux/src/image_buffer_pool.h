@@ -0,0 +1,92 @@
+#ifndef SINO_SCANNER_IMAGE_BUFFER_POOL_H
+#define SINO_SCANNER_IMAGE_BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * Image Buffer Pool
+ *
+ * Recycles the multi-megabyte pixel buffers the image paths allocate, so a
+ * long-running kiosk maps each size once instead of going through malloc
+ * (and page faults) for every image, and does not fragment its heap.
+ *
+ * Buffers come in size classes: powers of two from one page, then multiples
+ * of 2 MB. Each is its own anonymous mapping; from 2 MB up it is advised
+ * for transparent huge pages where the kernel has them. A released buffer
+ * goes back to its class's free list, up to |retainBytes| in total, and
+ * is unmapped beyond that.
+ *
+ * Buffers are held through Buffer, a move-only handle that returns its
+ * memory on destruction. Buffers cannot become a CDib's imageData: the SDK
+ * frees that with free().
+ */
+class ImageBufferPool {
+public:
+    class Buffer {
+    public:
+        Buffer() = default;
+        ~Buffer() { reset(); }
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+
+        unsigned char* data() const { return bytes; }
+        size_t size() const { return length; }          // As requested
+        size_t capacity() const { return mapped; }      // The size class
+        explicit operator bool() const { return bytes != nullptr; }
+
+        // Returns the memory to the pool.
+        void reset();
+
+    private:
+        friend class ImageBufferPool;
+        ImageBufferPool* pool = nullptr;
+        unsigned char* bytes = nullptr;
+        size_t length = 0;
+        size_t mapped = 0;
+
+        // Prevent copying
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+    };
+
+    struct Stats {
+        size_t inUseBytes = 0;       // Capacity of live buffers
+        size_t highWaterBytes = 0;   // Most ever in use at once
+        size_t pooledBytes = 0;      // Free, kept for reuse
+        uint64_t acquired = 0;
+        uint64_t reused = 0;         // Served from a free list
+        uint64_t failed = 0;
+    };
+
+    explicit ImageBufferPool(size_t retainBytes);
+    ~ImageBufferPool();
+
+    // Shared by every image path. Never destroyed, so buffers held by other
+    // statics stay valid during exit.
+    static ImageBufferPool& getInstance();
+
+    // An empty Buffer if no memory could be mapped.
+    Buffer acquire(size_t bytes);
+    // Unmaps every free buffer.
+    void trim();
+    Stats stats() const;
+
+private:
+    static size_t sizeClass(size_t bytes);
+    void release(unsigned char* bytes, size_t mapped);
+
+    mutable std::mutex mutex;
+    std::map<size_t, std::vector<unsigned char*>> freeLists;   // Size class -> free buffers
+    size_t retainBytes;
+    Stats counters;
+
+    // Prevent copying
+    ImageBufferPool(const ImageBufferPool&) = delete;
+    ImageBufferPool& operator=(const ImageBufferPool&) = delete;
+};
+
+#endif //SINO_SCANNER_IMAGE_BUFFER_POOL_H
@@ -0,0 +1,134 @@
+#include "image_previews.h"
+#include "logger.h"
+#include "pixel_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+
+namespace {
+
+// The smallest power-of-two reduction of |longEdge| that stays >= |edge|.
+int reductionFor(size_t longEdge, int edge) {
+    int factor = 1;
+    while (longEdge / (static_cast<size_t>(factor) * 2) >= static_cast<size_t>(edge)) {
+        factor *= 2;
+    }
+    return factor;
+}
+
+}
+
+ImagePreviews::Config ImagePreviews::configFromEnvironment() {
+    Config result;
+    const char* value = std::getenv("SINO_SCANNER_PREVIEWS");
+    if (!value || !*value) {
+        return result;
+    }
+    result.edges.clear();
+    for (const char* item = value; *item;) {
+        char* end = nullptr;
+        long edge = std::strtol(item, &end, 10);
+        if (end == item || (*end != ',' && *end != '\0')) {
+            SINO_LOG_WARN("ImagePreviews: Ignoring malformed SINO_SCANNER_PREVIEWS=%s", value);
+            return Config();
+        }
+        if (edge > 0) {
+            result.edges.push_back(static_cast<int>(std::min(edge, 1L << 16)));
+        }
+        item = *end ? end + 1 : end;
+    }
+    return result;
+}
+
+ImagePreviews::ImagePreviews() : ImagePreviews(configFromEnvironment()) {}
+
+ImagePreviews::ImagePreviews(const Config& newConfig)
+        : config(newConfig) {
+    // Largest first: each preview is reduced from the one before it.
+    std::sort(config.edges.begin(), config.edges.end(), std::greater<int>());
+    config.edges.erase(std::unique(config.edges.begin(), config.edges.end()), config.edges.end());
+}
+
+ImagePreviews::~ImagePreviews() {
+    worker.stop();
+}
+
+void ImagePreviews::generate(std::vector<std::string> imagePaths) {
+    if (!isEnabled() || imagePaths.empty()) {
+        return;
+    }
+    worker.start();
+    worker.post([this, paths = std::move(imagePaths)]() {
+        for (const std::string& path : paths) {
+            std::string error;
+            if (!render(path, error)) {
+                SINO_LOG_WARN("ImagePreviews: No previews of %s: %s", path.c_str(), error.c_str());
+            }
+        }
+    });
+}
+
+void ImagePreviews::flush() {
+    // Runs inline when the worker never started.
+    worker.submit([]() {}).wait();
+}
+
+std::string ImagePreviews::previewPath(const std::string& imagePath, int edge) {
+    std::filesystem::path image(imagePath);
+    std::string name = image.stem().string() + "@" + std::to_string(edge) + ".jpg";
+    return (image.parent_path() / "previews" / name).string();
+}
+
+bool ImagePreviews::render(const std::string& imagePath, std::string& error) {
+    if (!isEnabled()) {
+        return true;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    JpegCodec& codec = JpegCodec::getInstance();
+    JpegCodec::Image image;
+    if (!codec.decodeFile(imagePath, JpegCodec::Layout::Native, image, error)) {
+        return false;
+    }
+    std::error_code ignored;
+    std::filesystem::create_directories(std::filesystem::path(previewPath(imagePath, 0)).parent_path(), ignored);
+
+    size_t longEdge = std::max(image.width, image.height);
+    int reduced = 1;   // |image| is the original reduced this many times
+    for (int edge : config.edges) {
+        int factor = reductionFor(longEdge, edge);
+        if (!reduce(image, factor / reduced)) {
+            error = "no memory for a reduced image";
+            return false;
+        }
+        reduced = factor;
+        if (!codec.encodeFile(image, config.quality, previewPath(imagePath, edge), error)) {
+            return false;
+        }
+    }
+
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    SINO_LOG_DEBUG("ImagePreviews: %zu previews of %s in %lld us", config.edges.size(), imagePath.c_str(),
+                   static_cast<long long>(micros.count()));
+    return true;
+}
+
+bool ImagePreviews::reduce(JpegCodec::Image& image, int factor) {
+    while (factor > 1) {
+        int step = factor >= 4 ? 4 : 2;
+        JpegCodec::Image smaller;
+        smaller.width = image.width / step;
+        smaller.height = image.height / step;
+        smaller.channels = image.channels;
+        smaller.pixels = ImageBufferPool::getInstance().acquire(std::max<size_t>(smaller.stride() * smaller.height, 1));
+        if (!smaller.pixels) {
+            return false;
+        }
+        downscaleBox(image.pixels.data(), image.width, image.height, image.stride(), image.channels, step,
+                     smaller.pixels.data(), smaller.stride());
+        image = std::move(smaller);
+        factor /= step;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef SINO_SCANNER_IMAGE_PREVIEWS_H
+#define SINO_SCANNER_IMAGE_PREVIEWS_H
+
+#include <string>
+#include <vector>
+#include "jpeg_codec.h"
+#include "scanner_executor.h"
+
+/**
+ * Image Previews
+ *
+ * Small renditions of the images saveImages writes (white, IR, UV and the
+ * portraits), so the gallery can show a scan without decoding 2048x1536
+ * JPEGs on the UI thread. Each image gets one preview per configured edge,
+ * written next to it as previews/<name>@<edge>.jpg: for
+ * passports/p_IR.jpg, passports/previews/p_IR@256.jpg.
+ *
+ * A preview is the smallest power-of-two reduction of the image whose long
+ * edge is still at least |edge|, so it can be shown at that size without
+ * being scaled up: a 2048x1536 page becomes 256x192 for 256 and 1024x768
+ * for 768. Reductions are box averages (downscaleBox, SIMD), each edge
+ * derived from the next larger one, in buffers from ImageBufferPool.
+ *
+ * Work runs on a worker thread of its own, started by the first generate().
+ * JPEGs are read and written through JpegCodec.
+ *
+ * Edges come from SINO_SCANNER_PREVIEWS, a comma-separated list (default
+ * "256,768"); "0" turns previews off.
+ */
+class ImagePreviews {
+public:
+    struct Config {
+        std::vector<int> edges = {256, 768};
+        int quality = 85;                      // JPEG quality of the previews
+    };
+
+    static Config configFromEnvironment();
+
+    ImagePreviews();
+    explicit ImagePreviews(const Config& config);
+    // Finishes the previews already queued.
+    ~ImagePreviews();
+
+    bool isEnabled() const { return !config.edges.empty(); }
+    const Config& getConfig() const { return config; }
+
+    // Queues previews of every image in |imagePaths| and returns at once.
+    void generate(std::vector<std::string> imagePaths);
+
+    // Writes the previews of one image on the calling thread. Returns false
+    // with |error| set if the image cannot be read or a preview written.
+    bool render(const std::string& imagePath, std::string& error);
+
+    // Blocks until everything queued so far is written.
+    void flush();
+
+    static std::string previewPath(const std::string& imagePath, int edge);
+
+private:
+    static bool reduce(JpegCodec::Image& image, int factor);
+
+    Config config;
+    ScannerExecutor worker;
+
+    // Prevent copying
+    ImagePreviews(const ImagePreviews&) = delete;
+    ImagePreviews& operator=(const ImagePreviews&) = delete;
+};
+
+#endif //SINO_SCANNER_IMAGE_PREVIEWS_H
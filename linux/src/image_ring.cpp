@@ -0,0 +1,329 @@
+#include "image_ring.h"
+#include "logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+constexpr uint32_t kSegmentMagic = 0x474D4953;   // "SIMG"
+constexpr uint32_t kSegmentVersion = 1;
+constexpr size_t kHeaderBytes = 24;
+constexpr size_t kPlaneNameBytes = 24;
+constexpr size_t kPlaneEntryBytes = kPlaneNameBytes + 16;
+constexpr unsigned kRequiredSeals = F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW;
+
+uint64_t alignToPage(uint64_t value) {
+    static const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    return (value + page - 1) / page * page;
+}
+
+template<typename T>
+void put(std::vector<uint8_t>& out, size_t offset, T value) {
+    std::memcpy(out.data() + offset, &value, sizeof(value));
+}
+
+template<typename T>
+T get(const uint8_t* data, size_t offset) {
+    T value;
+    std::memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+// Copies |length| bytes of |source| to |offset| in |target|. sendfile keeps
+// the copy in the kernel; the read/write loop covers filesystems it refuses.
+bool copyInto(int target, uint64_t offset, int source, uint64_t length) {
+    if (lseek(target, static_cast<off_t>(offset), SEEK_SET) < 0) {
+        return false;
+    }
+    uint64_t copied = 0;
+    while (copied < length) {
+        ssize_t sent = sendfile(target, source, nullptr, length - copied);
+        if (sent > 0) {
+            copied += static_cast<uint64_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EINVAL || errno == ENOSYS)) break;
+        return false;
+    }
+
+    uint8_t buffer[64 * 1024];
+    while (copied < length) {
+        ssize_t got = pread(source, buffer, std::min<uint64_t>(sizeof(buffer), length - copied),
+                            static_cast<off_t>(copied));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        if (pwrite(target, buffer, static_cast<size_t>(got), static_cast<off_t>(offset + copied)) != got) {
+            return false;
+        }
+        copied += static_cast<uint64_t>(got);
+    }
+    return true;
+}
+
+}
+
+ImageRing::ImageRing() : ImageRing(Config()) {}
+
+ImageRing::ImageRing(const Config& newConfig)
+        : config(newConfig),
+          nextSequence(1),
+          stagingCreated(false) {
+    slots.resize(std::max<size_t>(config.slots, 1));
+}
+
+ImageRing::~ImageRing() {
+    for (Slot& slot : slots) {
+        if (slot.segment.fd >= 0) {
+            ::close(slot.segment.fd);
+        }
+    }
+    if (stagingCreated) {
+        std::error_code ignored;
+        std::filesystem::remove_all(config.stagingDirectory, ignored);
+    }
+}
+
+const std::string& ImageRing::stagingDirectory() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (config.stagingDirectory.empty()) {
+        // tmpfs, so SaveImageEx's files stay in memory.
+        std::string pattern = access("/dev/shm", W_OK) == 0 ? "/dev/shm" : std::filesystem::temp_directory_path().string();
+        pattern += "/sino_scanner-images-XXXXXX";
+        std::vector<char> path(pattern.begin(), pattern.end());
+        path.push_back('\0');
+        if (mkdtemp(path.data())) {
+            config.stagingDirectory = path.data();
+            stagingCreated = true;
+        } else {
+            SINO_LOG_ERROR("ImageRing: Cannot create %s: %s", pattern.c_str(), strerror(errno));
+        }
+    }
+    return config.stagingDirectory;
+}
+
+uint64_t ImageRing::publishFiles(const std::vector<PlaneFile>& files, std::string& error) {
+    // Each open file with the entry it came from; files that cannot be
+    // opened are skipped, so indexes into |files| no longer line up.
+    std::vector<std::pair<int, const PlaneFile*>> sources;
+    std::vector<Plane> planes;
+    for (const PlaneFile& file : files) {
+        int source = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (source < 0 || fstat(source, &info) != 0) {
+            if (source >= 0) ::close(source);
+            continue;
+        }
+        sources.emplace_back(source, &file);
+        planes.push_back({file.name.substr(0, kPlaneNameBytes - 1), 0, static_cast<uint64_t>(info.st_size)});
+    }
+    auto closeSources = [&sources]() {
+        for (const auto& source : sources) ::close(source.first);
+    };
+    if (planes.empty()) {
+        error = "no image files to publish";
+        return 0;
+    }
+
+    // Header, plane table, then each plane on its own pages.
+    uint64_t size = alignToPage(kHeaderBytes + planes.size() * kPlaneEntryBytes);
+    for (Plane& plane : planes) {
+        plane.offset = size;
+        size = alignToPage(size + plane.length);
+    }
+
+    // Built and sealed before taking the lock; only installing it needs one.
+    int fd = memfd_create("sino_scanner_images", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        error = std::string("memfd failed: ") + strerror(errno);
+        if (fd >= 0) ::close(fd);
+        closeSources();
+        return 0;
+    }
+    for (size_t i = 0; i < planes.size(); i++) {
+        if (!copyInto(fd, planes[i].offset, sources[i].first, planes[i].length)) {
+            error = "copying " + sources[i].second->path + " failed: " + strerror(errno);
+            ::close(fd);
+            closeSources();
+            return 0;
+        }
+    }
+    closeSources();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Slot* slot = freeSlot();
+    if (!slot) {
+        error = "all " + std::to_string(slots.size()) + " image slots are still held";
+        ::close(fd);
+        return 0;
+    }
+    uint64_t sequence = nextSequence++;
+
+    std::vector<uint8_t> header(kHeaderBytes + planes.size() * kPlaneEntryBytes, 0);
+    put<uint32_t>(header, 0, kSegmentMagic);
+    put<uint32_t>(header, 4, kSegmentVersion);
+    put<uint64_t>(header, 8, sequence);
+    put<uint32_t>(header, 16, static_cast<uint32_t>(planes.size()));
+    for (size_t i = 0; i < planes.size(); i++) {
+        size_t entry = kHeaderBytes + i * kPlaneEntryBytes;
+        std::memcpy(header.data() + entry, planes[i].name.data(), planes[i].name.size());
+        put<uint64_t>(header, entry + kPlaneNameBytes, planes[i].offset);
+        put<uint64_t>(header, entry + kPlaneNameBytes + 8, planes[i].length);
+    }
+    if (pwrite(fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size()) ||
+        fcntl(fd, F_ADD_SEALS, kRequiredSeals | F_SEAL_SEAL) != 0) {
+        error = std::string("sealing the image segment failed: ") + strerror(errno);
+        ::close(fd);
+        return 0;
+    }
+
+    if (slot->segment.fd >= 0) {
+        ::close(slot->segment.fd);
+    }
+    slot->segment.sequence = sequence;
+    slot->segment.fd = fd;
+    slot->segment.size = size;
+    slot->segment.planes = std::move(planes);
+    slot->references = 1;
+    return sequence;
+}
+
+ImageRing::Slot* ImageRing::freeSlot() {
+    // An empty slot, else the oldest segment nobody holds.
+    Slot* oldest = nullptr;
+    for (Slot& slot : slots) {
+        if (slot.segment.fd < 0) {
+            return &slot;
+        }
+        if (slot.references == 0 && (!oldest || slot.segment.sequence < oldest->segment.sequence)) {
+            oldest = &slot;
+        }
+    }
+    return oldest;
+}
+
+bool ImageRing::acquire(uint64_t sequence, Segment& segment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Slot& slot : slots) {
+        if (slot.segment.fd >= 0 && slot.segment.sequence == sequence) {
+            slot.references++;
+            segment = slot.segment;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ImageRing::release(uint64_t sequence) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Slot& slot : slots) {
+        if (slot.segment.fd >= 0 && slot.segment.sequence == sequence) {
+            if (slot.references > 0) {
+                slot.references--;
+            }
+            return;
+        }
+    }
+}
+
+size_t ImageRing::heldSegments() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<size_t>(std::count_if(slots.begin(), slots.end(),
+                                             [](const Slot& slot) { return slot.references > 0; }));
+}
+
+// ================================
+// IMAGE SEGMENT VIEW
+// ================================
+
+ImageSegmentView::ImageSegmentView()
+        : fd(-1),
+          base(nullptr),
+          size(0),
+          segmentSequence(0) {}
+
+ImageSegmentView::~ImageSegmentView() {
+    close();
+}
+
+bool ImageSegmentView::open(int newFd, std::string& error) {
+    close();
+    fd = newFd;
+
+    // Without these seals the owner could still change or truncate the
+    // segment, and a read past a truncation is a SIGBUS.
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (static_cast<unsigned>(seals) & kRequiredSeals) != kRequiredSeals) {
+        error = "image segment is not sealed";
+        close();
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < kHeaderBytes) {
+        error = "image segment is too small";
+        close();
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        error = std::string("mmap failed: ") + strerror(errno);
+        close();
+        return false;
+    }
+    base = static_cast<const uint8_t*>(mapped);
+    size = static_cast<size_t>(info.st_size);
+
+    uint32_t planeCount = get<uint32_t>(base, 16);
+    if (get<uint32_t>(base, 0) != kSegmentMagic || get<uint32_t>(base, 4) != kSegmentVersion ||
+        planeCount > (size - kHeaderBytes) / kPlaneEntryBytes) {
+        error = "not an image segment";
+        close();
+        return false;
+    }
+    segmentSequence = get<uint64_t>(base, 8);
+    for (uint32_t i = 0; i < planeCount; i++) {
+        const uint8_t* entry = base + kHeaderBytes + i * kPlaneEntryBytes;
+        ImageRing::Plane plane;
+        plane.name.assign(reinterpret_cast<const char*>(entry), strnlen(reinterpret_cast<const char*>(entry), kPlaneNameBytes));
+        plane.offset = get<uint64_t>(entry, kPlaneNameBytes);
+        plane.length = get<uint64_t>(entry, kPlaneNameBytes + 8);
+        if (plane.offset > size || plane.length > size - plane.offset) {
+            error = "image segment plane out of bounds";
+            close();
+            return false;
+        }
+        planeTable.push_back(std::move(plane));
+    }
+    return true;
+}
+
+void ImageSegmentView::close() {
+    if (base) {
+        munmap(const_cast<uint8_t*>(base), size);
+        base = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    size = 0;
+    segmentSequence = 0;
+    planeTable.clear();
+}
+
+std::string_view ImageSegmentView::plane(size_t index) const {
+    if (!base || index >= planeTable.size()) {
+        return {};
+    }
+    return std::string_view(reinterpret_cast<const char*>(base + planeTable[index].offset),
+                            static_cast<size_t>(planeTable[index].length));
+}
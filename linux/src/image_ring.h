@@ -0,0 +1,129 @@
+#ifndef SINO_SCANNER_IMAGE_RING_H
+#define SINO_SCANNER_IMAGE_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Image Ring
+ *
+ * Shared-memory hand-off for a scan's images. Each published scan becomes
+ * one memfd segment holding every image plane behind a small table (see
+ * ImageSegmentView). Once written, the segment is sealed against writes
+ * and resizing, so any process handed its descriptor can map it read-only
+ * and rely on it never changing or shrinking underneath.
+ *
+ * The ring keeps at most |slots| segments. Publishing takes a reference for
+ * the publisher; acquire() and release() add and drop more (one per client
+ * the segment was sent to). A slot is only reused once nothing references
+ * it, and publish() fails rather than drop a segment still in use.
+ *
+ * The SDK can only write encoded image files (SaveImageEx), so planes are
+ * staged in a private directory on tmpfs and copied into the segment by the
+ * kernel; nothing touches a disk and nothing is decoded.
+ */
+class ImageRing {
+public:
+    struct Config {
+        size_t slots = 4;
+        std::string stagingDirectory;   // Empty: a private directory under /dev/shm
+    };
+
+    struct Plane {
+        std::string name;    // File name suffix SaveImageEx used: ".jpg", "_IR.jpg", ...
+        uint64_t offset;     // Page-aligned, so a plane can be mapped on its own
+        uint64_t length;
+    };
+
+    struct Segment {
+        uint64_t sequence = 0;
+        int fd = -1;         // Owned by the ring; dup() it to keep it past release()
+        uint64_t size = 0;
+        std::vector<Plane> planes;
+    };
+
+    // One image file to publish.
+    struct PlaneFile {
+        std::string name;
+        std::string path;
+    };
+
+    ImageRing();
+    explicit ImageRing(const Config& config);
+    ~ImageRing();
+
+    // Where SaveImageEx should write files for publishFiles(). Created on
+    // first use; empty if no staging directory could be made.
+    const std::string& stagingDirectory();
+
+    // Copies |files| into a new sealed segment holding one reference.
+    // Returns its sequence, or 0 with |error| set.
+    uint64_t publishFiles(const std::vector<PlaneFile>& files, std::string& error);
+
+    // Adds a reference and fills |segment|. False if |sequence| is gone.
+    bool acquire(uint64_t sequence, Segment& segment);
+    void release(uint64_t sequence);
+
+    size_t heldSegments() const;
+
+private:
+    struct Slot {
+        Segment segment;
+        uint32_t references = 0;
+    };
+
+    Slot* freeSlot();
+
+    Config config;
+    mutable std::mutex mutex;
+    std::vector<Slot> slots;
+    uint64_t nextSequence;
+    bool stagingCreated;
+
+    // Prevent copying
+    ImageRing(const ImageRing&) = delete;
+    ImageRing& operator=(const ImageRing&) = delete;
+};
+
+/**
+ * Image Segment View
+ *
+ * Read-only mapping of a segment published by an ImageRing, in this or
+ * another process. The segment starts with a header:
+ *
+ *   u32 magic "SIMG" | u32 version | u64 sequence | u32 planeCount | u32 0
+ *
+ * followed by planeCount entries of (char name[24], u64 offset, u64 length).
+ */
+class ImageSegmentView {
+public:
+    ImageSegmentView();
+    ~ImageSegmentView();
+
+    // Takes ownership of |fd|. Fails unless it is a memfd sealed against
+    // writes and resizing with a valid header.
+    bool open(int fd, std::string& error);
+    void close();
+
+    bool isOpen() const { return base != nullptr; }
+    uint64_t sequence() const { return segmentSequence; }
+    const std::vector<ImageRing::Plane>& planes() const { return planeTable; }
+    std::string_view plane(size_t index) const;
+
+private:
+    int fd;
+    const uint8_t* base;
+    size_t size;
+    uint64_t segmentSequence;
+    std::vector<ImageRing::Plane> planeTable;
+
+    // Prevent copying
+    ImageSegmentView(const ImageSegmentView&) = delete;
+    ImageSegmentView& operator=(const ImageSegmentView&) = delete;
+};
+
+#endif //SINO_SCANNER_IMAGE_RING_H
@@ -0,0 +1,284 @@
+#include "jpeg_codec.h"
+#include "logger.h"
+#include "pixel_kernels.h"
+#include <algorithm>
+#include <cerrno>
+#include <csetjmp>
+#include <cstring>
+#include <dlfcn.h>
+#include <jpeglib.h>
+#include <type_traits>
+
+// The libjpeg entry points used, all from the system library. The
+// jpeg_create_* macros call jpeg_Create* with the struct sizes this file
+// was compiled with, so the library loaded has to match jpeglib.h.
+struct JpegCodec::Api {
+    void* handle = nullptr;
+    decltype(&::jpeg_std_error) std_error;
+    decltype(&::jpeg_CreateDecompress) CreateDecompress;
+    decltype(&::jpeg_stdio_src) stdio_src;
+    decltype(&::jpeg_read_header) read_header;
+    decltype(&::jpeg_start_decompress) start_decompress;
+    decltype(&::jpeg_read_scanlines) read_scanlines;
+    decltype(&::jpeg_finish_decompress) finish_decompress;
+    decltype(&::jpeg_destroy_decompress) destroy_decompress;
+    decltype(&::jpeg_CreateCompress) CreateCompress;
+    decltype(&::jpeg_stdio_dest) stdio_dest;
+    decltype(&::jpeg_set_defaults) set_defaults;
+    decltype(&::jpeg_set_quality) set_quality;
+    decltype(&::jpeg_start_compress) start_compress;
+    decltype(&::jpeg_write_scanlines) write_scanlines;
+    decltype(&::jpeg_finish_compress) finish_compress;
+    decltype(&::jpeg_destroy_compress) destroy_compress;
+};
+
+namespace {
+
+// libjpeg reports fatal errors through error_exit, which must not return.
+struct JpegError {
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+void jpegErrorExit(j_common_ptr info) {
+    JpegError* error = reinterpret_cast<JpegError*>(info->err);
+    error->manager.format_message(info, error->message);
+    longjmp(error->jump, 1);
+}
+
+// Corrupt-data warnings still decode; keep them off stderr.
+void jpegIgnoreMessage(j_common_ptr, int) {}
+
+// RGB rows decoded into the tail of an RGBA buffer, expanded front to back:
+// pixel i is written below where pixel i + 1 is read, for every i.
+void rgbToRgbaInPlace(const uint8_t* rgb, uint8_t* rgba, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+        rgba[i * 4] = r;
+        rgba[i * 4 + 1] = g;
+        rgba[i * 4 + 2] = b;
+        rgba[i * 4 + 3] = 0xFF;
+    }
+}
+
+}
+
+JpegCodec& JpegCodec::getInstance() {
+    static JpegCodec* instance = new JpegCodec();
+    return *instance;
+}
+
+JpegCodec::JpegCodec() : api(nullptr) {}
+
+bool JpegCodec::load(std::string& error) {
+    if (api.load(std::memory_order_acquire)) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(loadMutex);
+    if (api.load(std::memory_order_relaxed)) {
+        return true;
+    }
+
+    // The soname that goes with the jpeglib.h compiled against.
+#if JPEG_LIB_VERSION >= 90
+    const char* names[] = {"libjpeg.so.9", "libjpeg.so"};
+#elif JPEG_LIB_VERSION >= 80
+    const char* names[] = {"libjpeg.so.8", "libjpeg.so"};
+#else
+    const char* names[] = {"libjpeg.so.62", "libjpeg.so"};
+#endif
+    void* handle = nullptr;
+    for (const char* name : names) {
+        handle = dlopen(name, RTLD_LAZY | RTLD_LOCAL);
+        if (handle) {
+            break;
+        }
+    }
+    if (!handle) {
+        error = std::string("cannot load the system libjpeg: ") + dlerror();
+        return false;
+    }
+
+    Api* resolved = new Api();
+    resolved->handle = handle;
+    bool complete = true;
+    auto resolve = [&](auto& function, const char* name) {
+        function = reinterpret_cast<std::remove_reference_t<decltype(function)>>(dlsym(handle, name));
+        complete = complete && function;
+    };
+    resolve(resolved->std_error, "jpeg_std_error");
+    resolve(resolved->CreateDecompress, "jpeg_CreateDecompress");
+    resolve(resolved->stdio_src, "jpeg_stdio_src");
+    resolve(resolved->read_header, "jpeg_read_header");
+    resolve(resolved->start_decompress, "jpeg_start_decompress");
+    resolve(resolved->read_scanlines, "jpeg_read_scanlines");
+    resolve(resolved->finish_decompress, "jpeg_finish_decompress");
+    resolve(resolved->destroy_decompress, "jpeg_destroy_decompress");
+    resolve(resolved->CreateCompress, "jpeg_CreateCompress");
+    resolve(resolved->stdio_dest, "jpeg_stdio_dest");
+    resolve(resolved->set_defaults, "jpeg_set_defaults");
+    resolve(resolved->set_quality, "jpeg_set_quality");
+    resolve(resolved->start_compress, "jpeg_start_compress");
+    resolve(resolved->write_scanlines, "jpeg_write_scanlines");
+    resolve(resolved->finish_compress, "jpeg_finish_compress");
+    resolve(resolved->destroy_compress, "jpeg_destroy_compress");
+    if (!complete) {
+        error = "the system libjpeg is missing required functions";
+        dlclose(handle);
+        delete resolved;
+        return false;
+    }
+
+    // Kept loaded for the life of the process, like the instance.
+    api.store(resolved, std::memory_order_release);
+    SINO_LOG_INFO("JpegCodec: Loaded the system libjpeg (%d)", JPEG_LIB_VERSION);
+    return true;
+}
+
+bool JpegCodec::decode(const uint8_t* data, size_t size, Layout layout, Image& image, std::string& error) {
+    if (!load(error)) {
+        return false;
+    }
+    // libjpeg only reads from stdio streams in every version; fmemopen
+    // makes one of |data| without copying it.
+    FILE* file = size ? fmemopen(const_cast<uint8_t*>(data), size, "rb") : nullptr;
+    if (!file) {
+        error = size ? std::string("cannot read the image: ") + strerror(errno) : std::string("empty image");
+        return false;
+    }
+    bool decoded = decodeStream(file, layout, image, error);
+    fclose(file);
+    return decoded;
+}
+
+bool JpegCodec::decodeFile(const std::string& path, Layout layout, Image& image, std::string& error) {
+    if (!load(error)) {
+        return false;
+    }
+    FILE* file = fopen(path.c_str(), "rbe");
+    if (!file) {
+        error = std::string("cannot open it: ") + strerror(errno);
+        return false;
+    }
+    bool decoded = decodeStream(file, layout, image, error);
+    fclose(file);
+    return decoded;
+}
+
+bool JpegCodec::decodeStream(FILE* file, Layout layout, Image& image, std::string& error) {
+    Api* jpeg = api.load(std::memory_order_acquire);
+
+    // Zeroed, so destroying it is safe however early an error comes.
+    jpeg_decompress_struct info{};
+    JpegError failure;
+    info.err = jpeg->std_error(&failure.manager);
+    failure.manager.error_exit = jpegErrorExit;
+    failure.manager.emit_message = jpegIgnoreMessage;
+    if (setjmp(failure.jump)) {
+        jpeg->destroy_decompress(&info);
+        error = failure.message;
+        return false;
+    }
+
+    jpeg->CreateDecompress(&info, JPEG_LIB_VERSION, sizeof(info));
+    jpeg->stdio_src(&info, file);
+    jpeg->read_header(&info, TRUE);
+    bool gray = info.num_components == 1;
+    info.out_color_space = gray ? JCS_GRAYSCALE : JCS_RGB;
+#ifdef JCS_EXTENSIONS
+    // libjpeg-turbo writes RGBA itself.
+    if (layout == Layout::Rgba && !gray) {
+        info.out_color_space = JCS_EXT_RGBA;
+    }
+#endif
+    jpeg->start_decompress(&info);
+
+    image.width = info.output_width;
+    image.height = info.output_height;
+    image.channels = layout == Layout::Rgba ? 4 : info.output_components;
+    size_t pixels = image.width * image.height;
+    image.pixels = ImageBufferPool::getInstance().acquire(image.stride() * image.height);
+    if (!image.pixels) {
+        jpeg->destroy_decompress(&info);
+        error = "no memory for the decoded image";
+        return false;
+    }
+
+    // Anything narrower than the requested layout is decoded into the tail
+    // of the buffer and expanded in place afterwards.
+    size_t decodedStride = image.width * info.output_components;
+    uint8_t* decoded = image.pixels.data() + (image.stride() - decodedStride) * image.height;
+    while (info.output_scanline < info.output_height) {
+        JSAMPROW rows[4];
+        JDIMENSION count = std::min<JDIMENSION>(4, info.output_height - info.output_scanline);
+        for (JDIMENSION i = 0; i < count; i++) {
+            rows[i] = decoded + (info.output_scanline + i) * decodedStride;
+        }
+        jpeg->read_scanlines(&info, rows, count);
+    }
+    int decodedChannels = info.output_components;
+    jpeg->finish_decompress(&info);
+    jpeg->destroy_decompress(&info);
+
+    if (image.channels == 4 && decodedChannels == 1) {
+        grayToRgba(decoded, image.pixels.data(), pixels);
+    } else if (image.channels == 4 && decodedChannels == 3) {
+        rgbToRgbaInPlace(decoded, image.pixels.data(), pixels);
+    }
+    return true;
+}
+
+bool JpegCodec::encodeFile(const Image& image, int quality, const std::string& path, std::string& error) {
+    if (!load(error)) {
+        return false;
+    }
+    if (image.channels != 1 && image.channels != 3) {
+        error = "cannot encode " + std::to_string(image.channels) + "-channel images";
+        return false;
+    }
+    Api* jpeg = api.load(std::memory_order_acquire);
+
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wbe");
+    if (!file) {
+        error = "cannot create " + temporary + ": " + strerror(errno);
+        return false;
+    }
+
+    jpeg_compress_struct info{};
+    JpegError failure;
+    info.err = jpeg->std_error(&failure.manager);
+    failure.manager.error_exit = jpegErrorExit;
+    failure.manager.emit_message = jpegIgnoreMessage;
+    if (setjmp(failure.jump)) {
+        jpeg->destroy_compress(&info);
+        fclose(file);
+        remove(temporary.c_str());
+        error = path + ": " + failure.message;
+        return false;
+    }
+
+    jpeg->CreateCompress(&info, JPEG_LIB_VERSION, sizeof(info));
+    jpeg->stdio_dest(&info, file);
+    info.image_width = static_cast<JDIMENSION>(image.width);
+    info.image_height = static_cast<JDIMENSION>(image.height);
+    info.input_components = image.channels;
+    info.in_color_space = image.channels == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg->set_defaults(&info);
+    jpeg->set_quality(&info, quality, TRUE);
+    jpeg->start_compress(&info, TRUE);
+    while (info.next_scanline < info.image_height) {
+        JSAMPROW row = image.pixels.data() + info.next_scanline * image.stride();
+        jpeg->write_scanlines(&info, &row, 1);
+    }
+    jpeg->finish_compress(&info);
+    jpeg->destroy_compress(&info);
+
+    if (fclose(file) != 0 || rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "cannot write " + path + ": " + strerror(errno);
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
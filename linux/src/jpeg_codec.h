@@ -0,0 +1,69 @@
+#ifndef SINO_SCANNER_JPEG_CODEC_H
+#define SINO_SCANNER_JPEG_CODEC_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include "image_buffer_pool.h"
+
+/**
+ * JPEG Codec
+ *
+ * Decodes the JPEGs SaveImageEx writes and encodes the ones the app writes
+ * itself (image previews), through the system libjpeg. The library is
+ * opened with dlopen() on first use and its entry points resolved with
+ * dlsym(): libIDCard.so links its own copy, the same way it carries its own
+ * libpng (see PngWrapper), and the two must not be mixed.
+ *
+ * Decoded pixels live in ImageBufferPool buffers. Every call is safe from
+ * any thread; libjpeg errors come back as |error| strings, never exits.
+ */
+class JpegCodec {
+public:
+    enum class Layout {
+        Native,   // 1 sample per pixel for grayscale JPEGs, else RGB
+        Rgba,     // Always 4 samples, alpha opaque
+    };
+
+    // 8-bit samples, |channels| per pixel (1, 3 or 4), rows packed.
+    struct Image {
+        ImageBufferPool::Buffer pixels;
+        size_t width = 0;
+        size_t height = 0;
+        int channels = 0;
+
+        size_t stride() const { return width * channels; }
+    };
+
+    // Never destroyed, like ImageBufferPool.
+    static JpegCodec& getInstance();
+
+    // Loads libjpeg if it is not yet. False with |error| set if it cannot be.
+    bool load(std::string& error);
+
+    bool decode(const uint8_t* data, size_t size, Layout layout, Image& image, std::string& error);
+    bool decodeFile(const std::string& path, Layout layout, Image& image, std::string& error);
+
+    // Writes |image| (1 or 3 channels) to |path| through a temporary file
+    // renamed into place, so readers never see half a JPEG.
+    bool encodeFile(const Image& image, int quality, const std::string& path, std::string& error);
+
+private:
+    struct Api;
+
+    JpegCodec();
+
+    bool decodeStream(FILE* file, Layout layout, Image& image, std::string& error);
+
+    std::mutex loadMutex;
+    std::atomic<Api*> api;   // Set once by load(), then read-only
+
+    // Prevent copying
+    JpegCodec(const JpegCodec&) = delete;
+    JpegCodec& operator=(const JpegCodec&) = delete;
+};
+
+#endif //SINO_SCANNER_JPEG_CODEC_H
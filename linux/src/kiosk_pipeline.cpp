@@ -0,0 +1,255 @@
+#include "kiosk_pipeline.h"
+#include "logger.h"
+#include "scanner_executor.h"
+#include "sinosecu_wrapper.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t elapsedMicros(Clock::time_point from) {
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - from).count());
+}
+
+// OCR page value, falling back to the chip.
+std::string fieldValue(const ScanRecord& record, PassportField field) {
+    std::string_view value = record.ocr.has(field) ? record.ocr.value(field) : record.chip.value(field);
+    return std::string(value);
+}
+
+}
+
+KioskPipeline::KioskPipeline(ScannerExecutor& executor, SinosecuScanner& scanner, Sink sink)
+        : executor(executor),
+          scanner(scanner),
+          sink(std::move(sink)),
+          allocatedScans(0),
+          running(false),
+          armed(true),
+          nextSequence(1) {}
+
+KioskPipeline::~KioskPipeline() {
+    stop();
+}
+
+void KioskPipeline::start() {
+    start(Config());
+}
+
+void KioskPipeline::start(const Config& newConfig) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+
+    config = newConfig;
+    config.workers = std::max<size_t>(config.workers, 1);
+    config.maxInFlight = std::max<size_t>(config.maxInFlight, 1);
+    std::error_code error;
+    if (!config.imageDirectory.empty()) {
+        std::filesystem::create_directories(config.imageDirectory, error);
+    }
+    if (!config.archiveDirectory.empty()) {
+        std::filesystem::create_directories(config.archiveDirectory, error);
+    }
+
+    // A document already on the glass is scanned straight away.
+    armed = true;
+    running = true;
+    for (size_t i = 0; i < config.workers; i++) {
+        workers.emplace_back(&KioskPipeline::runWorker, this);
+    }
+    SINO_LOG_INFO("Kiosk mode started (%zu workers, %zu in flight)", config.workers, config.maxInFlight);
+}
+
+void KioskPipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    workCondition.notify_all();
+    poolCondition.notify_all();
+
+    // Workers finish every scan already handed to them before exiting.
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers.clear();
+    SINO_LOG_INFO("Kiosk mode stopped");
+}
+
+bool KioskPipeline::isRunning() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running;
+}
+
+KioskPipeline::Stats KioskPipeline::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats current = stats;
+    current.inFlight = allocatedScans - pool.size();
+    return current;
+}
+
+void KioskPipeline::onDetection(const DetectionEngine::Event& event) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        if (event.state == DetectionEngine::State::Empty || event.state == DetectionEngine::State::Removed) {
+            armed = true;
+            return;
+        }
+        if (event.state != DetectionEngine::State::Placed || !armed) {
+            return;
+        }
+        // One recognition per placement; the next needs the desk emptied.
+        armed = false;
+        stats.documents++;
+    }
+
+    if (!executor.post([this]() { recognize(); })) {
+        SINO_LOG_WARN("Kiosk: SDK thread is not running, document skipped");
+    }
+}
+
+std::unique_ptr<KioskScan> KioskPipeline::acquireScan() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (pool.empty() && allocatedScans >= config.maxInFlight && running) {
+        stats.backpressureWaits++;
+        poolCondition.wait(lock, [this]() { return !pool.empty() || !running; });
+    }
+    if (!running) {
+        return nullptr;
+    }
+    if (!pool.empty()) {
+        std::unique_ptr<KioskScan> scan = std::move(pool.back());
+        pool.pop_back();
+        return scan;
+    }
+    allocatedScans++;
+    return std::make_unique<KioskScan>();
+}
+
+void KioskPipeline::releaseScan(std::unique_ptr<KioskScan> scan) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pool.push_back(std::move(scan));
+    }
+    poolCondition.notify_one();
+}
+
+void KioskPipeline::recognize() {
+    std::unique_ptr<KioskScan> scan = acquireScan();
+    if (!scan) {
+        return;
+    }
+
+    const Clock::time_point start = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        scan->sequence = nextSequence++;
+    }
+    scan->record.reset();
+    scan->imageBase.clear();
+    scan->imagesSaved = false;
+    scan->archivePath.clear();
+
+    scanner.recognizeDocument(scan->record);
+
+    // The SDK keeps only the latest document's images, so they are copied
+    // out now, before the next recognition overwrites them.
+    if (scan->record.succeeded() && !config.imageDirectory.empty()) {
+        scan->imageBase = config.imageDirectory + "/kiosk_" + std::to_string(scan->sequence);
+        scan->imagesSaved = scanner.saveImages(scan->imageBase, config.imageTypes);
+    }
+    scan->sdkMicros = elapsedMicros(start);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!scan->record.succeeded()) {
+            stats.failed++;
+        }
+        if (!running) {
+            pool.push_back(std::move(scan));
+            return;
+        }
+        ready.push_back(std::move(scan));
+    }
+    workCondition.notify_one();
+}
+
+void KioskPipeline::runWorker() {
+    while (true) {
+        std::unique_ptr<KioskScan> scan;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workCondition.wait(lock, [this]() { return !running || !ready.empty(); });
+            if (ready.empty()) {
+                return;
+            }
+            scan = std::move(ready.front());
+            ready.pop_front();
+        }
+
+        const Clock::time_point start = Clock::now();
+        postProcess(*scan);
+        scan->postProcessMicros = elapsedMicros(start);
+
+        if (sink) {
+            sink(*scan);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.completed++;
+        }
+        releaseScan(std::move(scan));
+    }
+}
+
+void KioskPipeline::postProcess(KioskScan& scan) {
+    const ScanRecord& record = scan.record;
+    if (!record.succeeded()) {
+        scan.passportNumberValid = false;
+        scan.datesValid = false;
+        scan.mrzValid = false;
+        return;
+    }
+
+    // The validators are pure format checks and safe off the SDK thread.
+    scan.passportNumberValid = scanner.isValidPassportNumber(fieldValue(record, PassportField::PassportNumberMrz));
+    scan.datesValid = scanner.isValidDate(fieldValue(record, PassportField::DateOfBirth)) &&
+                      scanner.isValidDate(fieldValue(record, PassportField::DateOfExpiry));
+    scan.mrzValid = scanner.isValidMRZ(fieldValue(record, PassportField::MrzLine1)) &&
+                    scanner.isValidMRZ(fieldValue(record, PassportField::MrzLine2));
+
+    if (config.archiveDirectory.empty()) {
+        return;
+    }
+    std::string json;
+    json.reserve(4096);
+    record.toJson(json);
+
+    std::string path = config.archiveDirectory + "/kiosk_" + std::to_string(scan.sequence) + ".json";
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        SINO_LOG_WARN("Kiosk: cannot write %s", path.c_str());
+        return;
+    }
+    bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+    written = (fclose(file) == 0) && written;
+    if (written) {
+        scan.archivePath = std::move(path);
+    } else {
+        SINO_LOG_WARN("Kiosk: short write to %s", path.c_str());
+    }
+}
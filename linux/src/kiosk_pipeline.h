@@ -0,0 +1,130 @@
+#ifndef SINO_SCANNER_KIOSK_PIPELINE_H
+#define SINO_SCANNER_KIOSK_PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "detection_engine.h"
+#include "scan_record.h"
+
+class ScannerExecutor;
+class SinosecuScanner;
+
+/**
+ * Kiosk Scan
+ *
+ * One document moving through the kiosk pipeline. The SDK thread fills
+ * |record| and saves the images; a post-processing worker fills the rest.
+ * Scans are pooled by KioskPipeline and reused, so the record's strings and
+ * field arenas are only allocated for the first few documents.
+ */
+struct KioskScan {
+    uint64_t sequence = 0;
+    ScanRecord record;
+    std::string imageBase;     // SaveImageEx base path; empty when images are off
+    bool imagesSaved = false;
+    std::string archivePath;   // Record JSON written by the worker; empty when archiving is off
+
+    // Format checks on the OCR page (or chip, when OCR is missing)
+    bool passportNumberValid = false;
+    bool datesValid = false;
+    bool mrzValid = false;
+
+    int64_t sdkMicros = 0;           // Recognition and image copy-out on the SDK thread
+    int64_t postProcessMicros = 0;   // Validation, persistence and the sink, on a worker
+};
+
+/**
+ * Kiosk Pipeline
+ *
+ * Continuous scan mode for busy desks. scanDocumentComplete runs detection,
+ * recognition, field reads and (from Dart) a separate saveImages call back
+ * to back, and the desk cannot arm for the next document until all of it
+ * has finished. In kiosk mode the SDK thread only does what has to touch
+ * the SDK: it recognizes the placed document, copies the fields out into a
+ * pooled KioskScan and saves its images, then goes straight back to
+ * detection polling. Validation, persistence and serialization for the UI
+ * run on a small worker pool, overlapping the next document.
+ *
+ * The pipeline is driven by DetectionEngine events: a Placed event after
+ * the desk was seen empty (or the document removed) queues one recognition
+ * on the SDK thread. When every pooled scan is still being post-processed,
+ * the SDK thread waits for one to come back rather than dropping documents.
+ *
+ * The sink is called on a worker thread once a scan is fully processed; the
+ * scan returns to the pool when the sink returns.
+ */
+class KioskPipeline {
+public:
+    struct Config {
+        size_t workers = 2;
+        size_t maxInFlight = 4;         // Pooled scans; bounds memory and backlog
+        std::string imageDirectory;     // Images saved here per document; empty: no images
+        int imageTypes = 0x1F;
+        std::string archiveDirectory;   // Record JSON written here; empty: no archive
+    };
+
+    struct Stats {
+        uint64_t documents = 0;         // Recognitions started
+        uint64_t completed = 0;         // Sink calls
+        uint64_t failed = 0;            // Recognitions that found no usable document
+        uint64_t backpressureWaits = 0; // SDK thread waited for a free scan
+        size_t inFlight = 0;
+    };
+
+    using Sink = std::function<void(const KioskScan&)>;
+
+    KioskPipeline(ScannerExecutor& executor, SinosecuScanner& scanner, Sink sink);
+    ~KioskPipeline();
+
+    // Start the workers. Calling start() while running is a no-op.
+    void start();
+    void start(const Config& config);
+
+    // Stop accepting documents, let in-flight scans finish and join the workers.
+    void stop();
+    bool isRunning() const;
+
+    // Feed every DetectionEngine event here (engine thread).
+    void onDetection(const DetectionEngine::Event& event);
+
+    Stats getStats() const;
+
+private:
+    void recognize();                 // SDK thread
+    void runWorker();
+    void postProcess(KioskScan& scan);
+    std::unique_ptr<KioskScan> acquireScan();
+    void releaseScan(std::unique_ptr<KioskScan> scan);
+
+    ScannerExecutor& executor;
+    SinosecuScanner& scanner;
+    Sink sink;
+    Config config;
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable workCondition;   // Workers: a scan is ready
+    std::condition_variable poolCondition;   // SDK thread: a scan came back
+    std::deque<std::unique_ptr<KioskScan>> ready;
+    std::vector<std::unique_ptr<KioskScan>> pool;
+    size_t allocatedScans;
+    bool running;
+    bool armed;       // The desk was empty since the last recognition
+    uint64_t nextSequence;
+    Stats stats;
+
+    // Prevent copying
+    KioskPipeline(const KioskPipeline&) = delete;
+    KioskPipeline& operator=(const KioskPipeline&) = delete;
+};
+
+#endif //SINO_SCANNER_KIOSK_PIPELINE_H
@@ -0,0 +1,331 @@
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct Logger::Record {
+    int64_t timestampNs;   // system_clock
+    uint16_t length;
+    LogLevel level;
+    char text[kRecordBytes - sizeof(int64_t) - sizeof(uint16_t) - sizeof(LogLevel)];
+};
+
+static_assert((Logger::kRingRecords & (Logger::kRingRecords - 1)) == 0, "kRingRecords must be a power of two");
+
+// Single producer (the owning thread), single consumer (the drain thread).
+struct Logger::Ring {
+    alignas(64) std::atomic<uint32_t> head{0};
+    alignas(64) std::atomic<uint32_t> tail{0};
+    alignas(64) std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> closed{false};   // Owning thread has exited
+    uint32_t threadId = 0;
+    std::unique_ptr<Record[]> records;
+};
+
+Logger::Logger()
+        : running(false),
+          runtimeLevel(static_cast<int>(LogLevel::Trace)),
+          drainRequested(false),
+          stopRequested(false),
+          file(nullptr),
+          fileBytes(0),
+          reportedDrops(0),
+          retiredDrops(0) {}
+
+Logger::~Logger() {
+    stop();
+}
+
+Logger& Logger::getInstance() {
+    static Logger instance;
+    return instance;
+}
+
+const char* Logger::levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Trace: return "TRACE";
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO ";
+        case LogLevel::Warn: return "WARN ";
+        case LogLevel::Error: return "ERROR";
+        default: return "?    ";
+    }
+}
+
+std::string Logger::defaultPath() {
+    const char* state = std::getenv("XDG_STATE_HOME");
+    if (state && *state) {
+        return std::string(state) + "/sino_scanner/scanner.log";
+    }
+    const char* home = std::getenv("HOME");
+    if (home && *home) {
+        return std::string(home) + "/.local/state/sino_scanner/scanner.log";
+    }
+    return "/tmp/sino_scanner/scanner.log";
+}
+
+Logger::Ring* Logger::ringForCurrentThread() {
+    // Marks the ring closed when the thread exits; the drain thread frees it
+    // once it is empty.
+    struct Handle {
+        std::shared_ptr<Ring> ring;
+        ~Handle() {
+            if (ring) {
+                ring->closed.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Handle handle;
+
+    if (!handle.ring) {
+        auto ring = std::make_shared<Ring>();
+        ring->records = std::make_unique<Record[]>(kRingRecords);
+        ring->threadId = static_cast<uint32_t>(syscall(SYS_gettid));
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(ring);
+        handle.ring = std::move(ring);
+    }
+    return handle.ring.get();
+}
+
+void Logger::write(LogLevel level, const char* format, ...) {
+    Logger& logger = getInstance();
+    if (static_cast<int>(level) < logger.runtimeLevel.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    Ring* ring = logger.ringForCurrentThread();
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    uint32_t used = head - ring->tail.load(std::memory_order_acquire);
+    if (used >= kRingRecords) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& record = ring->records[head & (kRingRecords - 1)];
+    record.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    record.level = level;
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(record.text, sizeof(record.text), format, args);
+    va_end(args);
+    record.length = static_cast<uint16_t>(std::clamp<int>(length, 0, sizeof(record.text) - 1));
+
+    ring->head.store(head + 1, std::memory_order_release);
+
+    if (used == kRingRecords / 2) {
+        // Burst in progress: wake the drain thread early instead of letting
+        // the ring fill while it sleeps.
+        logger.drainRequested.store(true, std::memory_order_relaxed);
+        logger.stateCondition.notify_one();
+    }
+}
+
+void Logger::start() {
+    start(Config());
+}
+
+void Logger::start(const Config& newConfig) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (running) {
+        return;
+    }
+
+    config = newConfig;
+    if (config.path.empty()) {
+        config.path = defaultPath();
+    }
+    config.maxFiles = std::max(config.maxFiles, 1);
+    runtimeLevel = static_cast<int>(std::min(config.fileLevel, config.consoleLevel));
+    line.reserve(kRecordBytes + 64);
+    openFile();
+
+    stopRequested = false;
+    running = true;
+    drainThread = std::thread(&Logger::run, this);
+}
+
+void Logger::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!running) {
+            return;
+        }
+        stopRequested = true;
+    }
+    stateCondition.notify_all();
+
+    if (drainThread.joinable()) {
+        drainThread.join();
+    }
+    running = false;
+}
+
+uint64_t Logger::droppedRecords() const {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    uint64_t total = retiredDrops;
+    for (const auto& ring : rings) {
+        total += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Logger::run() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (!stopRequested) {
+        lock.unlock();
+        bool wrote = drainOnce();
+        lock.lock();
+        if (!wrote) {
+            stateCondition.wait_for(lock, std::chrono::milliseconds(50), [this]() {
+                return stopRequested || drainRequested.load(std::memory_order_relaxed);
+            });
+            drainRequested.store(false, std::memory_order_relaxed);
+        }
+    }
+    lock.unlock();
+
+    // Final drain: everything queued before stop() is written.
+    while (drainOnce()) {
+    }
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool Logger::drainOnce() {
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        drainList.assign(rings.begin(), rings.end());
+    }
+
+    bool wrote = false;
+    bool retire = false;
+    uint64_t dropped = 0;
+    for (const auto& ring : drainList) {
+        bool closed = ring->closed.load(std::memory_order_acquire);
+        uint32_t head = ring->head.load(std::memory_order_acquire);
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        while (tail != head) {
+            emit(ring->records[tail & (kRingRecords - 1)], ring->threadId);
+            tail++;
+            wrote = true;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+        retire = retire || closed;
+    }
+    drainList.clear();
+
+    if (retire) {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        // partition, not remove_if: the retired rings are still read below.
+        auto finished = std::partition(rings.begin(), rings.end(), [](const std::shared_ptr<Ring>& ring) {
+            return !ring->closed.load(std::memory_order_acquire) ||
+                   ring->head.load(std::memory_order_acquire) != ring->tail.load(std::memory_order_relaxed);
+        });
+        for (auto it = finished; it != rings.end(); ++it) {
+            uint64_t ringDrops = (*it)->dropped.load(std::memory_order_relaxed);
+            retiredDrops += ringDrops;
+            dropped -= ringDrops;   // Counted above while the ring was live
+        }
+        rings.erase(finished, rings.end());
+    }
+
+    dropped += retiredDrops;
+    if (dropped > reportedDrops) {
+        Record notice{};
+        notice.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        notice.level = LogLevel::Warn;
+        int length = snprintf(notice.text, sizeof(notice.text), "Logger: dropped %llu records (ring full)",
+                              static_cast<unsigned long long>(dropped - reportedDrops));
+        notice.length = static_cast<uint16_t>(std::clamp<int>(length, 0, sizeof(notice.text) - 1));
+        emit(notice, static_cast<uint32_t>(syscall(SYS_gettid)));
+        reportedDrops = dropped;
+        wrote = true;
+    }
+
+    if (wrote) {
+        if (file) fflush(file);
+        fflush(stderr);
+    }
+    return wrote;
+}
+
+void Logger::emit(const Record& record, uint32_t threadId) {
+    bool toFile = file && record.level >= config.fileLevel;
+    bool toConsole = record.level >= config.consoleLevel;
+    if (!toFile && !toConsole) {
+        return;
+    }
+
+    time_t seconds = static_cast<time_t>(record.timestampNs / 1000000000);
+    int millis = static_cast<int>((record.timestampNs / 1000000) % 1000);
+    struct tm local{};
+    localtime_r(&seconds, &local);
+
+    char prefix[64];
+    int prefixLength = snprintf(prefix, sizeof(prefix), "%04d-%02d-%02d %02d:%02d:%02d.%03d %s [%u] ",
+                                local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+                                local.tm_hour, local.tm_min, local.tm_sec, millis,
+                                levelName(record.level), threadId);
+    prefixLength = std::clamp<int>(prefixLength, 0, sizeof(prefix) - 1);
+
+    line.assign(prefix, prefix + prefixLength);
+    line.insert(line.end(), record.text, record.text + record.length);
+    line.push_back('\n');
+
+    if (toFile) {
+        fwrite(line.data(), 1, line.size(), file);
+        fileBytes += line.size();
+        if (fileBytes >= config.maxFileBytes) {
+            rotate();
+        }
+    }
+    if (toConsole) {
+        fwrite(line.data(), 1, line.size(), stderr);
+    }
+}
+
+void Logger::openFile() {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(config.path).parent_path(), error);
+
+    file = fopen(config.path.c_str(), "a");
+    if (!file) {
+        fprintf(stderr, "Logger: cannot open %s, logging to stderr only\n", config.path.c_str());
+        fileBytes = 0;
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fileBytes = size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+void Logger::rotate() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+
+    std::error_code error;
+    for (int i = config.maxFiles - 1; i >= 1; i--) {
+        std::string from = (i == 1) ? config.path : config.path + "." + std::to_string(i - 1);
+        std::string to = config.path + "." + std::to_string(i);
+        std::filesystem::rename(from, to, error);
+    }
+    if (config.maxFiles == 1) {
+        std::filesystem::remove(config.path, error);
+    }
+
+    openFile();
+}
@@ -0,0 +1,139 @@
+#ifndef SINO_SCANNER_LOGGER_H
+#define SINO_SCANNER_LOGGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class LogLevel : uint8_t {
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off
+};
+
+// Lowest level compiled in. Anything below it is discarded at compile time,
+// arguments included. Override with -DSINO_LOG_MIN_LEVEL=<0..5>.
+#ifndef SINO_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define SINO_LOG_MIN_LEVEL 2 // Info
+#else
+#define SINO_LOG_MIN_LEVEL 0 // Trace
+#endif
+#endif
+
+#define SINO_LOG(level, ...)                                                   \
+    do {                                                                       \
+        if constexpr (static_cast<int>(level) >= SINO_LOG_MIN_LEVEL) {         \
+            Logger::write(level, __VA_ARGS__);                                 \
+        }                                                                      \
+    } while (0)
+
+#define SINO_LOG_TRACE(...) SINO_LOG(LogLevel::Trace, __VA_ARGS__)
+#define SINO_LOG_DEBUG(...) SINO_LOG(LogLevel::Debug, __VA_ARGS__)
+#define SINO_LOG_INFO(...) SINO_LOG(LogLevel::Info, __VA_ARGS__)
+#define SINO_LOG_WARN(...) SINO_LOG(LogLevel::Warn, __VA_ARGS__)
+#define SINO_LOG_ERROR(...) SINO_LOG(LogLevel::Error, __VA_ARGS__)
+
+/**
+ * Logger
+ *
+ * Asynchronous logger for the scan path. Each thread that logs gets its own
+ * single-producer ring of fixed-size records; write() formats the message
+ * straight into the next free slot and returns. It never takes a lock, never
+ * allocates after the thread's first message, and never touches a file or
+ * terminal. When a ring is full the record is dropped and counted.
+ *
+ * A background drain thread empties the rings into a rotating log file and
+ * echoes records at or above consoleLevel to stderr. Messages logged before
+ * start() are kept in the rings and written once it runs.
+ *
+ * Use the SINO_LOG_* macros rather than write() so that levels below
+ * SINO_LOG_MIN_LEVEL compile to nothing.
+ */
+class Logger {
+public:
+    struct Config {
+        std::string path;                     // Empty: defaultPath()
+        size_t maxFileBytes = 4 * 1024 * 1024;
+        int maxFiles = 3;                     // scanner.log plus .1 .. .(maxFiles-1)
+        LogLevel fileLevel = LogLevel::Trace;
+#ifdef NDEBUG
+        LogLevel consoleLevel = LogLevel::Warn;
+#else
+        LogLevel consoleLevel = LogLevel::Info;
+#endif
+    };
+
+    static constexpr size_t kRecordBytes = 256;
+    static constexpr size_t kRingRecords = 512;   // Per thread; must be a power of two
+
+    static Logger& getInstance();
+
+    // printf-style. Messages longer than a record are truncated.
+    static void write(LogLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Start the drain thread. Calling start() on a running logger is a no-op.
+    void start();
+    void start(const Config& config);
+
+    // Drain every ring, flush and close the file, and join the drain thread.
+    void stop();
+
+    bool isRunning() const { return running.load(); }
+    uint64_t droppedRecords() const;
+
+    // $XDG_STATE_HOME/sino_scanner/scanner.log, falling back to
+    // ~/.local/state/sino_scanner/scanner.log.
+    static std::string defaultPath();
+    static const char* levelName(LogLevel level);
+
+    ~Logger();
+
+private:
+    struct Record;
+    struct Ring;
+
+    Logger();
+
+    Ring* ringForCurrentThread();
+    void run();
+    bool drainOnce();
+    void emit(const Record& record, uint32_t threadId);
+    void openFile();
+    void rotate();
+
+    mutable std::mutex ringsMutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::vector<std::shared_ptr<Ring>> drainList;   // Drain thread only; reused each pass
+
+    std::thread drainThread;
+    std::mutex stateMutex;
+    std::condition_variable stateCondition;
+    std::atomic<bool> running;
+    std::atomic<int> runtimeLevel;   // min(fileLevel, consoleLevel); checked before formatting
+    std::atomic<bool> drainRequested;  // Set by a writer whose ring is half full
+    bool stopRequested;
+
+    Config config;
+    FILE* file;
+    size_t fileBytes;
+    uint64_t reportedDrops;
+    uint64_t retiredDrops;   // Drops counted in rings whose thread has exited
+    std::vector<char> line;
+
+    // Prevent copying
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+};
+
+#endif //SINO_SCANNER_LOGGER_H
@@ -0,0 +1,550 @@
+#include "pixel_kernels.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SINO_PIXELS_X86 1
+#define SINO_PIXELS_TARGET(isa) __attribute__((target(isa)))
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SINO_PIXELS_NEON 1
+#endif
+
+namespace {
+
+// round(product / 255) for product <= 255 * 255, without a divide. The SIMD
+// versions take the same steps on 16-bit lanes, so they agree exactly.
+inline uint8_t divide255(unsigned product) {
+    product += 128;
+    return static_cast<uint8_t>((product + (product >> 8)) >> 8);
+}
+
+// downscaleBox, per output row. The vertical pass adds each of |factor|
+// input rows into a row of column sums, sums[i] += row[i]; the horizontal
+// pass then averages |factor| neighbouring pixels of those sums.
+using AccumulateRow = void (*)(const uint8_t* row, uint16_t* sums, size_t count);
+using CollapseRow = void (*)(const uint16_t* sums, size_t outWidth, int channels, int factor, uint8_t* out);
+
+void accumulateRowScalar(const uint8_t* row, uint16_t* sums, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        sums[i] += row[i];
+    }
+}
+
+// The horizontal passes are classes templated on the factor and channel
+// count, so their loops unroll and their strides are constants.
+template<int Factor, int Channels>
+struct CollapseScalar {
+    static void run(const uint16_t* sums, size_t outWidth, uint8_t* out) {
+        constexpr int shift = Factor == 2 ? 2 : 4;   // log2(Factor * Factor)
+        constexpr unsigned half = 1u << (shift - 1);
+        for (size_t x = 0; x < outWidth; x++, sums += Factor * Channels, out += Channels) {
+            for (int c = 0; c < Channels; c++) {
+                unsigned sum = 0;
+                for (int i = 0; i < Factor; i++) {
+                    sum += sums[i * Channels + c];
+                }
+                out[c] = static_cast<uint8_t>((sum + half) >> shift);
+            }
+        }
+    }
+};
+
+template<template<int, int> class Collapse>
+void collapseRowFor(const uint16_t* sums, size_t outWidth, int channels, int factor, uint8_t* out) {
+    switch (factor * 8 + channels) {
+        case 17: Collapse<2, 1>::run(sums, outWidth, out); break;
+        case 18: Collapse<2, 2>::run(sums, outWidth, out); break;
+        case 19: Collapse<2, 3>::run(sums, outWidth, out); break;
+        case 20: Collapse<2, 4>::run(sums, outWidth, out); break;
+        case 33: Collapse<4, 1>::run(sums, outWidth, out); break;
+        case 34: Collapse<4, 2>::run(sums, outWidth, out); break;
+        case 35: Collapse<4, 3>::run(sums, outWidth, out); break;
+        case 36: Collapse<4, 4>::run(sums, outWidth, out); break;
+        default: break;
+    }
+}
+
+void collapseRowScalar(const uint16_t* sums, size_t outWidth, int channels, int factor, uint8_t* out) {
+    collapseRowFor<CollapseScalar>(sums, outWidth, channels, factor, out);
+}
+
+// The SIMD horizontal passes add |Factor| copies of the sums, each offset
+// by one more pixel, so every lane holds the total of the block starting
+// there. The lanes that start a block are then picked out with a shuffle:
+// the first |Channels| of every Factor * Channels, as many whole blocks as
+// fit in sixteen lanes. Each step stores eight bytes; any past the blocks
+// it completed are rewritten by the next step.
+template<int Factor, int Channels>
+struct CollapseShape {
+    static constexpr size_t period = Factor * Channels;
+    static constexpr size_t blocks = 16 / period;                 // Output pixels per step
+    static constexpr size_t reach = (Factor - 1) * Channels + 16;  // Sums read per step
+
+    // Output pixels the SIMD steps cover before the scalar tail.
+    static size_t covered(size_t outWidth) {
+        if (outWidth * Channels < 8 || outWidth * period < reach) {
+            return 0;
+        }
+        // The last step may start at |last|: its store and reads both fit.
+        size_t last = std::min((outWidth * Channels - 8) / Channels, (outWidth * period - reach) / period);
+        return (last / blocks + 1) * blocks;
+    }
+
+    static void picks(int8_t (&lanes)[16]) {
+        for (int j = 0; j < 16; j++) {
+            lanes[j] = -1;
+        }
+        for (size_t block = 0; block < blocks; block++) {
+            for (int c = 0; c < Channels; c++) {
+                lanes[block * Channels + c] = static_cast<int8_t>(block * period + c);
+            }
+        }
+    }
+};
+
+bool downscale(AccumulateRow accumulate, CollapseRow collapse, const uint8_t* in, size_t width, size_t height,
+               size_t inStride, int channels, int factor, uint8_t* out, size_t outStride) {
+    if ((factor != 2 && factor != 4) || channels < 1 || channels > 4) {
+        return false;
+    }
+    size_t outWidth = width / factor;
+    size_t outHeight = height / factor;
+    size_t samples = outWidth * factor * channels;   // Per input row, leftover columns dropped
+    if (samples == 0) {
+        return true;
+    }
+
+    // 16 rows of 255 still fit a uint16_t. Reused by every call on this thread.
+    static thread_local std::vector<uint16_t> sums;
+    if (sums.size() < samples) {
+        sums.resize(samples);
+    }
+    for (size_t y = 0; y < outHeight; y++) {
+        std::memset(sums.data(), 0, samples * sizeof(uint16_t));
+        const uint8_t* row = in + y * factor * inStride;
+        for (int r = 0; r < factor; r++) {
+            accumulate(row + r * inStride, sums.data(), samples);
+        }
+        collapse(sums.data(), outWidth, channels, factor, out + y * outStride);
+    }
+    return true;
+}
+
+struct Kernels {
+    const char* isa;
+    void (*grayToRgba)(const uint8_t*, uint8_t*, size_t);
+    void (*swapRedBlue)(const uint8_t*, uint8_t*, size_t);
+    void (*premultiplyAlpha)(uint8_t*, size_t);
+    void (*extractChannel)(const uint8_t*, size_t, int, int, uint8_t*);
+    AccumulateRow accumulateRow;
+    CollapseRow collapseRow;
+};
+
+// ================================
+// SSE4.1 AND AVX2
+// ================================
+
+#if defined(SINO_PIXELS_X86)
+
+SINO_PIXELS_TARGET("sse4.1")
+void grayToRgbaSse4(const uint8_t* gray, uint8_t* rgba, size_t pixels) {
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    const __m128i spread0 = _mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1);
+    const __m128i spread1 = _mm_setr_epi8(4, 4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1);
+    const __m128i spread2 = _mm_setr_epi8(8, 8, 8, -1, 9, 9, 9, -1, 10, 10, 10, -1, 11, 11, 11, -1);
+    const __m128i spread3 = _mm_setr_epi8(12, 12, 12, -1, 13, 13, 13, -1, 14, 14, 14, -1, 15, 15, 15, -1);
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        // Loaded before anything is stored, for the in-place expansion.
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + i));
+        __m128i* out = reinterpret_cast<__m128i*>(rgba + i * 4);
+        _mm_storeu_si128(out, _mm_or_si128(_mm_shuffle_epi8(g, spread0), alpha));
+        _mm_storeu_si128(out + 1, _mm_or_si128(_mm_shuffle_epi8(g, spread1), alpha));
+        _mm_storeu_si128(out + 2, _mm_or_si128(_mm_shuffle_epi8(g, spread2), alpha));
+        _mm_storeu_si128(out + 3, _mm_or_si128(_mm_shuffle_epi8(g, spread3), alpha));
+    }
+    grayToRgbaScalar(gray + i, rgba + i * 4, pixels - i);
+}
+
+SINO_PIXELS_TARGET("sse4.1")
+void swapRedBlueSse4(const uint8_t* in, uint8_t* out, size_t pixels) {
+    // Five pixels per 16-byte load; the sixteenth byte goes back unchanged
+    // and is redone as the first byte of the next block.
+    const __m128i swap = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 6 <= pixels; i += 5) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 3), _mm_shuffle_epi8(block, swap));
+    }
+    swapRedBlueScalar(in + i * 3, out + i * 3, pixels - i);
+}
+
+// Eight 16-bit samples (two RGBA pixels) times their pixel's alpha, / 255.
+SINO_PIXELS_TARGET("sse4.1")
+inline __m128i premultiplyLanes(__m128i samples) {
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(samples, 0xFF), 0xFF);
+    __m128i product = _mm_add_epi16(_mm_mullo_epi16(samples, alpha), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+}
+
+SINO_PIXELS_TARGET("sse4.1")
+void premultiplyAlphaSse4(uint8_t* rgba, size_t pixels) {
+    const __m128i alphaBytes = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i* block = reinterpret_cast<__m128i*>(rgba + i * 4);
+        __m128i original = _mm_loadu_si128(block);
+        __m128i low = premultiplyLanes(_mm_cvtepu8_epi16(original));
+        __m128i high = premultiplyLanes(_mm_cvtepu8_epi16(_mm_srli_si128(original, 8)));
+        // Alpha itself stays as it was.
+        _mm_storeu_si128(block, _mm_blendv_epi8(_mm_packus_epi16(low, high), original, alphaBytes));
+    }
+    premultiplyAlphaScalar(rgba + i * 4, pixels - i);
+}
+
+SINO_PIXELS_TARGET("sse4.1")
+void extractChannelSse4(const uint8_t* in, size_t pixels, int channels, int channel, uint8_t* out) {
+    size_t i = 0;
+    if (channels > 1 && channels <= 4) {
+        // Sixteen pixels span |channels| loads; mask k picks the samples
+        // that fall in load k and zeroes the rest.
+        __m128i masks[4];
+        for (int k = 0; k < channels; k++) {
+            alignas(16) int8_t picks[16];
+            for (int j = 0; j < 16; j++) {
+                int source = j * channels + channel - 16 * k;
+                picks[j] = source >= 0 && source < 16 ? static_cast<int8_t>(source) : -1;
+            }
+            masks[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(picks));
+        }
+        for (; i + 16 <= pixels; i += 16) {
+            const uint8_t* block = in + i * channels;
+            __m128i plane = _mm_setzero_si128();
+            for (int k = 0; k < channels; k++) {
+                __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + k * 16));
+                plane = _mm_or_si128(plane, _mm_shuffle_epi8(samples, masks[k]));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), plane);
+        }
+    }
+    extractChannelScalar(in + i * channels, pixels - i, channels, channel, out + i);
+}
+
+SINO_PIXELS_TARGET("sse4.1")
+void accumulateRowSse4(const uint8_t* row, uint16_t* sums, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i* total = reinterpret_cast<__m128i*>(sums + i);
+        _mm_storeu_si128(total, _mm_add_epi16(_mm_loadu_si128(total), _mm_cvtepu8_epi16(samples)));
+        _mm_storeu_si128(total + 1, _mm_add_epi16(_mm_loadu_si128(total + 1),
+                                                  _mm_cvtepu8_epi16(_mm_srli_si128(samples, 8))));
+    }
+    accumulateRowScalar(row + i, sums + i, count - i);
+}
+
+template<int Factor, int Channels>
+struct CollapseSse4 {
+    using Shape = CollapseShape<Factor, Channels>;
+
+    SINO_PIXELS_TARGET("sse4.1")
+    static void run(const uint16_t* sums, size_t outWidth, uint8_t* out) {
+        alignas(16) int8_t lanes[16];
+        Shape::picks(lanes);
+        const __m128i pick = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+        const __m128i half = _mm_set1_epi16(Factor == 2 ? 2 : 8);
+        size_t covered = Shape::covered(outWidth);
+        for (size_t x = 0; x < covered; x += Shape::blocks) {
+            const uint16_t* block = sums + x * Shape::period;
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 8));
+            for (int k = 1; k < Factor; k++) {
+                low = _mm_add_epi16(low, _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + k * Channels)));
+                high = _mm_add_epi16(high,
+                                     _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + k * Channels + 8)));
+            }
+            low = _mm_srli_epi16(_mm_add_epi16(low, half), Factor == 2 ? 2 : 4);
+            high = _mm_srli_epi16(_mm_add_epi16(high, half), Factor == 2 ? 2 : 4);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * Channels),
+                             _mm_shuffle_epi8(_mm_packus_epi16(low, high), pick));
+        }
+        CollapseScalar<Factor, Channels>::run(sums + covered * Shape::period, outWidth - covered,
+                                              out + covered * Channels);
+    }
+};
+
+void collapseRowSse4(const uint16_t* sums, size_t outWidth, int channels, int factor, uint8_t* out) {
+    collapseRowFor<CollapseSse4>(sums, outWidth, channels, factor, out);
+}
+
+SINO_PIXELS_TARGET("avx2")
+void grayToRgbaAvx2(const uint8_t* gray, uint8_t* rgba, size_t pixels) {
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m256i low = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(gray + i)));
+        __m256i high = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(gray + i + 8)));
+        low = _mm256_or_si256(low, _mm256_slli_epi32(low, 8));
+        high = _mm256_or_si256(high, _mm256_slli_epi32(high, 8));
+        low = _mm256_or_si256(_mm256_or_si256(low, _mm256_slli_epi32(low, 16)), alpha);
+        high = _mm256_or_si256(_mm256_or_si256(high, _mm256_slli_epi32(high, 16)), alpha);
+        __m256i* out = reinterpret_cast<__m256i*>(rgba + i * 4);
+        _mm256_storeu_si256(out, low);
+        _mm256_storeu_si256(out + 1, high);
+    }
+    grayToRgbaScalar(gray + i, rgba + i * 4, pixels - i);
+}
+
+SINO_PIXELS_TARGET("avx2")
+inline __m256i premultiplyLanesAvx2(__m256i samples) {
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(samples, 0xFF), 0xFF);
+    __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(samples, alpha), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+}
+
+SINO_PIXELS_TARGET("avx2")
+void premultiplyAlphaAvx2(uint8_t* rgba, size_t pixels) {
+    const __m256i alphaBytes = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m256i* block = reinterpret_cast<__m256i*>(rgba + i * 4);
+        __m256i original = _mm256_loadu_si256(block);
+        __m256i low = premultiplyLanesAvx2(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(original)));
+        __m256i high = premultiplyLanesAvx2(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(original, 1)));
+        // The pack works per 128-bit lane; put the pixels back in order.
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+        _mm256_storeu_si256(block, _mm256_blendv_epi8(packed, original, alphaBytes));
+    }
+    premultiplyAlphaScalar(rgba + i * 4, pixels - i);
+}
+
+SINO_PIXELS_TARGET("avx2")
+void accumulateRowAvx2(const uint8_t* row, uint16_t* sums, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i low = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i)));
+        __m256i high = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i + 16)));
+        __m256i* total = reinterpret_cast<__m256i*>(sums + i);
+        _mm256_storeu_si256(total, _mm256_add_epi16(_mm256_loadu_si256(total), low));
+        _mm256_storeu_si256(total + 1, _mm256_add_epi16(_mm256_loadu_si256(total + 1), high));
+    }
+    accumulateRowScalar(row + i, sums + i, count - i);
+}
+
+#endif
+
+// ================================
+// NEON
+// ================================
+
+#if defined(SINO_PIXELS_NEON)
+
+void grayToRgbaNeon(const uint8_t* gray, uint8_t* rgba, size_t pixels) {
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16_t g = vld1q_u8(gray + i);
+        uint8x16x4_t expanded = {{g, g, g, vdupq_n_u8(0xFF)}};
+        vst4q_u8(rgba + i * 4, expanded);
+    }
+    grayToRgbaScalar(gray + i, rgba + i * 4, pixels - i);
+}
+
+void swapRedBlueNeon(const uint8_t* in, uint8_t* out, size_t pixels) {
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x3_t planes = vld3q_u8(in + i * 3);
+        uint8x16_t red = planes.val[0];
+        planes.val[0] = planes.val[2];
+        planes.val[2] = red;
+        vst3q_u8(out + i * 3, planes);
+    }
+    swapRedBlueScalar(in + i * 3, out + i * 3, pixels - i);
+}
+
+// divide255(value * alpha) on sixteen lanes: vrsra adds (p + 128) >> 8 to
+// p, and vrshrn adds the other 128 before its shift.
+inline uint8x16_t premultiplyPlane(uint8x16_t value, uint8x16_t alpha) {
+    uint16x8_t low = vmull_u8(vget_low_u8(value), vget_low_u8(alpha));
+    uint16x8_t high = vmull_high_u8(value, alpha);
+    return vcombine_u8(vrshrn_n_u16(vrsraq_n_u16(low, low, 8), 8), vrshrn_n_u16(vrsraq_n_u16(high, high, 8), 8));
+}
+
+void premultiplyAlphaNeon(uint8_t* rgba, size_t pixels) {
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x4_t planes = vld4q_u8(rgba + i * 4);
+        planes.val[0] = premultiplyPlane(planes.val[0], planes.val[3]);
+        planes.val[1] = premultiplyPlane(planes.val[1], planes.val[3]);
+        planes.val[2] = premultiplyPlane(planes.val[2], planes.val[3]);
+        vst4q_u8(rgba + i * 4, planes);
+    }
+    premultiplyAlphaScalar(rgba + i * 4, pixels - i);
+}
+
+void extractChannelNeon(const uint8_t* in, size_t pixels, int channels, int channel, uint8_t* out) {
+    size_t i = 0;
+    switch (channels) {
+        case 1:
+            for (; i + 16 <= pixels; i += 16) vst1q_u8(out + i, vld1q_u8(in + i));
+            break;
+        case 2:
+            for (; i + 16 <= pixels; i += 16) vst1q_u8(out + i, vld2q_u8(in + i * 2).val[channel]);
+            break;
+        case 3:
+            for (; i + 16 <= pixels; i += 16) vst1q_u8(out + i, vld3q_u8(in + i * 3).val[channel]);
+            break;
+        case 4:
+            for (; i + 16 <= pixels; i += 16) vst1q_u8(out + i, vld4q_u8(in + i * 4).val[channel]);
+            break;
+        default:
+            break;
+    }
+    extractChannelScalar(in + i * channels, pixels - i, channels, channel, out + i);
+}
+
+void accumulateRowNeon(const uint8_t* row, uint16_t* sums, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t samples = vld1q_u8(row + i);
+        vst1q_u16(sums + i, vaddw_u8(vld1q_u16(sums + i), vget_low_u8(samples)));
+        vst1q_u16(sums + i + 8, vaddw_high_u8(vld1q_u16(sums + i + 8), samples));
+    }
+    accumulateRowScalar(row + i, sums + i, count - i);
+}
+
+template<int Factor, int Channels>
+struct CollapseNeon {
+    using Shape = CollapseShape<Factor, Channels>;
+
+    static void run(const uint16_t* sums, size_t outWidth, uint8_t* out) {
+        int8_t lanes[16];
+        Shape::picks(lanes);
+        const uint8x16_t pick = vreinterpretq_u8_s8(vld1q_s8(lanes));
+        size_t covered = Shape::covered(outWidth);
+        for (size_t x = 0; x < covered; x += Shape::blocks) {
+            const uint16_t* block = sums + x * Shape::period;
+            uint16x8_t low = vld1q_u16(block);
+            uint16x8_t high = vld1q_u16(block + 8);
+            for (int k = 1; k < Factor; k++) {
+                low = vaddq_u16(low, vld1q_u16(block + k * Channels));
+                high = vaddq_u16(high, vld1q_u16(block + k * Channels + 8));
+            }
+            // vrshrn rounds as (sum + half) >> shift does.
+            uint8x16_t averages = vcombine_u8(vrshrn_n_u16(low, Factor == 2 ? 2 : 4),
+                                              vrshrn_n_u16(high, Factor == 2 ? 2 : 4));
+            vst1_u8(out + x * Channels, vget_low_u8(vqtbl1q_u8(averages, pick)));
+        }
+        CollapseScalar<Factor, Channels>::run(sums + covered * Shape::period, outWidth - covered,
+                                              out + covered * Channels);
+    }
+};
+
+void collapseRowNeon(const uint16_t* sums, size_t outWidth, int channels, int factor, uint8_t* out) {
+    collapseRowFor<CollapseNeon>(sums, outWidth, channels, factor, out);
+}
+
+#endif
+
+Kernels selectKernels() {
+#if defined(SINO_PIXELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        // Swaps and extraction are shuffle-bound; 256-bit shuffles stay
+        // within their lanes, so the SSE4.1 versions are used for those.
+        return {"avx2", grayToRgbaAvx2, swapRedBlueSse4, premultiplyAlphaAvx2, extractChannelSse4,
+                accumulateRowAvx2, collapseRowSse4};
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return {"sse4.1", grayToRgbaSse4, swapRedBlueSse4, premultiplyAlphaSse4, extractChannelSse4,
+                accumulateRowSse4, collapseRowSse4};
+    }
+#elif defined(SINO_PIXELS_NEON)
+    return {"neon", grayToRgbaNeon, swapRedBlueNeon, premultiplyAlphaNeon, extractChannelNeon, accumulateRowNeon,
+            collapseRowNeon};
+#endif
+    return {"scalar", grayToRgbaScalar, swapRedBlueScalar, premultiplyAlphaScalar, extractChannelScalar,
+            accumulateRowScalar, collapseRowScalar};
+}
+
+const Kernels& kernels() {
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+}
+
+const char* pixelKernelIsa() {
+    return kernels().isa;
+}
+
+void grayToRgba(const uint8_t* gray, uint8_t* rgba, size_t pixels) {
+    kernels().grayToRgba(gray, rgba, pixels);
+}
+
+void swapRedBlue(const uint8_t* in, uint8_t* out, size_t pixels) {
+    kernels().swapRedBlue(in, out, pixels);
+}
+
+void premultiplyAlpha(uint8_t* rgba, size_t pixels) {
+    kernels().premultiplyAlpha(rgba, pixels);
+}
+
+void extractChannel(const uint8_t* in, size_t pixels, int channels, int channel, uint8_t* out) {
+    kernels().extractChannel(in, pixels, channels, channel, out);
+}
+
+bool downscaleBox(const uint8_t* in, size_t width, size_t height, size_t inStride, int channels, int factor,
+                  uint8_t* out, size_t outStride) {
+    const Kernels& selected = kernels();
+    return downscale(selected.accumulateRow, selected.collapseRow, in, width, height, inStride,
+                     channels, factor, out, outStride);
+}
+
+// ================================
+// SCALAR REFERENCES
+// ================================
+
+void grayToRgbaScalar(const uint8_t* gray, uint8_t* rgba, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t g = gray[i];
+        rgba[i * 4] = g;
+        rgba[i * 4 + 1] = g;
+        rgba[i * 4 + 2] = g;
+        rgba[i * 4 + 3] = 0xFF;
+    }
+}
+
+void swapRedBlueScalar(const uint8_t* in, uint8_t* out, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t first = in[i * 3];
+        uint8_t third = in[i * 3 + 2];
+        out[i * 3] = third;
+        out[i * 3 + 1] = in[i * 3 + 1];
+        out[i * 3 + 2] = first;
+    }
+}
+
+void premultiplyAlphaScalar(uint8_t* rgba, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t* pixel = rgba + i * 4;
+        unsigned alpha = pixel[3];
+        pixel[0] = divide255(pixel[0] * alpha);
+        pixel[1] = divide255(pixel[1] * alpha);
+        pixel[2] = divide255(pixel[2] * alpha);
+    }
+}
+
+void extractChannelScalar(const uint8_t* in, size_t pixels, int channels, int channel, uint8_t* out) {
+    for (size_t i = 0; i < pixels; i++) {
+        out[i] = in[i * channels + channel];
+    }
+}
+
+bool downscaleBoxScalar(const uint8_t* in, size_t width, size_t height, size_t inStride, int channels, int factor,
+                        uint8_t* out, size_t outStride) {
+    return downscale(accumulateRowScalar, collapseRowScalar, in, width, height, inStride, channels,
+                     factor, out, outStride);
+}
@@ -0,0 +1,56 @@
+#ifndef SINO_SCANNER_PIXEL_KERNELS_H
+#define SINO_SCANNER_PIXEL_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Pixel Kernels
+ *
+ * The pixel-format conversions the image pipeline needs, on 8-bit samples:
+ * gray to RGBA, RGB <-> BGR (the SDK's CDib and BMP rows are BGR), alpha
+ * premultiplication, 2x/4x box downscaling, and pulling one channel out as
+ * a plane (the IR and UV captures carry their signal in one channel).
+ *
+ * Each kernel has a scalar reference and SIMD versions: NEON on ARM64, and
+ * SSE4.1 or AVX2 on x86-64, picked once at run time from what the CPU
+ * supports (x86 builds target the baseline ISA, so both have to be checked
+ * for). Every version produces exactly the scalar output; the benchmark
+ * checks that before timing anything.
+ *
+ * Counts are in pixels and strides in bytes. Only downscaleBox allocates: a
+ * row of column sums per thread, kept for the next call.
+ */
+
+// The kernel set in use: "avx2", "sse4.1", "neon" or "scalar".
+const char* pixelKernelIsa();
+
+// |gray| may be the last quarter of |rgba|, so a gray image decoded into the
+// tail of its RGBA buffer can be expanded in place. Otherwise no overlap.
+void grayToRgba(const uint8_t* gray, uint8_t* rgba, size_t pixels);
+
+// Swaps the first and third sample of each 3-byte pixel. |in| may equal |out|.
+void swapRedBlue(const uint8_t* in, uint8_t* out, size_t pixels);
+
+// RGBA to premultiplied RGBA in place, rounding to nearest.
+void premultiplyAlpha(uint8_t* rgba, size_t pixels);
+
+// |out| receives sample |channel| of every |channels|-sample pixel.
+void extractChannel(const uint8_t* in, size_t pixels, int channels, int channel, uint8_t* out);
+
+// Averages each |factor| x |factor| block (|factor| 2 or 4) of a |channels|
+// sample image into one pixel, rounding to nearest. The output is
+// width / factor by height / factor; leftover columns and rows are dropped.
+// Returns false, writing nothing, for any other factor or channel count.
+bool downscaleBox(const uint8_t* in, size_t width, size_t height, size_t inStride, int channels, int factor,
+                  uint8_t* out, size_t outStride);
+
+// Scalar references (no SIMD), kept for the benchmark.
+void grayToRgbaScalar(const uint8_t* gray, uint8_t* rgba, size_t pixels);
+void swapRedBlueScalar(const uint8_t* in, uint8_t* out, size_t pixels);
+void premultiplyAlphaScalar(uint8_t* rgba, size_t pixels);
+void extractChannelScalar(const uint8_t* in, size_t pixels, int channels, int channel, uint8_t* out);
+bool downscaleBoxScalar(const uint8_t* in, size_t width, size_t height, size_t inStride, int channels, int factor,
+                        uint8_t* out, size_t outStride);
+
+#endif //SINO_SCANNER_PIXEL_KERNELS_H
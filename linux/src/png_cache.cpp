@@ -0,0 +1,82 @@
+#include "png_cache.h"
+
+#include <functional>
+
+PngCache::PngCache(size_t budgetBytes)
+        : budget(budgetBytes),
+          bytes(0),
+          hits(0),
+          misses(0),
+          evictions(0) {}
+
+size_t PngCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<std::string>()(key.path);
+    for (int64_t value : {key.modifiedNanos, key.size, static_cast<int64_t>(key.layout)}) {
+        hash ^= std::hash<int64_t>()(value) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+PngCache::ImagePtr PngCache::find(const Key& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) {
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+void PngCache::insert(const Key& key, ImagePtr image) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t size = image->pixels.capacity();
+    if (!accepts(size)) {
+        return;
+    }
+    auto it = index.find(key);
+    if (it != index.end()) {
+        bytes -= it->second->second->pixels.capacity();
+        entries.erase(it->second);
+        index.erase(it);
+    }
+    evictLocked(budget.load() - size);
+    entries.emplace_front(key, std::move(image));
+    index[key] = entries.begin();
+    bytes += size;
+}
+
+void PngCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    bytes = 0;
+}
+
+void PngCache::setBudget(size_t budgetBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = budgetBytes;
+    evictLocked(budgetBytes);
+}
+
+PngCache::Stats PngCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.entries = entries.size();
+    stats.bytes = bytes;
+    stats.budgetBytes = budget;
+    return stats;
+}
+
+void PngCache::evictLocked(size_t limit) {
+    while (bytes > limit && !entries.empty()) {
+        bytes -= entries.back().second->pixels.capacity();
+        index.erase(entries.back().first);
+        entries.pop_back();
+        evictions++;
+    }
+}
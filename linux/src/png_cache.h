@@ -0,0 +1,96 @@
+#ifndef SINO_SCANNER_PNG_CACHE_H
+#define SINO_SCANNER_PNG_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "image_buffer_pool.h"
+
+/**
+ * PNG Cache
+ *
+ * Decoded images for read_png_file2, least recently used first out, within
+ * a byte budget. The SDK loads the same templates and reference images on
+ * every InitIDCard and again during recognition; with the cache a repeat
+ * load costs a copy instead of an inflate.
+ *
+ * Entries are keyed by path, modification time, size and output layout,
+ * so a file that changes on disk is decoded afresh. Images are handed out
+ * as shared, immutable buffers from the ImageBufferPool: a lookup holds
+ * its image while copying it even if it is evicted meanwhile.
+ */
+class PngCache {
+public:
+    struct Key {
+        std::string path;
+        int64_t modifiedNanos = 0;
+        int64_t size = 0;
+        int layout = 0;
+
+        bool operator==(const Key& other) const {
+            return path == other.path && modifiedNanos == other.modifiedNanos && size == other.size &&
+                   layout == other.layout;
+        }
+    };
+
+    struct Image {
+        int width = 0;
+        int height = 0;
+        int bitsPerPixel = 0;
+        ImageBufferPool::Buffer pixels;
+    };
+    using ImagePtr = std::shared_ptr<const Image>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t budgetBytes = 0;
+    };
+
+    explicit PngCache(size_t budgetBytes);
+
+    // Null on a miss.
+    ImagePtr find(const Key& key);
+    // Images larger than a quarter of the budget are not kept.
+    void insert(const Key& key, ImagePtr image);
+    void clear();
+
+    // 0 disables the cache.
+    void setBudget(size_t budgetBytes);
+    bool isEnabled() const { return budget.load() > 0; }
+    // Whether insert() would keep an image of |bytes|.
+    bool accepts(size_t bytes) const { return bytes <= budget.load() / 4; }
+    Stats stats() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    using Entry = std::pair<Key, ImagePtr>;
+
+    void evictLocked(size_t budget);
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries;    // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    std::atomic<size_t> budget;
+    size_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+
+    // Prevent copying
+    PngCache(const PngCache&) = delete;
+    PngCache& operator=(const PngCache&) = delete;
+};
+
+#endif //SINO_SCANNER_PNG_CACHE_H
@@ -3,89 +3,132 @@
 //
 #include "png_wrapper.h"
 #include <dlfcn.h>
-#include <iostream>
+#include "logger.h"
+#include "pixel_kernels.h"
+#include <algorithm>
 #include <cstdlib>
 #include <png.h>
 #include <cstring>
 #include <cstdio>
-
-// Forward declare CDib class (need to reverse engineer this)
-// This is a placeholder - you'll need to match the actual structure
-struct CDib {
-    int width;
-    int height;
-    int bitsPerPixel;
-    unsigned char* imageData;
-    size_t dataSize;
-    // Add more fields as you discover them
+#include <cerrno>
+#include <csetjmp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <type_traits>
+#include <vector>
+
+// The libpng entry points the decoder uses, all from the system library.
+// libIDCard.so carries its own static PNG15 copies under the same names, so
+// nothing here may be called through the ordinary symbol lookup.
+struct PngWrapper::Api {
+    png_structp (*create_read_struct)(png_const_charp, png_voidp, png_error_ptr, png_error_ptr);
+    png_infop (*create_info_struct)(png_const_structrp);
+    void (*destroy_read_struct)(png_structpp, png_infopp, png_infopp);
+    jmp_buf* (*set_longjmp_fn)(png_structrp, png_longjmp_ptr, size_t);
+    void (*init_io)(png_structrp, FILE*);
+    void (*read_info)(png_structrp, png_inforp);
+    void (*read_update_info)(png_structrp, png_inforp);
+    void (*read_image)(png_structrp, png_bytepp);
+    void (*read_end)(png_structrp, png_inforp);
+    png_uint_32 (*get_image_width)(png_const_structrp, png_const_inforp);
+    png_uint_32 (*get_image_height)(png_const_structrp, png_const_inforp);
+    png_byte (*get_color_type)(png_const_structrp, png_const_inforp);
+    png_byte (*get_bit_depth)(png_const_structrp, png_const_inforp);
+    png_uint_32 (*get_valid)(png_const_structrp, png_const_inforp, png_uint_32);
+    png_byte (*get_channels)(png_const_structrp, png_const_inforp);
+    size_t (*get_rowbytes)(png_const_structrp, png_const_inforp);
+    void (*set_strip_16)(png_structrp);
+    void (*set_palette_to_rgb)(png_structrp);
+    void (*set_expand_gray_1_2_4_to_8)(png_structrp);
+    void (*set_tRNS_to_alpha)(png_structrp);
+    void (*set_filler)(png_structrp, png_uint_32, int);
+    void (*set_gray_to_rgb)(png_structrp);
+    void (*set_strip_alpha)(png_structrp);
+    void (*set_rgb_to_gray_fixed)(png_structrp, int, png_fixed_point, png_fixed_point);
+    void (*set_read_fn)(png_structrp, png_voidp, png_rw_ptr);
+    void (*error)(png_const_structrp, png_const_charp);
 };
 
-// ================================
-// DEBUG FUNCTIONS
-// ================================
-
-void debugCDib(CDib* dib, const char* context = "") {
-    if (!dib) {
-        std::cout << "CDib debug [" << context << "]: NULL pointer" << std::endl;
-        return;
+// A PNG file in memory, read front to back by libpng. The read callback
+// finds it through |current| rather than png_get_io_ptr, which would need
+// the function table it is not given.
+struct PngWrapper::MemoryReader {
+    const Api* api;
+    const unsigned char* data;
+    size_t size;
+    size_t offset;
+
+    static thread_local MemoryReader* current;   // Decoding on this thread
+
+    static void read(png_structp png_ptr, png_bytep out, size_t length) {
+        MemoryReader* reader = current;
+        if (length > reader->size - reader->offset) {
+            reader->api->error(png_ptr, "Read Error");   // Does not return
+        }
+        memcpy(out, reader->data + reader->offset, length);
+        reader->offset += length;
     }
+};
 
-    std::cout << "=== CDib debug [" << context << "] ===" << std::endl;
-    std::cout << "CDib pointer: " << (void*)dib << std::endl;
-    std::cout << "CDib size: " << sizeof(CDib) << " bytes" << std::endl;
+thread_local PngWrapper::MemoryReader* PngWrapper::MemoryReader::current = nullptr;
 
-    // Print the CDib structure as it currently exists
-    std::cout << "Current CDib values:" << std::endl;
-    std::cout << "  width: " << dib->width << std::endl;
-    std::cout << "  height: " << dib->height << std::endl;
-    std::cout << "  bitsPerPixel: " << dib->bitsPerPixel << std::endl;
-    std::cout << "  imageData: " << (void*)dib->imageData << std::endl;
-    std::cout << "  dataSize: " << dib->dataSize << std::endl;
+namespace {
 
-    // Print first 128 bytes of the CDib structure as hex
-    std::cout << "Raw CDib memory (first 128 bytes):" << std::endl;
-    unsigned char* ptr = (unsigned char*)dib;
-    for (int i = 0; i < 128 && i < sizeof(CDib) * 4; i++) {
-        printf("%02x ", ptr[i]);
-        if (i % 16 == 15) printf("\n");
+PngWrapper::PixelLayout layoutFromEnvironment() {
+    const char* value = std::getenv("SINO_SCANNER_PNG_LAYOUT");
+    if (!value || !*value || strcmp(value, "native") == 0) {
+        return PngWrapper::PixelLayout::Native;
     }
-    if (128 % 16 != 0) printf("\n");
-
-    std::cout << "=========================" << std::endl;
+    if (strcmp(value, "gray") == 0) return PngWrapper::PixelLayout::Gray8;
+    if (strcmp(value, "rgb") == 0) return PngWrapper::PixelLayout::Rgb24;
+    if (strcmp(value, "rgba") == 0) return PngWrapper::PixelLayout::Rgba32;
+    SINO_LOG_WARN("PngWrapper: Ignoring unknown SINO_SCANNER_PNG_LAYOUT=%s", value);
+    return PngWrapper::PixelLayout::Native;
 }
 
-void analyzeCDibUsage(CDib* dib, const char* operation) {
-    static int call_count = 0;
-    call_count++;
-
-    std::cout << "\n*** CDib Analysis Call #" << call_count << " [" << operation << "] ***" << std::endl;
-
-    if (dib) {
-        // Check if CDib looks pre-initialized
-        bool looks_initialized = (dib->width > 0 && dib->width < 10000) &&
-                                 (dib->height > 0 && dib->height < 10000) &&
-                                 (dib->bitsPerPixel > 0 && dib->bitsPerPixel <= 32);
+size_t cacheBudgetFromEnvironment() {
+    const char* value = std::getenv("SINO_SCANNER_PNG_CACHE_MB");
+    long megabytes = value && *value ? std::atol(value) : 64;
+    return static_cast<size_t>(std::max(megabytes, 0L)) << 20;
+}
 
-        std::cout << "CDib appears " << (looks_initialized ? "PRE-INITIALIZED" : "UNINITIALIZED") << std::endl;
+// Hands |pixels| (malloc'd) to |dib|, which owns it from then on.
+void adoptPixels(CDib* dib, int width, int height, int bitsPerPixel, unsigned char* pixels, size_t size) {
+    // Check if CDib already has allocated memory
+    if (dib->imageData != nullptr) {
+        SINO_LOG_WARN("CDib already has imageData allocated at %p; it might manage its own memory",
+                      static_cast<void*>(dib->imageData));
+        // Don't free it yet - let's see what happens
+    }
 
-        if (looks_initialized) {
-            std::cout << "Expected image size: " << dib->width << "x" << dib->height
-                      << " (" << dib->bitsPerPixel << "bpp)" << std::endl;
-            std::cout << "Expected data size: " << (dib->width * dib->height * dib->bitsPerPixel / 8) << " bytes" << std::endl;
-        }
+    dib->width = width;
+    dib->height = height;
+    dib->bitsPerPixel = bitsPerPixel;
+    dib->dataSize = size;
+    dib->imageData = pixels;
+}
 
-        debugCDib(dib, operation);
-    } else {
-        std::cout << "CDib is NULL!" << std::endl;
+int layoutChannels(PngWrapper::PixelLayout layout) {
+    switch (layout) {
+        case PngWrapper::PixelLayout::Gray8: return 1;
+        case PngWrapper::PixelLayout::Rgb24: return 3;
+        default: return 4;
     }
+}
 
-    std::cout << "*** End Analysis Call #" << call_count << " ***\n" << std::endl;
 }
 
 // Static instance for singleton pattern
 static PngWrapper* g_instance = nullptr;
 
-PngWrapper::PngWrapper() : systemPngHandle(nullptr), initialized(false) {}
+PngWrapper::PngWrapper()
+        : systemPngHandle(nullptr),
+          initialized(false),
+          layout(layoutFromEnvironment()),
+          cache(cacheBudgetFromEnvironment()),
+          api(nullptr) {}
 
 PngWrapper::~PngWrapper() {
     cleanup();
@@ -96,7 +139,7 @@ bool PngWrapper::initialize() {
         return true;
     }
 
-    std::cout << "PngWrapper: Initializing system PNG library..." << std::endl;
+    SINO_LOG_INFO("PngWrapper: Initializing system PNG library...");
 
     // Try to load system PNG library
     const char* png_libs[] = {
@@ -109,29 +152,66 @@ bool PngWrapper::initialize() {
     for (const char* lib : png_libs) {
         systemPngHandle = dlopen(lib, RTLD_LAZY | RTLD_GLOBAL);
         if (systemPngHandle) {
-            std::cout << "PngWrapper: Successfully loaded " << lib << std::endl;
+            SINO_LOG_INFO("PngWrapper: Successfully loaded %s", lib);
             break;
         }
     }
 
     if (!systemPngHandle) {
-        std::cerr << "PngWrapper: Failed to load system PNG library: " << dlerror() << std::endl;
+        SINO_LOG_ERROR("PngWrapper: Failed to load system PNG library: %s", dlerror());
         return false;
     }
 
-    // Verify we can find key functions
-    if (!getSystemFunction<void*>("png_create_read_struct")) {
-        std::cerr << "PngWrapper: System PNG library missing required functions" << std::endl;
+    Api* resolved = new Api();
+    bool complete = true;
+    auto resolve = [&](auto& function, const char* name) {
+        function = getSystemFunction<std::remove_reference_t<decltype(function)>>(name);
+        complete = complete && function;
+    };
+    resolve(resolved->create_read_struct, "png_create_read_struct");
+    resolve(resolved->create_info_struct, "png_create_info_struct");
+    resolve(resolved->destroy_read_struct, "png_destroy_read_struct");
+    resolve(resolved->set_longjmp_fn, "png_set_longjmp_fn");
+    resolve(resolved->init_io, "png_init_io");
+    resolve(resolved->read_info, "png_read_info");
+    resolve(resolved->read_update_info, "png_read_update_info");
+    resolve(resolved->read_image, "png_read_image");
+    resolve(resolved->read_end, "png_read_end");
+    resolve(resolved->get_image_width, "png_get_image_width");
+    resolve(resolved->get_image_height, "png_get_image_height");
+    resolve(resolved->get_color_type, "png_get_color_type");
+    resolve(resolved->get_bit_depth, "png_get_bit_depth");
+    resolve(resolved->get_valid, "png_get_valid");
+    resolve(resolved->get_channels, "png_get_channels");
+    resolve(resolved->get_rowbytes, "png_get_rowbytes");
+    resolve(resolved->set_strip_16, "png_set_strip_16");
+    resolve(resolved->set_palette_to_rgb, "png_set_palette_to_rgb");
+    resolve(resolved->set_expand_gray_1_2_4_to_8, "png_set_expand_gray_1_2_4_to_8");
+    resolve(resolved->set_tRNS_to_alpha, "png_set_tRNS_to_alpha");
+    resolve(resolved->set_filler, "png_set_filler");
+    resolve(resolved->set_gray_to_rgb, "png_set_gray_to_rgb");
+    resolve(resolved->set_strip_alpha, "png_set_strip_alpha");
+    resolve(resolved->set_rgb_to_gray_fixed, "png_set_rgb_to_gray_fixed");
+    resolve(resolved->set_read_fn, "png_set_read_fn");
+    resolve(resolved->error, "png_error");
+
+    // Verify we found every function the decoder calls
+    if (!complete) {
+        SINO_LOG_ERROR("PngWrapper: System PNG library missing required functions");
+        delete resolved;
         cleanup();
         return false;
     }
 
+    api = resolved;
     initialized = true;
-    std::cout << "PngWrapper: Initialization successful!" << std::endl;
+    SINO_LOG_INFO("PngWrapper: Initialization successful!");
     return true;
 }
 
 void PngWrapper::cleanup() {
+    delete api;
+    api = nullptr;
     if (systemPngHandle) {
         dlclose(systemPngHandle);
         systemPngHandle = nullptr;
@@ -147,8 +227,7 @@ T PngWrapper::getSystemFunction(const char* functionName) {
 
     void* func = dlsym(systemPngHandle, functionName);
     if (!func) {
-        std::cerr << "PngWrapper: Function not found: " << functionName
-                  << " Error: " << dlerror() << std::endl;
+        SINO_LOG_ERROR("PngWrapper: Function not found: %s Error: %s", functionName, dlerror());
     }
     return reinterpret_cast<T>(func);
 }
@@ -157,177 +236,211 @@ T PngWrapper::getSystemFunction(const char* functionName) {
 // HIGH-LEVEL PNG READING FUNCTIONS
 // ================================
 
-bool PngWrapper::loadPngIntoBuffer(FILE* fp, unsigned char** imageData,
-                                   int* width, int* height, int* channels) {
+bool PngWrapper::decodeIntoCDib(CDib* dib, FILE* fp, MemoryReader* memory, PixelLayout target) {
     if (!initialized && !initialize()) {
         return false;
     }
 
-    // Use system PNG16 library functions via dlsym
-    typedef png_structp (*create_read_func)(png_const_charp, png_voidp, png_error_ptr, png_error_ptr);
-    typedef png_infop (*create_info_func)(png_const_structrp);
-    typedef void (*destroy_read_func)(png_structpp, png_infopp, png_infopp);
-    typedef void (*init_io_func)(png_structrp, FILE*);
-    typedef void (*read_info_func)(png_structrp, png_inforp);
-    typedef void (*read_image_func)(png_structrp, png_bytepp);
-    typedef void (*read_end_func)(png_structrp, png_inforp);
-    typedef void (*read_update_info_func)(png_structrp, png_inforp);
-
-    auto png_create_read_struct = getSystemFunction<create_read_func>("png_create_read_struct");
-    auto png_create_info_struct = getSystemFunction<create_info_func>("png_create_info_struct");
-    auto png_destroy_read_struct = getSystemFunction<destroy_read_func>("png_destroy_read_struct");
-    auto png_init_io = getSystemFunction<init_io_func>("png_init_io");
-    auto png_read_info = getSystemFunction<read_info_func>("png_read_info");
-    auto png_read_image = getSystemFunction<read_image_func>("png_read_image");
-    auto png_read_end = getSystemFunction<read_end_func>("png_read_end");
-    auto png_read_update_info = getSystemFunction<read_update_info_func>("png_read_update_info");
-
-    if (!png_create_read_struct || !png_create_info_struct || !png_init_io || !png_read_info) {
-        std::cerr << "Failed to load required PNG functions" << std::endl;
-        return false;
-    }
-
-    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_structp png_ptr = api->create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
     if (!png_ptr) {
-        std::cerr << "Failed to create PNG read struct" << std::endl;
+        SINO_LOG_ERROR("Failed to create PNG read struct");
         return false;
     }
 
-    png_infop info_ptr = png_create_info_struct(png_ptr);
+    png_infop info_ptr = api->create_info_struct(png_ptr);
     if (!info_ptr) {
-        png_destroy_read_struct(&png_ptr, nullptr, nullptr);
-        std::cerr << "Failed to create PNG info struct" << std::endl;
+        api->destroy_read_struct(&png_ptr, nullptr, nullptr);
+        SINO_LOG_ERROR("Failed to create PNG info struct");
         return false;
     }
 
-    // Set up error handling (simplified)
-    if (setjmp(png_jmpbuf(png_ptr))) {
-        png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
-        std::cerr << "PNG reading error occurred" << std::endl;
+    // Reused by every decode on this thread; only ever grows.
+    static thread_local std::vector<png_bytep> rowPointers;
+    // Owned here until the image is complete. volatile: it changes between
+    // setjmp() and a possible longjmp() back.
+    unsigned char* volatile pixels = nullptr;
+
+    // libpng reports errors by longjmp'ing back here
+    if (setjmp(*api->set_longjmp_fn(png_ptr, longjmp, sizeof(jmp_buf)))) {
+        MemoryReader::current = nullptr;
+        api->destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+        free(pixels);
+        SINO_LOG_ERROR("PNG reading error occurred");
         return false;
     }
 
     // Read PNG file
-    png_init_io(png_ptr, fp);
-    png_read_info(png_ptr, info_ptr);
+    if (memory) {
+        memory->api = api;
+        MemoryReader::current = memory;
+        api->set_read_fn(png_ptr, memory, &MemoryReader::read);
+    } else {
+        api->init_io(png_ptr, fp);
+    }
+    api->read_info(png_ptr, info_ptr);
 
     // Get image dimensions and properties
-    *width = png_get_image_width(png_ptr, info_ptr);
-    *height = png_get_image_height(png_ptr, info_ptr);
-    png_byte color_type = png_get_color_type(png_ptr, info_ptr);
-    png_byte bit_depth = png_get_bit_depth(png_ptr, info_ptr);
-
-    // Convert to standard format (8-bit RGBA)
-    if (bit_depth == 16) png_set_strip_16(png_ptr);
-    if (color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png_ptr);
-    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) png_set_expand_gray_1_2_4_to_8(png_ptr);
-    if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) png_set_tRNS_to_alpha(png_ptr);
-    if (color_type == PNG_COLOR_TYPE_RGB || color_type == PNG_COLOR_TYPE_GRAY ||
-        color_type == PNG_COLOR_TYPE_PALETTE) png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
-    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
-        png_set_gray_to_rgb(png_ptr);
-
-    png_read_update_info(png_ptr, info_ptr);
-
-    *channels = png_get_channels(png_ptr, info_ptr);
-    size_t row_bytes = png_get_rowbytes(png_ptr, info_ptr);
-
-    // Allocate memory for image
-    *imageData = (unsigned char*)malloc(row_bytes * (*height));
-    if (!*imageData) {
-        png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
-        return false;
+    int width = static_cast<int>(api->get_image_width(png_ptr, info_ptr));
+    int height = static_cast<int>(api->get_image_height(png_ptr, info_ptr));
+    png_byte color_type = api->get_color_type(png_ptr, info_ptr);
+    png_byte bit_depth = api->get_bit_depth(png_ptr, info_ptr);
+
+    bool hasColor = color_type & PNG_COLOR_MASK_COLOR;
+    bool hasTransparency = api->get_valid(png_ptr, info_ptr, PNG_INFO_tRNS);
+    bool hasAlpha = (color_type & PNG_COLOR_MASK_ALPHA) || hasTransparency;
+    if (target == PixelLayout::Native) {
+        target = hasAlpha ? PixelLayout::Rgba32 : hasColor ? PixelLayout::Rgb24 : PixelLayout::Gray8;
     }
 
-    // Create row pointers
-    png_bytep* row_pointers = (png_bytep*)malloc(sizeof(png_bytep) * (*height));
-    for (int y = 0; y < *height; y++) {
-        row_pointers[y] = (*imageData) + (y * row_bytes);
+    // 8 bits per sample, palettes and packed gray expanded
+    if (bit_depth == 16) api->set_strip_16(png_ptr);
+    if (color_type == PNG_COLOR_TYPE_PALETTE) api->set_palette_to_rgb(png_ptr);
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) api->set_expand_gray_1_2_4_to_8(png_ptr);
+
+    // Opaque gray wanted as RGBA decodes as gray and is expanded afterwards
+    // by grayToRgba() instead of libpng's gray_to_rgb and filler transforms,
+    // which work a sample at a time.
+    bool expandGray = target == PixelLayout::Rgba32 && !hasColor && !hasAlpha;
+
+    // Then only the conversions |target| needs
+    if (target == PixelLayout::Rgba32 && !expandGray) {
+        if (hasTransparency) api->set_tRNS_to_alpha(png_ptr);
+        if (!hasAlpha) api->set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
+    } else if (color_type & PNG_COLOR_MASK_ALPHA) {
+        api->set_strip_alpha(png_ptr);
+    }
+    if (target == PixelLayout::Gray8) {
+        if (hasColor) api->set_rgb_to_gray_fixed(png_ptr, 1, -1, -1);
+    } else if (!hasColor && !expandGray) {
+        api->set_gray_to_rgb(png_ptr);
     }
 
-    // Read the image
-    png_read_image(png_ptr, row_pointers);
-    png_read_end(png_ptr, nullptr);
-
-    // Cleanup
-    free(row_pointers);
-    png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
-
-    std::cout << "Successfully loaded PNG: " << *width << "x" << *height
-              << " channels=" << *channels << std::endl;
-    return true;
-}
-
-bool PngWrapper::convertToCDib(CDib* dib, unsigned char* imageData,
-                               int width, int height, int channels) {
-    if (!dib) return false;
-
-    std::cout << "Converting to CDib format..." << std::endl;
-
-    // IMPORTANT: Before modifying CDib, let's see what was there originally
-    debugCDib(dib, "convertToCDib - BEFORE modification");
-
-    // Set CDib properties
-    dib->width = width;
-    dib->height = height;
-    dib->bitsPerPixel = channels * 8;
-    dib->dataSize = width * height * channels;
-
-    // Check if CDib already has allocated memory
-    if (dib->imageData != nullptr) {
-        std::cout << "WARNING: CDib already has imageData allocated at "
-                  << (void*)dib->imageData << std::endl;
-        std::cout << "This might mean CDib manages its own memory!" << std::endl;
-        // Don't free it yet - let's see what happens
+    api->read_update_info(png_ptr, info_ptr);
+
+    int channels = layoutChannels(target);
+    int decodedChannels = api->get_channels(png_ptr, info_ptr);
+    size_t decodedRowBytes = api->get_rowbytes(png_ptr, info_ptr);
+    size_t row_bytes = static_cast<size_t>(width) * channels;
+    if (decodedChannels != (expandGray ? 1 : channels) ||
+        decodedRowBytes != static_cast<size_t>(width) * decodedChannels) {
+        MemoryReader::current = nullptr;
+        api->destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+        SINO_LOG_ERROR("PNG decodes to %d channels in %zu-byte rows, not the %d expected", decodedChannels,
+                       decodedRowBytes, expandGray ? 1 : channels);
+        return false;
     }
 
-    // Allocate memory for CDib (this might not be the right approach)
-    dib->imageData = (unsigned char*)malloc(dib->dataSize);
-    if (!dib->imageData) {
-        std::cerr << "Failed to allocate memory for CDib" << std::endl;
+    // The CDib's own allocation; libpng writes the rows straight into it.
+    pixels = static_cast<unsigned char*>(malloc(row_bytes * height));
+    if (!pixels) {
+        MemoryReader::current = nullptr;
+        api->destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+        SINO_LOG_ERROR("Failed to allocate memory for CDib");
         return false;
     }
+    // Gray to be expanded goes in the last quarter of the buffer, which
+    // grayToRgba() can expand in place.
+    unsigned char* decoded = expandGray ? pixels + static_cast<size_t>(width) * height * 3 : pixels;
+    rowPointers.resize(std::max(rowPointers.size(), static_cast<size_t>(height)));
+    for (int y = 0; y < height; y++) {
+        rowPointers[y] = decoded + y * decodedRowBytes;
+    }
 
-    // Copy image data
-    memcpy(dib->imageData, imageData, dib->dataSize);
+    // Read the image
+    api->read_image(png_ptr, rowPointers.data());
+    api->read_end(png_ptr, nullptr);
+    MemoryReader::current = nullptr;
+    api->destroy_read_struct(&png_ptr, &info_ptr, nullptr);
 
-    std::cout << "CDib conversion completed: " << width << "x" << height
-              << " " << dib->bitsPerPixel << "bpp" << std::endl;
+    if (expandGray) {
+        grayToRgba(decoded, pixels, static_cast<size_t>(width) * height);
+    }
 
-    // Show final state
-    debugCDib(dib, "convertToCDib - AFTER modification");
+    adoptPixels(dib, width, height, channels * 8, pixels, row_bytes * height);
 
+    SINO_LOG_DEBUG("Successfully loaded PNG: %dx%d channels=%d", width, height, channels);
     return true;
 }
 
 int PngWrapper::readPngFromFile(CDib* dib, FILE* fp) {
-    unsigned char* imageData = nullptr;
-    int width, height, channels;
-
-    if (!loadPngIntoBuffer(fp, &imageData, &width, &height, &channels)) {
-        std::cerr << "Failed to load PNG from file pointer" << std::endl;
+    if (!dib || !decodeIntoCDib(dib, fp, nullptr, layout)) {
+        SINO_LOG_ERROR("Failed to load PNG from file pointer");
         return -1;
     }
-
-    bool success = convertToCDib(dib, imageData, width, height, channels);
-    free(imageData);
-
-    return success ? 0 : -1;
+    return 0;
 }
 
 int PngWrapper::readPngFromPath(CDib* dib, const char* filename) {
-    FILE* fp = fopen(filename, "rb");
-    if (!fp) {
-        std::cerr << "Cannot open PNG file: " << filename << std::endl;
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SINO_LOG_ERROR("Cannot open PNG file: %s", filename);
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        SINO_LOG_ERROR("Cannot read PNG file: %s", filename);
+        close(fd);
         return -1;
     }
 
-    int result = readPngFromFile(dib, fp);
-    fclose(fp);
+    PngCache::Key key;
+    key.path = filename;
+    key.modifiedNanos = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    key.size = info.st_size;
+    key.layout = static_cast<int>(layout);
+    bool cached = cache.isEnabled();
+    if (cached && dib) {
+        if (PngCache::ImagePtr image = cache.find(key)) {
+            close(fd);
+            auto* pixels = static_cast<unsigned char*>(malloc(image->pixels.size()));
+            if (!pixels) {
+                SINO_LOG_ERROR("Failed to allocate memory for CDib");
+                return -1;
+            }
+            memcpy(pixels, image->pixels.data(), image->pixels.size());
+            adoptPixels(dib, image->width, image->height, image->bitsPerPixel, pixels, image->pixels.size());
+            return 0;
+        }
+    }
 
+    // Mapped read-only and decoded in place: no stdio buffer in between, and
+    // the kernel reads ahead since libpng walks it front to back.
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        SINO_LOG_ERROR("Cannot map PNG file %s: %s", filename, strerror(errno));
+        return -1;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    madvise(mapping, size, MADV_WILLNEED);
+
+    int result = readPngFromMemory(dib, static_cast<const unsigned char*>(mapping), size);
+    munmap(mapping, size);
+
+    if (result == 0 && cached && cache.accepts(dib->dataSize)) {
+        auto image = std::make_shared<PngCache::Image>();
+        image->width = dib->width;
+        image->height = dib->height;
+        image->bitsPerPixel = dib->bitsPerPixel;
+        image->pixels = ImageBufferPool::getInstance().acquire(dib->dataSize);
+        if (image->pixels) {
+            memcpy(image->pixels.data(), dib->imageData, dib->dataSize);
+            cache.insert(key, std::move(image));
+        }
+    }
     return result;
 }
 
+int PngWrapper::readPngFromMemory(CDib* dib, const unsigned char* data, size_t size) {
+    MemoryReader memory{nullptr, data, size, 0};
+    if (!dib || !data || !decodeIntoCDib(dib, nullptr, &memory, layout)) {
+        SINO_LOG_ERROR("Failed to load PNG from memory");
+        return -1;
+    }
+    return 0;
+}
+
 PngWrapper& PngWrapper::getInstance() {
     if (!g_instance) {
         g_instance = new PngWrapper();
@@ -347,43 +460,21 @@ extern "C" {
 
 // Override the main PNG reading functions from libIDCard.so
 int read_png_file(CDib* dib, FILE* fp) {
-    std::cout << "*** INTERCEPTED: read_png_file(CDib*, FILE*) ***" << std::endl;
-
-    // CRITICAL: Analyze the CDib structure BEFORE we modify it
-    analyzeCDibUsage(dib, "read_png_file - BEFORE processing");
-
     if (!dib || !fp) {
-        std::cerr << "Invalid parameters to read_png_file" << std::endl;
+        SINO_LOG_ERROR("Invalid parameters to read_png_file");
         return -1;
     }
 
-    int result = PngWrapper::getInstance().readPngFromFile(dib, fp);
-
-    // Analyze CDib AFTER our processing
-    analyzeCDibUsage(dib, "read_png_file - AFTER processing");
-
-    return result;
+    return PngWrapper::getInstance().readPngFromFile(dib, fp);
 }
 
 int read_png_file2(CDib* dib, char* filename) {
-    std::cout << "*** INTERCEPTED: read_png_file2(CDib*, char*) ***" << std::endl;
-
-    // CRITICAL: Analyze the CDib structure BEFORE we modify it
-    analyzeCDibUsage(dib, "read_png_file2 - BEFORE processing");
-
     if (!dib || !filename) {
-        std::cerr << "Invalid parameters to read_png_file2" << std::endl;
+        SINO_LOG_ERROR("Invalid parameters to read_png_file2");
         return -1;
     }
 
-    std::cout << "Attempting to read PNG file: " << filename << std::endl;
-
-    int result = PngWrapper::getInstance().readPngFromPath(dib, filename);
-
-    // Analyze CDib AFTER our processing
-    analyzeCDibUsage(dib, "read_png_file2 - AFTER processing");
-
-    return result;
+    return PngWrapper::getInstance().readPngFromPath(dib, filename);
 }
 
 // Keep the low-level PNG function overrides as fallback
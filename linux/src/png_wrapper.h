@@ -8,9 +8,18 @@
 #include <png.h>
 #include <memory>
 #include <cstdio>
-
-// Forward declare CDib class - you'll need to match this to the actual structure
-struct CDib;
+#include "png_cache.h"
+
+// Image buffer libIDCard.so hands to read_png_file. This is our best
+// reconstruction of the layout, not the SDK's own declaration.
+struct CDib {
+    int width;
+    int height;
+    int bitsPerPixel;
+    unsigned char* imageData;
+    size_t dataSize;
+    // Add more fields as you discover them
+};
 
 /**
  * PNG Wrapper Class
@@ -21,9 +30,30 @@ struct CDib;
  *
  * Strategy: Override the high-level read_png_file functions instead
  * of trying to replace 300+ individual PNG functions.
+ *
+ * Every libpng entry point the decoder uses is resolved once, in
+ * initialize(), and images are decoded straight into the CDib's own pixel
+ * allocation.
+ *
+ * Images keep their own layout: grayscale decodes to Gray8, RGB and
+ * opaque palettes to RGB24, anything with alpha (or a tRNS chunk) to
+ * RGBA32, all at 8 bits per sample. Most of what the SDK loads is single
+ * channel, so expanding everything to RGBA would cost four times the
+ * memory. A fixed layout is converted to only when asked for, through
+ * setOutputLayout() or SINO_SCANNER_PNG_LAYOUT=gray|rgb|rgba.
+ *
+ * Images read by path are kept decoded in a PngCache, 64 MB unless
+ * SINO_SCANNER_PNG_CACHE_MB says otherwise (0 turns it off).
  */
 class PngWrapper {
 public:
+    enum class PixelLayout {
+        Native,     // Whichever of the below the image is stored as
+        Gray8,
+        Rgb24,
+        Rgba32,
+    };
+
     PngWrapper();
     ~PngWrapper();
 
@@ -33,9 +63,21 @@ public:
     // Clean up resources
     void cleanup();
 
-    // High-level PNG reading functions
+    // High-level PNG reading functions, in outputLayout(). A path is
+    // mapped into memory and decoded from there, not read through stdio.
     int readPngFromFile(CDib* dib, FILE* fp);
     int readPngFromPath(CDib* dib, const char* filename);
+    // |data| is a whole PNG file already in memory (a mapped file, an image
+    // ring segment); it is only read.
+    int readPngFromMemory(CDib* dib, const unsigned char* data, size_t size);
+
+    // Layout read_png_file hands the SDK. Native unless
+    // SINO_SCANNER_PNG_LAYOUT says otherwise.
+    PixelLayout outputLayout() const { return layout; }
+    void setOutputLayout(PixelLayout newLayout) { layout = newLayout; }
+
+    PngCache::Stats cacheStats() const { return cache.stats(); }
+    void setCacheBudget(size_t budgetBytes) { cache.setBudget(budgetBytes); }
 
     // Check if wrapper is properly initialized
     bool isInitialized() const { return systemPngHandle != nullptr; }
@@ -50,12 +92,17 @@ public:
 private:
     void* systemPngHandle;
     bool initialized;
+    PixelLayout layout;
+    PngCache cache;
+
+    struct Api;
+    Api* api;
+
+    struct MemoryReader;
 
-    // PNG processing helpers
-    bool loadPngIntoBuffer(FILE* fp, unsigned char** imageData,
-                           int* width, int* height, int* channels);
-    bool convertToCDib(CDib* dib, unsigned char* imageData,
-                       int width, int height, int channels);
+    // Decodes |fp|, or |memory| without one, into a new allocation owned
+    // by |dib|, in |target|.
+    bool decodeIntoCDib(CDib* dib, FILE* fp, MemoryReader* memory, PixelLayout target);
 
     // Prevent copying
     PngWrapper(const PngWrapper&) = delete;
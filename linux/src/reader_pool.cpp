@@ -0,0 +1,756 @@
+#include "reader_pool.h"
+#include "logger.h"
+#include "scan_metrics.h"
+#include "scanner_warmup.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+constexpr auto kWorkerStartTimeout = std::chrono::seconds(10);
+constexpr auto kWorkerStopTimeout = std::chrono::seconds(5);
+constexpr auto kPollInterval = std::chrono::milliseconds(20);
+constexpr auto kRelaunchBackoff = std::chrono::seconds(5);
+
+int64_t steadyMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// scanner.sock -> scanner-reader0.sock, next to the pool's socket; later
+// generations (replacements) get scanner-reader0-1.sock and so on.
+std::string workerSocketPath(const std::string& poolSocket, uint32_t index, uint32_t generation) {
+    std::string base = poolSocket;
+    if (base.size() > 5 && base.compare(base.size() - 5, 5, ".sock") == 0) {
+        base.resize(base.size() - 5);
+    }
+    base += "-reader" + std::to_string(index);
+    if (generation > 0) {
+        base += "-" + std::to_string(generation);
+    }
+    return base + ".sock";
+}
+
+}
+
+ReaderPool::ReaderPool() = default;
+
+ReaderPool::~ReaderPool() {
+    stop();
+}
+
+bool ReaderPool::start(const Config& newConfig, std::string& error) {
+    if (isRunning()) {
+        return true;
+    }
+    config = newConfig;
+    if (config.readers.empty()) {
+        error = "no readers configured";
+        return false;
+    }
+    if (config.socketPath.empty()) {
+        config.socketPath = daemon_protocol::defaultSocketPath();
+    }
+    if (config.workerPath.empty()) {
+        config.workerPath = "/proc/self/exe";
+    }
+    {
+        // Checked before spawning: a live pool's workers already serve the
+        // socket paths ours would connect to.
+        ScannerClient probe;
+        std::string ignored;
+        if (probe.connect(config.socketPath, "reader pool probe", ignored)) {
+            error = "another sino_scannerd is serving " + config.socketPath;
+            return false;
+        }
+    }
+
+    slots.clear();
+    slots.resize(config.readers.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        slots[i].index = static_cast<uint32_t>(i);
+        slots[i].reader = config.readers[i];
+    }
+    assignCpus();
+
+    // All forked before any connects, so the readers initialize their SDKs
+    // side by side. Standbys are left to the supervisor, which starts each
+    // once its reader's active worker is ready.
+    std::vector<WorkerPtr> started;
+    for (Slot& slot : slots) {
+        slot.active = newWorker(slot);
+        started.push_back(slot.active);
+    }
+    for (const WorkerPtr& worker : started) {
+        if (!spawnWorker(*worker, error)) {
+            stopWorkers();
+            return false;
+        }
+    }
+    for (const WorkerPtr& worker : started) {
+        if (!connectWorker(*worker, error)) {
+            stopWorkers();
+            return false;
+        }
+    }
+
+    DaemonServer::Config serverConfig;
+    serverConfig.socketPath = config.socketPath;
+    serverConfig.socketMode = config.socketMode;
+    serverConfig.maxClients = config.maxClients;
+    if (!startServer(serverConfig, error)) {
+        stopWorkers();
+        return false;
+    }
+    stopping = false;
+    supervisor = std::thread(&ReaderPool::supervise, this);
+    SINO_LOG_INFO("ReaderPool: Serving %zu readers at %s%s", slots.size(), config.socketPath.c_str(),
+                  config.standby ? " with standby workers" : "");
+    return true;
+}
+
+void ReaderPool::stop() {
+    if (!isRunning()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(supervisorMutex);
+        stopping = true;
+    }
+    supervisorWake.notify_one();
+    if (supervisor.joinable()) {
+        supervisor.join();
+    }
+    stopServer();
+    stopWorkers();
+    SINO_LOG_INFO("ReaderPool: Stopped");
+}
+
+// ================================
+// WORKERS
+// ================================
+
+void ReaderPool::assignCpus() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    std::vector<int> cores;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) cores.push_back(cpu);
+        }
+    }
+    for (const Slot& slot : slots) {
+        cores.erase(std::remove(cores.begin(), cores.end(), slot.reader.cpu), cores.end());
+    }
+    if (cores.empty()) {
+        return;
+    }
+    // With a core to spare, the first stays with the pool and the UI. A
+    // standby shares its reader's core; it is idle once warmed up.
+    size_t unpinned = static_cast<size_t>(std::count_if(slots.begin(), slots.end(),
+            [](const Slot& slot) { return slot.reader.cpu < 0; }));
+    size_t next = cores.size() > unpinned ? 1 : 0;
+    for (Slot& slot : slots) {
+        if (slot.reader.cpu < 0) {
+            slot.reader.cpu = cores[next++ % cores.size()];
+        }
+    }
+}
+
+ReaderPool::WorkerPtr ReaderPool::newWorker(Slot& slot) {
+    auto worker = std::make_shared<Worker>();
+    worker->index = slot.index;
+    worker->reader = slot.reader;
+    worker->socketPath = workerSocketPath(config.socketPath, slot.index, slot.generation++);
+    return worker;
+}
+
+bool ReaderPool::spawnWorker(Worker& worker, std::string& error) {
+    std::vector<std::string> arguments = {
+        config.workerPath,
+        "--socket", worker.socketPath,
+        // The pool's own connection plus one per bound client.
+        "--max-clients", std::to_string(config.maxClients + 1),
+    };
+    if (!worker.reader.device.empty()) {
+        arguments.insert(arguments.end(), {"--device", worker.reader.device});
+    }
+    if (worker.reader.cpu >= 0) {
+        arguments.insert(arguments.end(), {"--cpu", std::to_string(worker.reader.cpu)});
+    }
+    // Built before fork(): the child may only exec.
+    std::vector<char*> argv;
+    for (std::string& argument : arguments) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+
+    pid_t parent = getpid();
+    pid_t pid = fork();
+    if (pid < 0) {
+        error = std::string("fork failed: ") + strerror(errno);
+        return false;
+    }
+    if (pid == 0) {
+        // A worker must not outlive a pool that crashed.
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() != parent) {
+            _exit(1);
+        }
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    worker.pid = pid;
+    SINO_LOG_INFO("ReaderPool: Reader %u (%s, cpu %d) is pid %d", worker.index,
+                  worker.reader.device.empty() ? "any device" : worker.reader.device.c_str(),
+                  worker.reader.cpu, static_cast<int>(pid));
+    return true;
+}
+
+bool ReaderPool::connectWorker(Worker& worker, std::string& error) {
+    Worker* target = &worker;
+    worker.control = std::make_unique<ScannerClient>();
+    worker.control->setEventHandler([this, target](const DaemonFrame& event) {
+        if (event.message == DaemonMessage::ScanEvent && activeWorker(target->index).get() == target) {
+            DaemonWriter prefix;
+            prefix.u32(target->index);
+            std::vector<uint8_t> payload = prefix.take();
+            payload.insert(payload.end(), event.payload.begin(), event.payload.end());
+            broadcastUnbound(daemon_protocol::kEventScan, DaemonMessage::ReaderScanEvent, payload);
+        } else if (event.message == DaemonMessage::ReadinessEvent) {
+            DaemonReader args(event.payload);
+            std::string state;
+            if (args.str(state)) {
+                target->ready = state == "ready";
+                target->failed = state == "failed";
+                if (state == "ready" || state == "idle") {
+                    noteRecovered(*target);
+                } else if (state == "failed") {
+                    SINO_LOG_WARN("ReaderPool: Reader %u (pid %d) failed to warm up", target->index,
+                                  static_cast<int>(target->pid));
+                }
+                if (state == "ready" || state == "failed") {
+                    // A standby to start, or an active worker to replace.
+                    wakeSupervisor();
+                }
+            }
+        }
+        if (event.fd >= 0) {
+            close(event.fd);
+        }
+    });
+    worker.control->setDisconnectHandler([this, target]() {
+        target->online = false;
+        wakeSupervisor();
+    });
+
+    auto deadline = std::chrono::steady_clock::now() + kWorkerStartTimeout;
+    std::string lastError;
+    while (!worker.control->connect(worker.socketPath, "reader pool", lastError)) {
+        int status = 0;
+        if (waitpid(worker.pid, &status, WNOHANG) == worker.pid) {
+            worker.pid = -1;
+            error = "worker for reader " + std::to_string(worker.index) + " exited with status " +
+                    std::to_string(WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+            return false;
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            error = "worker for reader " + std::to_string(worker.index) + " did not start: " + lastError;
+            return false;
+        }
+        std::this_thread::sleep_for(kPollInterval);
+    }
+    worker.lastHeartbeatMicros = steadyMicros();
+    worker.online = true;
+
+    DaemonWriter mask;
+    mask.u32(daemon_protocol::kEventScan | daemon_protocol::kEventReadiness);
+    worker.control->send(DaemonMessage::Subscribe, mask.bytes(), [](ScannerClient::Reply&) {});
+    return true;
+}
+
+void ReaderPool::stopWorkers() {
+    std::vector<WorkerPtr> workers;
+    {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        for (Slot& slot : slots) {
+            if (slot.active) workers.push_back(std::move(slot.active));
+            if (slot.standby) workers.push_back(std::move(slot.standby));
+        }
+        slots.clear();
+    }
+    for (const WorkerPtr& worker : workers) {
+        if (worker->control) {
+            worker->control->disconnect();
+        }
+        if (worker->pid > 0) {
+            kill(worker->pid, SIGTERM);
+        }
+    }
+    // Each releases its SDK on SIGTERM; one that does not in time is killed.
+    auto deadline = std::chrono::steady_clock::now() + kWorkerStopTimeout;
+    for (const WorkerPtr& worker : workers) {
+        while (worker->pid > 0) {
+            if (waitpid(worker->pid, nullptr, WNOHANG) != 0) {
+                worker->pid = -1;
+            } else if (std::chrono::steady_clock::now() > deadline) {
+                SINO_LOG_WARN("ReaderPool: Reader %u did not stop, killing pid %d", worker->index,
+                              static_cast<int>(worker->pid));
+                kill(worker->pid, SIGKILL);
+                waitpid(worker->pid, nullptr, 0);
+                worker->pid = -1;
+            } else {
+                std::this_thread::sleep_for(kPollInterval);
+            }
+        }
+    }
+}
+
+ReaderPool::WorkerPtr ReaderPool::activeWorker(uint32_t reader) const {
+    std::lock_guard<std::mutex> lock(workersMutex);
+    return reader < slots.size() ? slots[reader].active : nullptr;
+}
+
+// ================================
+// SUPERVISION
+// ================================
+
+void ReaderPool::supervise() {
+    std::unique_lock<std::mutex> lock(supervisorMutex);
+    while (!stopping) {
+        supervisorWake.wait_for(lock, config.heartbeatInterval, [this]() { return stopping || supervisorWoken; });
+        if (stopping) {
+            break;
+        }
+        supervisorWoken = false;
+        lock.unlock();
+        for (uint32_t reader = 0; reader < readerCount(); reader++) {
+            checkReader(reader);
+        }
+        lock.lock();
+    }
+}
+
+void ReaderPool::wakeSupervisor() {
+    {
+        std::lock_guard<std::mutex> lock(supervisorMutex);
+        supervisorWoken = true;
+    }
+    supervisorWake.notify_one();
+}
+
+void ReaderPool::checkReader(uint32_t reader) {
+    WorkerPtr active;
+    WorkerPtr standby;
+    {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        active = slots[reader].active;
+        standby = slots[reader].standby;
+    }
+
+    if (active) {
+        std::string reason = failure(*active);
+        if (reason.empty() && active->failed) {
+            // A standby's failed warm-up is retried when it is promoted.
+            reason = "failed to initialize the SDK";
+        }
+        if (!reason.empty()) {
+            failOver(reader, active, reason);
+            return;
+        }
+    } else if ((active = launch(reader))) {
+        // No standby took over; this is a cold start.
+        std::lock_guard<std::mutex> lock(workersMutex);
+        slots[reader].active = active;
+    }
+
+    if (standby) {
+        std::string reason = failure(*standby);
+        if (!reason.empty()) {
+            SINO_LOG_ERROR("ReaderPool: Standby for reader %u (pid %d) %s; replacing it", reader,
+                           static_cast<int>(standby->pid), reason.c_str());
+            {
+                std::lock_guard<std::mutex> lock(workersMutex);
+                slots[reader].standby = nullptr;
+            }
+            retire(standby);
+            standby = nullptr;
+        }
+    }
+    // Not while the active worker is still initializing (or never could):
+    // the standby's warm-up would race it for the device.
+    if (config.standby && !standby && active && active->ready && (standby = launch(reader))) {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        slots[reader].standby = standby;
+    }
+
+    if (active) heartbeat(active);
+    if (standby) heartbeat(standby);
+}
+
+std::string ReaderPool::failure(const Worker& worker) const {
+    if (!worker.online) {
+        return "went offline";
+    }
+    if (uint32_t message = worker.overdueMessage.load()) {
+        return std::string("hung in ") + daemon_protocol::messageName(static_cast<DaemonMessage>(message)) +
+               " for " + std::to_string(worker.overdueMicros.load() / 1000) + " ms";
+    }
+    int64_t silentMicros = steadyMicros() - worker.lastHeartbeatMicros.load();
+    if (silentMicros > std::chrono::duration_cast<std::chrono::microseconds>(config.heartbeatTimeout).count()) {
+        return "stopped answering heartbeats for " + std::to_string(silentMicros / 1000) + " ms";
+    }
+    return "";
+}
+
+void ReaderPool::failOver(uint32_t reader, const WorkerPtr& failed, const std::string& reason) {
+    WorkerPtr promoted;
+    {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        Slot& slot = slots[reader];
+        slot.failedAt = std::chrono::steady_clock::now();
+        slot.recovering = true;
+        slot.restarts++;
+        promoted = std::move(slot.standby);
+        slot.standby = nullptr;
+        slot.active = promoted;
+        if (failed->failed && !promoted) {
+            // A reader that cannot initialize would otherwise be restarted
+            // at every check.
+            slot.nextLaunch = slot.failedAt + kRelaunchBackoff;
+        }
+    }
+    if (promoted) {
+        SINO_LOG_ERROR("ReaderPool: Reader %u (pid %d) %s; standby pid %d takes over", reader,
+                       static_cast<int>(failed->pid), reason.c_str(), static_cast<int>(promoted->pid));
+    } else {
+        SINO_LOG_ERROR("ReaderPool: Reader %u (pid %d) %s; restarting it", reader,
+                       static_cast<int>(failed->pid), reason.c_str());
+    }
+    // Bound clients see their connection drop when it dies, and reconnect
+    // to the promoted worker.
+    retire(failed);
+
+    if (promoted) {
+        WarmupSettings settings = WarmupSettings::load();
+        if (promoted->ready) {
+            noteRecovered(*promoted);
+        } else if (settings.isComplete()) {
+            // It could not warm up beside the failed worker (or was started
+            // before any settings were saved); the device is free now.
+            DaemonWriter payload;
+            payload.str(settings.userId).i32(settings.nType).str(settings.sdkDirectory).str(settings.configPath);
+            promoted->failed = false;   // Warming again; its event may not be in yet
+            promoted->control->send(DaemonMessage::Initialize, payload.bytes(), [](ScannerClient::Reply&) {});
+        } else {
+            noteRecovered(*promoted);
+        }
+    }
+    // Relaunches a cold active if nothing was promoted. The standby follows
+    // once the active worker is ready.
+    checkReader(reader);
+}
+
+void ReaderPool::noteRecovered(const Worker& worker) {
+    std::lock_guard<std::mutex> lock(workersMutex);
+    if (worker.index >= slots.size()) {
+        return;
+    }
+    Slot& slot = slots[worker.index];
+    if (!slot.recovering || slot.active.get() != &worker) {
+        return;
+    }
+    slot.recovering = false;
+    slot.lastRecoveryMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - slot.failedAt).count();
+    SINO_LOG_INFO("ReaderPool: Reader %u recovered in %.1f ms (pid %d, restart %u)", worker.index,
+                  slot.lastRecoveryMicros / 1000.0, static_cast<int>(worker.pid), slot.restarts);
+}
+
+ReaderPool::WorkerPtr ReaderPool::launch(uint32_t reader) {
+    WorkerPtr worker;
+    {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        Slot& slot = slots[reader];
+        if (std::chrono::steady_clock::now() < slot.nextLaunch) {
+            return nullptr;
+        }
+        worker = newWorker(slot);
+    }
+    std::string error;
+    if (spawnWorker(*worker, error) && connectWorker(*worker, error)) {
+        return worker;
+    }
+    SINO_LOG_ERROR("ReaderPool: Cannot start a worker for reader %u: %s", reader, error.c_str());
+    {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        slots[reader].nextLaunch = std::chrono::steady_clock::now() + kRelaunchBackoff;
+    }
+    retire(worker);
+    return nullptr;
+}
+
+void ReaderPool::retire(const WorkerPtr& worker) {
+    // Hung or dead: there is no SDK state worth releasing gracefully.
+    worker->online = false;
+    if (worker->pid > 0) {
+        kill(worker->pid, SIGKILL);
+        int status = 0;
+        if (waitpid(worker->pid, &status, 0) == worker->pid && WIFSIGNALED(status) &&
+            WTERMSIG(status) != SIGKILL) {
+            SINO_LOG_ERROR("ReaderPool: Reader %u pid %d died of %s", worker->index,
+                           static_cast<int>(worker->pid), strsignal(WTERMSIG(status)));
+        }
+        worker->pid = -1;
+    }
+    if (worker->control) {
+        worker->control->disconnect();
+    }
+    unlink(worker->socketPath.c_str());
+}
+
+void ReaderPool::heartbeat(const WorkerPtr& worker) {
+    Worker* target = worker.get();
+    int64_t callDeadline = std::chrono::duration_cast<std::chrono::microseconds>(config.callDeadline).count();
+    int64_t initializeDeadline =
+            std::chrono::duration_cast<std::chrono::microseconds>(config.initializeDeadline).count();
+    worker->control->send(DaemonMessage::Heartbeat, {},
+            [target, callDeadline, initializeDeadline](ScannerClient::Reply& reply) {
+        DaemonReader result(reply.payload);
+        uint32_t message = 0;
+        int64_t runningMicros = 0;
+        int64_t allowanceMicros = 0;
+        if (!reply.ok || !result.u32(message) || !result.i64(runningMicros) || !result.i64(allowanceMicros)) {
+            return;
+        }
+        target->lastHeartbeatMicros = steadyMicros();
+        int64_t deadline = (message == static_cast<uint32_t>(DaemonMessage::Initialize)
+                            ? initializeDeadline : callDeadline) + allowanceMicros;
+        if (message != 0 && runningMicros > deadline) {
+            target->overdueMicros = runningMicros;
+            target->overdueMessage = message;
+        }
+    });
+}
+
+// ================================
+// CLIENTS
+// ================================
+
+std::shared_ptr<ReaderPool::Upstream> ReaderPool::upstreamFor(uint64_t clientId) {
+    std::lock_guard<std::mutex> lock(upstreamsMutex);
+    auto it = upstreams.find(clientId);
+    return it == upstreams.end() ? nullptr : it->second;
+}
+
+bool ReaderPool::onHello(const ClientPtr& client, DaemonReader& args, std::string& error) {
+    uint32_t reader = 0;
+    if (!args.u32(reader)) {
+        return true;   // Talks to the pool itself
+    }
+    if (std::shared_ptr<Upstream> bound = upstreamFor(client->id)) {
+        error = "connection is already bound to reader " + std::to_string(bound->reader);
+        return false;
+    }
+    if (reader >= readerCount()) {
+        error = "no reader " + std::to_string(reader) + "; the pool has " + std::to_string(readerCount());
+        return false;
+    }
+    WorkerPtr worker = activeWorker(reader);
+    if (!worker || !worker->online) {
+        error = "reader " + std::to_string(reader) + " is offline";
+        return false;
+    }
+
+    auto upstream = std::make_shared<Upstream>();
+    upstream->reader = reader;
+    upstream->client = std::make_unique<ScannerClient>();
+    upstream->client->setEventHandler([this, client](const DaemonFrame& event) {
+        uint16_t flags = event.fd >= 0 ? event.flags : event.flags & ~daemon_protocol::kFlagFd;
+        send(*client, event.message, flags, 0, event.payload, event.fd);
+        if (event.fd >= 0) {
+            close(event.fd);
+        }
+    });
+    upstream->client->setDisconnectHandler([this, client]() {
+        closeClient(*client);
+    });
+    std::string connectError;
+    if (!upstream->client->connect(worker->socketPath, client->name, connectError)) {
+        error = "reader " + std::to_string(reader) + " is offline: " + connectError;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(upstreamsMutex);
+    upstreams[client->id] = std::move(upstream);
+    return true;
+}
+
+void ReaderPool::onSubscriptionsChanged(const ClientPtr& client, uint32_t previous, uint32_t current) {
+    std::shared_ptr<Upstream> upstream = upstreamFor(client->id);
+    if (!upstream) {
+        return;
+    }
+    // The worker sends the events; the pool only relays them.
+    if (uint32_t added = current & ~previous) {
+        DaemonWriter mask;
+        mask.u32(added);
+        upstream->client->send(DaemonMessage::Subscribe, mask.bytes(), [](ScannerClient::Reply&) {});
+    }
+    if (uint32_t removed = previous & ~current) {
+        DaemonWriter mask;
+        mask.u32(removed);
+        upstream->client->send(DaemonMessage::Unsubscribe, mask.bytes(), [](ScannerClient::Reply&) {});
+    }
+}
+
+void ReaderPool::onDisconnect(const ClientPtr& client) {
+    std::shared_ptr<Upstream> upstream;
+    {
+        std::lock_guard<std::mutex> lock(upstreamsMutex);
+        auto it = upstreams.find(client->id);
+        if (it == upstreams.end()) {
+            return;
+        }
+        upstream = std::move(it->second);
+        upstreams.erase(it);
+    }
+    // The worker drops the client's queued work, waits and images in turn.
+    upstream->client->disconnect();
+}
+
+void ReaderPool::handleFrame(const ClientPtr& client, DaemonFrame& frame) {
+    if (std::shared_ptr<Upstream> upstream = upstreamFor(client->id)) {
+        forward(client, *upstream, frame);
+        return;
+    }
+    DaemonReader args(frame.payload);
+
+    switch (frame.message) {
+        case DaemonMessage::ListReaders:
+            listReaders(client, frame);
+            return;
+        case DaemonMessage::GetScanMetrics: {
+            bool reset = false;
+            if (!args.boolean(reset)) {
+                replyError(*client, frame, "BAD_REQUEST", "malformed GetScanMetrics request");
+                return;
+            }
+            gatherScanMetrics(client, frame, reset);
+            return;
+        }
+        default:
+            replyError(*client, frame, "READER_REQUIRED",
+                       std::string(daemon_protocol::messageName(frame.message)) +
+                       " needs a reader; name one in Hello");
+            return;
+    }
+}
+
+void ReaderPool::forward(const ClientPtr& client, Upstream& upstream, const DaemonFrame& frame) {
+    DaemonFrame request;
+    request.message = frame.message;
+    request.requestId = frame.requestId;
+    bool sent = upstream.client->send(frame.message, frame.payload, [this, client, request](ScannerClient::Reply& reply) {
+        if (reply.ok) {
+            uint16_t flags = daemon_protocol::kFlagReply | (reply.fd >= 0 ? daemon_protocol::kFlagFd : 0);
+            send(*client, request.message, flags, request.requestId, reply.payload, reply.fd);
+        } else {
+            replyError(*client, request, reply.errorCode.c_str(), reply.errorMessage);
+        }
+        if (reply.fd >= 0) {
+            close(reply.fd);
+        }
+    });
+    if (!sent) {
+        replyError(*client, request, "READER_OFFLINE",
+                   "reader " + std::to_string(upstream.reader) + " went offline");
+        closeClient(*client);
+    }
+}
+
+void ReaderPool::listReaders(const ClientPtr& client, const DaemonFrame& frame) {
+    DaemonWriter payload;
+    {
+        std::lock_guard<std::mutex> lock(workersMutex);
+        payload.u32(static_cast<uint32_t>(slots.size()));
+        for (const Slot& slot : slots) {
+            payload.u32(slot.index)
+                    .str(slot.reader.device)
+                    .i32(slot.reader.cpu)
+                    .i32(slot.active ? slot.active->pid : -1)
+                    .str(slot.active ? slot.active->socketPath : "")
+                    .boolean(slot.active && slot.active->online.load())
+                    .u32(slot.restarts)
+                    .i64(slot.lastRecoveryMicros)
+                    .boolean(slot.standby && slot.standby->online.load() && slot.standby->ready.load());
+        }
+    }
+    reply(*client, frame, payload.bytes());
+}
+
+void ReaderPool::gatherScanMetrics(const ClientPtr& client, const DaemonFrame& frame, bool reset) {
+    // Answered once every online worker has replied; a worker that fails
+    // the request is left out rather than failing the whole reply.
+    struct Gather {
+        std::atomic<size_t> remaining;
+        ScanMetrics merged;
+    };
+    std::vector<WorkerPtr> workers;
+    for (uint32_t reader = 0; reader < readerCount(); reader++) {
+        if (WorkerPtr worker = activeWorker(reader)) {
+            workers.push_back(std::move(worker));
+        }
+    }
+    auto gather = std::make_shared<Gather>();
+    gather->remaining = workers.size() + 1;   // The extra one is released below, after every send
+
+    DaemonFrame request;
+    request.message = frame.message;
+    request.requestId = frame.requestId;
+    auto finish = [this, client, request, gather]() {
+        if (gather->remaining.fetch_sub(1) != 1) {
+            return;
+        }
+        std::vector<uint8_t> metrics;
+        gather->merged.toBinary(metrics);
+        DaemonWriter payload;
+        payload.blob(metrics);
+        reply(*client, request, payload.bytes());
+    };
+
+    DaemonWriter arguments;
+    arguments.boolean(reset);
+    for (const auto& worker : workers) {
+        bool sent = worker->online && worker->control->send(DaemonMessage::GetScanMetrics, arguments.bytes(),
+                [gather, finish](ScannerClient::Reply& reply) {
+            DaemonReader result(reply.payload);
+            const uint8_t* data = nullptr;
+            size_t length = 0;
+            if (reply.ok && result.blob(data, length)) {
+                gather->merged.merge(data, length);
+            }
+            finish();
+        });
+        if (!sent) {
+            finish();
+        }
+    }
+    finish();
+}
+
+void ReaderPool::broadcastUnbound(uint32_t eventMask, DaemonMessage message, const std::vector<uint8_t>& payload) {
+    for (const ClientPtr& client : subscribers(eventMask)) {
+        if (!upstreamFor(client->id)) {
+            send(*client, message, daemon_protocol::kFlagEvent, 0, payload);
+        }
+    }
+}
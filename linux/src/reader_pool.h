@@ -0,0 +1,173 @@
+#ifndef SINO_SCANNER_READER_POOL_H
+#define SINO_SCANNER_READER_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+#include "daemon_protocol.h"
+#include "daemon_server.h"
+#include "scanner_client.h"
+
+/**
+ * Reader Pool
+ *
+ * Supervisor for a host with several readers. The SDK keeps its state in
+ * process globals (InitIDCard, AddIDCardID, ...), so one process can only
+ * ever drive one reader, one call at a time. The pool runs one sino_scannerd
+ * worker per reader instead, each confined to its own USB device node and
+ * pinned to its own core, and serves them all behind one socket:
+ *
+ *   - A connection whose Hello names a reader (ScannerClient::connect with a
+ *     reader index) is bound to that worker. The pool opens a connection of
+ *     its own to the worker for it and relays requests, replies, events and
+ *     image descriptors both ways, so it behaves exactly like a connection
+ *     to the worker's socket. It is closed if the worker goes away.
+ *   - Any other connection talks to the pool itself: ListReaders, and
+ *     GetScanMetrics with every worker's histograms added together. Its
+ *     ScanEvent subscription receives ReaderScanEvent from every worker.
+ *
+ * Workers start before the socket is served and are stopped with it.
+ *
+ * The SDK has no timeouts of its own and runs vendor code that can hang or
+ * crash, so the pool also supervises its workers. A supervisor thread sends
+ * each one a Heartbeat every heartbeatInterval; a worker is replaced when it
+ * crashes (its control connection drops), stops answering heartbeats,
+ * reports an SDK call running past its deadline or, if it is the active one,
+ * fails to initialize its SDK. A hung worker is killed.
+ *
+ * Replacement is fast because every reader keeps a standby worker, spawned
+ * and warmed up once the active one reports ready (side by side, the two
+ * would race InitIDCard for the device). On failure it is promoted at once,
+ * and a new standby is started behind it when it is ready. Clients bound to
+ * the failed worker are disconnected and reconnect to its successor.
+ * ListReaders reports each reader's restarts and how long the last recovery
+ * took, from the failure being noticed to the new worker being ready.
+ */
+class ReaderPool : public DaemonServer {
+public:
+    struct Reader {
+        std::string device;     // "BBB/DDD" under /dev/bus/usb; empty: not confined
+        int cpu = -1;           // Core to pin the worker to; -1 picks one
+    };
+
+    struct Config {
+        std::string socketPath;            // Empty: daemon_protocol::defaultSocketPath()
+        mode_t socketMode = 0660;
+        size_t maxClients = 32;
+        std::vector<Reader> readers;
+        std::string workerPath;            // sino_scannerd; empty: this executable
+
+        bool standby = true;               // Keep a warmed spare worker per reader
+        std::chrono::milliseconds heartbeatInterval{1000};
+        std::chrono::milliseconds heartbeatTimeout{5000};      // Unanswered this long: the worker is frozen
+        std::chrono::milliseconds callDeadline{30000};         // One SDK call, beyond the wait it asked for
+        std::chrono::milliseconds initializeDeadline{120000};  // Initialize loads the whole recognition kernel
+    };
+
+    ReaderPool();
+    ~ReaderPool() override;
+
+    // Spawns a worker per reader, waits until each serves its socket, then
+    // binds the pool's. Returns false with |error| set if any step fails;
+    // workers already started are stopped again.
+    bool start(const Config& config, std::string& error);
+
+    // Disconnects every client and stops the workers.
+    void stop();
+
+    size_t readerCount() const { return slots.size(); }
+
+protected:
+    void handleFrame(const ClientPtr& client, DaemonFrame& frame) override;
+    bool onHello(const ClientPtr& client, DaemonReader& args, std::string& error) override;
+    void onSubscriptionsChanged(const ClientPtr& client, uint32_t previous, uint32_t current) override;
+    void onDisconnect(const ClientPtr& client) override;
+
+private:
+    struct Worker {
+        uint32_t index = 0;                       // Reader index
+        Reader reader;
+        std::string socketPath;
+        pid_t pid = -1;
+        std::unique_ptr<ScannerClient> control;   // The pool's own connection
+        std::atomic<bool> online{false};
+        std::atomic<bool> ready{false};           // Readiness "ready"
+        std::atomic<bool> failed{false};          // Readiness "failed"
+        std::atomic<int64_t> lastHeartbeatMicros{0};   // steady_clock, last reply (or connect)
+        std::atomic<uint32_t> overdueMessage{0};       // SDK call past its deadline, from a heartbeat
+        std::atomic<int64_t> overdueMicros{0};
+    };
+    using WorkerPtr = std::shared_ptr<Worker>;
+
+    // One reader: the worker serving it and its standby. Guarded by workersMutex.
+    struct Slot {
+        uint32_t index = 0;
+        Reader reader;
+        WorkerPtr active;
+        WorkerPtr standby;
+        uint32_t generation = 0;                  // Workers spawned, for unique socket paths
+        uint32_t restarts = 0;
+        int64_t lastRecoveryMicros = 0;
+        bool recovering = false;
+        std::chrono::steady_clock::time_point failedAt;
+        std::chrono::steady_clock::time_point nextLaunch;   // Backoff after a worker failed to start
+    };
+
+    // A bound client's connection to its worker.
+    struct Upstream {
+        uint32_t reader = 0;
+        std::unique_ptr<ScannerClient> client;
+    };
+
+    void assignCpus();
+    WorkerPtr newWorker(Slot& slot);
+    bool spawnWorker(Worker& worker, std::string& error);
+    bool connectWorker(Worker& worker, std::string& error);
+    void stopWorkers();
+    WorkerPtr activeWorker(uint32_t reader) const;
+
+    // Supervisor thread.
+    void supervise();
+    void checkReader(uint32_t reader);
+    std::string failure(const Worker& worker) const;
+    void failOver(uint32_t reader, const WorkerPtr& failed, const std::string& reason);
+    WorkerPtr launch(uint32_t reader);
+    void retire(const WorkerPtr& worker);
+    void heartbeat(const WorkerPtr& worker);
+    // Any thread.
+    void wakeSupervisor();
+    void noteRecovered(const Worker& worker);
+
+    void forward(const ClientPtr& client, Upstream& upstream, const DaemonFrame& frame);
+    void listReaders(const ClientPtr& client, const DaemonFrame& frame);
+    void gatherScanMetrics(const ClientPtr& client, const DaemonFrame& frame, bool reset);
+    void broadcastUnbound(uint32_t eventMask, DaemonMessage message, const std::vector<uint8_t>& payload);
+    std::shared_ptr<Upstream> upstreamFor(uint64_t clientId);
+
+    Config config;
+    mutable std::mutex workersMutex;
+    std::vector<Slot> slots;
+
+    std::thread supervisor;
+    std::mutex supervisorMutex;
+    std::condition_variable supervisorWake;
+    bool supervisorWoken = false;
+    bool stopping = false;
+
+    std::mutex upstreamsMutex;
+    std::map<uint64_t, std::shared_ptr<Upstream>> upstreams;   // Client ID -> bound worker connection
+
+    // Prevent copying
+    ReaderPool(const ReaderPool&) = delete;
+    ReaderPool& operator=(const ReaderPool&) = delete;
+};
+
+#endif //SINO_SCANNER_READER_POOL_H
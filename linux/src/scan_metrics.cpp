@@ -0,0 +1,389 @@
+#include "scan_metrics.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+constexpr size_t kSubBucketCount = size_t(1) << LatencyHistogram::kSubBucketBits;
+constexpr size_t kSubBucketHalf = kSubBucketCount / 2;
+constexpr int64_t kMaxValue = (int64_t(1) << LatencyHistogram::kMaxValueBits) - 1;
+constexpr uint32_t kBinaryMagic = 0x31544D53;   // "SMT1"
+constexpr uint8_t kBinaryVersion = 1;
+
+template<typename T>
+void appendRaw(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool readRaw(const uint8_t*& cursor, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - cursor) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+void appendBinaryString(std::vector<uint8_t>& out, const std::string& text) {
+    uint16_t length = static_cast<uint16_t>(std::min<size_t>(text.size(), 0xFFFF));
+    appendRaw(out, length);
+    out.insert(out.end(), text.begin(), text.begin() + length);
+}
+
+bool readBinaryString(const uint8_t*& cursor, const uint8_t* end, std::string& text) {
+    uint16_t length;
+    if (!readRaw(cursor, end, length) || static_cast<size_t>(end - cursor) < length) {
+        return false;
+    }
+    text.assign(reinterpret_cast<const char*>(cursor), length);
+    cursor += length;
+    return true;
+}
+
+ScanMetrics::Stage metricStage(ScanStage stage) {
+    switch (stage) {
+        case ScanStage::Detect: return ScanMetrics::Stage::Detect;
+        case ScanStage::Recognize: return ScanMetrics::Stage::Recognize;
+        case ScanStage::SdkChipRead: return ScanMetrics::Stage::SdkChipRead;
+        case ScanStage::OcrFields: return ScanMetrics::Stage::OcrFields;
+        case ScanStage::ChipFields: return ScanMetrics::Stage::ChipFields;
+        case ScanStage::Total: return ScanMetrics::Stage::Total;
+        default: return ScanMetrics::Stage::Count;
+    }
+}
+
+const char* failureName(ScanStatus status) {
+    switch (status) {
+        case ScanStatus::NotReady: return "not_ready";
+        case ScanStatus::DetectionFailed: return "detection_failed";
+        case ScanStatus::Error: return "recognition_failed";
+        default: return "unknown";
+    }
+}
+
+}
+
+size_t LatencyHistogram::bucketIndex(int64_t micros) {
+    uint64_t value = static_cast<uint64_t>(std::clamp<int64_t>(micros, 0, kMaxValue));
+    if (value < kSubBucketCount) {
+        return static_cast<size_t>(value);
+    }
+    // Keep the top kSubBucketBits - 1 bits below the leading one.
+    int shift = std::bit_width(value) - kSubBucketBits;
+    size_t top = static_cast<size_t>(value >> shift);   // kSubBucketHalf .. kSubBucketCount - 1
+    return kSubBucketCount + static_cast<size_t>(shift - 1) * kSubBucketHalf + (top - kSubBucketHalf);
+}
+
+int64_t LatencyHistogram::bucketUpperValue(size_t index) {
+    if (index < kSubBucketCount) {
+        return static_cast<int64_t>(index);
+    }
+    size_t offset = index - kSubBucketCount;
+    int shift = static_cast<int>(offset / kSubBucketHalf) + 1;
+    int64_t top = static_cast<int64_t>(kSubBucketHalf + offset % kSubBucketHalf);
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t micros) {
+    micros = std::clamp<int64_t>(micros, 0, kMaxValue);
+    counts[bucketIndex(micros)]++;
+    if (total == 0 || micros < minimum) minimum = micros;
+    if (micros > maximum) maximum = micros;
+    sum += static_cast<uint64_t>(micros);
+    total++;
+}
+
+void LatencyHistogram::add(const LatencyHistogram& other) {
+    if (other.total == 0) {
+        return;
+    }
+    for (size_t i = 0; i < kBucketCount; i++) {
+        counts[i] += other.counts[i];
+    }
+    minimum = (total == 0) ? other.minimum : std::min(minimum, other.minimum);
+    maximum = std::max(maximum, other.maximum);
+    sum += other.sum;
+    total += other.total;
+}
+
+void LatencyHistogram::reset() {
+    counts.fill(0);
+    total = 0;
+    minimum = 0;
+    maximum = 0;
+    sum = 0;
+}
+
+int64_t LatencyHistogram::percentile(double percentile) const {
+    if (total == 0) {
+        return 0;
+    }
+    double fraction = std::clamp(percentile, 0.0, 100.0) / 100.0;
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(total))));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        seen += counts[i];
+        if (seen >= target) {
+            return std::min(bucketUpperValue(i), maximum);
+        }
+    }
+    return maximum;
+}
+
+// Layout: u64 total, and when non-zero
+//   i64 min | i64 max | u64 sum | u16 buckets | (u16 index, u32 count)[buckets]
+void LatencyHistogram::toBinary(std::vector<uint8_t>& out) const {
+    appendRaw(out, total);
+    if (total == 0) {
+        return;
+    }
+    appendRaw(out, minimum);
+    appendRaw(out, maximum);
+    appendRaw(out, sum);
+    size_t countAt = out.size();
+    appendRaw(out, static_cast<uint16_t>(0));
+    uint16_t used = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        if (counts[i] == 0) continue;
+        appendRaw(out, static_cast<uint16_t>(i));
+        appendRaw(out, counts[i]);
+        used++;
+    }
+    std::memcpy(out.data() + countAt, &used, sizeof(used));
+}
+
+bool LatencyHistogram::fromBinary(const uint8_t*& cursor, const uint8_t* end) {
+    LatencyHistogram parsed;
+    if (!readRaw(cursor, end, parsed.total)) {
+        return false;
+    }
+    if (parsed.total != 0) {
+        uint16_t used;
+        if (!readRaw(cursor, end, parsed.minimum) || !readRaw(cursor, end, parsed.maximum) ||
+            !readRaw(cursor, end, parsed.sum) || !readRaw(cursor, end, used)) {
+            return false;
+        }
+        for (uint16_t i = 0; i < used; i++) {
+            uint16_t index;
+            uint32_t count;
+            if (!readRaw(cursor, end, index) || !readRaw(cursor, end, count) || index >= kBucketCount) {
+                return false;
+            }
+            parsed.counts[index] += count;
+        }
+    }
+    add(parsed);
+    return true;
+}
+
+const char* ScanMetrics::stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Detect: return "detect";
+        case Stage::Recognize: return "recognize";
+        case Stage::SdkChipRead: return "sdk_chip_read";
+        case Stage::RecognizePage: return "recognize_page";
+        case Stage::OcrFields: return "ocr_fields";
+        case Stage::ChipFields: return "chip_fields";
+        case Stage::ImageSave: return "image_save";
+        case Stage::Serialize: return "serialize";
+        case Stage::Total: return "total";
+        default: return "unknown";
+    }
+}
+
+ScanMetrics::DocumentStats& ScanMetrics::statsFor(const std::string& documentType) {
+    auto it = documents.find(documentType);
+    if (it == documents.end()) {
+        it = documents.emplace(documentType, DocumentStats()).first;
+    }
+    return it->second;
+}
+
+void ScanMetrics::record(const ScanRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!record.succeeded()) {
+        failures[failureName(record.status)]++;
+        return;
+    }
+
+    DocumentStats& stats = statsFor(record.documentName);
+    stats.scans++;
+    for (size_t i = 0; i < record.stageMicros.size(); i++) {
+        Stage stage = metricStage(static_cast<ScanStage>(i));
+        // No chip time means no chip was read, not a 0 us read.
+        bool noChipRead = stage == Stage::SdkChipRead && record.stageMicros[i] <= 0;
+        if (stage != Stage::Count && !noChipRead) {
+            stats.stages[static_cast<size_t>(stage)].record(record.stageMicros[i]);
+        }
+    }
+
+    int64_t chipRead = record.stage(ScanStage::SdkChipRead);
+    if (chipRead > 0) {
+        int64_t page = std::max<int64_t>(0, record.stage(ScanStage::Recognize) - chipRead);
+        stats.stages[static_cast<size_t>(Stage::RecognizePage)].record(page);
+    }
+}
+
+void ScanMetrics::record(const std::string& documentType, Stage stage, int64_t micros) {
+    if (stage == Stage::Count) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    statsFor(documentType).stages[static_cast<size_t>(stage)].record(micros);
+}
+
+ScanMetrics::Summary ScanMetrics::summarize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return summarizeLocked();
+}
+
+ScanMetrics::Summary ScanMetrics::summarizeAndReset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Summary summary = summarizeLocked();
+    documents.clear();
+    failures.clear();
+    return summary;
+}
+
+ScanMetrics::Summary ScanMetrics::summarizeLocked() const {
+    auto summarizeStats = [](const std::string& documentType, const DocumentStats& stats) {
+        DocumentSummary summary{documentType, stats.scans, {}};
+        for (size_t i = 0; i < stats.stages.size(); i++) {
+            const LatencyHistogram& histogram = stats.stages[i];
+            if (histogram.count() == 0) continue;
+            summary.stages.push_back({static_cast<Stage>(i), histogram.count(), histogram.min(),
+                                      histogram.percentile(50.0), histogram.percentile(90.0),
+                                      histogram.percentile(99.0), histogram.max(), histogram.mean()});
+        }
+        return summary;
+    };
+
+    Summary summary;
+    summary.failures = failures;
+    if (documents.empty()) {
+        return summary;
+    }
+
+    // Merged row first, then one per document type.
+    auto all = std::make_unique<DocumentStats>();
+    for (const auto& [documentType, stats] : documents) {
+        all->scans += stats.scans;
+        for (size_t i = 0; i < stats.stages.size(); i++) {
+            all->stages[i].add(stats.stages[i]);
+        }
+    }
+    summary.documents.reserve(documents.size() + 1);
+    summary.documents.push_back(summarizeStats(kAllDocuments, *all));
+    for (const auto& [documentType, stats] : documents) {
+        summary.documents.push_back(summarizeStats(documentType, stats));
+    }
+    return summary;
+}
+
+void ScanMetrics::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    documents.clear();
+    failures.clear();
+}
+
+// Layout (host byte order, as ScanRecord::toBinary):
+//   u32 magic "SMT1" | u8 version | u8 stageCount | u16 documentCount
+//   per document: str documentType | u64 scans | histogram[stageCount]
+//   u16 failureCount | (str kind, u64 count)[failureCount]
+void ScanMetrics::toBinaryLocked(std::vector<uint8_t>& out) const {
+    appendRaw(out, kBinaryMagic);
+    appendRaw(out, kBinaryVersion);
+    appendRaw(out, static_cast<uint8_t>(Stage::Count));
+    appendRaw(out, static_cast<uint16_t>(std::min<size_t>(documents.size(), 0xFFFF)));
+    size_t written = 0;
+    for (const auto& [documentType, stats] : documents) {
+        if (written++ == 0xFFFF) break;
+        appendBinaryString(out, documentType);
+        appendRaw(out, stats.scans);
+        for (const LatencyHistogram& histogram : stats.stages) {
+            histogram.toBinary(out);
+        }
+    }
+    appendRaw(out, static_cast<uint16_t>(std::min<size_t>(failures.size(), 0xFFFF)));
+    written = 0;
+    for (const auto& [kind, count] : failures) {
+        if (written++ == 0xFFFF) break;
+        appendBinaryString(out, kind);
+        appendRaw(out, count);
+    }
+}
+
+void ScanMetrics::toBinary(std::vector<uint8_t>& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    toBinaryLocked(out);
+}
+
+void ScanMetrics::toBinaryAndReset(std::vector<uint8_t>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    toBinaryLocked(out);
+    documents.clear();
+    failures.clear();
+}
+
+bool ScanMetrics::merge(const uint8_t* data, size_t length) {
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + length;
+    uint32_t magic;
+    uint8_t version, stageCount;
+    uint16_t documentCount, failureCount;
+    if (!readRaw(cursor, end, magic) || !readRaw(cursor, end, version) || !readRaw(cursor, end, stageCount) ||
+        magic != kBinaryMagic || version != kBinaryVersion || !readRaw(cursor, end, documentCount)) {
+        return false;
+    }
+
+    // Parsed in full before anything is added. A writer with more stages
+    // than this build knows about has the extra ones dropped.
+    std::vector<std::pair<std::string, std::unique_ptr<DocumentStats>>> parsed;
+    LatencyHistogram ignored;
+    for (uint16_t i = 0; i < documentCount; i++) {
+        auto stats = std::make_unique<DocumentStats>();
+        std::string documentType;
+        if (!readBinaryString(cursor, end, documentType) || !readRaw(cursor, end, stats->scans)) {
+            return false;
+        }
+        for (uint8_t stage = 0; stage < stageCount; stage++) {
+            LatencyHistogram& target = stage < stats->stages.size() ? stats->stages[stage] : ignored;
+            if (!target.fromBinary(cursor, end)) {
+                return false;
+            }
+        }
+        parsed.emplace_back(std::move(documentType), std::move(stats));
+    }
+    std::vector<std::pair<std::string, uint64_t>> parsedFailures;
+    if (!readRaw(cursor, end, failureCount)) {
+        return false;
+    }
+    for (uint16_t i = 0; i < failureCount; i++) {
+        std::string kind;
+        uint64_t count;
+        if (!readBinaryString(cursor, end, kind) || !readRaw(cursor, end, count)) {
+            return false;
+        }
+        parsedFailures.emplace_back(std::move(kind), count);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& [documentType, stats] : parsed) {
+        DocumentStats& target = statsFor(documentType);
+        target.scans += stats->scans;
+        for (size_t stage = 0; stage < target.stages.size(); stage++) {
+            target.stages[stage].add(stats->stages[stage]);
+        }
+    }
+    for (const auto& [kind, count] : parsedFailures) {
+        failures[kind] += count;
+    }
+    return true;
+}
@@ -0,0 +1,156 @@
+#ifndef SINO_SCANNER_SCAN_METRICS_H
+#define SINO_SCANNER_SCAN_METRICS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "scan_record.h"
+
+/**
+ * Latency Histogram
+ *
+ * Fixed-size log-linear histogram of microsecond values, in the style of
+ * HdrHistogram: values below 128 get their own bucket, and every power of
+ * two above that is split into 64 linear sub-buckets. Any recorded value is
+ * reported back within 1/64 (about 1.6%) of itself, from 1 us up to the
+ * clamp at 2^36 us, in a flat array of counts that never allocates.
+ *
+ * Not thread-safe on its own; ScanMetrics guards it.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 7;
+    static constexpr int kMaxValueBits = 36;
+    static constexpr size_t kBucketCount =
+            (size_t(1) << kSubBucketBits) + size_t(kMaxValueBits - kSubBucketBits) * (size_t(1) << (kSubBucketBits - 1));
+
+    void record(int64_t micros);
+    void add(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const { return total; }
+    int64_t min() const { return total ? minimum : 0; }
+    int64_t max() const { return maximum; }
+    int64_t mean() const { return total ? static_cast<int64_t>(sum / total) : 0; }
+
+    // Smallest bucket value at or below which |percentile| (0..100) of the
+    // recorded values fall; 0 when empty. Reported at the bucket's upper
+    // edge, so it never understates.
+    int64_t percentile(double percentile) const;
+
+    static size_t bucketIndex(int64_t micros);
+    static int64_t bucketUpperValue(size_t index);
+
+    // Appends the non-empty buckets and totals to |out| (see ScanMetrics::toBinary).
+    void toBinary(std::vector<uint8_t>& out) const;
+    // Adds the toBinary() histogram at |cursor| to this one and advances
+    // |cursor|. Returns false, adding nothing, on malformed input.
+    bool fromBinary(const uint8_t*& cursor, const uint8_t* end);
+
+private:
+    std::array<uint32_t, kBucketCount> counts{};
+    uint64_t total = 0;
+    int64_t minimum = 0;
+    int64_t maximum = 0;
+    uint64_t sum = 0;
+};
+
+/**
+ * Scan Metrics
+ *
+ * Per-stage scan latency, kept per document type so p50/p99 of a passport
+ * and of an ID card are not mixed. SinosecuScanner feeds it one ScanRecord
+ * per successful scan, plus the image save and channel serialization times,
+ * which happen after the record is built. Failed scans are only counted.
+ *
+ * Recording happens on the SDK thread; summarize() may be called from any
+ * thread, so every access takes the mutex. It is held for a few hundred
+ * nanoseconds per scan.
+ */
+class ScanMetrics {
+public:
+    enum class Stage : uint8_t {
+        Detect,
+        Recognize,      // AutoProcessIDCard, wall clock
+        SdkChipRead,    // GetTimeConsumed chip read, part of Recognize
+        RecognizePage,  // Recognize minus SdkChipRead: capture, classify, OCR
+        OcrFields,
+        ChipFields,
+        ImageSave,      // saveImages after the scan
+        Serialize,      // ScanRecord to channel response
+        Total,          // scanDocument wall clock
+        Count
+    };
+
+    struct StageSummary {
+        Stage stage;
+        uint64_t count;
+        int64_t min;
+        int64_t p50;
+        int64_t p90;
+        int64_t p99;
+        int64_t max;
+        int64_t mean;
+    };
+
+    struct DocumentSummary {
+        std::string documentType;   // kAllDocuments for the merged row
+        uint64_t scans;
+        std::vector<StageSummary> stages;   // Only stages with samples
+    };
+
+    struct Summary {
+        std::vector<DocumentSummary> documents;
+        std::map<std::string, uint64_t> failures;   // By ScanRecord status/error kind
+    };
+
+    static constexpr const char* kAllDocuments = "all";
+
+    ScanMetrics() = default;
+
+    // Records every stage of a successful scan under its document name and
+    // counts a failed one.
+    void record(const ScanRecord& record);
+
+    // Adds one sample for a stage measured outside scanDocument.
+    void record(const std::string& documentType, Stage stage, int64_t micros);
+
+    Summary summarize() const;
+    // Summary of everything so far, then cleared; no sample lands between.
+    Summary summarizeAndReset();
+    void reset();
+
+    // Every histogram and failure count, for merging in another process
+    // (sino_scannerd's GetScanMetrics; ReaderPool adds up its workers').
+    void toBinary(std::vector<uint8_t>& out) const;
+    void toBinaryAndReset(std::vector<uint8_t>& out);
+    // Adds a toBinary() snapshot to what is recorded here. Returns false,
+    // adding nothing, if |data| is malformed.
+    bool merge(const uint8_t* data, size_t length);
+
+    static const char* stageName(Stage stage);
+
+private:
+    struct DocumentStats {
+        uint64_t scans = 0;
+        std::array<LatencyHistogram, static_cast<size_t>(Stage::Count)> stages;
+    };
+
+    DocumentStats& statsFor(const std::string& documentType);
+    Summary summarizeLocked() const;
+    void toBinaryLocked(std::vector<uint8_t>& out) const;
+
+    mutable std::mutex mutex;
+    std::map<std::string, DocumentStats, std::less<>> documents;
+    std::map<std::string, uint64_t> failures;
+
+    // Prevent copying
+    ScanMetrics(const ScanMetrics&) = delete;
+    ScanMetrics& operator=(const ScanMetrics&) = delete;
+};
+
+#endif //SINO_SCANNER_SCAN_METRICS_H
@@ -0,0 +1,313 @@
+#include "scan_record.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+void appendJsonString(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    static const char hex[] = "0123456789abcdef";
+                    out += "\\u00";
+                    out += hex[(c >> 4) & 0xF];
+                    out += hex[c & 0xF];
+                } else {
+                    out += c;
+                }
+                break;
+        }
+    }
+    out += '"';
+}
+
+void appendJsonMember(std::string& out, bool& first, std::string_view key, std::string_view value) {
+    if (!first) out += ',';
+    first = false;
+    appendJsonString(out, key);
+    out += ':';
+    appendJsonString(out, value);
+}
+
+template<typename T>
+void appendRaw(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void appendBinaryString(std::vector<uint8_t>& out, std::string_view text) {
+    uint16_t length = static_cast<uint16_t>(std::min<size_t>(text.size(), 0xFFFF));
+    appendRaw(out, length);
+    out.insert(out.end(), text.begin(), text.begin() + length);
+}
+
+void appendBinaryFields(std::vector<uint8_t>& out, const FieldSnapshot& fields) {
+    appendRaw(out, static_cast<uint8_t>(fields.size()));
+    for (size_t i = 0; i < kPassportFieldCount; i++) {
+        if (!fields.has(i)) continue;
+        appendRaw(out, static_cast<uint8_t>(i));
+        appendRaw(out, static_cast<int16_t>(fields.confidence(i)));
+        appendBinaryString(out, fields.value(i));
+    }
+}
+
+template<typename T>
+bool readRaw(const uint8_t*& cursor, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - cursor) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+bool readBinaryString(const uint8_t*& cursor, const uint8_t* end, std::string& text) {
+    uint16_t length;
+    if (!readRaw(cursor, end, length) || static_cast<size_t>(end - cursor) < length) {
+        return false;
+    }
+    text.assign(reinterpret_cast<const char*>(cursor), length);
+    cursor += length;
+    return true;
+}
+
+bool readBinaryFields(const uint8_t*& cursor, const uint8_t* end, FieldSnapshot& fields) {
+    uint8_t count;
+    if (!readRaw(cursor, end, count)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t position;
+        int16_t confidence;
+        uint16_t length;
+        if (!readRaw(cursor, end, position) || !readRaw(cursor, end, confidence) ||
+            !readRaw(cursor, end, length) || static_cast<size_t>(end - cursor) < length) {
+            return false;
+        }
+        fields.assign(position, std::string_view(reinterpret_cast<const char*>(cursor), length), confidence);
+        cursor += length;
+    }
+    return true;
+}
+
+constexpr uint32_t kBinaryMagic = 0x31524353; // "SCR1"
+constexpr uint8_t kBinaryVersion = 2; // 2: sdk_chip_read stage
+
+}
+
+void ScanRecord::reset() {
+    status = ScanStatus::None;
+    detectionResult = 0;
+    processResult = 0;
+    cardType = 0;
+    // clear() keeps the capacity for the next scan.
+    documentName.clear();
+    warning.clear();
+    error.clear();
+    ocr.clear();
+    chip.clear();
+    stageMicros.fill(0);
+}
+
+const char* ScanRecord::statusName(ScanStatus status) {
+    switch (status) {
+        case ScanStatus::Success: return "success";
+        case ScanStatus::PartialSuccess: return "partial_success";
+        case ScanStatus::Error:
+        case ScanStatus::NotReady:
+        case ScanStatus::DetectionFailed: return "error";
+        default: return "none";
+    }
+}
+
+const char* ScanRecord::stageName(ScanStage stage) {
+    switch (stage) {
+        case ScanStage::Detect: return "detect";
+        case ScanStage::Recognize: return "recognize";
+        case ScanStage::SdkChipRead: return "sdk_chip_read";
+        case ScanStage::OcrFields: return "ocr_fields";
+        case ScanStage::ChipFields: return "chip_fields";
+        case ScanStage::Total: return "total";
+        default: return "unknown";
+    }
+}
+
+std::string ScanRecord::mainTypeText() const {
+    if (status == ScanStatus::PartialSuccess) {
+        return "passport_detected";
+    }
+    return std::to_string(processResult);
+}
+
+std::map<std::string, std::string> ScanRecord::toMap() const {
+    std::map<std::string, std::string> result;
+
+    if (status == ScanStatus::None || status == ScanStatus::NotReady || status == ScanStatus::DetectionFailed) {
+        result["error"] = error;
+        return result;
+    }
+
+    result["status"] = statusName(status);
+    result["main_type"] = mainTypeText();
+    result["card_type"] = std::to_string(cardType);
+
+    if (status == ScanStatus::Error) {
+        result["error"] = error;
+        return result;
+    }
+
+    result["document_type"] = documentName;
+    if (!warning.empty()) {
+        result["warning"] = warning;
+    }
+
+    ocr.forEach([&result](const PassportFieldDescriptor& field, std::string_view value) {
+        result[std::string("ocr_") + field.name] = std::string(value);
+    });
+    chip.forEach([&result](const PassportFieldDescriptor& field, std::string_view value) {
+        result[std::string("chip_") + field.name] = std::string(value);
+    });
+    return result;
+}
+
+void ScanRecord::toJson(std::string& out) const {
+    bool first = true;
+    out += '{';
+
+    if (status == ScanStatus::None || status == ScanStatus::NotReady || status == ScanStatus::DetectionFailed) {
+        appendJsonMember(out, first, "error", error);
+        out += '}';
+        return;
+    }
+
+    appendJsonMember(out, first, "status", statusName(status));
+    appendJsonMember(out, first, "main_type", mainTypeText());
+    appendJsonMember(out, first, "card_type", std::to_string(cardType));
+
+    if (status == ScanStatus::Error) {
+        appendJsonMember(out, first, "error", error);
+    } else {
+        appendJsonMember(out, first, "document_type", documentName);
+        if (!warning.empty()) {
+            appendJsonMember(out, first, "warning", warning);
+        }
+
+        std::string key;
+        auto appendFields = [&](const FieldSnapshot& fields, const char* prefix) {
+            fields.forEach([&](const PassportFieldDescriptor& field, std::string_view value) {
+                key.assign(prefix).append(field.name);
+                appendJsonMember(out, first, key, value);
+            });
+        };
+        appendFields(ocr, "ocr_");
+        appendFields(chip, "chip_");
+
+        // "confidence": {"ocr": {"<field>": n, ...}, "chip": {...}}
+        out += ",\"confidence\":{";
+        bool firstSource = true;
+        for (const auto* source : {&ocr, &chip}) {
+            if (!firstSource) out += ',';
+            firstSource = false;
+            out += (source == &ocr) ? "\"ocr\":{" : "\"chip\":{";
+            bool firstField = true;
+            for (size_t i = 0; i < kPassportFieldCount; i++) {
+                if (!source->has(i)) continue;
+                if (!firstField) out += ',';
+                firstField = false;
+                appendJsonString(out, kPassportFields[i].name);
+                out += ':';
+                out += std::to_string(source->confidence(i));
+            }
+            out += '}';
+        }
+        out += '}';
+    }
+
+    out += ",\"timings_us\":{";
+    for (size_t i = 0; i < stageMicros.size(); i++) {
+        if (i > 0) out += ',';
+        appendJsonString(out, stageName(static_cast<ScanStage>(i)));
+        out += ':';
+        out += std::to_string(stageMicros[i]);
+    }
+    out += "}}";
+}
+
+// Layout (host byte order, which is little-endian on every target we ship):
+//   u32 magic "SCR1" | u8 version | u8 status | u16 reserved
+//   i32 detectionResult | i32 processResult | i32 cardType
+//   u8 stageCount | i64 stageMicros[stageCount]
+//   str documentName | str warning | str error          (str = u16 length + bytes)
+//   fields ocr | fields chip    (fields = u8 count, then per field:
+//                                u8 position | i16 confidence | str value)
+void ScanRecord::toBinary(std::vector<uint8_t>& out) const {
+    appendRaw(out, kBinaryMagic);
+    appendRaw(out, kBinaryVersion);
+    appendRaw(out, static_cast<uint8_t>(status));
+    appendRaw(out, static_cast<uint16_t>(0));
+    appendRaw(out, static_cast<int32_t>(detectionResult));
+    appendRaw(out, static_cast<int32_t>(processResult));
+    appendRaw(out, static_cast<int32_t>(cardType));
+
+    appendRaw(out, static_cast<uint8_t>(stageMicros.size()));
+    for (int64_t micros : stageMicros) {
+        appendRaw(out, micros);
+    }
+
+    appendBinaryString(out, documentName);
+    appendBinaryString(out, warning);
+    appendBinaryString(out, error);
+    appendBinaryFields(out, ocr);
+    appendBinaryFields(out, chip);
+}
+
+bool ScanRecord::fromBinary(const uint8_t* data, size_t length) {
+    reset();
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + length;
+
+    uint32_t magic;
+    uint8_t version, statusValue, stageCount;
+    uint16_t reserved;
+    int32_t detection, process, card;
+    if (!readRaw(cursor, end, magic) || !readRaw(cursor, end, version) ||
+        !readRaw(cursor, end, statusValue) || !readRaw(cursor, end, reserved) ||
+        magic != kBinaryMagic || version != kBinaryVersion ||
+        statusValue > static_cast<uint8_t>(ScanStatus::Error) ||
+        !readRaw(cursor, end, detection) || !readRaw(cursor, end, process) ||
+        !readRaw(cursor, end, card) || !readRaw(cursor, end, stageCount)) {
+        reset();
+        return false;
+    }
+    status = static_cast<ScanStatus>(statusValue);
+    detectionResult = detection;
+    processResult = process;
+    cardType = card;
+
+    for (uint8_t i = 0; i < stageCount; i++) {
+        int64_t micros;
+        if (!readRaw(cursor, end, micros)) {
+            reset();
+            return false;
+        }
+        if (i < stageMicros.size()) {
+            stageMicros[i] = micros;
+        }
+    }
+
+    if (!readBinaryString(cursor, end, documentName) || !readBinaryString(cursor, end, warning) ||
+        !readBinaryString(cursor, end, error) || !readBinaryFields(cursor, end, ocr) ||
+        !readBinaryFields(cursor, end, chip)) {
+        reset();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef SINO_SCANNER_SCAN_RECORD_H
+#define SINO_SCANNER_SCAN_RECORD_H
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "field_snapshot.h"
+
+enum class ScanStatus : uint8_t {
+    None,            // Record not filled yet
+    NotReady,        // Scanner not initialized
+    DetectionFailed, // No document placed before the timeout, or detect error
+    Success,
+    PartialSuccess,  // AutoProcessIDCard returned -8 or -9
+    Error
+};
+
+// Wall-clock stages of one scanDocumentComplete() call, in microseconds.
+enum class ScanStage : uint8_t {
+    Detect,
+    Recognize,   // AutoProcessIDCard (classification, OCR and chip read)
+    SdkChipRead, // Chip read time reported by GetTimeConsumed, inside Recognize
+    OcrFields,
+    ChipFields,
+    Total,
+    Count
+};
+
+/**
+ * Scan Record
+ *
+ * Typed result of one complete scan. Fields live in two FieldSnapshots (OCR
+ * and chip) indexed by PassportField, side by side, each with its
+ * GetFieldConfEx confidence. SinosecuScanner keeps one record and refills it
+ * on every scan, so the strings and arenas are reused rather than rebuilt.
+ *
+ * The serializers all work from this layout. toJson/toBinary append to a
+ * caller-owned buffer so that buffer can be reused as well.
+ */
+struct ScanRecord {
+    ScanStatus status = ScanStatus::None;
+    int detectionResult = 0;   // waitForDocumentDetection() result
+    int processResult = 0;     // AutoProcessIDCard() return value
+    int cardType = 0;          // AutoProcessIDCard() nCardType flags
+    std::string documentName;
+    std::string warning;
+    std::string error;
+
+    FieldSnapshot ocr;
+    FieldSnapshot chip;
+
+    std::array<int64_t, static_cast<size_t>(ScanStage::Count)> stageMicros{};
+
+    void reset();
+
+    bool succeeded() const { return status == ScanStatus::Success || status == ScanStatus::PartialSuccess; }
+    int64_t stage(ScanStage s) const { return stageMicros[static_cast<size_t>(s)]; }
+    void setStage(ScanStage s, int64_t micros) { stageMicros[static_cast<size_t>(s)] = micros; }
+
+    // Channel keys shared by every serializer.
+    static const char* statusName(ScanStatus status);
+    static const char* stageName(ScanStage stage);
+    std::string mainTypeText() const;
+
+    // Legacy layout: "status", "main_type", ..., "ocr_<field>", "chip_<field>".
+    std::map<std::string, std::string> toMap() const;
+
+    // Same keys as toMap(), plus "confidence" and "timings_us" objects.
+    void toJson(std::string& out) const;
+
+    // Compact little-endian encoding; see scan_record.cpp for the layout.
+    void toBinary(std::vector<uint8_t>& out) const;
+
+    // Inverse of toBinary. Returns false, leaving the record reset, if |data|
+    // is truncated or not a record this build understands.
+    bool fromBinary(const uint8_t* data, size_t length);
+};
+
+#endif //SINO_SCANNER_SCAN_RECORD_H
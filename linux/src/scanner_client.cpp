@@ -0,0 +1,274 @@
+#include "scanner_client.h"
+#include "logger.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// How long connect() waits for a daemon to accept the connection and answer
+// Hello. The runner connects from the GTK main loop, so a daemon that is
+// wedged, or whose listen backlog is full, must not hang it.
+constexpr std::chrono::seconds kHelloTimeout(2);
+
+}
+
+ScannerClient::ScannerClient()
+        : fd(-1),
+          connected(false),
+          daemonProcess(0),
+          nextRequestId(1) {}
+
+ScannerClient::~ScannerClient() {
+    disconnect();
+}
+
+bool ScannerClient::connect(const std::string& socketPath, const std::string& clientName, std::string& error) {
+    DaemonWriter hello;
+    hello.u32(daemon_protocol::kVersion).str(clientName);
+    return open(socketPath, hello.bytes(), error);
+}
+
+bool ScannerClient::connect(const std::string& socketPath, const std::string& clientName, uint32_t reader,
+                            std::string& error) {
+    DaemonWriter hello;
+    hello.u32(daemon_protocol::kVersion).str(clientName).u32(reader);
+    return open(socketPath, hello.bytes(), error);
+}
+
+bool ScannerClient::open(const std::string& socketPath, const std::vector<uint8_t>& hello, std::string& error) {
+    if (connected) {
+        return true;
+    }
+    // Reap the reader and socket of a connection the daemon dropped.
+    disconnect();
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        error = "socket path too long: " + socketPath;
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    // A Unix socket's connect() and send() both block for at most the send
+    // timeout; it is lifted again once the Hello is answered.
+    timeval timeout{static_cast<time_t>(kHelloTimeout.count()), 0};
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0 ||
+        ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        error = "no sino_scannerd at " + socketPath + ": " + strerror(errno);
+        if (fd >= 0) close(fd);
+        fd = -1;
+        return false;
+    }
+
+    connected = true;
+    reader = std::thread(&ScannerClient::run, this);
+
+    auto promise = std::make_shared<std::promise<Reply>>();
+    std::future<Reply> future = promise->get_future();
+    Reply reply;
+    if (!send(DaemonMessage::Hello, hello, [promise](Reply& answer) { promise->set_value(std::move(answer)); })) {
+        reply.errorCode = "DISCONNECTED";
+        reply.errorMessage = "sino_scannerd did not take Hello";
+    } else if (future.wait_for(kHelloTimeout) != std::future_status::ready) {
+        // disconnect() fails the pending Hello; nobody is waiting for it.
+        reply.errorCode = "TIMEOUT";
+        reply.errorMessage = "sino_scannerd did not answer Hello within " +
+                             std::to_string(kHelloTimeout.count()) + " s";
+    } else {
+        reply = future.get();
+    }
+    DaemonReader result(reply.payload);
+    uint32_t version = 0;
+    int32_t pid = 0;
+    if (!reply.ok || !result.u32(version) || !result.i32(pid)) {
+        error = reply.ok ? "malformed Hello reply" : reply.errorCode + ": " + reply.errorMessage;
+        disconnect();
+        return false;
+    }
+    timeout = timeval{0, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    daemonProcess = pid;
+    SINO_LOG_INFO("ScannerClient: Connected to sino_scannerd (pid %d) at %s", pid, socketPath.c_str());
+    return true;
+}
+
+void ScannerClient::disconnect() {
+    if (fd >= 0) {
+        // Wakes the reader out of recv(); it fails whatever is outstanding.
+        shutdown(fd, SHUT_RDWR);
+    }
+    if (reader.joinable()) {
+        reader.join();
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    connected = false;
+}
+
+bool ScannerClient::send(DaemonMessage message, const std::vector<uint8_t>& payload, ReplyHandler handler) {
+    if (!connected) {
+        return false;
+    }
+    DaemonFrame frame;
+    frame.message = message;
+    frame.payload = payload;
+    {
+        // Checked under the lock: once the reader has failed what is pending,
+        // nothing new may be added.
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (!connected) {
+            return false;
+        }
+        frame.requestId = nextRequestId++;
+        if (nextRequestId == 0) nextRequestId = 1;   // 0 is reserved for events
+        pending[frame.requestId] = std::move(handler);
+    }
+
+    std::vector<uint8_t> bytes;
+    frame.encode(bytes);
+    bool written = true;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        size_t offset = 0;
+        while (offset < bytes.size()) {
+            ssize_t sent = ::send(fd, bytes.data() + offset, bytes.size() - offset, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent <= 0) {
+                written = false;
+                break;
+            }
+            offset += static_cast<size_t>(sent);
+        }
+    }
+    if (!written) {
+        // The reader fails everything else once it sees the connection drop.
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending.erase(frame.requestId);
+        return false;
+    }
+    return true;
+}
+
+ScannerClient::Reply ScannerClient::call(DaemonMessage message, const std::vector<uint8_t>& payload) {
+    auto promise = std::make_shared<std::promise<Reply>>();
+    std::future<Reply> future = promise->get_future();
+    if (!send(message, payload, [promise](Reply& reply) { promise->set_value(std::move(reply)); })) {
+        Reply reply;
+        reply.errorCode = "DISCONNECTED";
+        reply.errorMessage = "not connected to sino_scannerd";
+        return reply;
+    }
+    return future.get();
+}
+
+void ScannerClient::run() {
+    FrameDecoder decoder;
+    std::vector<uint8_t> chunk(64 * 1024);
+    DaemonFrame frame;
+    // Descriptors arrive with the first byte of their frame, so always
+    // before the frame is complete, in frame order.
+    std::deque<int> descriptors;
+    alignas(cmsghdr) char control[CMSG_SPACE(4 * sizeof(int))];
+
+    while (true) {
+        iovec buffer{chunk.data(), chunk.size()};
+        msghdr message{};
+        message.msg_iov = &buffer;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t received = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) break;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+                size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (size_t i = 0; i < count; i++) {
+                    int descriptor;
+                    std::memcpy(&descriptor, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+                    descriptors.push_back(descriptor);
+                }
+            }
+        }
+        decoder.feed(chunk.data(), static_cast<size_t>(received));
+
+        while (decoder.next(frame)) {
+            frame.fd = -1;
+            if ((frame.flags & daemon_protocol::kFlagFd) && !descriptors.empty()) {
+                frame.fd = descriptors.front();
+                descriptors.pop_front();
+            }
+            if (frame.isEvent()) {
+                if (eventHandler) {
+                    eventHandler(frame);
+                } else if (frame.fd >= 0) {
+                    close(frame.fd);
+                }
+                continue;
+            }
+            ReplyHandler handler;
+            {
+                std::lock_guard<std::mutex> lock(pendingMutex);
+                auto it = pending.find(frame.requestId);
+                if (it != pending.end()) {
+                    handler = std::move(it->second);
+                    pending.erase(it);
+                }
+            }
+            if (!handler) {
+                if (frame.fd >= 0) close(frame.fd);
+                continue;
+            }
+            Reply reply;
+            reply.fd = frame.fd;
+            reply.ok = !frame.isError();
+            if (reply.ok) {
+                reply.payload = std::move(frame.payload);
+            } else {
+                DaemonReader error(frame.payload);
+                error.str(reply.errorCode);
+                error.str(reply.errorMessage);
+            }
+            handler(reply);
+        }
+        if (decoder.corrupt()) {
+            SINO_LOG_ERROR("ScannerClient: Daemon sent an oversized frame");
+            break;
+        }
+    }
+
+    for (int descriptor : descriptors) {
+        close(descriptor);
+    }
+    connected = false;
+    failPending("connection to sino_scannerd lost");
+    if (disconnectHandler) disconnectHandler();
+}
+
+void ScannerClient::failPending(const std::string& message) {
+    std::map<uint32_t, ReplyHandler> failed;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        failed.swap(pending);
+    }
+    for (auto& [id, handler] : failed) {
+        Reply reply;
+        reply.errorCode = "DISCONNECTED";
+        reply.errorMessage = message;
+        handler(reply);
+    }
+}
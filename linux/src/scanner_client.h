@@ -0,0 +1,93 @@
+#ifndef SINO_SCANNER_SCANNER_CLIENT_H
+#define SINO_SCANNER_SCANNER_CLIENT_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+#include "daemon_protocol.h"
+
+/**
+ * Scanner Client
+ *
+ * Connection to sino_scannerd (see ScannerDaemon). Requests are pipelined:
+ * send() writes the request and returns, and the reply handler runs on the
+ * client's reader thread when the daemon answers, so any number of requests
+ * can be outstanding. Events the client subscribed to arrive on the same
+ * thread through the event handler.
+ *
+ * Descriptors the daemon sends (image segments, see ImageSegmentView) are
+ * passed to the reply or event handler, which owns them.
+ *
+ * If the daemon goes away, every outstanding handler is called with a
+ * DISCONNECTED error and the disconnect handler runs; the client does not
+ * reconnect by itself.
+ */
+class ScannerClient {
+public:
+    struct Reply {
+        bool ok = false;
+        std::string errorCode;       // Daemon error code, or DISCONNECTED
+        std::string errorMessage;
+        std::vector<uint8_t> payload;
+        int fd = -1;                 // Descriptor sent with the reply; the handler owns it
+    };
+
+    using ReplyHandler = std::function<void(Reply& reply)>;
+    using EventHandler = std::function<void(const DaemonFrame& event)>;
+    using DisconnectHandler = std::function<void()>;
+
+    ScannerClient();
+    ~ScannerClient();
+
+    // Handlers run on the reader thread; set them before connect().
+    void setEventHandler(EventHandler handler) { eventHandler = std::move(handler); }
+    void setDisconnectHandler(DisconnectHandler handler) { disconnectHandler = std::move(handler); }
+
+    // Connects and exchanges Hello. Returns false with |error| set if no
+    // daemon answers within a couple of seconds or it speaks another
+    // protocol version.
+    bool connect(const std::string& socketPath, const std::string& clientName, std::string& error);
+    // Same, to a ReaderPool: binds the connection to reader |reader|, so it
+    // behaves as a connection to that reader's own daemon.
+    bool connect(const std::string& socketPath, const std::string& clientName, uint32_t reader, std::string& error);
+    void disconnect();
+    bool isConnected() const { return connected.load(); }
+    pid_t daemonPid() const { return daemonProcess; }
+
+    // Queues a request. Returns false, without calling |handler|, when not
+    // connected.
+    bool send(DaemonMessage message, const std::vector<uint8_t>& payload, ReplyHandler handler);
+
+    // send() and wait for the reply. Must not be called from a handler.
+    Reply call(DaemonMessage message, const std::vector<uint8_t>& payload);
+
+private:
+    bool open(const std::string& socketPath, const std::vector<uint8_t>& hello, std::string& error);
+    void run();
+    void failPending(const std::string& message);
+
+    int fd;
+    std::thread reader;
+    std::atomic<bool> connected;
+    pid_t daemonProcess;
+
+    std::mutex writeMutex;
+    std::mutex pendingMutex;
+    std::map<uint32_t, ReplyHandler> pending;
+    uint32_t nextRequestId;                  // Guarded by pendingMutex
+
+    EventHandler eventHandler;
+    DisconnectHandler disconnectHandler;
+
+    // Prevent copying
+    ScannerClient(const ScannerClient&) = delete;
+    ScannerClient& operator=(const ScannerClient&) = delete;
+};
+
+#endif //SINO_SCANNER_SCANNER_CLIENT_H
@@ -0,0 +1,528 @@
+#include "scanner_daemon.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+int64_t steadyMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+ScannerDaemon::ScannerDaemon()
+        : runningMessage(0),
+          runningSinceMicros(0),
+          runningAllowanceMicros(0) {
+    // Detection polls go through the SDK thread, like every other SDK call.
+    detectionEngine = std::make_unique<DetectionEngine>([this]() {
+        return executor.submit([this]() {
+            beginSdkCall(DaemonMessage::DetectDocument, 0);
+            int result = scanner.detectDocumentOnScanner();
+            endSdkCall();
+            return result;
+        }).get();
+    });
+    detectionEngine->addListener([this](const DetectionEngine::Event& event) {
+        DaemonWriter payload;
+        payload.str(DetectionEngine::stateName(event.state)).i32(event.code).i64(event.timestampMs);
+        broadcast(daemon_protocol::kEventDetection, DaemonMessage::DetectionEvent, payload.bytes());
+    });
+}
+
+ScannerDaemon::~ScannerDaemon() {
+    stop();
+}
+
+bool ScannerDaemon::start(std::string& error) {
+    return start(Config(), error);
+}
+
+bool ScannerDaemon::start(const Config& newConfig, std::string& error) {
+    if (isRunning()) {
+        return true;
+    }
+    config = newConfig;
+    ImageRing::Config ringConfig;
+    ringConfig.slots = config.imageSlots;
+    imageRing = std::make_unique<ImageRing>(ringConfig);
+
+    DaemonServer::Config serverConfig;
+    serverConfig.socketPath = config.socketPath;
+    serverConfig.socketMode = config.socketMode;
+    serverConfig.maxClients = config.maxClients;
+    startTime = std::chrono::steady_clock::now();
+    executor.start();
+    if (!startServer(serverConfig, error)) {
+        executor.stop();
+        return false;
+    }
+    config.socketPath = socketPath();
+    SINO_LOG_INFO("ScannerDaemon: Serving %s", config.socketPath.c_str());
+
+    if (config.warmup.isComplete()) {
+        // Queued first, ahead of any client request.
+        markWarming();
+        executor.post([this]() {
+            beginSdkCall(DaemonMessage::Initialize, 0);
+            initialize(config.warmup, false);
+            endSdkCall();
+        });
+    }
+    return true;
+}
+
+void ScannerDaemon::stop() {
+    if (!isRunning()) {
+        return;
+    }
+    stopServer();
+
+    // The engine's probe waits on the SDK thread, so it stops first.
+    scanner.cancelPendingWait();
+    detectionEngine->stop();
+    executor.post([this]() { scanner.releaseScanner(); });
+    executor.stop();
+    SINO_LOG_INFO("ScannerDaemon: Stopped");
+}
+
+void ScannerDaemon::onSubscriptionsChanged(const ClientPtr& client, uint32_t previous, uint32_t current) {
+    if ((current & ~previous) & daemon_protocol::kEventReadiness) {
+        // New readiness subscribers get the current state straight away.
+        send(*client, DaemonMessage::ReadinessEvent, daemon_protocol::kFlagEvent, 0, readinessPayload());
+    }
+    if ((current ^ previous) & daemon_protocol::kEventDetection) {
+        updateDetectionEngine();
+    }
+}
+
+void ScannerDaemon::onDisconnect(const ClientPtr& client) {
+    std::vector<uint64_t> held;
+    {
+        std::lock_guard<std::mutex> lock(heldImagesMutex);
+        auto it = heldImages.find(client->id);
+        if (it != heldImages.end()) {
+            held.swap(it->second);
+            heldImages.erase(it);
+        }
+    }
+    for (uint64_t sequence : held) {
+        imageRing->release(sequence);
+    }
+    // A UI that crashed mid-scan must not leave the SDK waiting out its
+    // detection timeout for nobody.
+    cancelClientWaits(client->id);
+    {
+        std::lock_guard<std::mutex> lock(waitCancelsMutex);
+        waitCancels.erase(client->id);
+    }
+    updateDetectionEngine();
+}
+
+// ================================
+// REPLIES AND EVENTS
+// ================================
+
+void ScannerDaemon::sendImages(Client& client, DaemonMessage message, uint16_t flags, uint32_t requestId,
+                               const std::vector<uint8_t>& payload, const ImageRing::Segment& segment) {
+    bool held = false;
+    {
+        // Checked under heldImagesMutex, so onDisconnect either sees this
+        // segment or the client was already closed.
+        std::lock_guard<std::mutex> lock(heldImagesMutex);
+        if (!isClosed(client)) {
+            heldImages[client.id].push_back(segment.sequence);
+            held = true;
+        }
+    }
+    if (!held) {
+        imageRing->release(segment.sequence);
+        return;
+    }
+    send(client, message, flags | daemon_protocol::kFlagFd, requestId, payload, segment.fd);
+}
+
+void ScannerDaemon::publishImages(const ClientPtr& client, const DaemonFrame& request, int imageTypes) {
+    uint64_t sequence = scanner.publishImages(*imageRing, imageTypes);
+    ImageRing::Segment segment;
+    if (sequence == 0 || !imageRing->acquire(sequence, segment)) {
+        replyError(*client, request, "IMAGES_FAILED", scanner.getLastError());
+        return;
+    }
+    // The reply's reference replaces the one publishing took.
+    imageRing->release(sequence);
+    DaemonWriter payload;
+    payload.u64(sequence);
+    sendImages(*client, request.message, daemon_protocol::kFlagReply, request.requestId, payload.bytes(), segment);
+
+    DaemonWriter event;
+    event.u64(client->id).u64(sequence);
+    for (const ClientPtr& subscriber : subscribers(daemon_protocol::kEventImages)) {
+        if (subscriber != client && imageRing->acquire(sequence, segment)) {
+            sendImages(*subscriber, DaemonMessage::ImagesEvent, daemon_protocol::kFlagEvent, 0, event.bytes(), segment);
+        }
+    }
+}
+
+std::vector<uint8_t> ScannerDaemon::readinessPayload() {
+    std::lock_guard<std::mutex> lock(readinessMutex);
+    DaemonWriter payload;
+    payload.str(readiness.state)
+            .i32(readiness.result)
+            .i64(readiness.timeToReadyMicros)
+            .i64(readiness.phases.verifyMicros)
+            .i64(readiness.phases.sdkInitMicros)
+            .i64(readiness.phases.configFileMicros)
+            .i64(readiness.phases.documentTypesMicros)
+            .i64(readiness.phases.totalMicros);
+    return payload.take();
+}
+
+void ScannerDaemon::setReadiness(const char* state, int result, const SinosecuScanner::InitPhases* phases) {
+    {
+        std::lock_guard<std::mutex> lock(readinessMutex);
+        bool wasReady = readiness.state == "ready";
+        bool ready = strcmp(state, "ready") == 0;
+        readiness.state = state;
+        readiness.result = result;
+        // A repeat Initialize that found the SDK warm keeps the original
+        // time to ready.
+        if (phases && (!ready || !wasReady)) {
+            readiness.phases = *phases;
+            readiness.timeToReadyMicros = ready
+                    ? std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - startTime).count()
+                    : 0;
+        }
+    }
+    broadcast(daemon_protocol::kEventReadiness, DaemonMessage::ReadinessEvent, readinessPayload());
+}
+
+void ScannerDaemon::updateDetectionEngine() {
+    if (!subscribers(daemon_protocol::kEventDetection).empty()) {
+        detectionEngine->start();
+    } else {
+        detectionEngine->pause();
+    }
+}
+
+// ================================
+// REQUESTS
+// ================================
+
+void ScannerDaemon::markWarming() {
+    {
+        std::lock_guard<std::mutex> lock(readinessMutex);
+        if (readiness.state == "ready") {
+            return;
+        }
+    }
+    setReadiness("warming", 0, nullptr);
+}
+
+int ScannerDaemon::initialize(const WarmupSettings& settings, bool save) {
+    int result = scanner.initializeScanner(settings.userId, settings.nType, settings.sdkDirectory,
+                                           settings.configPath);
+    SinosecuScanner::InitPhases phases = scanner.getInitPhases();
+    setReadiness(result == SinosecuScanner::SUCCESS ? "ready" : "failed", result, &phases);
+    if (result == SinosecuScanner::SUCCESS && save) {
+        // Warm up with the same settings on the next start.
+        settings.save();
+    }
+    return result;
+}
+
+void ScannerDaemon::beginSdkCall(DaemonMessage message, int32_t allowanceSeconds) {
+    // The start time and allowance are in place before the message says a
+    // call is running, and the message is cleared first.
+    runningSinceMicros = steadyMicros();
+    runningAllowanceMicros = static_cast<int64_t>(std::max(allowanceSeconds, 0)) * 1000000;
+    runningMessage = static_cast<uint32_t>(message);
+}
+
+void ScannerDaemon::endSdkCall() {
+    runningMessage = 0;
+}
+
+void ScannerDaemon::postSdkWork(const ClientPtr& client, const DaemonFrame& request,
+                                std::function<void(DaemonWriter&)> work, int32_t allowanceSeconds) {
+    DaemonMessage message = request.message;
+    uint32_t requestId = request.requestId;
+    bool queued = executor.post([this, client, message, requestId, allowanceSeconds, work = std::move(work)]() {
+        if (isClosed(*client)) {
+            return;
+        }
+        beginSdkCall(message, allowanceSeconds);
+        DaemonWriter payload;
+        work(payload);
+        endSdkCall();
+        send(*client, message, daemon_protocol::kFlagReply, requestId, payload.bytes());
+    });
+    if (!queued) {
+        replyError(*client, request, "SCANNER_NOT_READY", "SDK thread not running");
+    }
+}
+
+std::function<bool()> ScannerDaemon::clientWaitStop(uint64_t clientId) {
+    std::shared_ptr<std::atomic<uint64_t>> cancels;
+    {
+        std::lock_guard<std::mutex> lock(waitCancelsMutex);
+        auto& entry = waitCancels[clientId];
+        if (!entry) {
+            entry = std::make_shared<std::atomic<uint64_t>>(0);
+        }
+        cancels = entry;
+    }
+    uint64_t seen = cancels->load();
+    return [cancels, seen]() { return cancels->load() != seen; };
+}
+
+void ScannerDaemon::cancelClientWaits(uint64_t clientId) {
+    {
+        std::lock_guard<std::mutex> lock(waitCancelsMutex);
+        auto it = waitCancels.find(clientId);
+        if (it == waitCancels.end()) {
+            return;   // This client never queued a wait
+        }
+        (*it->second)++;
+    }
+    scanner.interruptWait();
+}
+
+void ScannerDaemon::handleFrame(const ClientPtr& client, DaemonFrame& frame) {
+    DaemonReader args(frame.payload);
+
+    switch (frame.message) {
+        case DaemonMessage::Initialize: {
+            WarmupSettings settings;
+            if (!args.str(settings.userId) || !args.i32(settings.nType) ||
+                !args.str(settings.sdkDirectory) || !args.str(settings.configPath)) {
+                break;
+            }
+            markWarming();
+            postSdkWork(client, frame, [this, settings](DaemonWriter& payload) {
+                // Returns at once if the SDK is already warm with these settings.
+                payload.i32(initialize(settings, true));
+            });
+            return;
+        }
+        case DaemonMessage::Release: {
+            if (clientCount() > 1) {
+                // Other clients still use the device; keep the SDK warm.
+                DaemonWriter payload;
+                payload.boolean(false);
+                reply(*client, frame, payload.bytes());
+                return;
+            }
+            scanner.cancelPendingWait();
+            postSdkWork(client, frame, [this](DaemonWriter& payload) {
+                scanner.releaseScanner();
+                payload.boolean(true);
+            });
+            setReadiness("idle", 0, nullptr);
+            return;
+        }
+        case DaemonMessage::DetectDocument:
+            postSdkWork(client, frame, [this](DaemonWriter& payload) {
+                payload.i32(scanner.detectDocumentOnScanner());
+            });
+            return;
+        case DaemonMessage::WaitForDocument: {
+            int32_t timeoutSeconds = 0;
+            if (!args.i32(timeoutSeconds)) {
+                break;
+            }
+            // Taken on arrival, so a Release, or a CancelWait from this
+            // client, while this is still queued cancels it.
+            uint64_t generation = scanner.waitGeneration();
+            std::function<bool()> stop = clientWaitStop(client->id);
+            postSdkWork(client, frame, [this, timeoutSeconds, generation, stop](DaemonWriter& payload) {
+                payload.i32(scanner.waitForDocumentDetection(timeoutSeconds, generation, stop));
+            }, timeoutSeconds);
+            return;
+        }
+        case DaemonMessage::AutoProcess:
+            postSdkWork(client, frame, [this](DaemonWriter& payload) {
+                std::map<std::string, int> result = scanner.autoProcessDocument();
+                payload.u32(static_cast<uint32_t>(result.size()));
+                for (const auto& [key, value] : result) {
+                    payload.str(key).i32(value);
+                }
+            });
+            return;
+        case DaemonMessage::ScanDocument: {
+            int32_t timeoutSeconds = 0;
+            if (!args.i32(timeoutSeconds)) {
+                break;
+            }
+            uint64_t clientId = client->id;
+            uint64_t generation = scanner.waitGeneration();
+            std::function<bool()> stop = clientWaitStop(clientId);
+            postSdkWork(client, frame, [this, timeoutSeconds, clientId, generation, stop](DaemonWriter& payload) {
+                const ScanRecord& record = scanner.scanDocument(timeoutSeconds, generation, stop);
+                auto serializeStart = std::chrono::steady_clock::now();
+                std::vector<uint8_t> encoded;
+                record.toBinary(encoded);
+                if (record.succeeded()) {
+                    auto serializeMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - serializeStart).count();
+                    scanner.getScanMetrics().record(record.documentName, ScanMetrics::Stage::Serialize,
+                                                    serializeMicros);
+                }
+                payload.blob(encoded);
+
+                DaemonWriter event;
+                event.u64(clientId).blob(encoded);
+                broadcast(daemon_protocol::kEventScan, DaemonMessage::ScanEvent, event.bytes());
+            }, timeoutSeconds);
+            return;
+        }
+        case DaemonMessage::GetDocumentFields: {
+            int32_t attribute = 0;
+            if (!args.i32(attribute)) {
+                break;
+            }
+            postSdkWork(client, frame, [this, attribute](DaemonWriter& payload) {
+                const FieldSnapshot& snapshot = scanner.captureFields(attribute);
+                payload.u32(static_cast<uint32_t>(snapshot.size()));
+                for (size_t i = 0; i < kPassportFieldCount; i++) {
+                    if (snapshot.has(i)) {
+                        payload.u32(static_cast<uint32_t>(i)).str(snapshot.value(i));
+                    }
+                }
+            });
+            return;
+        }
+        case DaemonMessage::GetDocumentName:
+            postSdkWork(client, frame, [this](DaemonWriter& payload) {
+                payload.str(scanner.getDocumentName());
+            });
+            return;
+        case DaemonMessage::SaveImages: {
+            std::string basePath;
+            int32_t imageTypes = 0;
+            if (!args.str(basePath) || !args.i32(imageTypes)) {
+                break;
+            }
+            postSdkWork(client, frame, [this, basePath, imageTypes](DaemonWriter& payload) {
+                payload.boolean(scanner.saveImages(basePath, imageTypes));
+            });
+            return;
+        }
+        case DaemonMessage::PublishImages: {
+            int32_t imageTypes = 0;
+            if (!args.i32(imageTypes)) {
+                break;
+            }
+            // Not through postSdkWork: the reply carries the segment.
+            DaemonFrame request;
+            request.message = frame.message;
+            request.requestId = frame.requestId;
+            bool queued = executor.post([this, client, request, imageTypes]() {
+                if (isClosed(*client)) {
+                    return;
+                }
+                        beginSdkCall(request.message, 0);
+                publishImages(client, request, imageTypes);
+                endSdkCall();
+                    });
+            if (!queued) {
+                replyError(*client, frame, "SCANNER_NOT_READY", "SDK thread not running");
+            }
+            return;
+        }
+        case DaemonMessage::ReleaseImages: {
+            uint64_t sequence = 0;
+            if (!args.u64(sequence)) {
+                break;
+            }
+            bool held = false;
+            {
+                std::lock_guard<std::mutex> lock(heldImagesMutex);
+                std::vector<uint64_t>& sent = heldImages[client->id];
+                auto it = std::find(sent.begin(), sent.end(), sequence);
+                if (it != sent.end()) {
+                    sent.erase(it);
+                    held = true;
+                }
+            }
+            if (held) {
+                imageRing->release(sequence);
+            }
+            reply(*client, frame, {});
+            return;
+        }
+        case DaemonMessage::LoadConfiguration: {
+            std::string configPath;
+            if (!args.str(configPath)) {
+                break;
+            }
+            postSdkWork(client, frame, [this, configPath](DaemonWriter& payload) {
+                payload.i32(scanner.loadConfiguration(configPath));
+            });
+            return;
+        }
+        case DaemonMessage::CheckDeviceStatus:
+            if (executor.isBusy()) {
+                // Don't queue a status probe behind a running scan.
+                DaemonWriter payload;
+                payload.i32(scanner.getCachedDeviceStatus());
+                reply(*client, frame, payload.bytes());
+            } else {
+                postSdkWork(client, frame, [this](DaemonWriter& payload) {
+                    payload.i32(scanner.checkDeviceStatus());
+                });
+            }
+            return;
+        case DaemonMessage::GetLastError: {
+            DaemonWriter payload;
+            payload.str(scanner.getLastError());
+            reply(*client, frame, payload.bytes());
+            return;
+        }
+        case DaemonMessage::CancelWait:
+            // Only waits this client started, running or queued; another
+            // client's scan is not this client's to abort.
+            cancelClientWaits(client->id);
+            reply(*client, frame, {});
+            return;
+        case DaemonMessage::GetReadiness:
+            reply(*client, frame, readinessPayload());
+            return;
+        case DaemonMessage::Heartbeat: {
+            uint32_t message = runningMessage.load();
+            int64_t since = runningSinceMicros.load();
+            DaemonWriter payload;
+            payload.u32(message)
+                    .i64(message ? steadyMicros() - since : 0)
+                    .i64(message ? runningAllowanceMicros.load() : 0);
+            reply(*client, frame, payload.bytes());
+            return;
+        }
+        case DaemonMessage::GetScanMetrics: {
+            bool reset = false;
+            if (!args.boolean(reset)) {
+                break;
+            }
+            // ScanMetrics is thread-safe; never waits behind a running scan.
+            std::vector<uint8_t> metrics;
+            if (reset) {
+                scanner.getScanMetrics().toBinaryAndReset(metrics);
+            } else {
+                scanner.getScanMetrics().toBinary(metrics);
+            }
+            DaemonWriter payload;
+            payload.blob(metrics);
+            reply(*client, frame, payload.bytes());
+            return;
+        }
+        default:
+            replyError(*client, frame, "UNKNOWN_MESSAGE",
+                       "unknown message " + std::to_string(static_cast<unsigned>(frame.message)));
+            return;
+    }
+    replyError(*client, frame, "BAD_REQUEST",
+               std::string("malformed ") + daemon_protocol::messageName(frame.message) + " request");
+}
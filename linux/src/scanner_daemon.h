@@ -0,0 +1,135 @@
+#ifndef SINO_SCANNER_SCANNER_DAEMON_H
+#define SINO_SCANNER_SCANNER_DAEMON_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+#include "daemon_protocol.h"
+#include "daemon_server.h"
+#include "detection_engine.h"
+#include "image_ring.h"
+#include "scanner_executor.h"
+#include "scanner_warmup.h"
+#include "sinosecu_wrapper.h"
+
+/**
+ * Scanner Daemon
+ *
+ * Owns the SDK and one SinosecuScanner for the life of the process and
+ * serves them to any number of local clients over a Unix stream socket
+ * (see daemon_protocol.h). The Flutter runner, back-office tools and batch
+ * jobs all share the one reader this way, and a client crashing no longer
+ * costs the device an InitIDCard.
+ *
+ * The socket side is DaemonServer's. Requests that touch the SDK are queued
+ * on a ScannerExecutor, exactly as the runner queues its channel calls, so
+ * SDK calls from all clients are serialized in arrival order; everything
+ * else is answered on the I/O thread.
+ *
+ * A client that disconnects has its queued SDK requests dropped, its
+ * running detection wait cancelled and its image segments released.
+ * Release only releases the SDK when no other client is connected.
+ *
+ * PublishImages hands a scan's images out as a sealed memfd from an
+ * ImageRing, sent over the socket with SCM_RIGHTS, instead of files.
+ *
+ * Heartbeat is answered on the I/O thread with the SDK call in progress and
+ * how long it has run, so a supervisor (ReaderPool) can tell a hung SDK
+ * call from a slow one without waiting behind it.
+ */
+class ScannerDaemon : public DaemonServer {
+public:
+    struct Config {
+        std::string socketPath;        // Empty: daemon_protocol::defaultSocketPath()
+        mode_t socketMode = 0660;      // Owner and group may connect
+        size_t maxClients = 32;
+        size_t imageSlots = 8;         // Image segments kept for PublishImages
+        WarmupSettings warmup;         // Initialized at start when complete
+    };
+
+    ScannerDaemon();
+    ~ScannerDaemon() override;
+
+    // Binds the socket and starts serving. Returns false with |error| set if
+    // the socket cannot be created or another daemon already serves it.
+    bool start(std::string& error);
+    bool start(const Config& config, std::string& error);
+
+    // Disconnects every client, releases the SDK and joins all threads.
+    void stop();
+
+protected:
+    void handleFrame(const ClientPtr& client, DaemonFrame& frame) override;
+    void onSubscriptionsChanged(const ClientPtr& client, uint32_t previous, uint32_t current) override;
+    void onDisconnect(const ClientPtr& client) override;
+
+private:
+    struct Readiness {
+        std::string state = "idle";    // idle | warming | ready | failed
+        int result = 0;
+        int64_t timeToReadyMicros = 0;
+        SinosecuScanner::InitPhases phases;
+    };
+
+    // Queues |work| on the SDK thread on behalf of |client| and replies with
+    // what it writes. Dropped if the client disconnects before it runs.
+    // |allowanceSeconds| is the detection wait the call asked for.
+    void postSdkWork(const ClientPtr& client, const DaemonFrame& request, std::function<void(DaemonWriter&)> work,
+                     int32_t allowanceSeconds = 0);
+    // SDK thread. Brackets every SDK call, for Heartbeat.
+    void beginSdkCall(DaemonMessage message, int32_t allowanceSeconds);
+    void endSdkCall();
+    void markWarming();
+    // SDK thread. initializeScanner, then publishes the outcome as readiness.
+    int initialize(const WarmupSettings& settings, bool save);
+    // SDK thread. Publishes the images, replies with the segment and sends
+    // it to every ImagesEvent subscriber.
+    void publishImages(const ClientPtr& client, const DaemonFrame& request, int imageTypes);
+
+    // send() with the segment's descriptor; |client| takes over a reference
+    // the caller already acquired.
+    void sendImages(Client& client, DaemonMessage message, uint16_t flags, uint32_t requestId,
+                    const std::vector<uint8_t>& payload, const ImageRing::Segment& segment);
+
+    // A stop condition for a wait |clientId| is queueing now: true once
+    // cancelClientWaits(clientId) is called. Other clients' waits, queued
+    // or running, are left alone.
+    std::function<bool()> clientWaitStop(uint64_t clientId);
+    void cancelClientWaits(uint64_t clientId);
+
+    void setReadiness(const char* state, int result, const SinosecuScanner::InitPhases* phases);
+    std::vector<uint8_t> readinessPayload();
+    void updateDetectionEngine();
+
+    Config config;
+    SinosecuScanner scanner;
+    ScannerExecutor executor;
+    std::unique_ptr<DetectionEngine> detectionEngine;
+    std::unique_ptr<ImageRing> imageRing;
+    std::atomic<uint32_t> runningMessage;          // SDK call in progress, 0 when idle
+    std::atomic<int64_t> runningSinceMicros;       // steady_clock
+    std::atomic<int64_t> runningAllowanceMicros;
+
+    std::mutex heldImagesMutex;
+    std::map<uint64_t, std::vector<uint64_t>> heldImages;   // Client ID -> segments sent, not yet released
+
+    std::mutex waitCancelsMutex;
+    std::map<uint64_t, std::shared_ptr<std::atomic<uint64_t>>> waitCancels;   // Client ID -> CancelWaits so far
+
+    std::mutex readinessMutex;
+    Readiness readiness;
+    std::chrono::steady_clock::time_point startTime;
+
+    // Prevent copying
+    ScannerDaemon(const ScannerDaemon&) = delete;
+    ScannerDaemon& operator=(const ScannerDaemon&) = delete;
+};
+
+#endif //SINO_SCANNER_SCANNER_DAEMON_H
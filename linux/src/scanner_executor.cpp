@@ -0,0 +1,92 @@
+#include "scanner_executor.h"
+#include "logger.h"
+
+ScannerExecutor::ScannerExecutor() : running(false), executing(false) {}
+
+ScannerExecutor::~ScannerExecutor() {
+    stop();
+}
+
+void ScannerExecutor::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    running = true;
+    worker = std::thread(&ScannerExecutor::run, this);
+}
+
+void ScannerExecutor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    condition.notify_all();
+
+    if (worker.joinable()) {
+        if (worker.get_id() == std::this_thread::get_id()) {
+            // Stopping from inside a task: the loop exits once the task returns.
+            worker.detach();
+        } else {
+            worker.join();
+        }
+    }
+}
+
+bool ScannerExecutor::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return false;
+        }
+        tasks.push_back(std::move(task));
+    }
+    condition.notify_one();
+    return true;
+}
+
+bool ScannerExecutor::isBusy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return executing.load() || !tasks.empty();
+}
+
+bool ScannerExecutor::isCurrentThread() const {
+    return worker.get_id() == std::this_thread::get_id();
+}
+
+size_t ScannerExecutor::pendingTasks() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size();
+}
+
+void ScannerExecutor::run() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return !running || !tasks.empty(); });
+
+            // Drain the queue before honouring a stop request so that queued
+            // releaseScanner() calls still reach the SDK.
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            executing = true;
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            SINO_LOG_ERROR("ScannerExecutor: task threw: %s", e.what());
+        } catch (...) {
+            SINO_LOG_ERROR("ScannerExecutor: task threw an unknown exception");
+        }
+
+        executing = false;
+    }
+}
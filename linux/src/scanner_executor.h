@@ -0,0 +1,79 @@
+#ifndef SINO_SCANNER_SCANNER_EXECUTOR_H
+#define SINO_SCANNER_SCANNER_EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+/**
+ * Scanner Executor
+ *
+ * A single long-lived worker thread that serializes every call into the
+ * Sinosecu SDK. The SDK keeps process-global state and is not safe to call
+ * from several threads, and most of its entry points block (detection waits,
+ * AutoProcessIDCard, chip reads), so none of them may run on the GTK main loop.
+ *
+ * Tasks run in FIFO order. Callers that need a result either use submit()
+ * and wait on the returned future, or post() a task that hands its result
+ * back to the main loop itself.
+ */
+class ScannerExecutor {
+public:
+    using Task = std::function<void()>;
+
+    ScannerExecutor();
+    ~ScannerExecutor();
+
+    // Start the worker thread. Calling start() on a running executor is a no-op.
+    void start();
+
+    // Run every task that is already queued, then join the worker thread.
+    void stop();
+
+    // Queue a task. Returns false if the executor is not running.
+    bool post(Task task);
+
+    // Queue a callable and get a future for its result.
+    template<typename F>
+    auto submit(F&& callable) -> std::future<std::invoke_result_t<F>> {
+        using Result = std::invoke_result_t<F>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(callable));
+        std::future<Result> future = packaged->get_future();
+        if (!post([packaged]() { (*packaged)(); })) {
+            // Not running: execute inline so the future is always satisfied.
+            (*packaged)();
+        }
+        return future;
+    }
+
+    // True while a task is executing or waiting in the queue.
+    bool isBusy() const;
+
+    // True when called from the worker thread itself.
+    bool isCurrentThread() const;
+
+    size_t pendingTasks() const;
+
+private:
+    void run();
+
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Task> tasks;
+    bool running;
+    std::atomic<bool> executing;
+
+    // Prevent copying
+    ScannerExecutor(const ScannerExecutor&) = delete;
+    ScannerExecutor& operator=(const ScannerExecutor&) = delete;
+};
+
+#endif //SINO_SCANNER_SCANNER_EXECUTOR_H
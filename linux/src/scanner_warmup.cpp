@@ -0,0 +1,142 @@
+#include "scanner_warmup.h"
+#include "logger.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <unistd.h>
+
+namespace {
+
+constexpr const char* kUserIdKey = "SINO_SCANNER_USER_ID";
+constexpr const char* kTypeKey = "SINO_SCANNER_NTYPE";
+constexpr const char* kSdkDirectoryKey = "SINO_SCANNER_SDK_DIR";
+constexpr const char* kConfigKey = "SINO_SCANNER_CONFIG";
+
+void apply(WarmupSettings& settings, std::string_view key, const std::string& value) {
+    if (key == kUserIdKey) {
+        settings.userId = value;
+    } else if (key == kTypeKey) {
+        settings.nType = std::atoi(value.c_str());
+    } else if (key == kSdkDirectoryKey) {
+        settings.sdkDirectory = value;
+    } else if (key == kConfigKey) {
+        settings.configPath = value;
+    }
+}
+
+bool loadFile(WarmupSettings& settings, const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t separator = line.find('=');
+        if (line.empty() || line[0] == '#' || separator == std::string::npos) {
+            continue;
+        }
+        apply(settings, std::string_view(line).substr(0, separator), line.substr(separator + 1));
+    }
+    return true;
+}
+
+}
+
+std::string WarmupSettings::settingsPath() {
+    const char* config = std::getenv("XDG_CONFIG_HOME");
+    if (config && *config) {
+        return std::string(config) + "/sino_scanner/warmup.conf";
+    }
+    const char* home = std::getenv("HOME");
+    if (home && *home) {
+        return std::string(home) + "/.config/sino_scanner/warmup.conf";
+    }
+    return std::string();
+}
+
+std::string WarmupSettings::bundleLibDirectory() {
+    std::error_code error;
+    std::filesystem::path executable = std::filesystem::read_symlink("/proc/self/exe", error);
+    if (error) {
+        return std::string();
+    }
+    return (executable.parent_path() / "lib").string();
+}
+
+WarmupSettings WarmupSettings::load() {
+    WarmupSettings settings;
+    std::string path = settingsPath();
+    if (!path.empty() && loadFile(settings, path)) {
+        SINO_LOG_DEBUG("Warm-up settings read from %s", path.c_str());
+    }
+
+    // The environment overrides the saved file key by key.
+    for (const char* key : {kUserIdKey, kTypeKey, kSdkDirectoryKey, kConfigKey}) {
+        const char* value = std::getenv(key);
+        if (value && *value) {
+            apply(settings, key, value);
+        }
+    }
+
+    if (settings.sdkDirectory.empty()) {
+        settings.sdkDirectory = bundleLibDirectory();
+    }
+    return settings;
+}
+
+bool WarmupSettings::save() const {
+    std::string path = settingsPath();
+    if (path.empty() || !isComplete()) {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    // Write a sibling and rename, so a crash never leaves a torn file. It
+    // holds the license user ID, so only its owner may read it; O_EXCL keeps
+    // us from writing through a file someone else planted there. A sibling
+    // left over from a crash is ours to replace.
+    std::string temporary = path + ".tmp";
+    ::unlink(temporary.c_str());
+    int fd = ::open(temporary.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        SINO_LOG_WARN("Cannot write warm-up settings to %s: %s", temporary.c_str(), strerror(errno));
+        return false;
+    }
+    std::ostringstream contents;
+    contents << "# Written by sino_scanner after a successful initializeScanner\n"
+             << kUserIdKey << '=' << userId << '\n'
+             << kTypeKey << '=' << nType << '\n'
+             << kSdkDirectoryKey << '=' << sdkDirectory << '\n';
+    if (!configPath.empty()) {
+        contents << kConfigKey << '=' << configPath << '\n';
+    }
+    std::string text = contents.str();
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t n = ::write(fd, text.data() + written, text.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            SINO_LOG_WARN("Cannot write warm-up settings to %s: %s", temporary.c_str(), strerror(errno));
+            ::close(fd);
+            ::unlink(temporary.c_str());
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        SINO_LOG_WARN("Cannot replace %s: %s", path.c_str(), error.message().c_str());
+        return false;
+    }
+    return true;
+}
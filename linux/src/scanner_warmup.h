@@ -0,0 +1,45 @@
+#ifndef SINO_SCANNER_SCANNER_WARMUP_H
+#define SINO_SCANNER_SCANNER_WARMUP_H
+
+#include <string>
+
+/**
+ * Warm-up Settings
+ *
+ * What the runner needs to initialize the SDK on its own at startup, before
+ * the Dart UI asks for it: InitIDCard loads some 73 MB of models, templates
+ * and OCR engines, and paying for that on the first scan is what warm-up is
+ * meant to avoid.
+ *
+ * Settings come from the environment when set, otherwise from the file the
+ * runner saved after the last successful initializeScanner call from Dart:
+ *
+ *   SINO_SCANNER_USER_ID   license user ID (required; warm-up is skipped without it)
+ *   SINO_SCANNER_NTYPE     InitIDCard nType, default 0
+ *   SINO_SCANNER_SDK_DIR   SDK directory, default <executable dir>/lib
+ *   SINO_SCANNER_CONFIG    optional SetConfigByFile path
+ *
+ * The saved file is $XDG_CONFIG_HOME/sino_scanner/warmup.conf (falling back
+ * to ~/.config), one key=value per line with the keys above.
+ */
+struct WarmupSettings {
+    std::string userId;
+    int nType = 0;
+    std::string sdkDirectory;
+    std::string configPath;
+
+    bool isComplete() const { return !userId.empty() && !sdkDirectory.empty(); }
+
+    // Environment first, then the saved file. Incomplete when neither names
+    // a user ID.
+    static WarmupSettings load();
+
+    // Remember settings that initialized successfully for the next start.
+    // Returns false if the file could not be written.
+    bool save() const;
+
+    static std::string settingsPath();
+    static std::string bundleLibDirectory();   // <executable dir>/lib
+};
+
+#endif //SINO_SCANNER_SCANNER_WARMUP_H
@@ -0,0 +1,240 @@
+#include "sdk_trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#ifdef SINO_SCANNER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+template<typename T>
+void appendRaw(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool readRaw(const uint8_t*& cursor, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - cursor) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+struct FileCloser {
+    void operator()(FILE* file) const { fclose(file); }
+};
+
+#ifdef SINO_SCANNER_HAVE_ZSTD
+// Decodes the length-prefixed frames of one decompressed block. Stops at
+// the first frame that does not decode.
+bool decodeFrames(const uint8_t* data, size_t length, std::vector<SdkTraceRecord>& records) {
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + length;
+    while (cursor < end) {
+        uint32_t frameLength;
+        if (!readRaw(cursor, end, frameLength) || static_cast<size_t>(end - cursor) < frameLength) {
+            return false;
+        }
+        SdkTraceRecord record;
+        if (!sdk_trace::decodeRecord(cursor, frameLength, record)) {
+            return false;
+        }
+        records.push_back(std::move(record));
+        cursor += frameLength;
+    }
+    return true;
+}
+#endif
+
+}
+
+void SdkTraceRecord::clear() {
+    call = SdkCall::Count;
+    result = 0;
+    startNs = 0;
+    durationNs = 0;
+    ints.clear();
+    blobs.clear();
+}
+
+namespace sdk_trace {
+
+const char* callName(SdkCall call) {
+    switch (call) {
+        case SdkCall::InitIDCard: return "InitIDCard";
+        case SdkCall::FreeIDCard: return "FreeIDCard";
+        case SdkCall::DetectDocument: return "DetectDocument";
+        case SdkCall::AutoProcessIDCard: return "AutoProcessIDCard";
+        case SdkCall::GetFieldNameEx: return "GetFieldNameEx";
+        case SdkCall::GetRecogResultEx: return "GetRecogResultEx";
+        case SdkCall::GetResultTypeEx: return "GetResultTypeEx";
+        case SdkCall::GetFieldConfEx: return "GetFieldConfEx";
+        case SdkCall::GetIDCardName: return "GetIDCardName";
+        case SdkCall::GetTimeConsumed: return "GetTimeConsumed";
+        case SdkCall::CheckDeviceOnlineEx: return "CheckDeviceOnlineEx";
+        case SdkCall::SetConfigByFile: return "SetConfigByFile";
+        case SdkCall::SetLanguage: return "SetLanguage";
+        case SdkCall::SetSaveImageType: return "SetSaveImageType";
+        case SdkCall::SetRecogVIZ: return "SetRecogVIZ";
+        case SdkCall::SetRecogDG: return "SetRecogDG";
+        case SdkCall::SetRecogChipCardAttribute: return "SetRecogChipCardAttribute";
+        case SdkCall::ResetIDCardID: return "ResetIDCardID";
+        case SdkCall::AddIDCardID: return "AddIDCardID";
+        case SdkCall::SaveImageEx: return "SaveImageEx";
+        default: return "Unknown";
+    }
+}
+
+bool zstdAvailable() {
+#ifdef SINO_SCANNER_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+void encodeHeader(std::vector<uint8_t>& out, uint16_t flags) {
+    appendRaw(out, kMagic);
+    appendRaw(out, kVersion);
+    appendRaw(out, flags);
+}
+
+void encodeRecord(const SdkTraceRecord& record, std::vector<uint8_t>& out) {
+    size_t intCount = std::min<size_t>(record.ints.size(), 0xFF);
+    size_t blobCount = std::min<size_t>(record.blobs.size(), 0xFF);
+
+    size_t lengthOffset = out.size();
+    appendRaw(out, static_cast<uint32_t>(0));   // Patched below
+    size_t payloadStart = out.size();
+
+    appendRaw(out, static_cast<uint8_t>(record.call));
+    appendRaw(out, static_cast<uint8_t>(intCount));
+    appendRaw(out, static_cast<uint8_t>(blobCount));
+    appendRaw(out, static_cast<uint8_t>(0));
+    appendRaw(out, record.result);
+    appendRaw(out, record.startNs);
+    appendRaw(out, record.durationNs);
+    for (size_t i = 0; i < intCount; i++) {
+        appendRaw(out, record.ints[i]);
+    }
+    for (size_t i = 0; i < blobCount; i++) {
+        const std::string& blob = record.blobs[i];
+        appendRaw(out, static_cast<uint32_t>(blob.size()));
+        out.insert(out.end(), blob.begin(), blob.end());
+    }
+
+    uint32_t payloadLength = static_cast<uint32_t>(out.size() - payloadStart);
+    std::memcpy(out.data() + lengthOffset, &payloadLength, sizeof(payloadLength));
+}
+
+bool decodeRecord(const uint8_t* payload, size_t length, SdkTraceRecord& record) {
+    const uint8_t* cursor = payload;
+    const uint8_t* end = payload + length;
+    uint8_t call, intCount, blobCount, reserved;
+    if (!readRaw(cursor, end, call) || !readRaw(cursor, end, intCount) ||
+        !readRaw(cursor, end, blobCount) || !readRaw(cursor, end, reserved) ||
+        !readRaw(cursor, end, record.result) || !readRaw(cursor, end, record.startNs) ||
+        !readRaw(cursor, end, record.durationNs)) {
+        return false;
+    }
+    if (call == 0 || call >= static_cast<uint8_t>(SdkCall::Count)) {
+        return false;
+    }
+    record.call = static_cast<SdkCall>(call);
+
+    record.ints.resize(intCount);
+    for (auto& value : record.ints) {
+        if (!readRaw(cursor, end, value)) return false;
+    }
+    record.blobs.resize(blobCount);
+    for (auto& blob : record.blobs) {
+        uint32_t blobLength;
+        if (!readRaw(cursor, end, blobLength) || static_cast<size_t>(end - cursor) < blobLength) {
+            return false;
+        }
+        blob.assign(reinterpret_cast<const char*>(cursor), blobLength);
+        cursor += blobLength;
+    }
+    return cursor == end;
+}
+
+bool readTrace(const std::string& path, std::vector<SdkTraceRecord>& records, std::string& error) {
+    std::unique_ptr<FILE, FileCloser> file(fopen(path.c_str(), "rb"));
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    uint8_t header[kHeaderBytes];
+    uint32_t magic;
+    uint16_t version, flags;
+    if (fread(header, 1, sizeof(header), file.get()) != sizeof(header)) {
+        error = path + " is too short to be a trace";
+        return false;
+    }
+    std::memcpy(&magic, header, 4);
+    std::memcpy(&version, header + 4, 2);
+    std::memcpy(&flags, header + 6, 2);
+    if (magic != kMagic || version != kVersion) {
+        error = path + " is not an SDK trace (or an unsupported version)";
+        return false;
+    }
+    bool compressed = flags & kFlagZstd;
+#ifndef SINO_SCANNER_HAVE_ZSTD
+    if (compressed) {
+        error = path + " is zstd-compressed, which this build does not read";
+        return false;
+    }
+#endif
+
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> block;
+    while (true) {
+        uint32_t length;
+        if (fread(&length, 1, sizeof(length), file.get()) != sizeof(length)) {
+            break;
+        }
+        if (length > kMaxFrameBytes) {
+            error = path + ": frame too large, trace truncated here";
+            break;
+        }
+        payload.resize(length);
+        if (fread(payload.data(), 1, length, file.get()) != length) {
+            break;   // Torn last frame or block
+        }
+
+        if (!compressed) {
+            SdkTraceRecord record;
+            if (!decodeRecord(payload.data(), payload.size(), record)) {
+                error = path + ": corrupt frame, trace truncated here";
+                break;
+            }
+            records.push_back(std::move(record));
+            continue;
+        }
+
+#ifdef SINO_SCANNER_HAVE_ZSTD
+        unsigned long long contentSize = ZSTD_getFrameContentSize(payload.data(), payload.size());
+        if (contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize == ZSTD_CONTENTSIZE_UNKNOWN ||
+            contentSize > 4 * kMaxFrameBytes) {
+            error = path + ": corrupt block, trace truncated here";
+            break;
+        }
+        block.resize(static_cast<size_t>(contentSize));
+        size_t decompressed = ZSTD_decompress(block.data(), block.size(), payload.data(), payload.size());
+        if (ZSTD_isError(decompressed) || !decodeFrames(block.data(), decompressed, records)) {
+            error = path + ": corrupt block, trace truncated here";
+            break;
+        }
+#endif
+    }
+    return true;
+}
+
+}
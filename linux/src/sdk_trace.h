@@ -0,0 +1,127 @@
+#ifndef SINO_SCANNER_SDK_TRACE_H
+#define SINO_SCANNER_SDK_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Every SDK entry point SinosecuScanner uses. Values are stored in trace
+// files; append only.
+enum class SdkCall : uint8_t {
+    InitIDCard = 1,
+    FreeIDCard,
+    DetectDocument,
+    AutoProcessIDCard,
+    GetFieldNameEx,
+    GetRecogResultEx,
+    GetResultTypeEx,
+    GetFieldConfEx,
+    GetIDCardName,
+    GetTimeConsumed,
+    CheckDeviceOnlineEx,
+    SetConfigByFile,
+    SetLanguage,
+    SetSaveImageType,
+    SetRecogVIZ,
+    SetRecogDG,
+    SetRecogChipCardAttribute,
+    ResetIDCardID,
+    AddIDCardID,
+    SaveImageEx,
+    Count
+};
+
+// What SaveImageEx("<base>.jpg", nType) writes, per nType bit: white, IR,
+// UV, page portrait, chip portrait, each named <base> plus the suffix.
+inline constexpr std::pair<int, const char*> kImageFileSuffixes[] = {
+        {0x01, ".jpg"}, {0x02, "_IR.jpg"}, {0x04, "_UV.jpg"}, {0x08, "_Head.jpg"}, {0x10, "_HeadEc.jpg"},
+};
+
+/**
+ * SDK Trace Record
+ *
+ * One SDK call: its result, when it started and how long it took, plus its
+ * arguments and outputs. Which call uses which slot:
+ *
+ *   InitIDCard                 ints {nType}              blobs {userId, directory}
+ *   DetectDocument, FreeIDCard, CheckDeviceOnlineEx, ResetIDCardID
+ *                              (result only)
+ *   AutoProcessIDCard          ints {nCardType out}
+ *   GetFieldNameEx, GetRecogResultEx
+ *                              ints {attribute, index, bufferLen in, bufferLen out}
+ *                              blobs {value as UTF-8}
+ *   GetResultTypeEx, GetFieldConfEx
+ *                              ints {attribute, index}
+ *   GetIDCardName              ints {bufferLen in, bufferLen out}  blobs {name as UTF-8}
+ *   GetTimeConsumed            ints {mainType, subType}
+ *   SetConfigByFile            blobs {path}
+ *   SetLanguage, SetSaveImageType, SetRecogVIZ, SetRecogDG, SetRecogChipCardAttribute
+ *                              ints {argument}
+ *   AddIDCardID                ints {mainId, subId...}
+ *   SaveImageEx                ints {nType}  blobs {base path, then per file written:
+ *                              name suffix after the base stem, file bytes}
+ *
+ * Void SDK functions record result 0.
+ */
+struct SdkTraceRecord {
+    SdkCall call = SdkCall::Count;
+    int32_t result = 0;
+    int64_t startNs = 0;      // steady_clock, relative to the trace start
+    int64_t durationNs = 0;
+    std::vector<int32_t> ints;
+    std::vector<std::string> blobs;
+
+    void clear();
+};
+
+/**
+ * SDK Trace Format
+ *
+ * Append-only binary file of SdkTraceRecords, shared by the recorder, the
+ * replaying mock SDK and the benchmarks. Host byte order (little-endian on
+ * every target we ship):
+ *
+ *   header   u32 magic "SDKT" | u16 version | u16 flags
+ *   frame*   u32 payload length | payload
+ *   payload  u8 call | u8 intCount | u8 blobCount | u8 reserved
+ *            i32 result | i64 startNs | i64 durationNs
+ *            i32 ints[intCount] | (u32 length, bytes)[blobCount]
+ *
+ * With kFlagZstd the frames are grouped into blocks as the recorder flushes
+ * them, and each block is stored as
+ *
+ *   block    u32 compressed length | one zstd frame holding the block's frames
+ *
+ * A frame (or block) cut short by a crash ends the trace; everything before
+ * it is still read.
+ */
+namespace sdk_trace {
+
+inline constexpr uint32_t kMagic = 0x544B4453;   // "SDKT"
+inline constexpr uint16_t kVersion = 1;
+inline constexpr uint16_t kFlagZstd = 0x1;       // Blocks of frames are zstd-compressed
+inline constexpr size_t kHeaderBytes = 8;
+inline constexpr size_t kMaxFrameBytes = 64 * 1024 * 1024;
+
+const char* callName(SdkCall call);
+
+void encodeHeader(std::vector<uint8_t>& out, uint16_t flags);
+
+// Appends the frame (length prefix included) to |out|.
+void encodeRecord(const SdkTraceRecord& record, std::vector<uint8_t>& out);
+
+// Decodes one payload (without its length prefix).
+bool decodeRecord(const uint8_t* payload, size_t length, SdkTraceRecord& record);
+
+// True when this build can write and read kFlagZstd traces.
+bool zstdAvailable();
+
+// Reads a whole trace file. Returns false with |error| set if the file
+// cannot be opened or is not a trace; a torn last frame is not an error.
+bool readTrace(const std::string& path, std::vector<SdkTraceRecord>& records, std::string& error);
+
+}
+
+#endif //SINO_SCANNER_SDK_TRACE_H
@@ -0,0 +1,549 @@
+#include "sdk_trace_recorder.h"
+#include "logger.h"
+#include "sinosecu_wrapper.h"
+#include "utf8_transcoder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cwchar>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#ifdef SINO_SCANNER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+static_assert((SdkTraceRecorder::kQueueRecords & (SdkTraceRecorder::kQueueRecords - 1)) == 0,
+              "kQueueRecords must be a power of two");
+
+// Encoded frames are written once a batch reaches this size, or after
+// Config::flushInterval, whichever comes first.
+constexpr size_t kBatchBytes = 1024 * 1024;
+constexpr size_t kRecordsPerDrain = 256;
+
+int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+SdkTraceRecorder::SdkTraceRecorder()
+        : slots(std::make_unique<Slot[]>(kQueueRecords)),
+          enqueuePosition(0),
+          dequeuePosition(0),
+          dropped(0),
+          recording(false),
+          producers(0),
+          originNs(0),
+          stopRequested(false),
+          file(nullptr),
+          compressed(false),
+          zstdContext(nullptr),
+          writtenRecords(0),
+          writtenBytes(0) {
+    for (size_t i = 0; i < kQueueRecords; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+SdkTraceRecorder::~SdkTraceRecorder() {
+    stop();
+}
+
+SdkTraceRecorder& SdkTraceRecorder::getInstance() {
+    static SdkTraceRecorder instance;
+    return instance;
+}
+
+std::string SdkTraceRecorder::defaultPath() {
+    std::string directory;
+    const char* state = std::getenv("XDG_STATE_HOME");
+    const char* home = std::getenv("HOME");
+    if (state && *state) {
+        directory = std::string(state) + "/sino_scanner/traces";
+    } else if (home && *home) {
+        directory = std::string(home) + "/.local/state/sino_scanner/traces";
+    } else {
+        directory = "/tmp/sino_scanner/traces";
+    }
+
+    char stamp[32];
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+    return directory + "/sdk-" + stamp + ".sdkt";
+}
+
+bool SdkTraceRecorder::compressionAvailable() {
+    return sdk_trace::zstdAvailable();
+}
+
+int64_t SdkTraceRecorder::now() const {
+    return steadyNanos() - originNs.load(std::memory_order_relaxed);
+}
+
+bool SdkTraceRecorder::start(std::string& error) {
+    return start(Config(), error);
+}
+
+bool SdkTraceRecorder::start(const Config& newConfig, std::string& error) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (recording) {
+        return true;
+    }
+
+    config = newConfig;
+    if (config.path.empty()) {
+        config.path = defaultPath();
+    }
+    std::error_code directoryError;
+    std::filesystem::create_directories(std::filesystem::path(config.path).parent_path(), directoryError);
+
+    file = fopen(config.path.c_str(), "wb");
+    if (!file) {
+        error = "Cannot create SDK trace " + config.path;
+        return false;
+    }
+
+    compressed = config.compress && compressionAvailable();
+    if (config.compress && !compressed) {
+        SINO_LOG_WARN("SDK trace compression requested, but this build has no zstd; writing uncompressed");
+    }
+#ifdef SINO_SCANNER_HAVE_ZSTD
+    if (compressed) {
+        zstdContext = ZSTD_createCCtx();
+    }
+#endif
+
+    batch.clear();
+    sdk_trace::encodeHeader(batch, compressed ? sdk_trace::kFlagZstd : 0);
+    fwrite(batch.data(), 1, batch.size(), file);
+    writtenBytes = batch.size();
+    batch.clear();
+    writtenRecords = 0;
+    dropped = 0;
+    lastFlush = std::chrono::steady_clock::now();
+
+    originNs.store(steadyNanos(), std::memory_order_relaxed);
+    stopRequested = false;
+    writerThread = std::thread(&SdkTraceRecorder::run, this);
+    recording = true;
+
+    SINO_LOG_INFO("Recording SDK calls to %s%s", config.path.c_str(), compressed ? " (zstd)" : "");
+    return true;
+}
+
+SdkTraceRecorder::Stats SdkTraceRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!recording) {
+            return getStatsLocked();
+        }
+        recording = false;
+        // A call that saw recording set is either still publishing its slot
+        // or will give up in claim(); wait for the former.
+        while (producers.load() > 0) {
+            std::this_thread::yield();
+        }
+        stopRequested = true;
+    }
+    stateCondition.notify_all();
+    if (writerThread.joinable()) {
+        writerThread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+#ifdef SINO_SCANNER_HAVE_ZSTD
+    ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(zstdContext));
+#endif
+    zstdContext = nullptr;
+
+    Stats stats = getStatsLocked();
+    SINO_LOG_INFO("SDK trace %s closed: %llu calls, %llu dropped, %llu bytes", stats.path.c_str(),
+                  static_cast<unsigned long long>(stats.records), static_cast<unsigned long long>(stats.dropped),
+                  static_cast<unsigned long long>(stats.bytes));
+    return stats;
+}
+
+void SdkTraceRecorder::startFromEnvironment() {
+    const char* trace = std::getenv("SINO_SCANNER_SDK_TRACE");
+    if (!trace || !*trace) {
+        return;
+    }
+    Config environmentConfig;
+    if (std::string(trace) != "1") {
+        environmentConfig.path = trace;
+    }
+    const char* compress = std::getenv("SINO_SCANNER_SDK_TRACE_ZSTD");
+    environmentConfig.compress = compress && std::string(compress) == "1";
+
+    std::string error;
+    if (!start(environmentConfig, error)) {
+        SINO_LOG_WARN("%s", error.c_str());
+    }
+}
+
+SdkTraceRecorder::Stats SdkTraceRecorder::getStats() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return getStatsLocked();
+}
+
+SdkTraceRecorder::Stats SdkTraceRecorder::getStatsLocked() const {
+    Stats stats;
+    stats.path = config.path;
+    stats.records = writtenRecords.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.bytes = writtenBytes.load(std::memory_order_relaxed);
+    stats.compressed = compressed;
+    return stats;
+}
+
+// Bounded multi-producer queue (Vyukov): a slot is free for position p when
+// its sequence equals p, and holds a record for the writer when it equals
+// p + 1.
+SdkTraceRecorder::Slot* SdkTraceRecorder::claim() {
+    producers.fetch_add(1);
+    if (!recording.load()) {
+        producers.fetch_sub(1);
+        return nullptr;
+    }
+
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots[position & (kQueueRecords - 1)];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                return &slot;
+            }
+        } else if (difference < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            producers.fetch_sub(1);
+            return nullptr;
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void SdkTraceRecorder::publish(Slot* slot) {
+    size_t position = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    producers.fetch_sub(1);
+}
+
+void SdkTraceRecorder::run() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (!stopRequested) {
+        lock.unlock();
+        bool wrote = drainOnce();
+        if (batch.size() >= kBatchBytes ||
+            std::chrono::steady_clock::now() - lastFlush >= config.flushInterval) {
+            flush();
+        }
+        lock.lock();
+        if (!wrote) {
+            // Producers never signal (that would mean a lock on the SDK
+            // thread); the queue is deep enough to poll.
+            stateCondition.wait_for(lock, std::chrono::milliseconds(20), [this]() { return stopRequested; });
+        }
+    }
+    lock.unlock();
+
+    // Final drain: every call published before stop() is written.
+    while (drainOnce()) {
+    }
+    flush();
+}
+
+bool SdkTraceRecorder::drainOnce() {
+    size_t drained = 0;
+    while (drained < kRecordsPerDrain) {
+        Slot& slot = slots[dequeuePosition & (kQueueRecords - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+            break;
+        }
+
+        SdkTraceRecord& record = slot.record;
+        if (record.call == SdkCall::SaveImageEx && config.captureImages) {
+            captureImages(record);
+        }
+        sdk_trace::encodeRecord(record, batch);
+        writtenRecords.fetch_add(1, std::memory_order_relaxed);
+        record.blobs.clear();   // Drop image bytes now rather than when the slot is reused
+
+        slot.sequence.store(dequeuePosition + kQueueRecords, std::memory_order_release);
+        dequeuePosition++;
+        drained++;
+
+        if (batch.size() >= kBatchBytes) {
+            flush();
+        }
+    }
+    return drained > 0;
+}
+
+void SdkTraceRecorder::captureImages(SdkTraceRecord& record) {
+    if (record.blobs.empty()) {
+        return;
+    }
+
+    // SaveImageEx writes one file per requested image type next to the path
+    // it was given, named after its stem: base.jpg, base_IR.jpg, ... Only
+    // those names are read; the directory may hold any number of others.
+    std::filesystem::path base(record.blobs[0]);
+    std::string stem = (base.parent_path() / base.stem()).string();
+    int imageTypes = record.ints.empty() ? 0 : record.ints[0];
+    std::error_code error;
+    size_t total = 0;
+    for (const auto& [type, suffix] : kImageFileSuffixes) {
+        std::string path = stem + suffix;
+        if (!(imageTypes & type) || !std::filesystem::is_regular_file(path, error)) {
+            continue;
+        }
+
+        std::ifstream image(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(image)), std::istreambuf_iterator<char>());
+        total += bytes.size();
+        if (total > sdk_trace::kMaxFrameBytes / 2) {
+            SINO_LOG_WARN("SDK trace: images for %s exceed the frame limit; the rest are left out",
+                          record.blobs[0].c_str());
+            break;
+        }
+        record.blobs.push_back(suffix);
+        record.blobs.push_back(std::move(bytes));
+    }
+}
+
+void SdkTraceRecorder::flush() {
+    lastFlush = std::chrono::steady_clock::now();
+    if (batch.empty() || !file) {
+        return;
+    }
+
+    const uint8_t* data = batch.data();
+    size_t length = batch.size();
+#ifdef SINO_SCANNER_HAVE_ZSTD
+    if (compressed) {
+        // One zstd frame per block, prefixed with its compressed length.
+        compressedBatch.resize(sizeof(uint32_t) + ZSTD_compressBound(batch.size()));
+        size_t written = ZSTD_compressCCtx(static_cast<ZSTD_CCtx*>(zstdContext),
+                                           compressedBatch.data() + sizeof(uint32_t),
+                                           compressedBatch.size() - sizeof(uint32_t),
+                                           batch.data(), batch.size(), config.compressionLevel);
+        if (ZSTD_isError(written)) {
+            SINO_LOG_WARN("SDK trace: zstd failed (%s); %zu bytes of calls lost",
+                          ZSTD_getErrorName(written), batch.size());
+            batch.clear();
+            return;
+        }
+        uint32_t blockLength = static_cast<uint32_t>(written);
+        std::memcpy(compressedBatch.data(), &blockLength, sizeof(blockLength));
+        data = compressedBatch.data();
+        length = sizeof(uint32_t) + written;
+    }
+#endif
+
+    if (fwrite(data, 1, length, file) != length) {
+        SINO_LOG_WARN("SDK trace: write to %s failed", config.path.c_str());
+    }
+    fflush(file);
+    writtenBytes.fetch_add(length, std::memory_order_relaxed);
+    batch.clear();
+}
+
+namespace {
+
+// Calls |invoke| and, while recording, queues a record with the result and
+// timing; |fill| adds the arguments and outputs.
+template<typename Invoke, typename Fill>
+int traced(SdkCall call, Invoke&& invoke, Fill&& fill) {
+    SdkTraceRecorder& recorder = SdkTraceRecorder::getInstance();
+    if (!recorder.isRecording()) {
+        return invoke();
+    }
+    int64_t start = recorder.now();
+    int result = invoke();
+    int64_t end = recorder.now();
+    recorder.record(call, result, start, end, [&](SdkTraceRecord& record) { fill(record, result); });
+    return result;
+}
+
+// Same, for the SDK's void functions.
+template<typename Invoke, typename Fill>
+void tracedVoid(SdkCall call, Invoke&& invoke, Fill&& fill) {
+    traced(call, [&]() { invoke(); return 0; }, [&](SdkTraceRecord& record, int) { fill(record); });
+}
+
+void noArguments(SdkTraceRecord&, int) {}
+
+// Output text as UTF-8: at most |length| units, stopping at a terminator,
+// and never past the |capacity| the caller passed in.
+void appendText(SdkTraceRecord& record, const wchar_t* text, int capacity, int length) {
+    std::string& blob = record.blobs.emplace_back();
+    if (!text || capacity <= 0 || length <= 0) {
+        return;
+    }
+    size_t limit = std::min(static_cast<size_t>(length), static_cast<size_t>(capacity - 1));
+    appendUtf8(blob, std::wstring_view(text, wcsnlen(text, limit)));
+}
+
+void appendPath(SdkTraceRecord& record, const wchar_t* path) {
+    std::string& blob = record.blobs.emplace_back();
+    if (path) {
+        appendUtf8(blob, std::wstring_view(path));
+    }
+}
+
+}
+
+namespace traced_sdk {
+
+int InitIDCard(const wchar_t* lpUserID, int nType, const wchar_t* lpDirectory) {
+    return traced(SdkCall::InitIDCard,
+                  [&]() { return ::InitIDCard(lpUserID, nType, lpDirectory); },
+                  [&](SdkTraceRecord& record, int) {
+                      record.ints.push_back(nType);
+                      appendPath(record, lpUserID);
+                      appendPath(record, lpDirectory);
+                  });
+}
+
+void FreeIDCard() {
+    tracedVoid(SdkCall::FreeIDCard, []() { ::FreeIDCard(); }, [](SdkTraceRecord&) {});
+}
+
+int DetectDocument() {
+    return traced(SdkCall::DetectDocument, []() { return ::DetectDocument(); }, noArguments);
+}
+
+int AutoProcessIDCard(int& nCardType) {
+    return traced(SdkCall::AutoProcessIDCard,
+                  [&]() { return ::AutoProcessIDCard(nCardType); },
+                  [&](SdkTraceRecord& record, int) { record.ints.push_back(nCardType); });
+}
+
+int GetFieldNameEx(int nAttribute, int nIndex, wchar_t* lpBuffer, int& nBufferLen) {
+    int capacity = nBufferLen;
+    return traced(SdkCall::GetFieldNameEx,
+                  [&]() { return ::GetFieldNameEx(nAttribute, nIndex, lpBuffer, nBufferLen); },
+                  [&](SdkTraceRecord& record, int result) {
+                      record.ints.assign({nAttribute, nIndex, capacity, nBufferLen});
+                      appendText(record, result == 0 ? lpBuffer : nullptr, capacity, nBufferLen);
+                  });
+}
+
+int GetRecogResultEx(int nAttribute, int nIndex, wchar_t* lpBuffer, int& nBufferLen) {
+    int capacity = nBufferLen;
+    return traced(SdkCall::GetRecogResultEx,
+                  [&]() { return ::GetRecogResultEx(nAttribute, nIndex, lpBuffer, nBufferLen); },
+                  [&](SdkTraceRecord& record, int result) {
+                      record.ints.assign({nAttribute, nIndex, capacity, nBufferLen});
+                      appendText(record, result == 0 ? lpBuffer : nullptr, capacity, nBufferLen);
+                  });
+}
+
+int GetResultTypeEx(int nAttribute, int nIndex) {
+    return traced(SdkCall::GetResultTypeEx,
+                  [&]() { return ::GetResultTypeEx(nAttribute, nIndex); },
+                  [&](SdkTraceRecord& record, int) { record.ints.assign({nAttribute, nIndex}); });
+}
+
+int GetFieldConfEx(int nAttribute, int nIndex) {
+    return traced(SdkCall::GetFieldConfEx,
+                  [&]() { return ::GetFieldConfEx(nAttribute, nIndex); },
+                  [&](SdkTraceRecord& record, int) { record.ints.assign({nAttribute, nIndex}); });
+}
+
+int GetIDCardName(wchar_t* lpBuffer, int& nBufferLen) {
+    int capacity = nBufferLen;
+    return traced(SdkCall::GetIDCardName,
+                  [&]() { return ::GetIDCardName(lpBuffer, nBufferLen); },
+                  [&](SdkTraceRecord& record, int result) {
+                      record.ints.assign({capacity, nBufferLen});
+                      appendText(record, result == 0 ? lpBuffer : nullptr, capacity, nBufferLen);
+                  });
+}
+
+int GetTimeConsumed(int nMainTimeType, int nSubTimeType) {
+    return traced(SdkCall::GetTimeConsumed,
+                  [&]() { return ::GetTimeConsumed(nMainTimeType, nSubTimeType); },
+                  [&](SdkTraceRecord& record, int) { record.ints.assign({nMainTimeType, nSubTimeType}); });
+}
+
+int CheckDeviceOnlineEx() {
+    return traced(SdkCall::CheckDeviceOnlineEx, []() { return ::CheckDeviceOnlineEx(); }, noArguments);
+}
+
+int SetConfigByFile(const wchar_t* lpConfigFile) {
+    return traced(SdkCall::SetConfigByFile,
+                  [&]() { return ::SetConfigByFile(lpConfigFile); },
+                  [&](SdkTraceRecord& record, int) { appendPath(record, lpConfigFile); });
+}
+
+int SetLanguage(int nLangType) {
+    return traced(SdkCall::SetLanguage,
+                  [&]() { return ::SetLanguage(nLangType); },
+                  [&](SdkTraceRecord& record, int) { record.ints.push_back(nLangType); });
+}
+
+void SetSaveImageType(int nImageType) {
+    tracedVoid(SdkCall::SetSaveImageType,
+               [&]() { ::SetSaveImageType(nImageType); },
+               [&](SdkTraceRecord& record) { record.ints.push_back(nImageType); });
+}
+
+void SetRecogVIZ(bool bRecogVIZ) {
+    tracedVoid(SdkCall::SetRecogVIZ,
+               [&]() { ::SetRecogVIZ(bRecogVIZ); },
+               [&](SdkTraceRecord& record) { record.ints.push_back(bRecogVIZ ? 1 : 0); });
+}
+
+void SetRecogDG(int nDG) {
+    tracedVoid(SdkCall::SetRecogDG,
+               [&]() { ::SetRecogDG(nDG); },
+               [&](SdkTraceRecord& record) { record.ints.push_back(nDG); });
+}
+
+int SetRecogChipCardAttribute(int nReadCard) {
+    return traced(SdkCall::SetRecogChipCardAttribute,
+                  [&]() { return ::SetRecogChipCardAttribute(nReadCard); },
+                  [&](SdkTraceRecord& record, int) { record.ints.push_back(nReadCard); });
+}
+
+void ResetIDCardID() {
+    tracedVoid(SdkCall::ResetIDCardID, []() { ::ResetIDCardID(); }, [](SdkTraceRecord&) {});
+}
+
+int AddIDCardID(int nMainID, int nSubID[], int nSubIDCount) {
+    return traced(SdkCall::AddIDCardID,
+                  [&]() { return ::AddIDCardID(nMainID, nSubID, nSubIDCount); },
+                  [&](SdkTraceRecord& record, int) {
+                      record.ints.push_back(nMainID);
+                      for (int i = 0; nSubID && i < nSubIDCount; i++) {
+                          record.ints.push_back(nSubID[i]);
+                      }
+                  });
+}
+
+int SaveImageEx(const wchar_t* lpFileName, int nType) {
+    // The image files are read back by the writer thread, not here.
+    return traced(SdkCall::SaveImageEx,
+                  [&]() { return ::SaveImageEx(lpFileName, nType); },
+                  [&](SdkTraceRecord& record, int) {
+                      record.ints.push_back(nType);
+                      appendPath(record, lpFileName);
+                  });
+}
+
+}
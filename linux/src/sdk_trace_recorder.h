@@ -0,0 +1,175 @@
+#ifndef SINO_SCANNER_SDK_TRACE_RECORDER_H
+#define SINO_SCANNER_SDK_TRACE_RECORDER_H
+
+#include "sdk_trace.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * SDK Trace Recorder
+ *
+ * Captures every SDK call SinosecuScanner makes (through traced_sdk below)
+ * into a trace file the mock libIDCard can replay. The calling thread only
+ * fills a preallocated slot in a bounded lock-free queue: the arguments,
+ * result, output text converted to UTF-8, and timing. A writer thread
+ * encodes the slots, reads the image files SaveImageEx wrote, and appends
+ * to the file in batches, flushed at least every flushInterval so a crash
+ * loses little. When the queue is full the call is dropped and counted.
+ *
+ * With compress set (and a build with libzstd), each batch is written as
+ * one zstd frame; see sdk_trace.h.
+ *
+ * While not recording, traced_sdk costs one relaxed atomic load per call.
+ */
+class SdkTraceRecorder {
+public:
+    struct Config {
+        std::string path;                  // Empty: defaultPath()
+        bool compress = false;             // Ignored without libzstd
+        int compressionLevel = 3;
+        bool captureImages = true;         // Read back the files SaveImageEx wrote
+        std::chrono::milliseconds flushInterval{200};
+    };
+
+    struct Stats {
+        std::string path;
+        uint64_t records = 0;
+        uint64_t dropped = 0;
+        uint64_t bytes = 0;                // Written to the file, header included
+        bool compressed = false;
+    };
+
+    static constexpr size_t kQueueRecords = 4096;   // Must be a power of two
+
+    static SdkTraceRecorder& getInstance();
+
+    // Opens the trace and starts the writer thread. Returns false with
+    // |error| set if the file cannot be created; a no-op returning true when
+    // already recording.
+    bool start(std::string& error);
+    bool start(const Config& config, std::string& error);
+
+    // Writes everything queued so far, closes the file and joins the writer.
+    Stats stop();
+
+    // Starts recording when SINO_SCANNER_SDK_TRACE is set: to that path, or
+    // to defaultPath() when it is "1". SINO_SCANNER_SDK_TRACE_ZSTD=1 asks
+    // for compression.
+    void startFromEnvironment();
+
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+    Stats getStats() const;
+
+    // $XDG_STATE_HOME/sino_scanner/traces/sdk-<date>-<time>.sdkt, falling
+    // back to ~/.local/state.
+    static std::string defaultPath();
+    static bool compressionAvailable();
+
+    // Producer side, used by traced_sdk. Nanoseconds since start().
+    int64_t now() const;
+
+    // Claims a queue slot and lets |fill| set the call-specific fields.
+    template<typename Fill>
+    void record(SdkCall call, int32_t result, int64_t startNs, int64_t endNs, Fill&& fill) {
+        Slot* slot = claim();
+        if (!slot) {
+            return;
+        }
+        SdkTraceRecord& entry = slot->record;
+        entry.call = call;
+        entry.result = result;
+        entry.startNs = startNs;
+        entry.durationNs = endNs - startNs;
+        entry.ints.clear();
+        entry.blobs.clear();
+        fill(entry);
+        publish(slot);
+    }
+
+    ~SdkTraceRecorder();
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        SdkTraceRecord record;
+    };
+
+    SdkTraceRecorder();
+
+    Slot* claim();
+    void publish(Slot* slot);
+    void run();
+    bool drainOnce();
+    void captureImages(SdkTraceRecord& record);
+    void flush();
+    Stats getStatsLocked() const;
+
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<size_t> enqueuePosition;
+    alignas(64) size_t dequeuePosition;   // Writer thread only
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> recording;
+    std::atomic<int> producers;           // Between claim() and publish()
+    std::atomic<int64_t> originNs;        // steady_clock at start()
+
+    std::thread writerThread;
+    mutable std::mutex stateMutex;
+    std::condition_variable stateCondition;
+    bool stopRequested;
+
+    Config config;
+    FILE* file;
+    bool compressed;
+    void* zstdContext;                    // ZSTD_CCtx, reused across batches
+    std::vector<uint8_t> batch;           // Encoded frames waiting to be written
+    std::vector<uint8_t> compressedBatch;
+    std::chrono::steady_clock::time_point lastFlush;
+    std::atomic<uint64_t> writtenRecords;
+    std::atomic<uint64_t> writtenBytes;
+
+    // Prevent copying
+    SdkTraceRecorder(const SdkTraceRecorder&) = delete;
+    SdkTraceRecorder& operator=(const SdkTraceRecorder&) = delete;
+};
+
+/**
+ * Traced SDK
+ *
+ * The SDK entry points SinosecuScanner uses, with the same signatures. Each
+ * calls straight through to libIDCard and, while SdkTraceRecorder is
+ * recording, queues a trace record of the call.
+ */
+namespace traced_sdk {
+
+int InitIDCard(const wchar_t* lpUserID, int nType, const wchar_t* lpDirectory);
+void FreeIDCard();
+int DetectDocument();
+int AutoProcessIDCard(int& nCardType);
+int GetFieldNameEx(int nAttribute, int nIndex, wchar_t* lpBuffer, int& nBufferLen);
+int GetRecogResultEx(int nAttribute, int nIndex, wchar_t* lpBuffer, int& nBufferLen);
+int GetResultTypeEx(int nAttribute, int nIndex);
+int GetFieldConfEx(int nAttribute, int nIndex);
+int GetIDCardName(wchar_t* lpBuffer, int& nBufferLen);
+int GetTimeConsumed(int nMainTimeType, int nSubTimeType);
+int CheckDeviceOnlineEx();
+int SetConfigByFile(const wchar_t* lpConfigFile);
+int SetLanguage(int nLangType);
+void SetSaveImageType(int nImageType);
+void SetRecogVIZ(bool bRecogVIZ);
+void SetRecogDG(int nDG);
+int SetRecogChipCardAttribute(int nReadCard);
+void ResetIDCardID();
+int AddIDCardID(int nMainID, int nSubID[], int nSubIDCount);
+int SaveImageEx(const wchar_t* lpFileName, int nType);
+
+}
+
+#endif //SINO_SCANNER_SDK_TRACE_RECORDER_H
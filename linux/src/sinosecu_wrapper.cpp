@@ -1,53 +1,46 @@
 #include "sinosecu_wrapper.h"
 #include "png_wrapper.h"
-#include <iostream>
-#include <locale>
-#include <codecvt>
+#include "image_buffer_pool.h"
+#include "pixel_kernels.h"
+#include "utf8_transcoder.h"
+#include "logger.h"
+#include "sdk_trace.h"
+#include "sdk_trace_recorder.h"
+#include "image_ring.h"
 #include <filesystem>
 #include <thread>
 #include <chrono>
+#include <utility>
+
+// GetTimeConsumed main type for the chip (RFID) read, as used by the SDK's
+// TestLinux sample. The other main types are not documented.
+static constexpr int kTimeConsumedChipRead = 5;
 
 std::wstring string_to_wstring(const std::string& str) {
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> conv;
-    return conv.from_bytes(str);
+    return utf8ToWide(str);
 }
 
 std::string wstring_to_string(const std::wstring& wstr) {
-    if (wstr.empty()) {
-        return "";
-    }
-
-    try {
-        std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> conv;
-        return conv.to_bytes(wstr);
-    } catch (const std::exception& e) {
-        std::cerr << "String conversion error: " << e.what() << std::endl;
-
-        // Fallback: manual conversion for basic ASCII
-        std::string result;
-        for (wchar_t wc : wstr) {
-            if (wc < 128) {
-                result += static_cast<char>(wc);
-            } else {
-                result += '?';
-            }
-        }
-        return result;
-    }
+    return wideToUtf8(wstr);
 }
 
-SinosecuScanner::SinosecuScanner() : isInitialized(false) {}
+SinosecuScanner::SinosecuScanner()
+        : isInitialized(false), initType(0), lastDeviceStatus(0), cancelGeneration(0), wakeRequested(false) {}
 
 SinosecuScanner::~SinosecuScanner() {
     releaseScanner();
 }
 
 void SinosecuScanner::setLastError(const std::string& error) {
-    lastError = error;
-    std::cerr << "SinosecuScanner Error: " << error << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        lastError = error;
+    }
+    SINO_LOG_ERROR("SinosecuScanner Error: %s", error.c_str());
 }
 
 std::string SinosecuScanner::getLastError() const {
+    std::lock_guard<std::mutex> lock(errorMutex);
     return lastError;
 }
 
@@ -60,16 +53,40 @@ bool SinosecuScanner::validateInitialization() {
 }
 
 int SinosecuScanner::initializeScanner(const std::string& userId, int nType, const std::string& sdkDirectory) {
-    std::cout << "=== SinosecuScanner::initializeScanner ===" << std::endl;
-    std::cout << "Architecture: "
-                 #ifdef __aarch64__
-                 "ARM64"
-                 #elif defined(__x86_64__) || defined(_M_X64)
-                 "x86/x64"
-                 #else
-                 "Unknown"
-              #endif
-              << std::endl;
+    return initializeScanner(userId, nType, sdkDirectory, std::string());
+}
+
+int SinosecuScanner::initializeScanner(const std::string& userId, int nType, const std::string& sdkDirectory,
+                                       const std::string& configPath) {
+    using Clock = std::chrono::steady_clock;
+    auto micros = [](Clock::time_point from, Clock::time_point to) {
+        return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+    };
+
+    auto samePath = [](const std::string& a, const std::string& b) {
+        std::error_code error;
+        return a == b || std::filesystem::weakly_canonical(a, error) == std::filesystem::weakly_canonical(b, error);
+    };
+    if (isInitialized && userId == initUserId && nType == initType && samePath(sdkDirectory, sdkPath) &&
+        (configPath.empty() || configPath == initConfigPath)) {
+        // Already warmed up with these settings; re-running InitIDCard would
+        // only throw the loaded models away.
+        SINO_LOG_INFO("Scanner already initialized with these settings");
+        return SUCCESS;
+    }
+
+    SINO_LOG_INFO("=== SinosecuScanner::initializeScanner ===");
+    initPhases = InitPhases();
+    const Clock::time_point initStart = Clock::now();
+    const char* architecture =
+#ifdef __aarch64__
+            "ARM64";
+#elif defined(__x86_64__) || defined(_M_X64)
+            "x86/x64";
+#else
+            "Unknown";
+#endif
+    SINO_LOG_INFO("Architecture: %s", architecture);
 
     // Check if directory exists
     if (!std::filesystem::exists(sdkDirectory)) {
@@ -84,26 +101,30 @@ int SinosecuScanner::initializeScanner(const std::string& userId, int nType, con
         return ERROR_INIT;
     }
 
-    std::cout << "SDK directory verified: " << sdkDirectory << std::endl;
-    std::cout << "libIDCard.so found at: " << libPath << std::endl;
+    SINO_LOG_DEBUG("SDK directory verified: %s", sdkDirectory.c_str());
+    SINO_LOG_DEBUG("libIDCard.so found at: %s", libPath.c_str());
 
     if (isInitialized) {
-        std::cout << "Scanner already initialized, releasing first..." << std::endl;
+        SINO_LOG_INFO("Scanner already initialized, releasing first...");
         releaseScanner();
     }
+    Clock::time_point phaseEnd = Clock::now();
+    initPhases.verifyMicros = micros(initStart, phaseEnd);
 
     std::wstring wUserId = string_to_wstring(userId);
     std::wstring wSdkDirectory = string_to_wstring(sdkDirectory);
 
-    std::cout << "Calling InitIDCard with:" << std::endl;
-    std::cout << "  UserID: " << userId << std::endl;
-    std::cout << "  nType: " << nType << std::endl;
-    std::cout << "  Directory: " << sdkDirectory << std::endl;
+    SINO_LOG_INFO("Calling InitIDCard with UserID: %s, nType: %d, Directory: %s",
+                  userId.c_str(), nType, sdkDirectory.c_str());
 
     int result;
     try {
-        result = InitIDCard(wUserId.c_str(), nType, wSdkDirectory.c_str());
-        std::cout << "InitIDCard returned: " << result << std::endl;
+        Clock::time_point phaseStart = Clock::now();
+        result = traced_sdk::InitIDCard(wUserId.c_str(), nType, wSdkDirectory.c_str());
+        phaseEnd = Clock::now();
+        initPhases.sdkInitMicros = micros(phaseStart, phaseEnd);
+        SINO_LOG_INFO("InitIDCard returned: %d (%lld ms)", result,
+                      static_cast<long long>(initPhases.sdkInitMicros / 1000));
     } catch (const std::exception& e) {
         setLastError("Exception during InitIDCard: " + std::string(e.what()));
         return ERROR_INIT;
@@ -116,13 +137,31 @@ int SinosecuScanner::initializeScanner(const std::string& userId, int nType, con
         case 0:
             isInitialized = true;
             sdkPath = sdkDirectory;
-            std::cout << "SDK initialized successfully!" << std::endl;
+            initUserId = userId;
+            initType = nType;
+            SINO_LOG_INFO("SDK initialized successfully!");
+
+            if (!configPath.empty()) {
+                Clock::time_point phaseStart = Clock::now();
+                int configResult = loadConfiguration(configPath);
+                initPhases.configFileMicros = micros(phaseStart, Clock::now());
+                if (configResult != 0) {
+                    releaseScanner();
+                    return ERROR_CONFIG;
+                }
+                initConfigPath = configPath;
+            }
 
             // Configure scanner for common document types after successful initialization
-            if (!configureDocumentTypes()) {
-                setLastError("Failed to configure document types");
-                releaseScanner();
-                return ERROR_CONFIG;
+            {
+                Clock::time_point phaseStart = Clock::now();
+                bool configured = configureDocumentTypes();
+                initPhases.documentTypesMicros = micros(phaseStart, Clock::now());
+                if (!configured) {
+                    setLastError("Failed to configure document types");
+                    releaseScanner();
+                    return ERROR_CONFIG;
+                }
             }
             break;
         case 1:
@@ -148,17 +187,29 @@ int SinosecuScanner::initializeScanner(const std::string& userId, int nType, con
             break;
     }
 
-    std::cout << "=== initializeScanner complete ===" << std::endl;
+    initPhases.totalMicros = micros(initStart, Clock::now());
+    SINO_LOG_INFO("=== initializeScanner complete (%lld ms) ===", static_cast<long long>(initPhases.totalMicros / 1000));
+    // InitIDCard loads most of the PNGs the SDK reads; a second cycle
+    // should be mostly hits.
+    PngCache::Stats pngCache = PngWrapper::getInstance().cacheStats();
+    SINO_LOG_INFO("PNG cache: %llu hits, %llu misses, %zu images in %zu KB of %zu KB",
+                  static_cast<unsigned long long>(pngCache.hits), static_cast<unsigned long long>(pngCache.misses),
+                  pngCache.entries, pngCache.bytes >> 10, pngCache.budgetBytes >> 10);
+    ImageBufferPool::Stats buffers = ImageBufferPool::getInstance().stats();
+    SINO_LOG_INFO("Image buffers: %zu KB in use (high-water %zu KB), %zu KB pooled, %llu of %llu reused",
+                  buffers.inUseBytes >> 10, buffers.highWaterBytes >> 10, buffers.pooledBytes >> 10,
+                  static_cast<unsigned long long>(buffers.reused), static_cast<unsigned long long>(buffers.acquired));
+    SINO_LOG_INFO("Pixel kernels: %s", pixelKernelIsa());
     return result;
 }
 
 bool SinosecuScanner::configureDocumentTypes() {
     try {
         // Clear any existing document types
-        ResetIDCardID();
+        traced_sdk::ResetIDCardID();
 
         // Set language to English
-        SetLanguage(1);
+        traced_sdk::SetLanguage(1);
 
         // Configure common document types for recognition
         // Based on the SDK documentation, these are common document main IDs:
@@ -172,50 +223,48 @@ bool SinosecuScanner::configureDocumentTypes() {
        // AddIDCardID(5, subIDs, 1);  // Vehicle drivers license
 
         // Passport
-        AddIDCardID(13, subIDs, 1); // Passport
+        traced_sdk::AddIDCardID(13, subIDs, 1); // Passport
 
         // Visa
        // AddIDCardID(12, subIDs, 1); // Visa
 
         // Set image capture options
-        SetSaveImageType(0x1F); // Capture all image types (white, IR, UV, portraits)
+        traced_sdk::SetSaveImageType(0x1F); // Capture all image types (white, IR, UV, portraits)
 
         // Enable page recognition
-        SetRecogVIZ(true);
+        traced_sdk::SetRecogVIZ(true);
 
-        std::cout << "Configuring chip reading..." << std::endl;
+        SINO_LOG_DEBUG("Configuring chip reading...");
         try {
             // Enable chip reading for documents that have chips
-            int chipResult = SetRecogChipCardAttribute(1); // 1 = enable chip reading
+            int chipResult = traced_sdk::SetRecogChipCardAttribute(1); // 1 = enable chip reading
 
             switch(chipResult) {
                 case 0:
-                    std::cout << "Chip reading enabled successfully" << std::endl;
+                    SINO_LOG_INFO("Chip reading enabled successfully");
 
                     // Configure which data groups to read from the chip
-                    SetRecogDG(1); // Enable  (common passport data groups)
+                    traced_sdk::SetRecogDG(1); // Enable  (common passport data groups)
                     //std::cout << "Passport chip data groups configured (DG1-DG12)" << std::endl;
                     break;
 
                 case 1:
-                    std::cout << "Chip reading setup failed - device not initialized" << std::endl;
+                    SINO_LOG_WARN("Chip reading setup failed - device not initialized");
                     break;
 
                 case 2:
-                    std::cout << "Chip reading not supported by this device" << std::endl;
-                    std::cout << "Continuing with OCR-only mode..." << std::endl;
+                    SINO_LOG_WARN("Chip reading not supported by this device, continuing with OCR-only mode");
                     break;
 
                 default:
-                    std::cout << "Chip reading setup returned: " << chipResult << std::endl;
+                    SINO_LOG_WARN("Chip reading setup returned: %d", chipResult);
                     break;
             }
 
         } catch (const std::exception& e) {
-            std::cout << "Chip configuration exception: " << e.what() << std::endl;
-            std::cout << "Continuing with OCR-only mode..." << std::endl;
+            SINO_LOG_WARN("Chip configuration exception: %s, continuing with OCR-only mode", e.what());
         }
-        std::cout << "Document types and settings configured successfully" << std::endl;
+        SINO_LOG_INFO("Document types and settings configured successfully");
         return true;
 
     } catch (const std::exception& e) {
@@ -227,12 +276,14 @@ bool SinosecuScanner::configureDocumentTypes() {
 void SinosecuScanner::releaseScanner() {
     if (isInitialized) {
         try {
-            FreeIDCard();
-            std::cout << "SDK released successfully" << std::endl;
+            traced_sdk::FreeIDCard();
+            SINO_LOG_INFO("SDK released successfully");
         } catch (const std::exception& e) {
             setLastError("Error releasing SDK: " + std::string(e.what()));
         }
         isInitialized = false;
+        initUserId.clear();
+        initConfigPath.clear();
     }
 }
 
@@ -242,21 +293,24 @@ int SinosecuScanner::checkDeviceStatus() {
     }
 
     try {
-        int status = CheckDeviceOnlineEx();
-        std::cout << "Device status: " << status << std::endl;
-
+        int status = traced_sdk::CheckDeviceOnlineEx();
+        if (lastDeviceStatus.exchange(status) != status) {
+            // Reconnects and disconnects should be noticed at the fast rate.
+            std::lock_guard<std::mutex> lock(waitMutex);
+            detectionScheduler.noteActivity();
+        }
         switch(status) {
             case 1:
-                std::cout << "Device connected and initialized" << std::endl;
+                SINO_LOG_TRACE("Device status 1: connected and initialized");
                 break;
             case 2:
-                std::cout << "Device lost connection" << std::endl;
+                SINO_LOG_WARN("Device status 2: lost connection");
                 break;
             case 3:
-                std::cout << "Device lost connection - need re-initialization" << std::endl;
+                SINO_LOG_WARN("Device status 3: lost connection - need re-initialization");
                 break;
             default:
-                std::cout << "Unknown device status: " << status << std::endl;
+                SINO_LOG_WARN("Unknown device status: %d", status);
                 break;
         }
 
@@ -267,6 +321,10 @@ int SinosecuScanner::checkDeviceStatus() {
     }
 }
 
+int SinosecuScanner::getCachedDeviceStatus() const {
+    return lastDeviceStatus.load();
+}
+
 int SinosecuScanner::detectDocumentOnScanner() {
     if (!validateInitialization()) {
         return ERROR_INIT;
@@ -283,26 +341,26 @@ int SinosecuScanner::detectDocumentOnScanner() {
     }
 
     try {
-        int result = DetectDocument();
+        int result = traced_sdk::DetectDocument();
 
         switch(result) {
             case -1:
-                std::cout << "Core engine not initialized" << std::endl;
+                SINO_LOG_WARN("Core engine not initialized");
                 break;
             case 0:
-                std::cout << "No document detected" << std::endl;
+                SINO_LOG_TRACE("No document detected");
                 break;
             case 1:
-                std::cout << "Document detected and placed" << std::endl;
+                SINO_LOG_DEBUG("Document detected and placed");
                 break;
             case 2:
-                std::cout << "Document was taken out" << std::endl;
+                SINO_LOG_DEBUG("Document was taken out");
                 break;
             case 3:
-                std::cout << "Mobile phone barcode detected (AR/KR series)" << std::endl;
+                SINO_LOG_DEBUG("Mobile phone barcode detected (AR/KR series)");
                 break;
             default:
-                std::cout << "Unknown detection result: " << result << std::endl;
+                SINO_LOG_WARN("Unknown detection result: %d", result);
                 break;
         }
 
@@ -314,16 +372,34 @@ int SinosecuScanner::detectDocumentOnScanner() {
 }
 
 int SinosecuScanner::waitForDocumentDetection(int timeoutSeconds) {
+    return waitForDocumentDetection(timeoutSeconds, waitGeneration());
+}
+
+int SinosecuScanner::waitForDocumentDetection(int timeoutSeconds, uint64_t generation,
+                                              const std::function<bool()>& stopRequested) {
     if (!validateInitialization()) {
         return ERROR_INIT;
     }
 
-    std::cout << "Waiting for document detection (timeout: " << timeoutSeconds << "s)..." << std::endl;
+    SINO_LOG_INFO("Waiting for document detection (timeout: %ds)...", timeoutSeconds);
 
     auto startTime = std::chrono::steady_clock::now();
     auto timeoutDuration = std::chrono::seconds(timeoutSeconds);
+    auto cancelled = [this, generation, &stopRequested]() {
+        return cancelGeneration.load() != generation || (stopRequested && stopRequested());
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        detectionScheduler.noteActivity(startTime);
+    }
 
     while (true) {
+        if (cancelled()) {
+            setLastError("Document detection cancelled");
+            return ERROR_TIMEOUT;
+        }
+
         int result = detectDocumentOnScanner();
 
         if (result == 1) { // Document detected
@@ -341,11 +417,47 @@ int SinosecuScanner::waitForDocumentDetection(int timeoutSeconds) {
             return ERROR_TIMEOUT;
         }
 
-        // Wait a bit before next check
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        // Wait before the next check; wakeDetection() and cancelPendingWait()
+        // cut the wait short. A caller is waiting for a document right now,
+        // so the wait never backs off: fastInterval for its whole timeout.
+        std::unique_lock<std::mutex> lock(waitMutex);
+        detectionScheduler.recordPoll(result, currentTime);
+        auto interval = detectionScheduler.getConfig().fastInterval;
+        waitCondition.wait_for(lock, interval, [this, &cancelled]() { return wakeRequested || cancelled(); });
+        wakeRequested = false;
     }
 }
 
+void SinosecuScanner::cancelPendingWait() {
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        cancelGeneration++;
+    }
+    waitCondition.notify_all();
+}
+
+void SinosecuScanner::interruptWait() {
+    {
+        // Taken so the notify cannot fall between a wait's check and its sleep.
+        std::lock_guard<std::mutex> lock(waitMutex);
+    }
+    waitCondition.notify_all();
+}
+
+void SinosecuScanner::wakeDetection() {
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        detectionScheduler.noteActivity();
+        wakeRequested = true;
+    }
+    waitCondition.notify_all();
+}
+
+void SinosecuScanner::setDetectionSchedule(const DetectionScheduler::Config& config) {
+    std::lock_guard<std::mutex> lock(waitMutex);
+    detectionScheduler.setConfig(config);
+}
+
 std::map<std::string, int> SinosecuScanner::autoProcessDocument() {
     std::map<std::string, int> result;
 
@@ -354,29 +466,29 @@ std::map<std::string, int> SinosecuScanner::autoProcessDocument() {
         return result;
     }
 
-    try {
-        int cardType = 0;
-        int processResult = AutoProcessIDCard(cardType);
+    int cardType = 0;
+    result["status"] = processDocument(cardType);
+    result["cardType"] = cardType;
+    return result;
+}
 
-        result["status"] = processResult;
-        result["cardType"] = cardType;
+int SinosecuScanner::processDocument(int& cardType) {
+    cardType = 0;
+    int processResult = ERROR_PROCESS;
 
-        std::cout << "Auto process result: " << processResult << ", Card type: " << cardType << std::endl;
+    try {
+        processResult = traced_sdk::AutoProcessIDCard(cardType);
+
+        SINO_LOG_INFO("Auto process result: %d, Card type: %d", processResult, cardType);
 
         // Interpret cardType flags
-        if (cardType & 1) std::cout << "  → Document has chip" << std::endl;
-        if (cardType & 2) std::cout << "  → Document has no chip" << std::endl;
-        if (cardType & 4) std::cout << "  → Document has barcode" << std::endl;
+        if (cardType & 1) SINO_LOG_DEBUG("  → Document has chip");
+        if (cardType & 2) SINO_LOG_DEBUG("  → Document has no chip");
+        if (cardType & 4) SINO_LOG_DEBUG("  → Document has barcode");
 
         // Interpret results based on documentation
         if (processResult > 0) {
-            std::cout << "✓ Document processed successfully. Main type: " << processResult << std::endl;
-
-            // Get document name
-            std::string docName = getDocumentName();
-            if (!docName.empty()) {
-                std::cout << "  → Document type: " << docName << std::endl;
-            }
+            SINO_LOG_INFO("✓ Document processed successfully. Main type: %d", processResult);
 
         } else {
             switch (processResult) {
@@ -418,11 +530,11 @@ std::map<std::string, int> SinosecuScanner::autoProcessDocument() {
 
     } catch (const std::exception& e) {
         setLastError("Exception during document processing: " + std::string(e.what()));
-        result["status"] = ERROR_PROCESS;
-        result["cardType"] = 0;
+        processResult = ERROR_PROCESS;
+        cardType = 0;
     }
 
-    return result;
+    return processResult;
 }
 
 std::string SinosecuScanner::getDocumentName() {
@@ -434,7 +546,7 @@ std::string SinosecuScanner::getDocumentName() {
         // Initialize buffer to prevent issues
         std::wmemset(buffer, 0, bufferSize);
 
-        int result = GetIDCardName(buffer, actualSize);
+        int result = traced_sdk::GetIDCardName(buffer, actualSize);
         if (result == 0 && actualSize > 0) {
             // Ensure null termination
             if (actualSize >= bufferSize) {
@@ -445,7 +557,7 @@ std::string SinosecuScanner::getDocumentName() {
             std::wstring wstr(buffer, actualSize);
             return wstring_to_string(wstr);
         } else {
-            std::cout << "GetIDCardName failed or returned empty. Result: " << result << ", Size: " << actualSize << std::endl;
+            SINO_LOG_WARN("GetIDCardName failed or returned empty. Result: %d, Size: %d", result, actualSize);
             return "";
         }
     } catch (const std::exception& e) {
@@ -466,10 +578,10 @@ int SinosecuScanner::loadConfiguration(const std::string& configPath) {
 
     try {
         std::wstring wConfigPath = string_to_wstring(configPath);
-        int result = SetConfigByFile(wConfigPath.c_str());
+        int result = traced_sdk::SetConfigByFile(wConfigPath.c_str());
 
         if (result == 0) {
-            std::cout << "Configuration loaded successfully from: " << configPath << std::endl;
+            SINO_LOG_INFO("Configuration loaded successfully from: %s", configPath.c_str());
         } else {
             setLastError("Failed to load configuration. Result: " + std::to_string(result));
         } 
@@ -490,7 +602,7 @@ std::string SinosecuScanner::getFieldValue(int attribute, int index) {
         // Initialize buffer
         std::wmemset(buffer, 0, bufferSize);
 
-        int result = GetRecogResultEx(attribute, index, buffer, actualSize);
+        int result = traced_sdk::GetRecogResultEx(attribute, index, buffer, actualSize);
 
         if (result == 0 && actualSize > 0) {
             // Ensure proper termination
@@ -502,20 +614,19 @@ std::string SinosecuScanner::getFieldValue(int attribute, int index) {
             std::wstring wstr(buffer, actualSize);
             std::string converted = wstring_to_string(wstr);
 
-            // Debug output
-            std::cout << "  Field[" << attribute << "][" << index << "]: '" << converted << "' (size: " << actualSize << ")" << std::endl;
+            SINO_LOG_TRACE("  Field[%d][%d]: '%s' (size: %d)", attribute, index, converted.c_str(), actualSize);
 
             return converted;
         } else if (result == 1) {
             // Buffer too small, try again with larger buffer
-            std::cout << "  Buffer too small for field[" << attribute << "][" << index << "], need: " << actualSize << std::endl;
+            SINO_LOG_DEBUG("  Buffer too small for field[%d][%d], need: %d", attribute, index, actualSize);
 
             if (actualSize > 0 && actualSize < 10000) { // Sanity check
                 std::vector<wchar_t> largerBuffer(actualSize + 1);
                 std::wmemset(largerBuffer.data(), 0, actualSize + 1);
 
                 int newSize = actualSize;
-                result = GetRecogResultEx(attribute, index, largerBuffer.data(), newSize);
+                result = traced_sdk::GetRecogResultEx(attribute, index, largerBuffer.data(), newSize);
                 if (result == 0) {
                     largerBuffer[newSize] = L'\0';
                     std::wstring wstr(largerBuffer.data(), newSize);
@@ -523,10 +634,10 @@ std::string SinosecuScanner::getFieldValue(int attribute, int index) {
                 }
             }
         } else {
-            std::cout << "  Field[" << attribute << "][" << index << "] not available. Result: " << result << std::endl;
+            SINO_LOG_TRACE("  Field[%d][%d] not available. Result: %d", attribute, index, result);
         }
     } catch (const std::exception& e) {
-        std::cout << "  Exception getting field[" << attribute << "][" << index << "]: " << e.what() << std::endl;
+        SINO_LOG_WARN("  Exception getting field[%d][%d]: %s", attribute, index, e.what());
     }
 
     return "";
@@ -588,84 +699,48 @@ std::string SinosecuScanner::getValidatedFieldValue(int attribute, int index, co
     // Apply field-specific validation
     if (fieldName == "passport_number_mrz" || fieldName == "passport_number_direct") {
         if (!isValidPassportNumber(value)) {
-            std::cout << "Warning: Invalid passport number format: " << value << std::endl;
+            SINO_LOG_WARN("Invalid passport number format: %s", value.c_str());
         }
     } else if (fieldName == "date_of_birth" || fieldName == "date_of_expiry" || fieldName == "date_of_issue") {
         if (!isValidDate(value)) {
-            std::cout << "Warning: Invalid date format: " << value << std::endl;
+            SINO_LOG_WARN("Invalid date format: %s", value.c_str());
         }
     } else if (fieldName == "mrz_line_1" || fieldName == "mrz_line_2") {
         if (!isValidMRZ(value)) {
-            std::cout << "Warning: Invalid MRZ format: " << value << std::endl;
+            SINO_LOG_WARN("Invalid MRZ format: %s", value.c_str());
         }
     } else if (fieldName == "gender") {
         if (value != "M" && value != "F" && value != "X") {
-            std::cout << "Warning: Unexpected gender value: " << value << std::endl;
+            SINO_LOG_WARN("Unexpected gender value: %s", value.c_str());
         }
     }
 
     return value;
 }
 
-std::map<std::string, std::string> SinosecuScanner::getDocumentFields(int attribute) {
-    std::map<std::string, std::string> fields;
+const FieldSnapshot& SinosecuScanner::captureFields(int attribute) {
+    FieldSnapshot& snapshot = (attribute == 0) ? chipFieldSnapshot : ocrFieldSnapshot;
 
     if (!validateInitialization()) {
-        return fields;
-    }
-
-    std::vector<std::pair<int, std::string>> passportFieldMap = {
-            // Core MRZ fields (these exactly match the SDK documentation)
-            {0,  "passport_type"},           // "P" - Passport type from MRZ
-            {1,  "passport_number_mrz"},     // Passport number from MRZ
-            {2,  "domestic_name"},           // Name in local language/script
-            {3,  "english_name"},            // Full English name
-            {4,  "gender"},                  // "M" or "F"
-            {5,  "date_of_birth"},           // Birth date in YYYYMMDD format
-            {6,  "date_of_expiry"},          // Expiry date in YYYYMMDD format
-            {7,  "issuing_country_code"},    // 3-letter country code
-            {8,  "english_surname"},         // Surname only
-            {9,  "english_first_name"},      // First name(s)
-            {10, "mrz_line_1"},              // First MRZ line (44 characters)
-            {11, "mrz_line_2"},              // Second MRZ line (44 characters)
-            {12, "nationality_code"},        // Holder nationality code from MRZ
-
-            // Additional passport fields
-            {13, "passport_number_direct"},  // Passport number from direct OCR (visual zone)
-            {14, "place_of_birth"},          // Birth place
-            {15, "place_of_issue"},          // Issue place
-            {16, "date_of_issue"},           // Issue date
-            {17, "rfid_mrz"},                // MRZ data from RFID chip
-            {18, "ocr_mrz"},                 // MRZ data from OCR
-            {21, "national_id_number"},      // National ID number
-            {23, "gender_ocr"},              // Gender from OCR
-            {24, "nationality_code_ocr"},    // Nationality from OCR
-            {25, "id_card_number_ocr"},      // ID card number from OCR
-            {26, "birth_date_ocr"},          // Birth date from OCR
-            {27, "valid_until_ocr"},         // Valid until from OCR
-            {28, "issuing_authority_ocr"},   // Issuing authority from OCR
-            {29, "domestic_surname"},        // Domestic surname
-            {30, "domestic_first_name"}      // Domestic first name
-    };
+        snapshot.clear();
+        return snapshot;
+    }
 
-    std::cout << "Extracting " << (attribute == 0 ? "CHIP" : "OCR") << " fields:" << std::endl;
+    size_t count = snapshot.capture(attribute);
+    SINO_LOG_DEBUG("Extracted %zu %s fields", count, attribute == 0 ? "CHIP" : "OCR");
+    return snapshot;
+}
 
-    for (const auto& field : passportFieldMap) {
-        std::string value = getFieldValue(attribute, field.first);
-        if (!value.empty() && value != " " && value.length() > 0) {
-            // Clean up the value
-            value.erase(0, value.find_first_not_of(" \t\n\r")); // trim left
-            value.erase(value.find_last_not_of(" \t\n\r") + 1); // trim right
+std::map<std::string, std::string> SinosecuScanner::getDocumentFields(int attribute) {
+    std::map<std::string, std::string> fields;
 
-            if (!value.empty()) {
-                fields[field.second] = value;
-                std::cout << "  ✓ " << field.second << ": '" << value << "'" << std::endl;
-            }
-        }
-    }
+    const FieldSnapshot& snapshot = captureFields(attribute);
+    snapshot.forEach([&fields](const PassportFieldDescriptor& field, std::string_view value) {
+        fields.emplace(field.name, value);
+    });
 
     if (fields.empty()) {
-        std::cout << "No fields extracted for attribute " << attribute << std::endl;
+        SINO_LOG_DEBUG("No fields extracted for attribute %d", attribute);
     }
 
     return fields;
@@ -679,41 +754,29 @@ std::map<std::string, std::string> SinosecuScanner::getFormattedPassportData() {
         return formattedData;
     }
 
-    // Get OCR fields (attribute = 1) - this is what you'll primarily use
-    auto ocrFields = getDocumentFields(1);
-
-
-    if (ocrFields.count("passport_number_mrz")) {
-        formattedData["passport_number"] = "The passport number from MRZ " + ocrFields["passport_number_mrz"];
-    }
-
-    if (ocrFields.count("english_name")) {
-        formattedData["english_name"] = ocrFields["english_name"];
-    }
-
-    if (ocrFields.count("gender")) {
-        formattedData["sex"] = ocrFields["gender"];
-    }
-
-    if (ocrFields.count("date_of_birth")) {
-        formattedData["date_of_birth"] = formatDate(ocrFields["date_of_birth"]);
-    }
+    // OCR fields (attribute = 1) - this is what you'll primarily use
+    const FieldSnapshot& ocrFields = captureFields(1);
+    auto copy = [&](const char* key, PassportField field) {
+        if (ocrFields.has(field)) {
+            formattedData.emplace(key, ocrFields.value(field));
+        }
+    };
 
-    if (ocrFields.count("date_of_expiry")) {
-        formattedData["date_of_expiry"] = formatDate(ocrFields["date_of_expiry"]);
+    if (ocrFields.has(PassportField::PassportNumberMrz)) {
+        formattedData["passport_number"] = "The passport number from MRZ " +
+                                           std::string(ocrFields.value(PassportField::PassportNumberMrz));
     }
-
-    if (ocrFields.count("issuing_country_code")) {
-        formattedData["issuing_country_code"] = ocrFields["issuing_country_code"];
+    copy("english_name", PassportField::EnglishName);
+    copy("sex", PassportField::Gender);
+    if (ocrFields.has(PassportField::DateOfBirth)) {
+        formattedData["date_of_birth"] = formatDate(std::string(ocrFields.value(PassportField::DateOfBirth)));
     }
-
-    if (ocrFields.count("english_surname")) {
-        formattedData["english_surname"] = ocrFields["english_surname"];
-    }
-
-    if (ocrFields.count("english_first_name")) {
-        formattedData["english_first_name"] = ocrFields["english_first_name"];
+    if (ocrFields.has(PassportField::DateOfExpiry)) {
+        formattedData["date_of_expiry"] = formatDate(std::string(ocrFields.value(PassportField::DateOfExpiry)));
     }
+    copy("issuing_country_code", PassportField::IssuingCountryCode);
+    copy("english_surname", PassportField::EnglishSurname);
+    copy("english_first_name", PassportField::EnglishFirstName);
 
     return formattedData;
 }
@@ -730,6 +793,27 @@ std::string SinosecuScanner::formatDate(const std::string& dateStr) {
 }
 
 bool SinosecuScanner::saveImages(const std::string& basePath, int imageTypes) {
+    bool saved = writeImages(basePath, imageTypes);
+    if (!imagePreviews.isEnabled()) {
+        return saved;
+    }
+
+    // The requested types' files, by name; the gallery directory is not
+    // listed, and other scans sharing the prefix are left alone. Partial
+    // saves still get previews of what was written.
+    std::vector<std::string> written;
+    std::error_code error;
+    for (const auto& [type, suffix] : kImageFileSuffixes) {
+        std::string path = basePath + suffix;
+        if ((imageTypes & type) && std::filesystem::is_regular_file(path, error)) {
+            written.push_back(std::move(path));
+        }
+    }
+    imagePreviews.generate(std::move(written));
+    return saved;
+}
+
+bool SinosecuScanner::writeImages(const std::string& basePath, int imageTypes) {
     if (!validateInitialization()) {
         return false;
     }
@@ -738,22 +822,29 @@ bool SinosecuScanner::saveImages(const std::string& basePath, int imageTypes) {
         std::string imagePath = basePath + ".jpg";
         std::wstring wImagePath = string_to_wstring(imagePath);
 
-        int result = SaveImageEx(wImagePath.c_str(), imageTypes);
+        auto saveStart = std::chrono::steady_clock::now();
+        int result = traced_sdk::SaveImageEx(wImagePath.c_str(), imageTypes);
+        auto saveMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - saveStart).count();
+        // Attributed to the document of the last scan, which is what the
+        // SDK's image buffers hold.
+        scanMetrics.record(lastDocumentName.empty() ? std::string("unknown") : lastDocumentName,
+                           ScanMetrics::Stage::ImageSave, saveMicros);
 
         if (result == 0) {
-            std::cout << "Images saved successfully to: " << imagePath << std::endl;
+            SINO_LOG_INFO("Images saved successfully to: %s", imagePath.c_str());
             return true;
         } else {
             setLastError("Failed to save images. Result: " + std::to_string(result));
 
             // Interpret the result bits for partial success
             if (result > 0) {
-                std::cout << "Partial image save failure:" << std::endl;
-                if (result & 1) std::cout << "  White image save failed" << std::endl;
-                if (result & 2) std::cout << "  IR image save failed" << std::endl;
-                if (result & 4) std::cout << "  UV image save failed" << std::endl;
-                if (result & 8) std::cout << "  Page portrait save failed" << std::endl;
-                if (result & 16) std::cout << "  Chip portrait save failed" << std::endl;
+                SINO_LOG_WARN("Partial image save failure:%s%s%s%s%s",
+                              (result & 1) ? " white" : "",
+                              (result & 2) ? " IR" : "",
+                              (result & 4) ? " UV" : "",
+                              (result & 8) ? " page-portrait" : "",
+                              (result & 16) ? " chip-portrait" : "");
             }
 
             return false;
@@ -764,6 +855,41 @@ bool SinosecuScanner::saveImages(const std::string& basePath, int imageTypes) {
     }
 }
 
+uint64_t SinosecuScanner::publishImages(ImageRing& ring, int imageTypes) {
+    const std::string& staging = ring.stagingDirectory();
+    if (staging.empty()) {
+        setLastError("No staging directory for images");
+        return 0;
+    }
+
+    // The previous scan's files are cleared now rather than after publishing,
+    // so an SDK trace recorder still gets to read them back.
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(staging, error)) {
+        std::filesystem::remove(entry.path(), error);
+    }
+    // Partial failures still publish whatever planes were written. The ring
+    // carries full images; the UI has no use for previews of them.
+    writeImages(staging + "/scan", imageTypes);
+
+    // One plane per file written (scan.jpg, scan_IR.jpg, ...), named by its
+    // suffix.
+    std::vector<ImageRing::PlaneFile> files;
+    for (const auto& [type, suffix] : kImageFileSuffixes) {
+        std::string path = staging + "/scan" + suffix;
+        if ((imageTypes & type) && std::filesystem::is_regular_file(path, error)) {
+            files.push_back({suffix, path});
+        }
+    }
+
+    std::string publishError;
+    uint64_t sequence = ring.publishFiles(files, publishError);
+    if (sequence == 0) {
+        setLastError("Failed to publish images: " + publishError);
+    }
+    return sequence;
+}
+
 std::map<std::string, std::string> SinosecuScanner::handleProcessingResult(int processResult, int cardType) {
     std::map<std::string, std::string> result;
 
@@ -781,8 +907,7 @@ std::map<std::string, std::string> SinosecuScanner::handleProcessingResult(int p
 
     } else if (processResult == -8) {
         // Chip reading failed but OCR succeeded
-        std::cout << "Chip reading failed, but OCR was successful" << std::endl;
-        std::cout << "This is common - continuing with OCR data only..." << std::endl;
+        SINO_LOG_INFO("Chip reading failed, but OCR was successful - continuing with OCR data only");
 
         result["status"] = "partial_success";
         result["main_type"] = "unknown"; // We don't know the main type due to chip failure
@@ -797,7 +922,7 @@ std::map<std::string, std::string> SinosecuScanner::handleProcessingResult(int p
 
     } else if (processResult == -9) {
         // Chip reading succeeded but OCR failed
-        std::cout << "OCR failed, but chip reading was successful" << std::endl;
+        SINO_LOG_INFO("OCR failed, but chip reading was successful");
 
         result["status"] = "partial_success";
         result["main_type"] = std::to_string(abs(processResult)); // Use absolute value
@@ -816,13 +941,13 @@ std::map<std::string, std::string> SinosecuScanner::handleProcessingResult(int p
 }
 
 void SinosecuScanner::debugAllAvailableFields(int attribute) {
-    std::cout << "\n=== DEBUG: Scanning all fields for attribute " << attribute << " ===" << std::endl;
+    SINO_LOG_DEBUG("=== DEBUG: Scanning all fields for attribute %d ===", attribute);
 
     // Try indices 0-50 to see what's available
     for (int i = 0; i <= 50; i++) {
         std::string value = getFieldValue(attribute, i);
         if (!value.empty() && value != " ") {
-            std::cout << "Index " << i << ": '" << value << "'" << std::endl;
+            SINO_LOG_DEBUG("Index %d: '%s'", i, value.c_str());
 
             // Also try to get the field name
             const int bufferSize = 256;
@@ -830,108 +955,150 @@ void SinosecuScanner::debugAllAvailableFields(int attribute) {
             int nameSize = bufferSize;
             std::wmemset(nameBuffer, 0, bufferSize);
 
-            int nameResult = GetFieldNameEx(attribute, i, nameBuffer, nameSize);
+            int nameResult = traced_sdk::GetFieldNameEx(attribute, i, nameBuffer, nameSize);
             if (nameResult == 0 && nameSize > 0) {
                 nameBuffer[std::min(nameSize, bufferSize - 1)] = L'\0';
                 std::wstring wFieldName(nameBuffer, nameSize);
                 std::string fieldName = wstring_to_string(wFieldName);
-                std::cout << "  → Field name: '" << fieldName << "'" << std::endl;
+                SINO_LOG_DEBUG("  → Field name: '%s'", fieldName.c_str());
             }
         }
     }
 
-    std::cout << "=== End debug scan ===" << std::endl;
+    SINO_LOG_DEBUG("=== End debug scan ===");
 }
 
 
+namespace {
+
+using ScanClock = std::chrono::steady_clock;
+
+int64_t elapsedMicros(ScanClock::time_point from, ScanClock::time_point to) {
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+}
+
+}
+
 // utility method for complete document scanning workflow
-std::map<std::string, std::string> SinosecuScanner::scanDocumentComplete(int timeoutSeconds) {
-    std::map<std::string, std::string> result;
+const ScanRecord& SinosecuScanner::scanDocument(int timeoutSeconds) {
+    return scanDocument(timeoutSeconds, waitGeneration());
+}
+
+const ScanRecord& SinosecuScanner::scanDocument(int timeoutSeconds, uint64_t generation,
+                                                const std::function<bool()>& stopRequested) {
+    ScanRecord& record = scanRecord;
+    record.reset();
 
     if (!validateInitialization()) {
-        result["error"] = "Scanner not initialized";
-        return result;
+        record.status = ScanStatus::NotReady;
+        record.error = "Scanner not initialized";
+        scanMetrics.record(record);
+        return record;
     }
 
-    std::cout << "\n=== Starting Complete Document Scan ===" << std::endl;
+    SINO_LOG_INFO("=== Starting Complete Document Scan ===");
+    const ScanClock::time_point scanStart = ScanClock::now();
 
     // Wait for document detection
-    int detectionResult = waitForDocumentDetection(timeoutSeconds);
-    if (detectionResult != 1) {
-        result["error"] = "Document detection failed: " + std::to_string(detectionResult);
-        return result;
+    record.detectionResult = waitForDocumentDetection(timeoutSeconds, generation, stopRequested);
+    int64_t detectMicros = elapsedMicros(scanStart, ScanClock::now());
+    record.setStage(ScanStage::Detect, detectMicros);
+    if (record.detectionResult != 1) {
+        record.status = ScanStatus::DetectionFailed;
+        record.error = "Document detection failed: " + std::to_string(record.detectionResult);
+        record.setStage(ScanStage::Total, detectMicros);
+        scanMetrics.record(record);
+        return record;
+    }
+
+    recognizeDocument(record);
+    return record;
+}
+
+void SinosecuScanner::recognizeDocument(ScanRecord& record) {
+    if (!validateInitialization()) {
+        record.status = ScanStatus::NotReady;
+        record.error = "Scanner not initialized";
+        scanMetrics.record(record);
+        return;
     }
 
+    // Total covers detection too when the caller timed it.
+    const int64_t detectMicros = record.stage(ScanStage::Detect);
+    const ScanClock::time_point recognizeStart = ScanClock::now();
+
     // Process the document
-    auto processResult = autoProcessDocument();
-    int status = processResult["status"];
-    int cardType = processResult["cardType"];
+    record.processResult = processDocument(record.cardType);
+    ScanClock::time_point stageEnd = ScanClock::now();
+    record.setStage(ScanStage::Recognize, elapsedMicros(recognizeStart, stageEnd));
+
+    // The SDK's own breakdown of AutoProcessIDCard; only the chip read is
+    // split out. Reported in milliseconds, 0 when no chip was read.
+    int chipReadMillis = traced_sdk::GetTimeConsumed(kTimeConsumedChipRead, 0);
+    if (chipReadMillis > 0) {
+        record.setStage(ScanStage::SdkChipRead, static_cast<int64_t>(chipReadMillis) * 1000);
+    }
 
-    std::cout << "Processing result: " << status << ", Card type: " << cardType << std::endl;
+    int status = record.processResult;
+    SINO_LOG_DEBUG("Processing result: %d, Card type: %d", status, record.cardType);
 
     // Handle results with better error tolerance
     if (status > 0 || status == -8 || status == -9) {
-        // Success or partial success
-        result["status"] = (status > 0) ? "success" : "partial_success";
-        result["main_type"] = (status > 0) ? std::to_string(status) : "passport_detected";
-        result["card_type"] = std::to_string(cardType);
+        record.status = (status > 0) ? ScanStatus::Success : ScanStatus::PartialSuccess;
 
         if (status == -8) {
-            result["warning"] = "Chip reading failed - using OCR data only";
+            record.warning = "Chip reading failed - using OCR data only";
         } else if (status == -9) {
-            result["warning"] = "OCR failed - using chip data only";
+            record.warning = "OCR failed - using chip data only";
         }
 
-        // Get document name (with error handling)
-        std::string docName = getDocumentName();
-        if (!docName.empty()) {
-            result["document_type"] = docName;
-        } else {
-            result["document_type"] = "passport";
+        record.documentName = getDocumentName();
+        if (record.documentName.empty()) {
+            record.documentName = "passport";
         }
-
+        lastDocumentName = record.documentName;
     } else {
-        // Complete failure
-        result["error"] = getProcessingErrorMessage(status);
-        result["status"] = "error";
-        result["main_type"] = std::to_string(status);
-        result["card_type"] = std::to_string(cardType);
-        return result; // Don't try to extract fields on complete failure
-    }
-
-    // Extract fields with error handling
-    try {
-        std::cout << "Extracting OCR fields..." << std::endl;
-        auto ocrFields = getDocumentFields(1); // OCR fields
-
-        // Add OCR fields with prefix
-        for (const auto& field : ocrFields) {
-            result["ocr_" + field.first] = field.second;
-        }
-
-        std::cout << "Extracting chip fields..." << std::endl;
-        auto chipFields = getDocumentFields(0); // Chip fields
-
-        // Add chip fields with prefix
-        for (const auto& field : chipFields) {
-            result["chip_" + field.first] = field.second;
-        }
-
-    } catch (const std::exception& e) {
-        std::cout << "Exception during field extraction: " << e.what() << std::endl;
-        result["field_extraction_error"] = e.what();
+        // Complete failure; don't try to extract fields
+        record.status = ScanStatus::Error;
+        record.error = getProcessingErrorMessage(status);
+        lastDocumentName.clear();
+        record.setStage(ScanStage::Total, detectMicros + elapsedMicros(recognizeStart, stageEnd));
+        scanMetrics.record(record);
+        return;
     }
 
-    std::cout << "=== Document Scan Complete ===" << std::endl;
+    ScanClock::time_point stageStart = ScanClock::now();
+    size_t ocrCount = record.ocr.capture(1, true);
+    stageEnd = ScanClock::now();
+    record.setStage(ScanStage::OcrFields, elapsedMicros(stageStart, stageEnd));
+
+    stageStart = stageEnd;
+    size_t chipCount = record.chip.capture(0, true);
+    stageEnd = ScanClock::now();
+    record.setStage(ScanStage::ChipFields, elapsedMicros(stageStart, stageEnd));
+    record.setStage(ScanStage::Total, detectMicros + elapsedMicros(recognizeStart, stageEnd));
+
+    scanMetrics.record(record);
+
+    SINO_LOG_INFO("=== Document Scan Complete: %zu OCR and %zu chip fields ===", ocrCount, chipCount);
+    SINO_LOG_DEBUG("Scan timings (us): detect %lld, recognize %lld (chip %lld), fields %lld + %lld, total %lld",
+                   static_cast<long long>(record.stage(ScanStage::Detect)),
+                   static_cast<long long>(record.stage(ScanStage::Recognize)),
+                   static_cast<long long>(record.stage(ScanStage::SdkChipRead)),
+                   static_cast<long long>(record.stage(ScanStage::OcrFields)),
+                   static_cast<long long>(record.stage(ScanStage::ChipFields)),
+                   static_cast<long long>(record.stage(ScanStage::Total)));
+}
 
-    return result;
+std::map<std::string, std::string> SinosecuScanner::scanDocumentComplete(int timeoutSeconds) {
+    return scanDocument(timeoutSeconds).toMap();
 }
 
 std::map<std::string, std::string> SinosecuScanner::scanDocumentCompleteWithDebug(int timeoutSeconds, bool enableDebug) {
     auto result = scanDocumentComplete(timeoutSeconds);
 
     if (enableDebug && (result["status"] == "success" || result["status"] == "partial_success")) {
-        std::cout << "\n=== DEBUG MODE ENABLED ===" << std::endl;
+        SINO_LOG_DEBUG("=== DEBUG MODE ENABLED ===");
         debugAllAvailableFields(1); // OCR fields
         debugAllAvailableFields(0); // Chip fields
     }
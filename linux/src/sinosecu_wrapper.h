@@ -6,9 +6,19 @@
 #include <vector>
 #include <algorithm>
 #include <cctype>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include "detection_scheduler.h"
+#include "field_snapshot.h"
+#include "image_previews.h"
+#include "scan_metrics.h"
+#include "scan_record.h"
 
 // Forward declaration
 class PngWrapper;
+class ImageRing;
 
 // Utility function to convert std::string to std::wstring
 std::wstring string_to_wstring(const std::string& str);
@@ -30,6 +40,7 @@ int GetRecogResultEx(int nAttribute, int nIndex, wchar_t* lpBuffer, int& nBuffer
 int GetResultTypeEx(int nAttribute, int nIndex);
 int GetFieldConfEx(int nAttribute, int nIndex);
 int GetIDCardName(wchar_t* lpBuffer, int& nBufferLen);
+int GetTimeConsumed(int nMainTimeType, int nSubTimeType); // Milliseconds spent in the last AutoProcessIDCard step
 
 // Device status
 int CheckDeviceOnlineEx();
@@ -54,25 +65,83 @@ public:
     SinosecuScanner();
     ~SinosecuScanner();
 
-    // Core functionality
+    // Wall-clock time of each phase of the last initializeScanner call, in
+    // microseconds. A phase that did not run stays 0.
+    struct InitPhases {
+        int64_t verifyMicros = 0;          // SDK directory and libIDCard.so checks
+        int64_t sdkInitMicros = 0;         // InitIDCard: models, templates, OCR engines
+        int64_t configFileMicros = 0;      // SetConfigByFile
+        int64_t documentTypesMicros = 0;   // configureDocumentTypes
+        int64_t totalMicros = 0;
+    };
+
+    // Core functionality. Calling initializeScanner again with the settings
+    // the SDK is already initialized with returns SUCCESS without re-running
+    // InitIDCard. A non-empty |configPath| is loaded with SetConfigByFile
+    // before the document types are configured.
     int initializeScanner(const std::string& userId, int nType, const std::string& sdkDirectory);
+    int initializeScanner(const std::string& userId, int nType, const std::string& sdkDirectory,
+                          const std::string& configPath);
+    const InitPhases& getInitPhases() const { return initPhases; }
+    bool isReady() const { return isInitialized; }
     int detectDocumentOnScanner();
     std::map<std::string, int> autoProcessDocument();
     void releaseScanner();
 
     // Device and document operations
     int checkDeviceStatus();
+    int getCachedDeviceStatus() const; // Last CheckDeviceOnlineEx result, safe from any thread
     std::map<std::string, std::string> getDocumentFields(int attribute = 1); // 1 = OCR page data
+    // Bulk, allocation-free field read. The returned snapshot is owned by the
+    // scanner and reused: it is overwritten by the next capture of the same
+    // attribute (0 = chip, anything else shares the OCR snapshot).
+    const FieldSnapshot& captureFields(int attribute = 1);
     int loadConfiguration(const std::string& configPath);
-    bool saveImages(const std::string& basePath, int imageTypes = 0x1F); // Save all image types
+    // Save all image types, then queue their previews (see ImagePreviews)
+    bool saveImages(const std::string& basePath, int imageTypes = 0x1F);
+    // saveImages into |ring|'s staging directory, then publishes the files
+    // as one shared-memory segment. Returns its sequence (holding one
+    // reference), or 0 with the last error set.
+    uint64_t publishImages(ImageRing& ring, int imageTypes = 0x1F);
     bool configureDocumentTypes();
+    // cancelPendingWait() aborts the running wait and every wait submitted
+    // before it, from any thread. A caller that queues a wait for another
+    // thread captures waitGeneration() when it queues it and passes that
+    // along, so a cancel made in between still reaches it; without one a
+    // wait only sees cancels made after it starts. A caller with its own
+    // cancel scope (one client's requests) also passes |stopRequested|,
+    // checked with the generation; after making it true it calls
+    // interruptWait() so a wait already sleeping notices.
+    uint64_t waitGeneration() const { return cancelGeneration.load(); }
     int waitForDocumentDetection(int timeoutSeconds = 30);
+    int waitForDocumentDetection(int timeoutSeconds, uint64_t generation,
+                                 const std::function<bool()>& stopRequested = nullptr);
+    void cancelPendingWait();
+    void interruptWait();
+    void wakeDetection();     // Poll now and return to the fast interval (hot-plug, status change)
+    void setDetectionSchedule(const DetectionScheduler::Config& config);
     std::string getDocumentName();
 
-    // Complete scanning workflows
+    // Complete scanning workflows. scanDocument fills a record owned by the
+    // scanner and reused by the next scan; scanDocumentComplete is the legacy
+    // string map built from it.
+    const ScanRecord& scanDocument(int timeoutSeconds = 20);
+    const ScanRecord& scanDocument(int timeoutSeconds, uint64_t generation,   // See waitGeneration()
+                                   const std::function<bool()>& stopRequested = nullptr);
+    // The recognition half of scanDocument, for a document already known to
+    // be on the glass: AutoProcessIDCard and both field reads into |record|,
+    // which the caller owns and has reset. Feeds scan metrics like scanDocument.
+    void recognizeDocument(ScanRecord& record);
     std::map<std::string, std::string> scanDocumentComplete(int timeoutSeconds = 20);
     std::map<std::string, std::string> scanDocumentCompleteWithDebug(int timeoutSeconds = 20, bool enableDebug = false);
 
+    // Per-stage latency histograms fed by every scanDocument and saveImages
+    // call. Thread-safe; the channel layer also records serialization time.
+    ScanMetrics& getScanMetrics() { return scanMetrics; }
+
+    // Previews of the images saveImages writes. flush() it before reading them.
+    ImagePreviews& getImagePreviews() { return imagePreviews; }
+
     // Formatted data extraction (matches GUI display format)
     std::map<std::string, std::string> getFormattedPassportData();
 
@@ -86,7 +155,7 @@ public:
     void debugAllAvailableFields(int attribute);
     std::string formatDate(const std::string& dateStr);
 
-    // Error handling
+    // Error handling (thread-safe)
     std::string getLastError() const;
 
     // Return values for error handling
@@ -101,16 +170,45 @@ public:
 private:
     bool isInitialized;
     std::string lastError;
+    mutable std::mutex errorMutex;
     std::string sdkPath;
+    std::string initUserId;        // Settings of the current initialization
+    int initType;
+    std::string initConfigPath;
+    InitPhases initPhases;
+    std::atomic<int> lastDeviceStatus;
+    std::atomic<uint64_t> cancelGeneration;   // cancelPendingWait() calls so far
+
+    // Reused field snapshots (see captureFields)
+    FieldSnapshot ocrFieldSnapshot;
+    FieldSnapshot chipFieldSnapshot;
+
+    // Result of the last scanDocument call
+    ScanRecord scanRecord;
+    ScanMetrics scanMetrics;
+    std::string lastDocumentName;   // Of the last recognized document; what saveImages writes
+    ImagePreviews imagePreviews;
+
+    // Adaptive spacing for waitForDocumentDetection polls
+    std::mutex waitMutex;
+    std::condition_variable waitCondition;
+    DetectionScheduler detectionScheduler;
+    bool wakeRequested;
 
     // Processing and error handling
+    int processDocument(int& cardType); // AutoProcessIDCard with logging and lastError
     std::map<std::string, std::string> handleProcessingResult(int processResult, int cardType);
     std::string getProcessingErrorMessage(int errorCode);
 
+    // SaveImageEx with metrics and lastError; no previews
+    bool writeImages(const std::string& basePath, int imageTypes);
+
     // Helper methods
     void setLastError(const std::string& error);
     std::string getFieldValue(int attribute, int index);
     bool validateInitialization();
+
+    friend struct SinoBenchAccess;   // bench/sino_bench.cpp times getFieldValue
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "usb_hotplug_monitor.h"
+#include "logger.h"
+#include <dlfcn.h>
+#include <sys/time.h>
+#include <cstdint>
+
+// Subset of libusb-1.0 declarations (libusb.h is not available at build time).
+namespace {
+constexpr int LIBUSB_CAP_HAS_HOTPLUG = 0x0001;
+constexpr int LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED = 0x01;
+constexpr int LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT = 0x02;
+constexpr int LIBUSB_HOTPLUG_MATCH_ANY = -1;
+
+struct LibusbDeviceDescriptor {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint16_t bcdUSB;
+    uint8_t bDeviceClass;
+    uint8_t bDeviceSubClass;
+    uint8_t bDeviceProtocol;
+    uint8_t bMaxPacketSize0;
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint16_t bcdDevice;
+    uint8_t iManufacturer;
+    uint8_t iProduct;
+    uint8_t iSerialNumber;
+    uint8_t bNumConfigurations;
+};
+
+typedef int (*hotplug_callback_fn)(void*, void*, int, void*);
+}
+
+struct UsbHotplugMonitor::Api {
+    int (*init)(void** ctx);
+    void (*exit)(void* ctx);
+    int (*has_capability)(uint32_t capability);
+    int (*hotplug_register_callback)(void* ctx, int events, int flags, int vendorId, int productId,
+                                     int devClass, hotplug_callback_fn callback, void* userData,
+                                     int* handle);
+    void (*hotplug_deregister_callback)(void* ctx, int handle);
+    int (*handle_events_timeout_completed)(void* ctx, struct timeval* tv, int* completed);
+    int (*get_device_descriptor)(void* device, LibusbDeviceDescriptor* descriptor);
+};
+
+UsbHotplugMonitor::UsbHotplugMonitor()
+        : libusbHandle(nullptr), context(nullptr), callbackHandle(0), running(false), api(nullptr) {}
+
+UsbHotplugMonitor::~UsbHotplugMonitor() {
+    stop();
+    delete api;
+    if (libusbHandle) {
+        dlclose(libusbHandle);
+    }
+}
+
+bool UsbHotplugMonitor::loadLibrary() {
+    if (api) {
+        return true;
+    }
+
+    const char* usb_libs[] = {
+            "libusb-1.0.so.0",
+            "libusb-1.0.so",
+    };
+
+    for (const char* lib : usb_libs) {
+        libusbHandle = dlopen(lib, RTLD_LAZY | RTLD_LOCAL);
+        if (libusbHandle) {
+            SINO_LOG_INFO("UsbHotplugMonitor: Loaded %s", lib);
+            break;
+        }
+    }
+
+    if (!libusbHandle) {
+        SINO_LOG_WARN("UsbHotplugMonitor: libusb not available: %s", dlerror());
+        return false;
+    }
+
+    Api* resolved = new Api();
+    resolved->init = reinterpret_cast<decltype(resolved->init)>(dlsym(libusbHandle, "libusb_init"));
+    resolved->exit = reinterpret_cast<decltype(resolved->exit)>(dlsym(libusbHandle, "libusb_exit"));
+    resolved->has_capability = reinterpret_cast<decltype(resolved->has_capability)>(
+            dlsym(libusbHandle, "libusb_has_capability"));
+    resolved->hotplug_register_callback = reinterpret_cast<decltype(resolved->hotplug_register_callback)>(
+            dlsym(libusbHandle, "libusb_hotplug_register_callback"));
+    resolved->hotplug_deregister_callback = reinterpret_cast<decltype(resolved->hotplug_deregister_callback)>(
+            dlsym(libusbHandle, "libusb_hotplug_deregister_callback"));
+    resolved->handle_events_timeout_completed = reinterpret_cast<decltype(resolved->handle_events_timeout_completed)>(
+            dlsym(libusbHandle, "libusb_handle_events_timeout_completed"));
+    resolved->get_device_descriptor = reinterpret_cast<decltype(resolved->get_device_descriptor)>(
+            dlsym(libusbHandle, "libusb_get_device_descriptor"));
+
+    if (!resolved->init || !resolved->exit || !resolved->has_capability ||
+        !resolved->hotplug_register_callback || !resolved->hotplug_deregister_callback ||
+        !resolved->handle_events_timeout_completed) {
+        SINO_LOG_WARN("UsbHotplugMonitor: libusb is missing hot-plug functions");
+        delete resolved;
+        dlclose(libusbHandle);
+        libusbHandle = nullptr;
+        return false;
+    }
+
+    api = resolved;
+    return true;
+}
+
+bool UsbHotplugMonitor::start(Listener newListener, int vendorId) {
+    if (running) {
+        return true;
+    }
+    if (!loadLibrary()) {
+        return false;
+    }
+    if (!api->has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        SINO_LOG_WARN("UsbHotplugMonitor: libusb built without hot-plug support");
+        return false;
+    }
+    if (api->init(&context) != 0) {
+        SINO_LOG_WARN("UsbHotplugMonitor: libusb_init failed");
+        context = nullptr;
+        return false;
+    }
+
+    listener = std::move(newListener);
+    int result = api->hotplug_register_callback(
+            context,
+            LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+            0,
+            vendorId < 0 ? LIBUSB_HOTPLUG_MATCH_ANY : vendorId,
+            LIBUSB_HOTPLUG_MATCH_ANY,
+            LIBUSB_HOTPLUG_MATCH_ANY,
+            &UsbHotplugMonitor::onHotplug,
+            this,
+            &callbackHandle);
+    if (result != 0) {
+        SINO_LOG_WARN("UsbHotplugMonitor: Failed to register hot-plug callback: %d", result);
+        api->exit(context);
+        context = nullptr;
+        return false;
+    }
+
+    running = true;
+    worker = std::thread(&UsbHotplugMonitor::run, this);
+    SINO_LOG_INFO("UsbHotplugMonitor: Watching for USB hot-plug events");
+    return true;
+}
+
+void UsbHotplugMonitor::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    api->hotplug_deregister_callback(context, callbackHandle);
+    api->exit(context);
+    context = nullptr;
+}
+
+int UsbHotplugMonitor::onHotplug(void* ctx, void* device, int event, void* userData) {
+    UsbHotplugMonitor* self = static_cast<UsbHotplugMonitor*>(userData);
+
+    int vendorId = 0;
+    int productId = 0;
+    LibusbDeviceDescriptor descriptor{};
+    if (self->api->get_device_descriptor && self->api->get_device_descriptor(device, &descriptor) == 0) {
+        vendorId = descriptor.idVendor;
+        productId = descriptor.idProduct;
+    }
+
+    if (self->listener) {
+        self->listener(event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED ? Event::Arrived : Event::Left,
+                       vendorId, productId);
+    }
+    return 0; // Stay registered
+}
+
+void UsbHotplugMonitor::run() {
+    while (running) {
+        // Short timeout so stop() is honoured promptly.
+        struct timeval timeout = {0, 250000};
+        api->handle_events_timeout_completed(context, &timeout, nullptr);
+    }
+}
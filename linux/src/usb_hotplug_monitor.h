@@ -0,0 +1,55 @@
+#ifndef SINO_SCANNER_USB_HOTPLUG_MONITOR_H
+#define SINO_SCANNER_USB_HOTPLUG_MONITOR_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+/**
+ * USB Hot-plug Monitor
+ *
+ * Watches for USB devices arriving or leaving through libusb's hot-plug API
+ * and calls a listener, so detection can wake up immediately instead of
+ * waiting out an idle back-off interval.
+ *
+ * libusb-1.0.so ships next to the SDK in libs/nativeLibs but no headers do,
+ * so, like PngWrapper with libpng, the library is loaded with dlopen and the
+ * few entry points we need are resolved by hand. If libusb is missing or has
+ * no hot-plug support, start() returns false and detection simply relies on
+ * its polling schedule.
+ */
+class UsbHotplugMonitor {
+public:
+    enum class Event { Arrived, Left };
+    using Listener = std::function<void(Event event, int vendorId, int productId)>;
+
+    UsbHotplugMonitor();
+    ~UsbHotplugMonitor();
+
+    // vendorId < 0 matches any vendor. Listener runs on the monitor thread.
+    bool start(Listener listener, int vendorId = -1);
+    void stop();
+    bool isRunning() const { return running.load(); }
+
+private:
+    void run();
+    bool loadLibrary();
+
+    void* libusbHandle;
+    void* context;
+    int callbackHandle;
+    Listener listener;
+    std::thread worker;
+    std::atomic<bool> running;
+
+    struct Api;
+    Api* api;
+
+    static int onHotplug(void* ctx, void* device, int event, void* userData);
+
+    // Prevent copying
+    UsbHotplugMonitor(const UsbHotplugMonitor&) = delete;
+    UsbHotplugMonitor& operator=(const UsbHotplugMonitor&) = delete;
+};
+
+#endif //SINO_SCANNER_USB_HOTPLUG_MONITOR_H
@@ -0,0 +1,257 @@
+#include "utf8_transcoder.h"
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SINO_UTF8_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SINO_UTF8_NEON 1
+#endif
+
+namespace {
+
+constexpr uint32_t kReplacement = 0xFFFD;
+
+inline char* putCodePoint(uint32_t c, char* out) {
+    if (c < 0x80) {
+        *out++ = static_cast<char>(c);
+    } else if (c < 0x800) {
+        *out++ = static_cast<char>(0xC0 | (c >> 6));
+        *out++ = static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+        if ((c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF) {
+            c = kReplacement;
+        }
+        if (c < 0x10000) {
+            *out++ = static_cast<char>(0xE0 | (c >> 12));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xF0 | (c >> 18));
+            *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return out;
+}
+
+// |Unit| is char32_t or a 32-bit wchar_t.
+template<typename Unit>
+char* encodeUtf32Scalar(const Unit* text, const Unit* end, char* out) {
+    while (text < end) {
+        out = putCodePoint(static_cast<uint32_t>(*text++), out);
+    }
+    return out;
+}
+
+// |Unit| is char16_t or a 16-bit wchar_t. A surrogate pair split across
+// |end| is treated as unpaired.
+template<typename Unit>
+char* encodeUtf16Scalar(const Unit* text, const Unit* end, char* out) {
+    while (text < end) {
+        uint32_t c = static_cast<uint16_t>(*text++);
+        if (c >= 0xD800 && c <= 0xDBFF && text < end) {
+            uint32_t low = static_cast<uint16_t>(*text);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                text++;
+            }
+        }
+        // Anything still in the surrogate range is unpaired; putCodePoint
+        // turns it into U+FFFD.
+        out = putCodePoint(c, out);
+    }
+    return out;
+}
+
+template<typename Unit>
+char* encodeUtf32(const Unit* text, const Unit* end, char* out) {
+    static_assert(sizeof(Unit) == 4, "UTF-32 input must be 32-bit");
+#if defined(SINO_UTF8_SSE2)
+    const __m128i highBits = _mm_set1_epi32(~0x7F);
+    const __m128i zero = _mm_setzero_si128();
+    while (end - text >= 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 4));
+        __m128i nonAscii = _mm_and_si128(_mm_or_si128(a, b), highBits);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(nonAscii, zero)) == 0xFFFF) {
+            // Every lane is < 0x80, so the saturating packs are exact.
+            __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), zero);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), bytes);
+            out += 8;
+        } else {
+            out = encodeUtf32Scalar(text, text + 8, out);
+        }
+        text += 8;
+    }
+#elif defined(SINO_UTF8_NEON)
+    while (end - text >= 8) {
+        uint32x4_t a = vld1q_u32(reinterpret_cast<const uint32_t*>(text));
+        uint32x4_t b = vld1q_u32(reinterpret_cast<const uint32_t*>(text + 4));
+        if (vmaxvq_u32(vorrq_u32(a, b)) < 0x80) {
+            uint16x8_t halves = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+            vst1_u8(reinterpret_cast<uint8_t*>(out), vmovn_u16(halves));
+            out += 8;
+        } else {
+            out = encodeUtf32Scalar(text, text + 8, out);
+        }
+        text += 8;
+    }
+#endif
+    return encodeUtf32Scalar(text, end, out);
+}
+
+template<typename Unit>
+char* encodeUtf16(const Unit* text, const Unit* end, char* out) {
+    static_assert(sizeof(Unit) == 2, "UTF-16 input must be 16-bit");
+#if defined(SINO_UTF8_SSE2)
+    const __m128i highBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i zero = _mm_setzero_si128();
+    while (end - text >= 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 8));
+        __m128i nonAscii = _mm_and_si128(_mm_or_si128(a, b), highBits);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, zero)) == 0xFFFF) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(a, b));
+            out += 16;
+            text += 16;
+        } else {
+            // Stop one unit early if the block ends on a high surrogate so
+            // the pair is not split across blocks.
+            const Unit* blockEnd = text + 16;
+            uint16_t last = static_cast<uint16_t>(blockEnd[-1]);
+            if (last >= 0xD800 && last <= 0xDBFF) {
+                blockEnd--;
+            }
+            out = encodeUtf16Scalar(text, blockEnd, out);
+            text = blockEnd;
+        }
+    }
+#elif defined(SINO_UTF8_NEON)
+    while (end - text >= 16) {
+        uint16x8_t a = vld1q_u16(reinterpret_cast<const uint16_t*>(text));
+        uint16x8_t b = vld1q_u16(reinterpret_cast<const uint16_t*>(text + 8));
+        if (vmaxvq_u16(vorrq_u16(a, b)) < 0x80) {
+            vst1q_u8(reinterpret_cast<uint8_t*>(out), vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+            out += 16;
+            text += 16;
+        } else {
+            const Unit* blockEnd = text + 16;
+            uint16_t last = static_cast<uint16_t>(blockEnd[-1]);
+            if (last >= 0xD800 && last <= 0xDBFF) {
+                blockEnd--;
+            }
+            out = encodeUtf16Scalar(text, blockEnd, out);
+            text = blockEnd;
+        }
+    }
+#endif
+    return encodeUtf16Scalar(text, end, out);
+}
+
+}
+
+size_t utf32ToUtf8(const char32_t* text, size_t length, char* out) {
+    return static_cast<size_t>(encodeUtf32(text, text + length, out) - out);
+}
+
+size_t utf16ToUtf8(const char16_t* text, size_t length, char* out) {
+    return static_cast<size_t>(encodeUtf16(text, text + length, out) - out);
+}
+
+size_t wideToUtf8(const wchar_t* text, size_t length, char* out) {
+    if constexpr (sizeof(wchar_t) == 4) {
+        return static_cast<size_t>(encodeUtf32(text, text + length, out) - out);
+    } else {
+        return static_cast<size_t>(encodeUtf16(text, text + length, out) - out);
+    }
+}
+
+size_t utf32ToUtf8Scalar(const char32_t* text, size_t length, char* out) {
+    return static_cast<size_t>(encodeUtf32Scalar(text, text + length, out) - out);
+}
+
+size_t utf16ToUtf8Scalar(const char16_t* text, size_t length, char* out) {
+    return static_cast<size_t>(encodeUtf16Scalar(text, text + length, out) - out);
+}
+
+void appendUtf8(std::string& out, std::wstring_view text) {
+    size_t start = out.size();
+    size_t bytesPerUnit = sizeof(wchar_t) == 4 ? kUtf8BytesPerUtf32 : kUtf8BytesPerUtf16;
+    out.resize(start + text.size() * bytesPerUnit);
+    out.resize(start + wideToUtf8(text.data(), text.size(), out.data() + start));
+}
+
+void appendUtf8(std::string& out, std::u16string_view text) {
+    size_t start = out.size();
+    out.resize(start + text.size() * kUtf8BytesPerUtf16);
+    out.resize(start + utf16ToUtf8(text.data(), text.size(), out.data() + start));
+}
+
+std::string wideToUtf8(std::wstring_view text) {
+    std::string result;
+    appendUtf8(result, text);
+    return result;
+}
+
+std::wstring utf8ToWide(std::string_view text) {
+    std::wstring result;
+    result.reserve(text.size());
+
+    const auto* bytes = reinterpret_cast<const uint8_t*>(text.data());
+    const size_t length = text.size();
+    size_t i = 0;
+    while (i < length) {
+        uint32_t lead = bytes[i];
+        if (lead < 0x80) {
+            result.push_back(static_cast<wchar_t>(lead));
+            i++;
+            continue;
+        }
+
+        size_t extra;
+        uint32_t c;
+        uint32_t minimum;
+        if ((lead & 0xE0) == 0xC0) {
+            extra = 1; c = lead & 0x1F; minimum = 0x80;
+        } else if ((lead & 0xF0) == 0xE0) {
+            extra = 2; c = lead & 0x0F; minimum = 0x800;
+        } else if ((lead & 0xF8) == 0xF0) {
+            extra = 3; c = lead & 0x07; minimum = 0x10000;
+        } else {
+            result.push_back(static_cast<wchar_t>(kReplacement));
+            i++;
+            continue;
+        }
+
+        // A truncated or broken sequence becomes one U+FFFD; the byte that
+        // broke it is decoded again as a new lead byte.
+        size_t consumed = 1;
+        bool valid = true;
+        for (size_t k = 1; k <= extra; k++) {
+            if (i + k >= length || (bytes[i + k] & 0xC0) != 0x80) {
+                valid = false;
+                break;
+            }
+            c = (c << 6) | (bytes[i + k] & 0x3F);
+            consumed++;
+        }
+        if (!valid || c < minimum || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+            c = kReplacement;
+        }
+        i += consumed;
+
+        if constexpr (sizeof(wchar_t) == 4) {
+            result.push_back(static_cast<wchar_t>(c));
+        } else if (c >= 0x10000) {
+            c -= 0x10000;
+            result.push_back(static_cast<wchar_t>(0xD800 + (c >> 10)));
+            result.push_back(static_cast<wchar_t>(0xDC00 + (c & 0x3FF)));
+        } else {
+            result.push_back(static_cast<wchar_t>(c));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,44 @@
+#ifndef SINO_SCANNER_UTF8_TRANSCODER_H
+#define SINO_SCANNER_UTF8_TRANSCODER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * UTF-8 Transcoder
+ *
+ * Converts SDK text (wchar_t, which is UTF-32 on Linux, or UTF-16 code
+ * units from the ID-card reader) to UTF-8, and UTF-8 paths back to wchar_t.
+ *
+ * MRZ and English-name fields are almost entirely ASCII, so the encoders
+ * check blocks of 8 (UTF-32) or 16 (UTF-16) units at a time with SSE2 or
+ * NEON and narrow them straight to bytes. A block holding anything else
+ * falls back to the scalar encoder for that block only.
+ *
+ * Invalid input (unpaired surrogates, code points above U+10FFFF) becomes
+ * U+FFFD; nothing throws.
+ */
+
+// Upper bound on the bytes written for |units| input units.
+inline constexpr size_t kUtf8BytesPerUtf32 = 4;
+inline constexpr size_t kUtf8BytesPerUtf16 = 3;
+
+// Raw encoders. |out| must have room for length * kUtf8BytesPer*; the
+// output is not NUL-terminated. Return the number of bytes written.
+size_t utf32ToUtf8(const char32_t* text, size_t length, char* out);
+size_t utf16ToUtf8(const char16_t* text, size_t length, char* out);
+size_t wideToUtf8(const wchar_t* text, size_t length, char* out);
+
+// Scalar reference encoders (no SIMD), kept for the benchmark.
+size_t utf32ToUtf8Scalar(const char32_t* text, size_t length, char* out);
+size_t utf16ToUtf8Scalar(const char16_t* text, size_t length, char* out);
+
+// Appends to |out|, reusing its capacity.
+void appendUtf8(std::string& out, std::wstring_view text);
+void appendUtf8(std::string& out, std::u16string_view text);
+
+std::string wideToUtf8(std::wstring_view text);
+std::wstring utf8ToWide(std::string_view text);
+
+#endif //SINO_SCANNER_UTF8_TRANSCODER_H